@@ -7,10 +7,10 @@
 #include "hooks.h"
 
 #include "board.h"
+#include "crc8.h"
 #include "gpio.h"
 
 #include "spi.h"
-#include "spi_chip.h"
 #include "spi_flash.h"
 
 #include "flash_storage.h"
@@ -26,6 +26,26 @@
 static struct ec_flash_flags_info current_flags;
 bool flash_storage_dirty;
 
+/* Flags changed since the last commit */
+static uint32_t dirty_flags[FLASH_FLAGS_MAX / 32];
+/* Sector in use, -1 if there is no log yet */
+static int log_sector = -1;
+static uint32_t log_seq;
+/* Where the next record goes in log_sector */
+static uint32_t log_offset;
+/* Rewrite all the flags into a new sector on the next commit */
+static bool log_compact;
+
+#define SECTOR_ADDR(s) (SPI_FLAGS_REGION + (s) * FLASH_STORAGE_SECTOR_SIZE)
+#define RECORD_SIZE sizeof(struct flash_storage_record)
+/* Records written or read at once */
+#define RECORD_BATCH 16
+
+BUILD_ASSERT(FLASH_FLAGS_MAX % 32 == 0);
+BUILD_ASSERT(FLASH_STORAGE_SECTORS >= 3);
+BUILD_ASSERT(sizeof(struct flash_storage_sector_header) +
+	     FLASH_FLAGS_MAX * RECORD_SIZE <= FLASH_STORAGE_SECTOR_SIZE);
+
 bool check_flags_valid_header(void)
 {
 	if (current_flags.magic != FLASH_FLAGS_MAGIC ||
@@ -37,6 +57,18 @@ bool check_flags_valid_header(void)
 	}
 }
 
+static void set_flag_dirty(int idx)
+{
+	dirty_flags[idx / 32] |= BIT(idx % 32);
+	flash_storage_dirty = true;
+}
+
+static uint8_t record_crc(const struct flash_storage_record *r)
+{
+	return crc8((const uint8_t *)r, offsetof(struct flash_storage_record,
+						 crc));
+}
+
 void flash_storage_load_defaults(void)
 {
 		CPRINTS("Init flash storage to defaults");
@@ -44,17 +76,101 @@ void flash_storage_load_defaults(void)
 		current_flags.magic = FLASH_FLAGS_MAGIC;
 		current_flags.length = (sizeof(current_flags) - 8);
 		current_flags.version = FLASH_FLAGS_VERSION;
+		memset(dirty_flags, 0, sizeof(dirty_flags));
+		log_compact = true;
 		flash_storage_dirty = true;
 }
 
-int flash_storage_initialize(void)
+/* Find the sector in use, the valid header with the highest sequence. */
+static int flash_storage_find_log(void)
 {
+	struct flash_storage_sector_header hdr;
+	int s, rv;
+
+	log_sector = -1;
+	log_seq = 0;
+	for (s = 1; s < FLASH_STORAGE_SECTORS; s++) {
+		rv = spi_flash_read((void *)&hdr, SECTOR_ADDR(s), sizeof(hdr));
+		if (rv != EC_SUCCESS)
+			return rv;
+		if (hdr.magic != FLASH_STORAGE_LOG_MAGIC)
+			continue;
+		if (log_sector < 0 || (int32_t)(hdr.seq - log_seq) > 0) {
+			log_sector = s;
+			log_seq = hdr.seq;
+		}
+	}
+	return EC_SUCCESS;
+}
 
+/* Apply the records of the sector in use, in the order they were written. */
+static int flash_storage_replay_log(void)
+{
+	struct flash_storage_record r[RECORD_BATCH];
+	uint32_t offset = sizeof(struct flash_storage_sector_header);
+	int i, n, rv;
+
+	while (offset < FLASH_STORAGE_SECTOR_SIZE) {
+		n = MIN(RECORD_BATCH,
+			(FLASH_STORAGE_SECTOR_SIZE - offset) / RECORD_SIZE);
+		rv = spi_flash_read((void *)r, SECTOR_ADDR(log_sector) + offset,
+				    n * RECORD_SIZE);
+		if (rv != EC_SUCCESS)
+			return rv;
+
+		for (i = 0; i < n; i++, offset += RECORD_SIZE) {
+			if (r[i].idx == 0xff && r[i].value == 0xff &&
+			    r[i].reserved == 0xff && r[i].crc == 0xff)
+				goto done;
+			if (r[i].crc != record_crc(&r[i]) ||
+			    r[i].idx >= FLASH_FLAGS_MAX) {
+				CPRINTS("flash storage bad record @0x%x",
+					SECTOR_ADDR(log_sector) + offset);
+				continue;
+			}
+			current_flags.flags[r[i].idx] = r[i].value;
+		}
+	}
+done:
+	log_offset = offset;
+	return EC_SUCCESS;
+}
+
+int flash_storage_initialize(void)
+{
 	int rv;
 
+	memset(&current_flags, 0x00, sizeof(current_flags));
+	memset(dirty_flags, 0, sizeof(dirty_flags));
+	flash_storage_dirty = false;
+	log_compact = false;
+
 	spi_mux_control(1);
 
-	rv = spi_flash_read((void *)&current_flags, SPI_FLAGS_REGION, sizeof(current_flags));
+	rv = flash_storage_find_log();
+	/* The flags structure older versions read and write */
+	if (rv == EC_SUCCESS)
+		rv = spi_flash_read((void *)&current_flags, SPI_FLAGS_REGION,
+				    sizeof(current_flags));
+	if (rv == EC_SUCCESS && log_sector >= 0 &&
+	    !(check_flags_valid_header() &&
+	      (int32_t)(current_flags.update_number - log_seq) > 0)) {
+		memset(&current_flags, 0x00, sizeof(current_flags));
+		current_flags.magic = FLASH_FLAGS_MAGIC;
+		current_flags.length = (sizeof(current_flags) - 8);
+		current_flags.version = FLASH_FLAGS_VERSION;
+		current_flags.update_number = log_seq;
+		rv = flash_storage_replay_log();
+	} else if (rv == EC_SUCCESS) {
+		/*
+		 * No log yet, or an older image committed to the structure
+		 * after the last compaction: its values are the newest, move
+		 * them to the log on the next commit.
+		 */
+		if (check_flags_valid_header())
+			log_seq = current_flags.update_number;
+		log_compact = true;
+	}
 	if (rv != EC_SUCCESS)
 		CPRINTS("Could not load flash storage");
 
@@ -79,51 +195,141 @@ int flash_storage_update(enum ec_flash_flags_idx idx, uint8_t v)
 
 	if (current_flags.flags[idx] != v) {
 		current_flags.flags[idx] = v;
-		flash_storage_dirty = true;
+		set_flag_dirty(idx);
 	}
 	return EC_SUCCESS;
 }
 
+/*
+ * Append records at offset in sector: the dirty flags, or all the flags
+ * that are not 0 when the sector is being started.
+ */
+static int flash_storage_write_records(int sector, uint32_t *offset,
+				       bool all)
+{
+	struct flash_storage_record r[RECORD_BATCH];
+	int idx, n = 0, rv;
+
+	for (idx = 0; idx < FLASH_FLAGS_MAX; idx++) {
+		if (all ? !current_flags.flags[idx] :
+		    !(dirty_flags[idx / 32] & BIT(idx % 32)))
+			continue;
+
+		r[n].idx = idx;
+		r[n].value = current_flags.flags[idx];
+		r[n].reserved = 0;
+		r[n].crc = record_crc(&r[n]);
+		if (++n < RECORD_BATCH && idx < FLASH_FLAGS_MAX - 1)
+			continue;
+
+		rv = spi_flash_write(SECTOR_ADDR(sector) + *offset,
+				     n * RECORD_SIZE, (void *)r);
+		if (rv != EC_SUCCESS)
+			return rv;
+		*offset += n * RECORD_SIZE;
+		n = 0;
+	}
+	if (n) {
+		rv = spi_flash_write(SECTOR_ADDR(sector) + *offset,
+				     n * RECORD_SIZE, (void *)r);
+		if (rv != EC_SUCCESS)
+			return rv;
+		*offset += n * RECORD_SIZE;
+	}
+	return EC_SUCCESS;
+}
+
+/*
+ * Start the next sector with the current values. The header goes last, if
+ * power is lost before that the sector in use is still the previous one.
+ * Then refresh the structure in sector 0 for older images, numbered like
+ * the new sector so that it is only taken over the log once an older image
+ * has committed to it.
+ */
+static int flash_storage_compact(void)
+{
+	struct flash_storage_sector_header hdr = {
+		.magic = FLASH_STORAGE_LOG_MAGIC,
+		.seq = log_seq + 1,
+	};
+	uint32_t offset = sizeof(hdr);
+	/* The log rotates through sectors 1 and up */
+	int sector = log_sector < 0 ? 1 :
+		     log_sector % (FLASH_STORAGE_SECTORS - 1) + 1;
+	int rv;
+
+	rv = spi_flash_erase(SECTOR_ADDR(sector), FLASH_STORAGE_SECTOR_SIZE);
+	if (rv != EC_SUCCESS) {
+		CPRINTS("SPI fail to erase");
+		return rv;
+	}
+	rv = flash_storage_write_records(sector, &offset, true);
+	if (rv == EC_SUCCESS)
+		rv = spi_flash_write(SECTOR_ADDR(sector), sizeof(hdr),
+				     (void *)&hdr);
+	if (rv != EC_SUCCESS) {
+		CPRINTS("SPI fail to write");
+		return rv;
+	}
+
+	log_sector = sector;
+	log_seq = hdr.seq;
+	log_offset = offset;
+	log_compact = false;
+	current_flags.update_number = log_seq;
+
+	rv = spi_flash_erase(SPI_FLAGS_REGION, FLASH_STORAGE_SECTOR_SIZE);
+	if (rv == EC_SUCCESS)
+		rv = spi_flash_write(SPI_FLAGS_REGION, sizeof(current_flags),
+				     (void *)&current_flags);
+	if (rv != EC_SUCCESS)
+		CPRINTS("SPI fail to refresh flags structure");
+	return rv;
+}
+
 int flash_storage_commit(void)
 {
 	int rv = EC_SUCCESS;
+	int idx, count = 0;
 
 	if (check_flags_valid_header() == false)
 		flash_storage_initialize();
 
-	if (flash_storage_dirty) {
+	if (!flash_storage_dirty)
+		return rv;
 
-		spi_mux_control(1);
+	for (idx = 0; idx < FLASH_FLAGS_MAX; idx++)
+		if (dirty_flags[idx / 32] & BIT(idx % 32))
+			count++;
 
-		rv = spi_flash_erase(SPI_FLAGS_REGION, 0x1000);
-
-		if (rv != EC_SUCCESS) {
-			CPRINTS("SPI fail to erase");
-			goto fail;
-		}
-
-		current_flags.update_number += 1;
-
-		rv = spi_flash_write(SPI_FLAGS_REGION,
-								sizeof(current_flags),
-								(void *)&current_flags);
+	spi_mux_control(1);
 
-		if (rv != EC_SUCCESS) {
+	if (log_sector < 0 || log_compact ||
+	    log_offset + count * RECORD_SIZE > FLASH_STORAGE_SECTOR_SIZE) {
+		rv = flash_storage_compact();
+	} else {
+		rv = flash_storage_write_records(log_sector, &log_offset,
+						 false);
+		if (rv != EC_SUCCESS)
 			CPRINTS("SPI fail to write");
-			goto fail;
-		}
+	}
 
-		CPRINTS("%s, update:%d", __func__, current_flags.update_number);
+	spi_mux_control(0);
 
-		spi_mux_control(0);
+	if (rv == EC_SUCCESS) {
+		CPRINTS("%s, sector:%d seq:%d used:%d", __func__, log_sector,
+			log_seq, log_offset);
+		memset(dirty_flags, 0, sizeof(dirty_flags));
 		flash_storage_dirty = false;
+	} else {
+		/*
+		 * Part of the records may have made it, start a new sector
+		 * next time rather than appending after them.
+		 */
+		log_compact = true;
 	}
 
 	return rv;
-
-fail:
-	spi_mux_control(0);
-	return rv;
 }
 
 int flash_storage_get(enum ec_flash_flags_idx idx)
@@ -143,6 +349,14 @@ static int cmd_flash_flags(int argc, char **argv)
 	int i, d;
 	char *e;
 
+	if (argc == 2 && !strcasecmp(argv[1], "info")) {
+		if (check_flags_valid_header() == false)
+			flash_storage_initialize();
+		ccprintf("sector:%d seq:%d used:%d/%d dirty:%d\n", log_sector,
+			 log_seq, log_offset, FLASH_STORAGE_SECTOR_SIZE,
+			 flash_storage_dirty);
+		return EC_SUCCESS;
+	}
 
 	if (argc >= 3) {
 
@@ -170,5 +384,5 @@ static int cmd_flash_flags(int argc, char **argv)
 	return EC_ERROR_PARAM2;
 }
 DECLARE_CONSOLE_COMMAND(flashflag, cmd_flash_flags,
-			"[read/write] i [d]",
+			"info | [read/write] i [d]",
 			"read or write bytes from flags structure");
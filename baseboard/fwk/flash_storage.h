@@ -8,7 +8,22 @@
 #ifndef __CROS_EC_FLASHSTORAGE_H
 #define __CROS_EC_FLASHSTORAGE_H
 
+/*
+ * Flags are kept in a log spread over the FLASH_STORAGE_SECTORS - 1 sectors
+ * that follow SPI_FLAGS_REGION, above the 512KB used by the EC images. Each
+ * sector starts with a header and is followed by records appended in order,
+ * the valid header with the highest sequence number marks the sector in
+ * use. When it fills up its live values are copied to the next sector, so
+ * erases rotate through all of them.
+ *
+ * The first sector keeps struct ec_flash_flags_info, which older images
+ * read and write. It is rewritten with the values of each new log sector,
+ * update_number set to its sequence number. A higher update_number means an
+ * older image committed to it since, and its values are taken over the log.
+ */
 #define SPI_FLAGS_REGION (0x80000)
+#define FLASH_STORAGE_SECTOR_SIZE (0x1000)
+#define FLASH_STORAGE_SECTORS 4
 
 enum ec_flash_flags_idx {
 	FLASH_FLAGS_ACPOWERON = 0,
@@ -34,6 +49,37 @@ struct ec_flash_flags_info {
 
 } __ec_align1;
 
+#define FLASH_STORAGE_LOG_MAGIC (0x474f4c46) /* "FLOG" */
+
+struct flash_storage_sector_header {
+	uint32_t magic; /* FLASH_STORAGE_LOG_MAGIC */
+	uint32_t seq; /* Incremented every time a sector is started */
+} __ec_align1;
+
+/*
+ * One flag value. Blank records read as 0xff, so the log ends at the first
+ * record that is all 0xff. Records failing the CRC (write interrupted by a
+ * power loss) are skipped.
+ */
+struct flash_storage_record {
+	uint8_t idx; /* ec_flash_flags_idx */
+	uint8_t value;
+	uint8_t reserved; /* 0 */
+	uint8_t crc; /* crc8 of the bytes above */
+} __ec_align1;
+
+/* Give the SPI flash to the EC (1) or back to the host (0), from the board */
+void spi_mux_control(int enable);
+
+/**
+ * @brief Load the flags from flash, dropping changes not committed
+ *
+ * Called on first access.
+ *
+ * @return int EC_SUCCESS, or an error if flash could not be read
+ */
+int flash_storage_initialize(void);
+
 /**
  * @brief Update flags value at idx, but does not write to flash
  *
@@ -46,6 +92,9 @@ int flash_storage_update(enum ec_flash_flags_idx idx, uint8_t v);
 /**
  * @brief Commits storage if dirty
  *
+ * Appends a record per changed flag, a sector is only erased when the one
+ * in use is full or after flash_storage_load_defaults().
+ *
  * @return int EC_SUCCESS
  */
 int flash_storage_commit(void);
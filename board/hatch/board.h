@@ -31,6 +31,8 @@
 #define CONFIG_ACCELGYRO_BMI160_INT_EVENT \
 	TASK_EVENT_MOTION_SENSOR_INTERRUPT(BASE_ACCEL)
 #define CONFIG_ACCELGYRO_BMI160_INT2_OUTPUT
+/* Read the BMI160 FIFO in blocks, the next one on the bus during decoding */
+#define CONFIG_I2C_ASYNC
 /* BMA253 Lid accel */
 #define CONFIG_ACCEL_BMA255
 #define CONFIG_ACCEL_FORCE_MODE_MASK (BIT(LID_ACCEL) | BIT(CLEAR_ALS))
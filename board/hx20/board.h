@@ -60,6 +60,12 @@
 #define CONFIG_SYSTEMSERIAL_DEBUG
 #endif
 
+/* CRC-32 slicing-by-4, large buffers on the DMA CRC engine */
+#define CONFIG_SW_CRC
+#undef CONFIG_SW_CRC_SLICE
+#define CONFIG_SW_CRC_SLICE 4
+#define CONFIG_DMA_CRC
+
 /*
  * DEBUG: Add CRC32 in last 4 bytes of EC_RO/RW binaries
  * in SPI. LFW will use DMA CRC32 HW to check data integrity.
@@ -330,6 +336,9 @@
 #define CONFIG_FLASH_SIZE 0x100000
 #define CONFIG_SPI_FLASH_W25Q80
 
+/* Record checksums of the flash_storage log */
+#define CONFIG_CRC8
+
 /*
  * Enable extra SPI flash and generic SPI
  * commands via EC UART
@@ -60,6 +60,12 @@
 #define CONFIG_SYSTEMSERIAL_DEBUG
 #endif
 
+/* CRC-32 slicing-by-4, large buffers on the DMA CRC engine */
+#define CONFIG_SW_CRC
+#undef CONFIG_SW_CRC_SLICE
+#define CONFIG_SW_CRC_SLICE 4
+#define CONFIG_DMA_CRC
+
 /*
  * DEBUG: Add CRC32 in last 4 bytes of EC_RO/RW binaries
  * in SPI. LFW will use DMA CRC32 HW to check data integrity.
@@ -338,6 +344,9 @@
  */
 #define CONFIG_FLASH_SIZE 0x100000
 #define CONFIG_SPI_FLASH_W25Q80
+
+/* Record checksums of the flash_storage log */
+#define CONFIG_CRC8
 #define SPI_BIOS_SETUP 0x00
 
 #define BIOS_SETUP_AC_BOOT	BIT(0)
@@ -530,6 +539,7 @@
  * All other ports set to 0xff (not used)
  */
 #define CONFIG_I2C_DEBUG
+#define CONFIG_I2C_PROFILE
 #define I2C_PORT_TOUCHPAD		MCHP_I2C_PORT2
 #define I2C_PORT_PD_MCU0        MCHP_I2C_PORT6
 #define I2C_PORT_PD_MCU1        MCHP_I2C_PORT7
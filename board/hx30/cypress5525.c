@@ -113,6 +113,34 @@ int cypd_write_reg_block(int controller, int reg, void *data, int len)
 	return rv;
 }
 
+int cypd_write_reg_block_pair(int controller, int reg0, void *data0, int len0,
+			      int reg1, void *data1, int len1)
+{
+	int rv;
+	uint16_t i2c_port = pd_chip_config[controller].i2c_port;
+	uint16_t addr_flags = pd_chip_config[controller].addr_flags;
+	/* Register offsets are 16 bit little endian */
+	uint8_t offset0[2] = {reg0 & 0xff, (reg0 >> 8) & 0xff};
+	uint8_t offset1[2] = {reg1 & 0xff, (reg1 >> 8) & 0xff};
+	struct i2c_msg msgs[] = {
+		{ addr_flags, 0, offset0, sizeof(offset0) },
+		{ addr_flags, I2C_MSG_NOSTART | I2C_MSG_STOP, data0, len0 },
+		{ addr_flags, 0, offset1, sizeof(offset1) },
+		{ addr_flags, I2C_MSG_NOSTART, data1, len1 },
+	};
+
+	/*
+	 * Two STOP terminated writes as cypd_write_reg_block() does, with no
+	 * other transfer in between. Joining them with a repeated START needs
+	 * validating on the PD controller first.
+	 */
+	rv = i2c_xfer_msgs(i2c_port, msgs, ARRAY_SIZE(msgs));
+	if (rv != EC_SUCCESS)
+		CPRINTS("%s failed: ctrl=0x%x, reg=0x%02x/0x%02x", __func__,
+			controller, reg0, reg1);
+	return rv;
+}
+
 int cypd_write_reg16(int controller, int reg, int data)
 {
 	int rv;
@@ -367,8 +395,9 @@ static void port_to_safe_mode(int port)
 	uint8_t data[2] = {0x00, CCG_PD_USER_MUX_CONFIG_SAFE};
 
 	data[0] = PORT_TO_CONTROLLER_PORT(port);
-	cypd_write_reg_block(PORT_TO_CONTROLLER(port), CYP5225_MUX_CFG_REG, data, 2);
-	cypd_write_reg_block(PORT_TO_CONTROLLER(port), CYP5225_DEINIT_PORT_REG, data, 1);
+	cypd_write_reg_block_pair(PORT_TO_CONTROLLER(port),
+				  CYP5225_MUX_CFG_REG, data, 2,
+				  CYP5225_DEINIT_PORT_REG, data, 1);
 	CPRINTS("P%d: Safe", port);
 }
 
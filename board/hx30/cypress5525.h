@@ -457,6 +457,10 @@ int cypd_write_reg8(int controller, int reg, int data);
 
 int cypd_write_reg_block(int controller, int reg, void *data, int len);
 
+/* Write two register blocks, nothing else goes on the bus in between */
+int cypd_write_reg_block_pair(int controller, int reg0, void *data0, int len0,
+			      int reg1, void *data1, int len1);
+
 int cypd_read_reg_block(int controller, int reg, void *data, int len);
 
 void cypd_reinitialize(void);
@@ -10,6 +10,7 @@
 #include "host_command.h"
 #include "peci.h"
 #include "peci_customization.h"
+#include "task.h"
 #include "timer.h"
 #include "util.h"
 
@@ -21,10 +22,72 @@ static int peci_temp;
 static int peci_select_count;
 static int peci_select_flags;
 
+/*
+ * PECI service layer.
+ *
+ * Thermal hooks, cpu_power.c and console commands all talk to the CPU, and
+ * each round trip goes over the bus. Transactions are serialized by
+ * peci_lock; RdPkgConfig results are cached for as long as their index
+ * allows, and a caller which had to wait for the lock while the same cached
+ * read was in flight gets that result instead of issuing it again. WrPkgConfig
+ * is skipped when the data is the one last written, refreshing it now and
+ * then in case the host changed it.
+ */
+static struct mutex peci_lock;
+
+#define PECI_CACHE_SIZE 4
+#define PECI_CACHE_FOREVER UINT32_MAX
+#define PECI_WRITTEN_SIZE 4
+#define PECI_WRITE_REFRESH_US (30 * SECOND)
+
+/* How long RdPkgConfig results stay valid, by index; others are not cached */
+static const struct {
+	uint8_t index;
+	uint32_t max_age_us;
+} peci_cache_policy[] = {
+	/* CPU ID, platform ID, microcode: until the CPU is reset */
+	{ PECI_INDEX_PACKAGE_INDENTIFIER_READ, PECI_CACHE_FOREVER },
+	/* TjMax and TCC activation offset */
+	{ PECI_INDEX_TEMP_TARGET_READ, 10 * SECOND },
+};
+
+struct peci_cache_entry {
+	timestamp_t filled;
+	uint16_t parameter;
+	uint8_t index;
+	/* 0 if the entry is free */
+	uint8_t len;
+	uint8_t data[PECI_RD_PKG_CONFIG_READ_LENGTH_DWORD];
+};
+static struct peci_cache_entry peci_cache[PECI_CACHE_SIZE];
+
+struct peci_written_entry {
+	timestamp_t written;
+	uint32_t data;
+	uint16_t parameter;
+	uint8_t index;
+	uint8_t valid;
+};
+static struct peci_written_entry peci_written[PECI_WRITTEN_SIZE];
+
+static struct {
+	/* RdPkgConfig served from the cache */
+	uint32_t hits;
+	/* RdPkgConfig served by a read issued while waiting for it */
+	uint32_t coalesced;
+	uint32_t misses;
+	uint32_t writes;
+	/* WrPkgConfig skipped, data unchanged */
+	uint32_t suppressed;
+	/* Temperature reads served from the last poll */
+	uint32_t temp_reads;
+} peci_stats;
+
 /*****************************************************************************/
 /* Internal functions */
 
-int peci_Rd_Pkg_Config(uint8_t index, uint16_t parameter, int rlen, uint8_t *in)
+static int peci_rd_pkg_config_xfer(uint8_t index, uint16_t parameter, int rlen,
+				   uint8_t *in)
 {
 	int rv;
 	uint8_t out[PECI_RD_PKG_CONFIG_WRITE_LENGTH];
@@ -51,7 +114,8 @@ int peci_Rd_Pkg_Config(uint8_t index, uint16_t parameter, int rlen, uint8_t *in)
 	return EC_SUCCESS;
 }
 
-int peci_Wr_Pkg_Config(uint8_t index, uint16_t parameter, uint32_t data, int wlen)
+static int peci_wr_pkg_config_xfer(uint8_t index, uint16_t parameter,
+				   uint32_t data, int wlen)
 {
 	int rv;
 	int clen;
@@ -97,6 +161,163 @@ int peci_Wr_Pkg_Config(uint8_t index, uint16_t parameter, uint32_t data, int wle
 	return EC_SUCCESS;
 }
 
+static uint32_t peci_cache_max_age(uint8_t index)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(peci_cache_policy); i++)
+		if (peci_cache_policy[i].index == index)
+			return peci_cache_policy[i].max_age_us;
+	return 0;
+}
+
+static uint64_t peci_cache_expiry(const struct peci_cache_entry *e)
+{
+	return e->filled.val + peci_cache_max_age(e->index);
+}
+
+/*
+ * Entry for index/parameter, or the one to replace if there is none: a free
+ * one, else the one expiring first, expired ones being the first.
+ */
+static struct peci_cache_entry *peci_cache_get(uint8_t index,
+					       uint16_t parameter, int *found)
+{
+	struct peci_cache_entry *victim = &peci_cache[0];
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(peci_cache); i++) {
+		struct peci_cache_entry *e = &peci_cache[i];
+
+		if (e->len && e->index == index && e->parameter == parameter) {
+			*found = 1;
+			return e;
+		}
+		if (!e->len || (victim->len &&
+				peci_cache_expiry(e) < peci_cache_expiry(victim)))
+			victim = e;
+	}
+
+	*found = 0;
+	return victim;
+}
+
+static struct peci_written_entry *peci_written_get(uint8_t index,
+						   uint16_t parameter)
+{
+	struct peci_written_entry *free = NULL;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(peci_written); i++) {
+		struct peci_written_entry *w = &peci_written[i];
+
+		if (w->valid && w->index == index && w->parameter == parameter)
+			return w;
+		if (!w->valid && !free)
+			free = w;
+	}
+
+	return free;
+}
+
+/* Forget everything cached, the CPU lost or is about to lose its state. */
+static void peci_cache_invalidate(void)
+{
+	mutex_lock(&peci_lock);
+	memset(peci_cache, 0, sizeof(peci_cache));
+	memset(peci_written, 0, sizeof(peci_written));
+	mutex_unlock(&peci_lock);
+}
+DECLARE_HOOK(HOOK_CHIPSET_STARTUP, peci_cache_invalidate, HOOK_PRIO_DEFAULT);
+DECLARE_HOOK(HOOK_CHIPSET_RESUME, peci_cache_invalidate, HOOK_PRIO_DEFAULT);
+DECLARE_HOOK(HOOK_CHIPSET_SHUTDOWN, peci_cache_invalidate, HOOK_PRIO_DEFAULT);
+
+int peci_Rd_Pkg_Config(uint8_t index, uint16_t parameter, int rlen, uint8_t *in)
+{
+	const timestamp_t start = get_time();
+	const uint32_t max_age = peci_cache_max_age(index);
+	struct peci_cache_entry *e;
+	int found, rv;
+
+	mutex_lock(&peci_lock);
+
+	/* Not worth an entry if it can't be kept */
+	if (rlen > sizeof(e->data) || !max_age) {
+		rv = peci_rd_pkg_config_xfer(index, parameter, rlen, in);
+		mutex_unlock(&peci_lock);
+		return rv;
+	}
+
+	e = peci_cache_get(index, parameter, &found);
+	if (found && e->len == rlen) {
+		if (e->filled.val >= start.val) {
+			/* Read by someone else while we were waiting */
+			peci_stats.coalesced++;
+			memcpy(in, e->data, rlen);
+			mutex_unlock(&peci_lock);
+			return EC_SUCCESS;
+		} else if (start.val - e->filled.val < max_age) {
+			peci_stats.hits++;
+			memcpy(in, e->data, rlen);
+			mutex_unlock(&peci_lock);
+			return EC_SUCCESS;
+		}
+	}
+
+	peci_stats.misses++;
+	rv = peci_rd_pkg_config_xfer(index, parameter, rlen, in);
+	if (rv == EC_SUCCESS) {
+		e->filled = get_time();
+		e->index = index;
+		e->parameter = parameter;
+		e->len = rlen;
+		memcpy(e->data, in, rlen);
+	} else if (found) {
+		e->len = 0;
+	}
+
+	mutex_unlock(&peci_lock);
+
+	return rv;
+}
+
+int peci_Wr_Pkg_Config(uint8_t index, uint16_t parameter, uint32_t data, int wlen)
+{
+	const timestamp_t now = get_time();
+	struct peci_written_entry *w;
+	int i, rv;
+
+	mutex_lock(&peci_lock);
+
+	w = peci_written_get(index, parameter);
+	if (w && w->valid && w->data == data &&
+	    now.val - w->written.val < PECI_WRITE_REFRESH_US) {
+		peci_stats.suppressed++;
+		mutex_unlock(&peci_lock);
+		return EC_SUCCESS;
+	}
+
+	peci_stats.writes++;
+	rv = peci_wr_pkg_config_xfer(index, parameter, data, wlen);
+
+	/* Reads of that index may return something else now */
+	for (i = 0; i < ARRAY_SIZE(peci_cache); i++)
+		if (peci_cache[i].index == index)
+			peci_cache[i].len = 0;
+
+	if (w) {
+		w->valid = (rv == EC_SUCCESS);
+		w->index = index;
+		w->parameter = parameter;
+		w->data = data;
+		w->written = now;
+	}
+
+	mutex_unlock(&peci_lock);
+
+	return rv;
+}
+
 static int peci_over_espi_get_cpu_temp(int *cpu_temp)
 {
 	int rv;
@@ -125,10 +346,8 @@ static int peci_over_espi_get_cpu_temp(int *cpu_temp)
 	} else {
 		rv = espi_oob_peci_transaction(&peci);
 
-		if (rv == EC_ERROR_TIMEOUT) {
+		if (rv == EC_ERROR_TIMEOUT)
 			CPRINTS("ESPI GET VALUE TIMEOUT!");
-			espi_oob_retry_receive_date(r_buf);
-		}
 	}
 
 	if (rv)
@@ -283,6 +502,7 @@ int peci_over_espi_temp_sensor_get_val(int idx, int *temp_ptr)
 		return EC_ERROR_INVAL;
 
 	*temp_ptr = peci_temp;
+	peci_stats.temp_reads++;
 
 	return EC_SUCCESS;
 }
@@ -299,7 +519,9 @@ void read_peci_over_espi_gettemp(void)
 		peci_temp = 0xfffe;
 	} else {
 		for (i = 0; i < 2; i++) {
+			mutex_lock(&peci_lock);
 			rv = peci_over_espi_get_cpu_temp(&peci_temp);
+			mutex_unlock(&peci_lock);
 			if (!rv)
 				break;
 			msleep(10);
@@ -310,3 +532,40 @@ void read_peci_over_espi_gettemp(void)
 	}
 }
 DECLARE_HOOK(HOOK_SECOND, read_peci_over_espi_gettemp, HOOK_PRIO_DEFAULT);
+
+static int cmd_pecicache(int argc, char **argv)
+{
+	int i;
+
+	if (argc == 2 && !strcasecmp(argv[1], "flush")) {
+		peci_cache_invalidate();
+		return EC_SUCCESS;
+	} else if (argc == 2 && !strcasecmp(argv[1], "reset")) {
+		memset(&peci_stats, 0, sizeof(peci_stats));
+		return EC_SUCCESS;
+	} else if (argc != 1) {
+		return EC_ERROR_PARAM_COUNT;
+	}
+
+	ccprintf("read  hit %u coalesced %u miss %u\n", peci_stats.hits,
+		 peci_stats.coalesced, peci_stats.misses);
+	ccprintf("write %u suppressed %u\n", peci_stats.writes,
+		 peci_stats.suppressed);
+	ccprintf("temp  %u cached reads\n", peci_stats.temp_reads);
+
+	mutex_lock(&peci_lock);
+	for (i = 0; i < ARRAY_SIZE(peci_cache); i++) {
+		const struct peci_cache_entry *e = &peci_cache[i];
+
+		if (e->len)
+			ccprintf("  0x%02x/0x%04x %ph\n", e->index,
+				 e->parameter, HEX_BUF(e->data, e->len));
+	}
+	mutex_unlock(&peci_lock);
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(pecicache, cmd_pecicache,
+			"[flush|reset]",
+			"Show PECI cache statistics, flush the cache or reset "
+			"the counters");
@@ -51,9 +51,13 @@
 #define PECI_PL4_POWER_LIMIT(x)                 (x << 3)
 
 
+/*
+ * RdPkgConfig results are cached according to their index, concurrent reads
+ * of the same index/parameter are coalesced. WrPkgConfig of the data last
+ * written is skipped. Both are serialized with the GetTemp polling.
+ */
 int peci_Rd_Pkg_Config(uint8_t index, uint16_t parameter, int rlen, uint8_t *in);
 int peci_Wr_Pkg_Config(uint8_t index, uint16_t parameter, uint32_t data, int wlen);
-int espi_oob_retry_receive_date(uint8_t *readBuf);
 int espi_oob_peci_transaction(struct peci_data *peci);
 
 int peci_update_PL1(int watt);
@@ -7,6 +7,7 @@
 #include "espi.h"
 #include "peci.h"
 #include "peci_customization.h"
+#include "timer.h"
 #include "util.h"
 
 #define CPRINTS(format, args...) cprints(CC_LPC, format, ## args)
@@ -15,9 +16,13 @@
 #define ESPI_OOB_SMB_SLAVE_DEST_ADDR_PMC_FW 0x20
 #define ESPI_OOB_PECI_CMD 0x01
 
+/* PMC replies within a few ms, the OOB channel may have others queued */
+#define ESPI_OOB_PECI_TIMEOUT_US (15 * MSEC)
+
 
 int espi_oob_peci_transaction(struct peci_data *peci)
 {
+	struct espi_oob_peci_req req;
 	uint8_t espiOobMsg[16];
 	uint8_t aw_FCS_calc;
 	uint8_t OobWrLen = peci->w_len + 4;
@@ -42,7 +47,13 @@ int espi_oob_peci_transaction(struct peci_data *peci)
 	}
 
 
-	return espi_oob_build_peci_command(ESPI_OOB_SMB_SLAVE_SRC_ADDR_EC,
-		ESPI_OOB_SMB_SLAVE_DEST_ADDR_PMC_FW, ESPI_OOB_PECI_CMD,
-		OobWrLen, espiOobMsg, peci->r_buf);
+	req.src_addr = ESPI_OOB_SMB_SLAVE_SRC_ADDR_EC;
+	req.dest_addr = ESPI_OOB_SMB_SLAVE_DEST_ADDR_PMC_FW;
+	req.cmd_code = ESPI_OOB_PECI_CMD;
+	req.n_write = OobWrLen;
+	req.write_buf = espiOobMsg;
+	req.read_size = peci->r_len;
+	req.read_buf = peci->r_buf;
+
+	return espi_oob_peci_xfer(&req, ESPI_OOB_PECI_TIMEOUT_US);
 }
@@ -12,6 +12,7 @@
 #include "temp_sensor.h"
 #include "console.h"
 #include "peci.h"
+#include "peci_customization.h"
 
 /* update the mk temperature to offset EC_MEMMAP_CUSTOM_TEMP */
 __override void board_update_temperature_mk(enum temp_sensor_id id)
@@ -44,7 +45,8 @@ __override void board_update_temperature_mk(enum temp_sensor_id id)
 		break;
 	case 4:
 		/* PECI temp */
-		peci_temp_sensor_get_val(0, &temp_mk_ptr);
+		/* Last polled value, don't wait on the bus */
+		peci_over_espi_temp_sensor_get_val(0, &temp_mk_ptr);
 		temp_mk_ptr = temp_mk_ptr * 10;
 		break;
 	default:
@@ -131,8 +131,9 @@ int ucsi_write_tunnel(void)
 			i = 0;
 
 		pd_chip_ucsi_info[i].write_tunnel_complete = 1;
-		rv = cypd_write_reg_block(i, CYP5525_MESSAGE_OUT_REG, message_out, 16);
-		rv = cypd_write_reg_block(i, CYP5525_CONTROL_REG, command, 8);
+		rv = cypd_write_reg_block_pair(i,
+					       CYP5525_MESSAGE_OUT_REG, message_out, 16,
+					       CYP5525_CONTROL_REG, command, 8);
 		break;
 	default:
 		for (i = 0; i < PD_CHIP_COUNT; i++) {
@@ -142,11 +143,9 @@ int ucsi_write_tunnel(void)
 				continue;
 			}
 
-			rv = cypd_write_reg_block(i, CYP5525_MESSAGE_OUT_REG, message_out, 16);
-			if (rv != EC_SUCCESS)
-				break;
-
-			rv = cypd_write_reg_block(i, CYP5525_CONTROL_REG, command, 8);
+			rv = cypd_write_reg_block_pair(i,
+						       CYP5525_MESSAGE_OUT_REG, message_out, 16,
+						       CYP5525_CONTROL_REG, command, 8);
 			if (rv != EC_SUCCESS)
 				break;
 
@@ -77,9 +77,16 @@ static int test_check_detached(const int port,
 	return 0;
 }
 
-int chip_i2c_xfer(const int port, const uint16_t slave_addr_flags,
-		  const uint8_t *out, int out_size,
-		  uint8_t *in, int in_size, int flags)
+/*
+ * Ports left open by a transfer without STOP. Like a real controller, a
+ * transfer continuing without START on a released bus fails, and the bus is
+ * released after an error.
+ */
+static uint8_t bus_open[I2C_PORT_COUNT];
+
+static int i2c_emul_xfer(const int port, const uint16_t slave_addr_flags,
+			 const uint8_t *out, int out_size,
+			 uint8_t *in, int in_size, int flags)
 {
 	const struct test_i2c_xfer *p;
 	int rv;
@@ -96,6 +103,26 @@ int chip_i2c_xfer(const int port, const uint16_t slave_addr_flags,
 	return EC_ERROR_UNKNOWN;
 }
 
+int chip_i2c_xfer(const int port, const uint16_t slave_addr_flags,
+		  const uint8_t *out, int out_size,
+		  uint8_t *in, int in_size, int flags)
+{
+	int rv;
+
+	if (port < 0 || port >= ARRAY_SIZE(bus_open))
+		return i2c_emul_xfer(port, slave_addr_flags, out, out_size,
+				     in, in_size, flags);
+
+	if (!(flags & I2C_XFER_START) && !bus_open[port])
+		return EC_ERROR_UNKNOWN;
+
+	rv = i2c_emul_xfer(port, slave_addr_flags, out, out_size,
+			   in, in_size, flags);
+	bus_open[port] = rv == EC_SUCCESS && !(flags & I2C_XFER_STOP);
+
+	return rv;
+}
+
 int chip_i2c_set_freq(int port, enum i2c_freq freq)
 {
 	return EC_ERROR_UNIMPLEMENTED;
@@ -19,6 +19,8 @@
 #undef  CONFIG_MAPPED_STORAGE
 #undef  CONFIG_FLASH_PSTATE
 #define CONFIG_SPI_FLASH
+/* Reads can run on QMSPI DMA in the background */
+#define CONFIG_FLASH_READ_ASYNC
 
 /*
  * MEC17xx BootROM uses two 4-byte TAG's at SPI offset 0x0 and 0x04.
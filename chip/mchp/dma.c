@@ -5,6 +5,7 @@
 
 #include "common.h"
 #include "console.h"
+#include "crc.h"
 #include "dma.h"
 #include "hooks.h"
 #include "registers.h"
@@ -359,13 +360,13 @@ uint32_t dma_is_done_chan(enum dma_channel ch)
 }
 
 /*
- * Use DMA Channel 0 CRC32 ALU to compute CRC32 of data.
+ * Use DMA Channel 0 CRC32 ALU to compute CRC32 of data, starting from seed.
  * Hardware implements IEEE 802.3 CRC32.
- * IEEE 802.3 CRC32 initial value = 0xffffffff.
  * Data must be aligned >= 4-bytes and number of bytes must
  * be a multiple of 4.
  */
-int dma_crc32_start(const uint8_t *mstart, const uint32_t nbytes, int ien)
+static int dma_crc32_seed_start(uint32_t seed, const uint8_t *mstart,
+				const uint32_t nbytes, int ien)
 {
 	if ((mstart == NULL) || (nbytes == 0))
 		return EC_ERROR_INVAL;
@@ -378,7 +379,7 @@ int dma_crc32_start(const uint8_t *mstart, const uint32_t nbytes, int ien)
 	MCHP_DMA_CH_IEN(0) = 0;
 	MCHP_DMA_CH_ISTS(0) = 0xff;
 	MCHP_DMA_CH0_CRC32_EN = 1;
-	MCHP_DMA_CH0_CRC32_DATA	= 0xfffffffful;
+	MCHP_DMA_CH0_CRC32_DATA	= seed;
 	/* program device address to point to read-only register */
 	MCHP_DMA_CH_DEV_ADDR(0) = (uint32_t)(MCHP_DMA_CH_BASE + 0x1c);
 	MCHP_DMA_CH_MEM_START(0) = (uint32_t)mstart;
@@ -391,3 +392,50 @@ int dma_crc32_start(const uint8_t *mstart, const uint32_t nbytes, int ien)
 	MCHP_DMA_CH_CTRL(0) |= MCHP_DMA_SW_GO;
 	return EC_SUCCESS;
 }
+
+/*
+ * IEEE 802.3 CRC32 initial value = 0xffffffff.
+ */
+int dma_crc32_start(const uint8_t *mstart, const uint32_t nbytes, int ien)
+{
+	return dma_crc32_seed_start(0xfffffffful, mstart, nbytes, ien);
+}
+
+#if defined(CONFIG_DMA_CRC) && !defined(LFW)
+/* Channel 0 moves 4 bytes per bus cycle, this is plenty for any buffer. */
+#define CRC32_DMA_TIMEOUT_US 10000
+
+static struct mutex crc32_dma_lock;
+
+/*
+ * The CRC32 data register is seeded with the running CRC and reads back
+ * its complement: LFW compares it with the zlib.crc32() of the image.
+ */
+int crc32_dma_hash(uint32_t *ctx, const void *buf, int size)
+{
+	timestamp_t deadline;
+	uint32_t sts;
+	int rv;
+
+	mutex_lock(&crc32_dma_lock);
+	rv = dma_crc32_seed_start(*ctx, buf, size, 0);
+	if (rv == EC_SUCCESS) {
+		deadline.val = get_time().val + CRC32_DMA_TIMEOUT_US;
+		while (!(sts = dma_is_done_chan(0))) {
+			if (timestamp_expired(deadline, NULL)) {
+				rv = EC_ERROR_TIMEOUT;
+				break;
+			}
+		}
+		if (rv == EC_SUCCESS && sts != MCHP_DMA_STS_DONE)
+			rv = EC_ERROR_HW_INTERNAL;
+		if (rv == EC_SUCCESS)
+			*ctx = MCHP_DMA_CH0_CRC32_DATA ^ 0xfffffffful;
+		dma_clr_chan(0);
+		MCHP_DMA_CH0_CRC32_EN = 0;
+	}
+	mutex_unlock(&crc32_dma_lock);
+
+	return rv;
+}
+#endif
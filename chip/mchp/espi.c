@@ -27,6 +27,7 @@
 #include "util.h"
 #include "power.h"
 #include "timer.h"
+#include "peci.h"
 #include "tfdp_chip.h"
 
 /* Console output macros */
@@ -55,6 +56,16 @@
 #define ESPI_CHAN_READY_TIMEOUT_US (100 * MSEC)
 #define ESPI_CHAN_READY_POLL_INTERVAL_US 100
 
+/* OOB channel status bits */
+#define ESPI_OOB_RX_STS_DONE	BIT(0)
+#define ESPI_OOB_RX_STS_ERR	(BIT(1) | BIT(2))
+#define ESPI_OOB_TX_STS_ERR	(BIT(2) | BIT(3) | BIT(5))
+#define ESPI_OOB_TX_IEN_DONE	BIT(0)
+#define ESPI_OOB_TX_IEN_CHEN	BIT(1)
+
+/* How long to hold the OOB channel for the late reply of a timed out request */
+#define ESPI_OOB_DRAIN_US	(20 * MSEC)
+
 static uint32_t espi_channels_ready;
 static uint8_t espi_slave_oobDn[128]; /* Rx buffer */
 static uint8_t espi_slave_oobUp[128]; /* Tx buffer */
@@ -474,7 +485,8 @@ void espi_oob_init(void)
 	MCHP_ESPI_OOB_TX_ADDR_LO = espi_OOB_TxUp_BufferAddress;
 	MCHP_ESPI_OOB_TX_LEN = 0x04;
 
-	MCHP_ESPI_OOB_TX_IEN |= BIT(1);
+	/* Transmit errors are reported with DONE */
+	MCHP_ESPI_OOB_TX_IEN |= ESPI_OOB_TX_IEN_DONE | ESPI_OOB_TX_IEN_CHEN;
 	MCHP_ESPI_OOB_RX_IEN |= BIT(0);
 	CPRINTS("init RXIN=0x%08x", MCHP_ESPI_OOB_RX_IEN);
 }
@@ -578,6 +590,8 @@ static void espi_host_init(void)
 DECLARE_HOOK(HOOK_CHIPSET_STARTUP, espi_host_init, HOOK_PRIO_FIRST);
 
 
+static void espi_oob_abort(int rv);
+
 /*
  * Called in response to VWire OOB_RST_WARN==1 from
  * espi_vw_evt_oob_rst_warn.
@@ -587,6 +601,7 @@ DECLARE_HOOK(HOOK_CHIPSET_STARTUP, espi_host_init, HOOK_PRIO_FIRST);
  */
 static void espi_oob_flush(void)
 {
+	espi_oob_abort(EC_ERROR_NOT_POWERED);
 }
 
 
@@ -1022,42 +1037,55 @@ void espi_vw_evt2_dflt(uint32_t wire_state, uint32_t bpos)
 	MCHP_INT_DISABLE(25) = (1ul << bpos);
 }
 
-int espi_oob_retry_receive_date(uint8_t *readBuf)
-{
-	int retry = 2;
-	int i;
-	/* Clear slave OOB Dn/Up buffers */
-	memset(espi_slave_oobDn, 0, sizeof(espi_slave_oobDn));
+/*
+ * PECI over eSPI OOB.
+ *
+ * The OOB channel has one upstream and one downstream buffer, so requests
+ * are queued and run one at a time. The OOB_DN interrupt completes the
+ * request at the head of the queue, wakes its task and puts the next one on
+ * the wire right away.
+ *
+ * PECI replies carry nothing to tell which request they answer. When the
+ * request on the wire times out, the channel is held until its reply comes
+ * in and is dropped, or for ESPI_OOB_DRAIN_US, before the next one starts.
+ */
+static struct espi_oob_peci_req *oob_head, *oob_tail;
+static int oob_draining;
+
+/* Latency statistics, by PECI command */
+static const uint8_t oob_stat_cmds[] = {
+	PECI_CMD_GET_TEMP,
+	PECI_CMD_RD_PKG_CFG,
+	PECI_CMD_WR_PKG_CFG,
+};
+static const char * const oob_stat_names[] = {
+	"GetTemp", "RdPkgConfig", "WrPkgConfig", "other",
+};
 
-	/**
-	 * Init OOB RX to be read to rx data packet from master
-	 * note: espi_OOB_RxDn_BufferAddress = &espi_slave_oobDn[]
-	 */
-	MCHP_ESPI_OOB_RX_ADDR_LO = espi_OOB_RxDn_BufferAddress;
-	MCHP_ESPI_OOB_RX_LEN |= (0xFF << 16);
-	MCHP_ESPI_OOB_RX_CTL |= BIT(0); /* SET_RECEIVE_AVAILABLE */
+struct oob_stat {
+	uint32_t count;
+	uint32_t errors;
+	uint32_t timeouts;
+	uint32_t max_us;
+	uint64_t total_us;
+};
+static struct oob_stat oob_stats[ARRAY_SIZE(oob_stat_names)];
+BUILD_ASSERT(ARRAY_SIZE(oob_stat_cmds) + 1 == ARRAY_SIZE(oob_stat_names));
 
-		/* wait eSPI Tx done */
-	while (retry--) {
-		msleep(5);
-		if (espi_slave_oobDn[0] != 0) {
-			if (espi_slave_oobDn[1] == 0x01) {
-				/* only process peci cmd */
-				for (i = 0; i < espi_slave_oobDn[2]-2; i++)
-					readBuf[i] = espi_slave_oobDn[i+5];
-			}
-			return EC_SUCCESS;
-		}
-	}
+static struct oob_stat *oob_stat_get(const struct espi_oob_peci_req *req)
+{
+	int i;
 
-	return EC_ERROR_UNKNOWN;
+	/* PECI command code follows target address, write and read length */
+	for (i = 0; req->n_write > 3 && i < ARRAY_SIZE(oob_stat_cmds); i++)
+		if (req->write_buf[3] == oob_stat_cmds[i])
+			break;
+	return &oob_stats[i];
 }
 
-int espi_oob_build_peci_command(uint8_t srcAddr, uint8_t destAddr, uint8_t cmdCode,
-		uint8_t nWrite, uint8_t *writeBuf, uint8_t *readBuf)
+/* Put a request on the wire, called with interrupts disabled. */
+static void espi_oob_start(struct espi_oob_peci_req *req)
 {
-	int i;
-
 	/* Clear slave OOB Dn/Up buffers */
 	memset(espi_slave_oobDn, 0, sizeof(espi_slave_oobDn));
 	memset(espi_slave_oobUp, 0, sizeof(espi_slave_oobUp));
@@ -1075,7 +1103,7 @@ int espi_oob_build_peci_command(uint8_t srcAddr, uint8_t destAddr, uint8_t cmdCo
 	 * note: espi_OOB_TxUp_BufferAddress = &espi_slave_oobUp[]
 	 */
 	MCHP_ESPI_OOB_TX_ADDR_LO = espi_OOB_TxUp_BufferAddress;
-	MCHP_ESPI_OOB_TX_LEN = nWrite + 4;
+	MCHP_ESPI_OOB_TX_LEN = req->n_write + 4;
 
 	/**
 	 * eSPI PECI command Format.
@@ -1112,30 +1140,194 @@ int espi_oob_build_peci_command(uint8_t srcAddr, uint8_t destAddr, uint8_t cmdCo
 	 *       +-----------------------------------------------+
 	 */
 
-	espi_slave_oobUp[0] = destAddr;	/* Destination slave address */
-	espi_slave_oobUp[1] = cmdCode;	/* Command code */
-	espi_slave_oobUp[2] = nWrite+1;	/* Byte count */
-	espi_slave_oobUp[3] = srcAddr;	/* Source slave address */
-	memcpy(espi_slave_oobUp + 4, writeBuf, nWrite); /* Copy the other datas */
+	espi_slave_oobUp[0] = req->dest_addr;	/* Destination slave address */
+	espi_slave_oobUp[1] = req->cmd_code;	/* Command code */
+	espi_slave_oobUp[2] = req->n_write + 1;	/* Byte count */
+	espi_slave_oobUp[3] = req->src_addr;	/* Source slave address */
+	/* Copy the other datas */
+	memcpy(espi_slave_oobUp + 4, req->write_buf, req->n_write);
 
 	MCHP_ESPI_OOB_TX_STATUS = 0x2F;	/* Write clear register, reset status */
 	MCHP_ESPI_OOB_TX_CTL |= 0x01;	/* TRANSMIT_START */
+}
+
+/*
+ * Complete the request at the head of the queue and start the next one.
+ * Called with interrupts disabled.
+ */
+static void espi_oob_complete(int rv, int wake)
+{
+	struct espi_oob_peci_req *req = oob_head;
+	struct oob_stat *stat = oob_stat_get(req);
+	uint32_t us = get_time().le.lo - req->submit;
+
+	stat->count++;
+	stat->total_us += us;
+	stat->max_us = MAX(stat->max_us, us);
+	if (rv == EC_ERROR_TIMEOUT)
+		stat->timeouts++;
+	else if (rv)
+		stat->errors++;
+
+	oob_head = req->next;
+	if (!oob_head)
+		oob_tail = NULL;
+	req->rv = rv;
+	req->pending = 0;
+	if (wake)
+		task_set_event(req->task, TASK_EVENT_PECI_DONE, 0);
+
+	if (oob_head && !oob_draining)
+		espi_oob_start(oob_head);
+}
 
-	/* wait eSPI Tx done */
-	msleep(5);
+/*
+ * The late reply came in or never will, let the next request go.
+ * Called with interrupts disabled.
+ */
+static void espi_oob_drained(void)
+{
+	oob_draining = 0;
+	if (oob_head)
+		espi_oob_start(oob_head);
+	else
+		MCHP_ESPI_OOB_RX_CTL |= BIT(0); /* SET_RECEIVE_AVAILABLE */
+}
 
-	if (espi_slave_oobDn[0] != 0) {
-		if (espi_slave_oobDn[1] == 0x01) {
-			/* only process peci cmd */
-			for (i = 0; i < espi_slave_oobDn[2]-2; i++)
-				readBuf[i] = espi_slave_oobDn[i+5];
-		}
+static void espi_oob_drain_timeout(void)
+{
+	interrupt_disable();
+	if (oob_draining)
+		espi_oob_drained();
+	interrupt_enable();
+}
+DECLARE_DEFERRED(espi_oob_drain_timeout);
+
+/*
+ * Fail all queued requests, the channel is being reset or disabled.
+ * Called from interrupt context.
+ */
+static void espi_oob_abort(int rv)
+{
+	/* Nothing in flight survives a reset */
+	if (oob_draining) {
+		oob_draining = 0;
+		hook_call_deferred(&espi_oob_drain_timeout_data, -1);
+	}
+	while (oob_head)
+		espi_oob_complete(rv, 1);
+}
+
+int espi_oob_peci_submit(struct espi_oob_peci_req *req)
+{
+	if (req->n_write > sizeof(espi_slave_oobUp) - 4)
+		return EC_ERROR_INVAL;
+
+	req->task = task_get_current();
+	req->next = NULL;
+	req->rv = EC_ERROR_BUSY;
+	req->submit = get_time().le.lo;
+	req->pending = 1;
+
+	interrupt_disable();
+	if (oob_tail) {
+		oob_tail->next = req;
 	} else {
-		return EC_ERROR_TIMEOUT;
+		oob_head = req;
+		if (!oob_draining)
+			espi_oob_start(req);
+	}
+	oob_tail = req;
+	interrupt_enable();
+
+	return EC_SUCCESS;
+}
+
+int espi_oob_peci_wait(struct espi_oob_peci_req *req, int timeout_us)
+{
+	timestamp_t deadline = get_time();
+	struct espi_oob_peci_req *prev;
+	int remaining;
+
+	deadline.val += timeout_us;
+	while (req->pending) {
+		remaining = deadline.val - get_time().val;
+		if (remaining <= 0)
+			break;
+		task_wait_event_mask(TASK_EVENT_PECI_DONE, remaining);
+	}
+
+	interrupt_disable();
+	if (req->pending) {
+		if (req == oob_head && !oob_draining) {
+			/*
+			 * It's on the wire, hold the channel so that a late
+			 * reply isn't taken for the next request's.
+			 */
+			oob_draining = 1;
+			hook_call_deferred(&espi_oob_drain_timeout_data,
+					   ESPI_OOB_DRAIN_US);
+			espi_oob_complete(EC_ERROR_TIMEOUT, 0);
+		} else if (req == oob_head) {
+			espi_oob_complete(EC_ERROR_TIMEOUT, 0);
+		} else {
+			/* Still queued, unlink it */
+			for (prev = oob_head; prev->next != req;
+			     prev = prev->next)
+				;
+			prev->next = req->next;
+			if (oob_tail == req)
+				oob_tail = prev;
+			req->rv = EC_ERROR_TIMEOUT;
+			req->pending = 0;
+			oob_stat_get(req)->count++;
+			oob_stat_get(req)->timeouts++;
+		}
+	}
+	interrupt_enable();
+
+	/* Completion may have raced with the timeout, don't leave its event */
+	deprecated_atomic_clear_bits(task_get_event_bitmap(task_get_current()),
+				     TASK_EVENT_PECI_DONE);
+
+	return req->rv;
+}
+
+int espi_oob_peci_xfer(struct espi_oob_peci_req *req, int timeout_us)
+{
+	int rv = espi_oob_peci_submit(req);
+
+	return rv ? rv : espi_oob_peci_wait(req, timeout_us);
+}
+
+static int command_espi_oob(int argc, char **argv)
+{
+	const struct oob_stat *stat;
+	int i;
+
+	if (argc == 2 && !strcasecmp(argv[1], "reset")) {
+		interrupt_disable();
+		memset(oob_stats, 0, sizeof(oob_stats));
+		interrupt_enable();
+		return EC_SUCCESS;
+	} else if (argc != 1) {
+		return EC_ERROR_PARAM_COUNT;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(oob_stats); i++) {
+		stat = &oob_stats[i];
+		ccprintf("%-12s count %u err %u timeout %u avg %u us "
+			 "max %u us\n", oob_stat_names[i], stat->count,
+			 stat->errors, stat->timeouts,
+			 stat->count ? (uint32_t)(stat->total_us /
+						  stat->count) : 0,
+			 stat->max_us);
 	}
 
 	return EC_SUCCESS;
 }
+DECLARE_CONSOLE_COMMAND(espioob, command_espi_oob, "[reset]",
+			"Show or reset PECI over eSPI OOB latency statistics");
 
 /************************************************************************/
 /* Interrupt handlers */
@@ -1399,11 +1591,15 @@ void espi_oob_tx_isr(void)
 			espi_channels_ready &= ~(1ul << 2);
 			CPRINTS("eSPI OOB_UP ISR: OOB Channel Disable");
 			trace0(0, ESPI, 0, "eSPI OOB_TX OOB Disable");
+			espi_oob_abort(EC_ERROR_NOT_POWERED);
 		}
-	} else {
-		/* Handle OOB Up transmit status: done and/or errors, here */
+	} else if (sts & ESPI_OOB_TX_STS_ERR) {
+		/* Handle OOB Up transmit errors, here */
 		CPRINTS("eSPI OOB_UP status = 0x%x", sts);
 		trace11(0, ESPI, 0, "eSPI OOB_TX Status = 0x%08x", sts);
+		/* No reply is coming for a request which failed to go out */
+		if (oob_head && !oob_draining)
+			espi_oob_complete(EC_ERROR_UNKNOWN, 1);
 	}
 
 	MCHP_INT_SOURCE(MCHP_ESPI_GIRQ) = MCHP_ESPI_OOB_TX_GIRQ_BIT;
@@ -1415,13 +1611,50 @@ DECLARE_IRQ(MCHP_IRQ_ESPI_OOB_UP, espi_oob_tx_isr, 2);
 void espi_oob_rx_isr(void)
 {
 	uint32_t sts;
+	int i, len;
 
 	sts = MCHP_ESPI_OOB_RX_STATUS;
 	MCHP_ESPI_OOB_RX_STATUS = sts;
 	MCHP_INT_SOURCE(MCHP_ESPI_GIRQ) = MCHP_ESPI_OOB_RX_GIRQ_BIT;
-	/* Handle OOB Up transmit status: done and/or errors, if any */
-	CPRINTS("eSPI OOB_DN status = 0x%x", sts);
 	trace11(0, ESPI, 0, "eSPI OOB_RX Status = 0x%08x", sts);
+
+	if (oob_draining) {
+		if ((sts & ESPI_OOB_RX_STS_DONE) &&
+		    !(sts & ESPI_OOB_RX_STS_ERR) &&
+		    espi_slave_oobDn[1] != 0x01) {
+			/* Not PECI, keep waiting for the late reply */
+			MCHP_ESPI_OOB_RX_CTL |= BIT(0);
+		} else if (sts & (ESPI_OOB_RX_STS_DONE | ESPI_OOB_RX_STS_ERR)) {
+			/* Reply to a timed out request, drop it */
+			hook_call_deferred(&espi_oob_drain_timeout_data, -1);
+			espi_oob_drained();
+		}
+		return;
+	}
+
+	if (!oob_head) {
+		/* Handle OOB Dn receive status: done and/or errors, if any */
+		CPRINTS("eSPI OOB_DN status = 0x%x", sts);
+		return;
+	}
+
+	if (sts & ESPI_OOB_RX_STS_ERR) {
+		espi_oob_complete(EC_ERROR_UNKNOWN, 1);
+		return;
+	}
+	if (!(sts & ESPI_OOB_RX_STS_DONE))
+		return;
+
+	if (espi_slave_oobDn[1] != 0x01) {
+		/* only process peci cmd, keep waiting for the reply */
+		MCHP_ESPI_OOB_RX_CTL |= BIT(0); /* SET_RECEIVE_AVAILABLE */
+		return;
+	}
+
+	len = MIN(espi_slave_oobDn[2] - 2, oob_head->read_size);
+	for (i = 0; i < len; i++)
+		oob_head->read_buf[i] = espi_slave_oobDn[i + 5];
+	espi_oob_complete(EC_SUCCESS, 1);
 }
 DECLARE_IRQ(MCHP_IRQ_ESPI_OOB_DN, espi_oob_rx_isr, 2);
 
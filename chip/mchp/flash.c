@@ -43,6 +43,16 @@ int flash_physical_read(int offset, int size, char *data)
 	return spi_flash_read(data, offset, size);
 }
 
+int flash_physical_read_async(int offset, int size, char *data)
+{
+	return spi_flash_read_async(data, offset, size);
+}
+
+int flash_physical_read_flush(void)
+{
+	return spi_flash_read_flush();
+}
+
 /**
  * Write to physical flash.
  *
@@ -54,9 +64,6 @@ int flash_physical_read(int offset, int size, char *data)
  */
 int flash_physical_write(int offset, int size, const char *data)
 {
-	int ret = EC_SUCCESS;
-	int  i, write_size;
-
 	trace13(0, FLASH, 0,
 		"flash_phys_write: offset=0x%08X size=0x%08X dataptr=0x%08X",
 		offset, size, (uint32_t)data);
@@ -68,15 +75,8 @@ int flash_physical_write(int offset, int size, const char *data)
 	if ((offset | size | (uint32_t)(uintptr_t)data) & 3)
 		return EC_ERROR_INVAL;
 
-	for (i = 0; i < size; i += write_size) {
-		write_size = MIN((size - i), SPI_FLASH_MAX_WRITE_SIZE);
-		ret = spi_flash_write(offset + i,
-				      write_size,
-				      (uint8_t *)data + i);
-		if (ret != EC_SUCCESS)
-			break;
-	}
-	return ret;
+	/* Page programs are split and pipelined by the SPI flash driver */
+	return spi_flash_write(offset, size, (uint8_t *)data);
 }
 
 /**
@@ -575,9 +575,13 @@ static int i2c_check_recover(int port, int controller)
 		CPRINTS("I2C%d port%d recov status 0x%02x, SDA:SCL=0x%0x",
 			controller, port, reg, lines);
 		/* Attempt to unwedge the port. */
-		if (lines != I2C_LINE_IDLE)
+		if (lines != I2C_LINE_IDLE) {
 			if (i2c_unwedge(port))
 				return EC_ERROR_UNKNOWN;
+		} else if (IS_ENABLED(CONFIG_I2C_PROFILE)) {
+			/* Only a reset, i2c_unwedge() accounts the others */
+			i2c_profile_unwedge(port, EC_SUCCESS);
+		}
 
 		/* Bus error, bus busy, or arbitration lost. Try reset. */
 		reset_controller(controller);
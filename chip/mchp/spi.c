@@ -233,6 +233,16 @@ int spi_transaction_wait(const struct spi_device_t *spi_device)
 	return rc;
 }
 
+#ifndef LFW
+void spi_transaction_lock(const struct spi_device_t *spi_device, int lock)
+{
+	if (lock)
+		spi_mutex_lock(spi_device->port);
+	else
+		spi_mutex_unlock(spi_device->port);
+}
+#endif
+
 /*
  * called from common/spi_flash.c
  * For tranfers reading less than the size of QMSPI RX FIFO call
@@ -9,7 +9,10 @@
 #include "hwtimer.h"
 #include "lid_switch.h"
 #include "math_util.h"
+#include "motion_sense_decim.h"
 #include "motion_sense_fifo.h"
+#include "online_stats.h"
+#include "task.h"
 #include "timer.h"
 
 /* Console output macros */
@@ -24,59 +27,34 @@ static int window_size = CONFIG_BODY_DETECTION_MAX_WINDOW_SIZE;
 static uint64_t var_threshold_scaled, confidence_delta_scaled;
 static int stationary_timeframe;
 
-static int history_idx;
 static enum body_detect_states motion_state = BODY_DETECTION_OFF_BODY;
 
-static bool history_initialized;
 static bool body_detect_enable;
 
-static struct body_detect_motion_data
-{
-	int history[CONFIG_BODY_DETECTION_MAX_WINDOW_SIZE]; /* acceleration */
-	int sum;              /* sum(history) */
-	uint64_t n2_variance; /* n^2 * var(history) */
-} data[2]; /* motion data for X-axis and Y-axis */
-
 /*
- * This function will update new variance and new sum according to incoming
- * value, previous value, previous sum and previous variance.
- * In order to prevent inaccuracy, we use integer to calculate instead of float
- *
- * n: window size
- * x: data in the old window
- * x': data in the new window
- * x_0: oldest value in the window, will be replaced by x_n
- * x_n: new coming value
- *
- * n^2 * var(x') = n^2 * var(x) + (sum(x') - sum(x))^2 +
- *                 (n * x_n - sum(x'))^2 / n - (n * x_0 - sum(x'))^2 / n
+ * Motion data for X-axis and Y-axis. The window keeps integer sums of the
+ * acceleration and of its square, the variance is exact and the update needs
+ * no division.
  */
-static void update_motion_data(struct body_detect_motion_data *x, int x_n)
-{
-	const int n = window_size;
-	const int x_0 = x->history[history_idx];
-	const int new_sum = x->sum + (x_n - x->history[history_idx]);
-
-	x->n2_variance = x->n2_variance + POW2((int64_t)new_sum - x->sum) +
-			 (POW2((int64_t)x_n * n - new_sum) -
-			  POW2((int64_t)x_0 * n - new_sum)) / n;
-	x->sum = new_sum;
-	x->history[history_idx] = x_n;
-}
+static int32_t history[2][CONFIG_BODY_DETECTION_MAX_WINDOW_SIZE];
+static struct online_stats_window data[2] = {
+	[X] = { .history = history[X], .size = ARRAY_SIZE(history[X]) },
+	[Y] = { .history = history[Y], .size = ARRAY_SIZE(history[Y]) },
+};
 
 /* Update motion data of X, Y with new sensor data. */
-static void update_motion_variance(void)
+static void update_motion_variance(const intv3_t v)
 {
-	update_motion_data(&data[X], body_sensor->xyz[X]);
-	update_motion_data(&data[Y], body_sensor->xyz[Y]);
-	history_idx = (history_idx + 1 >= window_size) ? 0 : history_idx + 1;
+	online_stats_window_update(&data[X], v[X]);
+	online_stats_window_update(&data[Y], v[Y]);
 }
 
 /* return Var(X) + Var(Y) */
 static uint64_t get_motion_variance(void)
 {
-	return (data[X].n2_variance + data[Y].n2_variance)
-		/ window_size / window_size;
+	return (online_stats_window_n2_var(&data[X]) +
+		online_stats_window_n2_var(&data[Y])) / window_size /
+		window_size;
 }
 
 static int calculate_motion_confidence(uint64_t var)
@@ -180,28 +158,43 @@ void body_detect_reset(void)
 	 */
 	if (odr == 0)
 		return;
+#ifdef CONFIG_MOTION_SENSE_DECIM
+	{
+		struct motion_decim *d = motion_decim_get(
+				body_sensor, MOTION_DECIM_BODY_DETECT);
+
+		/* Restart the stage, the window covers its output rate. */
+		mutex_lock(&g_sensor_mutex);
+		motion_decim_init(d, d->ratio, d->shift);
+		odr /= MAX(d->ratio, 1);
+		mutex_unlock(&g_sensor_mutex);
+	}
+#endif
 	determine_window_size(odr);
 	determine_threshold_scale(range, resolution, rms_noise);
 	/* initialize motion data and state */
-	memset(data, 0, sizeof(data));
-	history_idx = 0;
-	history_initialized = 0;
+	online_stats_window_init(&data[X], history[X], window_size);
+	online_stats_window_init(&data[Y], history[Y], window_size);
 }
 
 void body_detect(void)
 {
 	uint64_t motion_var;
 	int motion_confidence;
+	intv3_t v;
 
 	if (!body_detect_enable)
 		return;
 
-	update_motion_variance();
-	if (!history_initialized) {
-		if (history_idx == window_size - 1)
-			history_initialized = 1;
+#ifdef CONFIG_MOTION_SENSE_DECIM
+	if (!motion_decim_sample(body_sensor, MOTION_DECIM_BODY_DETECT, v))
+		return;
+#else
+	memcpy(v, body_sensor->xyz, sizeof(intv3_t));
+#endif
+	update_motion_variance(v);
+	if (!online_stats_window_full(&data[X]))
 		return;
-	}
 
 	motion_var = get_motion_variance();
 	motion_confidence = calculate_motion_confidence(motion_var);
@@ -13,16 +13,9 @@ void gyro_still_det_update(struct gyro_still_det *gyro_still_det,
 			   uint32_t stillness_win_endtime, uint32_t sample_time,
 			   fp_t x, fp_t y, fp_t z)
 {
-	fp_t delta = INT_TO_FP(0);
-
 	/*
-	 * Using the method of the assumed mean to preserve some numerical
-	 * stability while avoiding per-sample divisions that the more
-	 * numerically stable Welford method would afford.
-	 *
-	 * Reference for the numerical method used below to compute the
-	 * online mean and variance statistics:
-	 *   1). en.wikipedia.org/wiki/assumed_mean
+	 * The window statistics use the method of the assumed mean, see
+	 * online_stats.h.
 	 */
 
 	/* Increment the number of samples. */
@@ -39,19 +32,11 @@ void gyro_still_det_update(struct gyro_still_det *gyro_still_det,
 		gyro_still_det->window_start_time = sample_time;
 		gyro_still_det->start_new_window = false;
 
-		/* Update assumed mean values. */
-		gyro_still_det->assumed_mean[X] = x;
-		gyro_still_det->assumed_mean[Y] = y;
-		gyro_still_det->assumed_mean[Z] = z;
-
-		/* Reset current window mean and variance. */
-		gyro_still_det->num_acc_win_samples = 0;
-		gyro_still_det->win_mean[X] = INT_TO_FP(0);
-		gyro_still_det->win_mean[Y] = INT_TO_FP(0);
-		gyro_still_det->win_mean[Z] = INT_TO_FP(0);
-		gyro_still_det->acc_var[X] = INT_TO_FP(0);
-		gyro_still_det->acc_var[Y] = INT_TO_FP(0);
-		gyro_still_det->acc_var[Z] = INT_TO_FP(0);
+		/*
+		 * Reset current window mean and variance, the first sample
+		 * becomes the assumed mean.
+		 */
+		online_stats_reset(&gyro_still_det->win_stats);
 	} else {
 		/*
 		 * Check to see if we have enough samples to compute a stillness
@@ -66,72 +51,23 @@ void gyro_still_det_update(struct gyro_still_det *gyro_still_det,
 	gyro_still_det->last_sample_time = sample_time;
 
 	/* Online window mean and variance ("one-pass" accumulation). */
-	gyro_still_det->num_acc_win_samples++;
-
-	delta = (x - gyro_still_det->assumed_mean[X]);
-	gyro_still_det->win_mean[X] += delta;
-	gyro_still_det->acc_var[X] += fp_sq(delta);
-
-	delta = (y - gyro_still_det->assumed_mean[Y]);
-	gyro_still_det->win_mean[Y] += delta;
-	gyro_still_det->acc_var[Y] += fp_sq(delta);
-
-	delta = (z - gyro_still_det->assumed_mean[Z]);
-	gyro_still_det->win_mean[Z] += delta;
-	gyro_still_det->acc_var[Z] += fp_sq(delta);
+	online_stats_update(&gyro_still_det->win_stats, x, y, z);
 }
 
 fp_t gyro_still_det_compute(struct gyro_still_det *gyro_still_det)
 {
-	fp_t tmp_denom = INT_TO_FP(1);
-	fp_t tmp_denom_mean = INT_TO_FP(1);
-	fp_t tmp;
+	fp_t tmp_denom;
 	fp_t upper_var_thresh, lower_var_thresh;
 
-	/* Don't divide by zero (not likely, but a precaution). */
-	if (gyro_still_det->num_acc_win_samples > 1) {
-		tmp_denom = fp_div(
-			tmp_denom,
-			INT_TO_FP(gyro_still_det->num_acc_win_samples - 1));
-		tmp_denom_mean =
-			fp_div(tmp_denom_mean,
-			       INT_TO_FP(gyro_still_det->num_acc_win_samples));
-	} else {
+	/* Update the final calculation of window mean and variance. */
+	if (!online_stats_compute(&gyro_still_det->win_stats,
+				  gyro_still_det->win_mean,
+				  gyro_still_det->win_var, true)) {
 		/* Return zero stillness confidence. */
 		gyro_still_det->stillness_confidence = 0;
 		return gyro_still_det->stillness_confidence;
 	}
 
-	/* Update the final calculation of window mean and variance. */
-	tmp = gyro_still_det->win_mean[X];
-	gyro_still_det->win_mean[X] =
-		fp_mul(gyro_still_det->win_mean[X], tmp_denom_mean);
-	gyro_still_det->win_var[X] =
-		fp_mul((gyro_still_det->acc_var[X] -
-			fp_mul(gyro_still_det->win_mean[X], tmp)),
-		       tmp_denom);
-
-	tmp = gyro_still_det->win_mean[Y];
-	gyro_still_det->win_mean[Y] =
-		fp_mul(gyro_still_det->win_mean[Y], tmp_denom_mean);
-	gyro_still_det->win_var[Y] =
-		fp_mul((gyro_still_det->acc_var[Y] -
-			fp_mul(gyro_still_det->win_mean[Y], tmp)),
-		       tmp_denom);
-
-	tmp = gyro_still_det->win_mean[Z];
-	gyro_still_det->win_mean[Z] =
-		fp_mul(gyro_still_det->win_mean[Z], tmp_denom_mean);
-	gyro_still_det->win_var[Z] =
-		fp_mul((gyro_still_det->acc_var[Z] -
-			fp_mul(gyro_still_det->win_mean[Z], tmp)),
-		       tmp_denom);
-
-	/* Adds the assumed mean value back to the total mean calculation. */
-	gyro_still_det->win_mean[X] += gyro_still_det->assumed_mean[X];
-	gyro_still_det->win_mean[Y] += gyro_still_det->assumed_mean[Y];
-	gyro_still_det->win_mean[Z] += gyro_still_det->assumed_mean[Z];
-
 	/* Define the variance thresholds. */
 	upper_var_thresh = gyro_still_det->var_threshold +
 			   gyro_still_det->confidence_delta;
@@ -225,9 +161,6 @@ void gyro_still_det_reset(struct gyro_still_det *gyro_still_det,
 		gyro_still_det->mean[X] = INT_TO_FP(0);
 		gyro_still_det->mean[Y] = INT_TO_FP(0);
 		gyro_still_det->mean[Z] = INT_TO_FP(0);
-		gyro_still_det->acc_var[X] = INT_TO_FP(0);
-		gyro_still_det->acc_var[Y] = INT_TO_FP(0);
-		gyro_still_det->acc_var[Z] = INT_TO_FP(0);
 	}
 }
 
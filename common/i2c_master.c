@@ -17,6 +17,7 @@
 #include "i2c_private.h"
 #include "system.h"
 #include "task.h"
+#include "timer.h"
 #include "usb_pd.h"
 #include "usb_pd_tcpm.h"
 #include "util.h"
@@ -97,10 +98,14 @@ static int chip_i2c_xfer_with_notify(const int port,
 	int ret;
 	uint16_t addr_flags = slave_addr_flags;
 	const struct i2c_port_t *i2c_port = get_i2c_port(port);
+	uint32_t start = 0;
 
 	if (IS_ENABLED(CONFIG_I2C_XFER_BOARD_CALLBACK))
 		i2c_start_xfer_notify(port, slave_addr_flags);
 
+	if (IS_ENABLED(CONFIG_I2C_PROFILE))
+		start = get_time().le.lo;
+
 	if (IS_ENABLED(CONFIG_SMBUS_PEC))
 		/*
 		 * Since we've done PEC processing here,
@@ -114,6 +119,10 @@ static int chip_i2c_xfer_with_notify(const int port,
 		ret = chip_i2c_xfer(port, addr_flags,
 				    out, out_size, in, in_size, flags);
 
+	if (IS_ENABLED(CONFIG_I2C_PROFILE))
+		i2c_profile_xfer(port, slave_addr_flags, out_size + in_size,
+				 get_time().le.lo - start, ret);
+
 	if (IS_ENABLED(CONFIG_I2C_XFER_BOARD_CALLBACK))
 		i2c_end_xfer_notify(port, slave_addr_flags);
 
@@ -157,6 +166,23 @@ static int i2c_xfer_no_retry(const int port,
 }
 #endif /* CONFIG_I2C_XFER_LARGE_READ */
 
+/*
+ * One attempt at a transfer, without retrying on NACK.
+ */
+static int i2c_xfer_once(const int port,
+			 const uint16_t addr_flags,
+			 const uint8_t *out, int out_size,
+			 uint8_t *in, int in_size, int flags)
+{
+#ifdef CONFIG_I2C_XFER_LARGE_READ
+	return i2c_xfer_no_retry(port, addr_flags, out, out_size, in,
+				 in_size, flags);
+#else
+	return chip_i2c_xfer_with_notify(port, addr_flags, out, out_size,
+					 in, in_size, flags);
+#endif /* CONFIG_I2C_XFER_LARGE_READ */
+}
+
 int i2c_xfer_unlocked(const int port,
 		      const uint16_t slave_addr_flags,
 		      const uint8_t *out, int out_size,
@@ -173,17 +199,18 @@ int i2c_xfer_unlocked(const int port,
 	}
 
 	for (i = 0; i <= CONFIG_I2C_NACK_RETRY_COUNT; i++) {
-#ifdef CONFIG_I2C_XFER_LARGE_READ
-		ret = i2c_xfer_no_retry(port, addr_flags,
-					    out, out_size, in,
-					    in_size, flags);
-#else
-		ret = chip_i2c_xfer_with_notify(port, addr_flags,
-						    out, out_size,
-						    in, in_size, flags);
-#endif /* CONFIG_I2C_XFER_LARGE_READ */
-		if (ret != EC_ERROR_BUSY)
+		ret = i2c_xfer_once(port, addr_flags, out, out_size,
+				    in, in_size, flags);
+		/*
+		 * The controller released the bus after the NACK: a transfer
+		 * continuing a previous one without START can't be replayed
+		 * alone, its caller has to restart the whole message.
+		 */
+		if (ret != EC_ERROR_BUSY || !(flags & I2C_XFER_START))
 			break;
+		if (IS_ENABLED(CONFIG_I2C_PROFILE) &&
+		    i < CONFIG_I2C_NACK_RETRY_COUNT)
+			i2c_profile_retry(port, addr_flags);
 	}
 	return ret;
 }
@@ -204,8 +231,222 @@ int i2c_xfer(const int port,
 	return rv;
 }
 
+/*
+ * Run a message from its START to its STOP, once. Segments go straight to the
+ * chip driver: a NACK anywhere fails the whole message.
+ */
+static int i2c_xfer_msgs_once(const int port, struct i2c_msg *msgs, int count)
+{
+	const uint8_t *out;
+	uint8_t *in;
+	int i, flags, out_size, in_size;
+	int rv = EC_SUCCESS;
+
+	for (i = 0; i < count && rv == EC_SUCCESS; i++) {
+		const struct i2c_msg *msg = &msgs[i];
+
+		flags = (msg->flags & I2C_MSG_NOSTART) ? 0 : I2C_XFER_START;
+		out = NULL;
+		out_size = 0;
+		in = NULL;
+		in_size = 0;
+		if (msg->flags & I2C_MSG_READ) {
+			in = msg->buf;
+			in_size = msg->len;
+		} else {
+			out = msg->buf;
+			out_size = msg->len;
+			/*
+			 * A write followed by a read from the same device with
+			 * a repeated START is what chip drivers do in one call.
+			 * They only send that repeated START along with the
+			 * write's own START, so a continued write is not merged.
+			 */
+			if ((flags & I2C_XFER_START) && i + 1 < count &&
+			    (msgs[i + 1].flags & (I2C_MSG_READ |
+						  I2C_MSG_NOSTART)) ==
+			    I2C_MSG_READ &&
+			    msgs[i + 1].addr_flags == msg->addr_flags) {
+				msg = &msgs[++i];
+				in = msg->buf;
+				in_size = msg->len;
+			}
+		}
+
+		if (i == count - 1)
+			flags |= I2C_XFER_STOP;
+
+		rv = i2c_xfer_once(port, msg->addr_flags & ~I2C_FLAG_PEC,
+				   out, out_size, in, in_size, flags);
+	}
+
+	return rv;
+}
+
+int i2c_xfer_msgs_unlocked(const int port, struct i2c_msg *msgs, int count)
+{
+	int first, end, retry;
+	int rv = EC_SUCCESS;
+
+	if (!i2c_port_is_locked(port)) {
+		CPUTS("Access I2C without lock!");
+		return EC_ERROR_INVAL;
+	}
+
+	/* Check the whole sequence first, never leave the bus held */
+	for (end = 0; end < count; end++) {
+		if ((msgs[end].flags & I2C_MSG_NOSTART) &&
+		    (end == 0 || (msgs[end - 1].flags & I2C_MSG_STOP) ||
+		     ((msgs[end].flags ^ msgs[end - 1].flags) & I2C_MSG_READ)))
+			return EC_ERROR_INVAL;
+	}
+
+	for (first = 0; first < count && rv == EC_SUCCESS; first = end) {
+		/* Messages up to the next STOP are one message on the bus */
+		for (end = first; end < count - 1; end++)
+			if (msgs[end].flags & I2C_MSG_STOP)
+				break;
+		end++;
+
+		/* On NACK, restart from its START like i2c_xfer_unlocked() */
+		for (retry = 0; retry <= CONFIG_I2C_NACK_RETRY_COUNT; retry++) {
+			rv = i2c_xfer_msgs_once(port, &msgs[first],
+						end - first);
+			if (rv != EC_ERROR_BUSY)
+				break;
+			if (IS_ENABLED(CONFIG_I2C_PROFILE) &&
+			    retry < CONFIG_I2C_NACK_RETRY_COUNT)
+				i2c_profile_retry(port, msgs[first].addr_flags);
+		}
+	}
+
+	return rv;
+}
+
+int i2c_xfer_msgs(const int port, struct i2c_msg *msgs, int count)
+{
+	int rv;
+
+	i2c_lock(port, 1);
+	rv = i2c_xfer_msgs_unlocked(port, msgs, count);
+	i2c_lock(port, 0);
+
+	return rv;
+}
+
+#ifdef CONFIG_I2C_ASYNC
+#ifndef HAS_TASK_I2C_ASYNC
+#error "CONFIG_I2C_ASYNC needs the I2C_ASYNC task in ec.tasklist"
+#endif
+
+/* Queued asynchronous transactions of each port, oldest first. */
+static struct i2c_async_xfer *async_head[ARRAY_SIZE(port_protected)];
+static struct i2c_async_xfer *async_tail[ARRAY_SIZE(port_protected)];
+
+int i2c_xfer_async(struct i2c_async_xfer *xfer)
+{
+	const int port = xfer->port;
+
+	if (port < 0 || port >= ARRAY_SIZE(async_head) || !get_i2c_port(port))
+		return EC_ERROR_INVAL;
+	if (xfer->pending)
+		return EC_ERROR_BUSY;
+
+	xfer->pending = 1;
+	xfer->next = NULL;
+
+	interrupt_disable();
+	if (async_tail[port])
+		async_tail[port]->next = xfer;
+	else
+		async_head[port] = xfer;
+	async_tail[port] = xfer;
+	interrupt_enable();
+
+	task_wake(TASK_ID_I2C_ASYNC);
+	return EC_SUCCESS;
+}
+
+int i2c_xfer_async_wait(struct i2c_async_xfer *xfer, int timeout_us)
+{
+	timestamp_t deadline;
+	uint32_t events = 0;
+	int remaining = -1;
+
+	if (!xfer->event)
+		return EC_ERROR_INVAL;
+
+	/*
+	 * The event is posted once pending is cleared: wait for the event
+	 * itself rather than for pending, so it is consumed here and does not
+	 * wake the task again later.
+	 */
+	deadline.val = get_time().val + timeout_us;
+	while (!(events & xfer->event)) {
+		if (timeout_us >= 0) {
+			if (timestamp_expired(deadline, NULL))
+				return EC_ERROR_TIMEOUT;
+			remaining = deadline.val - get_time().val;
+		}
+		events = task_wait_event_mask(xfer->event, remaining);
+	}
+	return xfer->rv;
+}
+
+void i2c_async_task(void *u)
+{
+	struct i2c_async_xfer *xfer;
+	task_id_t task;
+	uint32_t event;
+	int port, ran;
+
+	while (1) {
+		/*
+		 * One transaction per port at a time, so a long queue on a
+		 * port does not hold back the others.
+		 */
+		do {
+			ran = 0;
+			for (port = 0; port < ARRAY_SIZE(async_head); port++) {
+				interrupt_disable();
+				xfer = async_head[port];
+				if (xfer) {
+					async_head[port] = xfer->next;
+					if (!async_head[port])
+						async_tail[port] = NULL;
+				}
+				interrupt_enable();
+
+				if (!xfer)
+					continue;
+
+				xfer->rv = i2c_xfer(xfer->port,
+						    xfer->slave_addr_flags,
+						    xfer->out, xfer->out_size,
+						    xfer->in, xfer->in_size);
+				if (xfer->complete)
+					xfer->complete(xfer);
+
+				/* xfer may be reused as soon as it is done. */
+				task = xfer->task;
+				event = xfer->event;
+				xfer->pending = 0;
+				if (event)
+					task_set_event(task, event, 0);
+				ran = 1;
+			}
+		} while (ran);
+
+		task_wait_event(-1);
+	}
+}
+#endif /* CONFIG_I2C_ASYNC */
+
 void i2c_lock(int port, int lock)
 {
+	const int bus_port = port;
+	uint32_t start = 0;
+
 #ifdef CONFIG_I2C_MULTI_PORT_CONTROLLER
 	/* Lock the controller, not the port */
 	port = i2c_port_to_controller(port);
@@ -214,8 +455,15 @@ void i2c_lock(int port, int lock)
 		return;
 
 	if (lock) {
+		if (IS_ENABLED(CONFIG_I2C_PROFILE))
+			start = get_time().le.lo;
+
 		mutex_lock(port_mutex + port);
 
+		if (IS_ENABLED(CONFIG_I2C_PROFILE))
+			i2c_profile_lock(bus_port,
+					 get_time().le.lo - start);
+
 		/* Disable interrupt during changing counter for preemption. */
 		interrupt_disable();
 
@@ -1004,6 +1252,9 @@ unwedge_done:
 	/* Take port out of raw bit bang mode. */
 	i2c_raw_mode(port, 0);
 
+	if (IS_ENABLED(CONFIG_I2C_PROFILE))
+		i2c_profile_unwedge(port, ret);
+
 	return ret;
 }
 
@@ -0,0 +1,277 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+ * I2C bus utilization and latency profiler.
+ *
+ * Counters are updated by the I2C master code with the port locked, so they
+ * need no locking of their own. Slaves get a slot the first time they are
+ * addressed and keep it; resetting the sampling window only clears counters.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "ec_commands.h"
+#include "host_command.h"
+#include "i2c.h"
+#include "task.h"
+#include "timer.h"
+#include "util.h"
+
+struct i2c_profile_port {
+	uint64_t busy_us;
+	uint64_t lock_wait_us;
+	uint32_t xfers;
+	uint32_t locks;
+	uint32_t lock_wait_max_us;
+	uint32_t untracked;
+	uint16_t unwedges;
+	uint16_t unwedge_fails;
+};
+
+struct i2c_profile_slave {
+	uint64_t busy_us;
+	uint32_t xfers;
+	uint32_t bytes;
+	uint32_t retries;
+	uint32_t max_us;
+	uint16_t errors;
+	uint16_t addr_flags;
+	/* Index of the port in i2c_ports[] */
+	uint8_t port_idx;
+};
+
+static struct i2c_profile_port ports[I2C_PORT_COUNT];
+static struct i2c_profile_slave slaves[CONFIG_I2C_PROFILE_SLAVES];
+static int slave_count;
+static uint64_t window_start;
+
+/* Only ports in i2c_ports[] are profiled, not bit-banged ones. */
+static int port_index(int port)
+{
+	int i;
+
+	for (i = 0; i < i2c_ports_used && i < ARRAY_SIZE(ports); i++)
+		if (i2c_ports[i].port == port)
+			return i;
+	return -1;
+}
+
+static struct i2c_profile_slave *get_slave(int idx, uint16_t addr_flags)
+{
+	struct i2c_profile_slave *s = NULL;
+	int i;
+
+	addr_flags &= ~I2C_FLAG_PEC;
+	for (i = 0; i < slave_count; i++)
+		if (slaves[i].port_idx == idx &&
+		    slaves[i].addr_flags == addr_flags)
+			return &slaves[i];
+
+	/* Other ports may be claiming a slot too. */
+	interrupt_disable();
+	if (slave_count < ARRAY_SIZE(slaves)) {
+		s = &slaves[slave_count];
+		memset(s, 0, sizeof(*s));
+		s->port_idx = idx;
+		s->addr_flags = addr_flags;
+		slave_count++;
+	}
+	interrupt_enable();
+
+	return s;
+}
+
+void i2c_profile_xfer(int port, uint16_t slave_addr_flags, int bytes,
+		      uint32_t busy_us, int rv)
+{
+	const int idx = port_index(port);
+	struct i2c_profile_slave *s;
+
+	if (idx < 0)
+		return;
+
+	ports[idx].xfers++;
+	ports[idx].busy_us += busy_us;
+
+	s = get_slave(idx, slave_addr_flags);
+	if (!s) {
+		ports[idx].untracked++;
+		return;
+	}
+	s->xfers++;
+	s->bytes += bytes;
+	s->busy_us += busy_us;
+	s->max_us = MAX(s->max_us, busy_us);
+	if (rv)
+		s->errors++;
+}
+
+void i2c_profile_retry(int port, uint16_t slave_addr_flags)
+{
+	const int idx = port_index(port);
+	struct i2c_profile_slave *s;
+
+	if (idx < 0)
+		return;
+
+	s = get_slave(idx, slave_addr_flags);
+	if (s)
+		s->retries++;
+}
+
+void i2c_profile_lock(int port, uint32_t wait_us)
+{
+	const int idx = port_index(port);
+
+	if (idx < 0)
+		return;
+
+	ports[idx].locks++;
+	ports[idx].lock_wait_us += wait_us;
+	ports[idx].lock_wait_max_us = MAX(ports[idx].lock_wait_max_us,
+					  wait_us);
+}
+
+void i2c_profile_unwedge(int port, int rv)
+{
+	const int idx = port_index(port);
+
+	if (idx < 0)
+		return;
+
+	ports[idx].unwedges++;
+	if (rv)
+		ports[idx].unwedge_fails++;
+}
+
+/* Start a new sampling window. */
+static void i2c_profile_reset(void)
+{
+	int idx, i;
+
+	window_start = get_time().val;
+
+	for (idx = 0; idx < i2c_ports_used && idx < ARRAY_SIZE(ports); idx++) {
+		i2c_lock(i2c_ports[idx].port, 1);
+		memset(&ports[idx], 0, sizeof(ports[idx]));
+		for (i = 0; i < slave_count; i++) {
+			struct i2c_profile_slave *s = &slaves[i];
+
+			if (s->port_idx != idx)
+				continue;
+			s->busy_us = 0;
+			s->xfers = 0;
+			s->bytes = 0;
+			s->retries = 0;
+			s->max_us = 0;
+			s->errors = 0;
+		}
+		i2c_lock(i2c_ports[idx].port, 0);
+	}
+}
+
+/* Busy time as a share of the window, in tenths of a percent. */
+static int permille(uint64_t us, uint64_t window_us)
+{
+	return window_us ? (int)(us * 1000 / window_us) : 0;
+}
+
+static int command_i2c_profile(int argc, char **argv)
+{
+	const uint64_t window_us = get_time().val - window_start;
+	int idx, i, busy;
+
+	if (argc == 2 && !strcasecmp(argv[1], "reset")) {
+		i2c_profile_reset();
+		return EC_SUCCESS;
+	} else if (argc != 1) {
+		return EC_ERROR_PARAM_COUNT;
+	}
+
+	ccprintf("window %" PRId64 " ms\n", window_us / 1000);
+	for (idx = 0; idx < i2c_ports_used && idx < ARRAY_SIZE(ports); idx++) {
+		const struct i2c_profile_port *p = &ports[idx];
+
+		busy = permille(p->busy_us, window_us);
+		ccprintf("port %d %-8s xfers %u busy %d.%d%% locks %u "
+			 "wait %" PRId64 "/%u us unwedge %u (%u failed) "
+			 "untracked %u\n",
+			 i2c_ports[idx].port, i2c_ports[idx].name, p->xfers,
+			 busy / 10, busy % 10, p->locks, p->lock_wait_us,
+			 p->lock_wait_max_us, p->unwedges, p->unwedge_fails,
+			 p->untracked);
+		for (i = 0; i < slave_count; i++) {
+			const struct i2c_profile_slave *s = &slaves[i];
+
+			if (s->port_idx != idx)
+				continue;
+			ccprintf("  0x%02x xfers %u bytes %u busy %" PRId64 " us "
+				 "max %u us err %u retry %u\n",
+				 I2C_GET_ADDR(s->addr_flags), s->xfers,
+				 s->bytes, s->busy_us, s->max_us, s->errors,
+				 s->retries);
+		}
+		cflush();
+	}
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(i2cprof, command_i2c_profile,
+			"[reset]",
+			"Show I2C bus usage, or start a new sampling window");
+
+static enum ec_status i2c_profile_host(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_i2c_profile *p = args->params;
+	struct ec_response_i2c_profile *r = args->response;
+	const int idx = port_index(p->port);
+	int i, max, n = 0;
+
+	if (idx < 0)
+		return EC_RES_INVALID_PARAM;
+	if (args->response_max < sizeof(*r))
+		return EC_RES_RESPONSE_TOO_BIG;
+	max = (args->response_max - sizeof(*r)) / sizeof(r->slaves[0]);
+
+	memset(r, 0, sizeof(*r));
+	r->window_us = get_time().val - window_start;
+	r->busy_us = ports[idx].busy_us;
+	r->lock_wait_us = ports[idx].lock_wait_us;
+	r->xfers = ports[idx].xfers;
+	r->locks = ports[idx].locks;
+	r->lock_wait_max_us = ports[idx].lock_wait_max_us;
+	r->untracked = ports[idx].untracked;
+	r->unwedges = ports[idx].unwedges;
+	r->unwedge_fails = ports[idx].unwedge_fails;
+
+	for (i = 0; i < slave_count; i++) {
+		const struct i2c_profile_slave *s = &slaves[i];
+		struct ec_i2c_profile_slave *out;
+
+		if (s->port_idx != idx)
+			continue;
+		if (r->slave_count++ < p->first || n >= max)
+			continue;
+
+		out = &r->slaves[n++];
+		out->addr_flags = s->addr_flags;
+		out->errors = s->errors;
+		out->xfers = s->xfers;
+		out->bytes = s->bytes;
+		out->retries = s->retries;
+		out->max_us = s->max_us;
+		out->busy_us = s->busy_us;
+	}
+	r->num_slaves = n;
+	args->response_size = sizeof(*r) + n * sizeof(r->slaves[0]);
+
+	if (p->flags & EC_I2C_PROFILE_RESET)
+		i2c_profile_reset();
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_PRIVATE_HOST_COMMAND(EC_CMD_I2C_PROFILE, i2c_profile_host,
+			     EC_VER_MASK(0));
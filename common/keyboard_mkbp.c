@@ -40,10 +40,12 @@
  * to read them out right away.
  *
  * RAM usage is (depth * #cols); A 16-entry FIFO will consume 16x13=208 bytes,
- * which is non-trivial but not horrible.
+ * which is non-trivial but not horrible.  Boards which see bursts of events
+ * (fast typing on top of sensor traffic) can raise CONFIG_MKBP_FIFO_DEPTH.
  */
-
-#define FIFO_DEPTH 16
+#define FIFO_DEPTH CONFIG_MKBP_FIFO_DEPTH
+/* fifo_max_depth is reported to the host as an uint8_t */
+BUILD_ASSERT(FIFO_DEPTH > 0 && FIFO_DEPTH <= UINT8_MAX);
 
 /* Changes to col,row here need to also be reflected in kernel.
  * drivers/input/mkbp.c ... see KEY_BATTERY.
@@ -63,6 +63,12 @@ struct mkbp_state {
 	 * get_next_events in order to limit the retry logic.
 	 */
 	uint8_t failed_attempts;
+#ifdef CONFIG_MKBP_EVENT_COALESCE
+	/* Number of events queued while the interrupt is held back. */
+	uint8_t coalesced;
+	/* Set once the coalescing timeout expired for the held events. */
+	uint8_t coalesce_expired;
+#endif
 };
 
 static struct mkbp_state state;
@@ -76,6 +82,16 @@ static uint32_t mkbp_event_wake_mask = CONFIG_MKBP_EVENT_WAKEUP_MASK;
 static uint32_t mkbp_host_event_wake_mask = CONFIG_MKBP_HOST_EVENT_WAKEUP_MASK;
 #endif /* CONFIG_MKBP_HOST_EVENT_WAKEUP_MASK */
 
+#ifdef CONFIG_MKBP_EVENT_COALESCE
+static struct {
+	uint8_t watermark;
+	uint32_t timeout_us;
+} coalesce = {
+	.watermark = CONFIG_MKBP_EVENT_COALESCE_WATERMARK,
+	.timeout_us = CONFIG_MKBP_EVENT_COALESCE_TIMEOUT_US,
+};
+#endif /* CONFIG_MKBP_EVENT_COALESCE */
+
 #if defined(CONFIG_MKBP_USE_GPIO) || \
 	defined(CONFIG_MKBP_USE_GPIO_AND_HOST_EVENT)
 static int mkbp_set_host_active_via_gpio(int active, uint32_t *timestamp)
@@ -189,11 +205,49 @@ static inline int host_is_sleeping(void)
 static void force_mkbp_if_events(void);
 DECLARE_DEFERRED(force_mkbp_if_events);
 
+#ifdef CONFIG_MKBP_EVENT_COALESCE
+/*
+ * Deferred function raising the interrupt for events which were held back,
+ * once the coalescing timeout has elapsed.
+ */
+static void mkbp_coalesce_expire(void);
+DECLARE_DEFERRED(mkbp_coalesce_expire);
+
+/*
+ * Check whether the interrupt should be held back so that more events can be
+ * handed to the AP with a single interrupt.
+ *
+ * This can only be called when the state.lock mutex is held.
+ *
+ * @return 1 if the interrupt should be held back, 0 to raise it now.
+ */
+static int coalesce_interrupt(uint32_t events_to_add)
+{
+	if (events_to_add && state.coalesced < UINT8_MAX)
+		state.coalesced++;
+
+	return coalesce.watermark > 1 && !state.coalesce_expired &&
+	       state.coalesced < coalesce.watermark &&
+	       !(state.events & CONFIG_MKBP_EVENT_COALESCE_IMMEDIATE);
+}
+
+/* This can only be called when the state.lock mutex is held */
+static void coalesce_reset(void)
+{
+	state.coalesced = 0;
+	state.coalesce_expired = 0;
+}
+#endif /* CONFIG_MKBP_EVENT_COALESCE */
+
 static void activate_mkbp_with_events(uint32_t events_to_add)
 {
 	int interrupt_id = -1;
 	int skip_interrupt = 0;
+	int hold_interrupt = 0;
 	int rv, schedule_deferred = 0;
+#ifdef CONFIG_MKBP_EVENT_COALESCE
+	int arm_coalesce = 0;
+#endif
 
 #ifdef CONFIG_MKBP_HOST_EVENT_WAKEUP_MASK
 	/*
@@ -224,11 +278,33 @@ static void activate_mkbp_with_events(uint32_t events_to_add)
 
 	if (state.events && state.interrupt == INTERRUPT_INACTIVE &&
 	    !skip_interrupt) {
-		state.interrupt = INTERRUPT_INACTIVE_TO_ACTIVE;
-		interrupt_id = ++state.interrupt_id;
+#ifdef CONFIG_MKBP_EVENT_COALESCE
+		hold_interrupt = coalesce_interrupt(events_to_add);
+		/*
+		 * Arm the coalescing timeout on the first held event only, so
+		 * that a steady stream of events cannot keep pushing the
+		 * interrupt out.
+		 */
+		arm_coalesce = hold_interrupt && events_to_add &&
+			       state.coalesced == 1;
+		if (!hold_interrupt)
+			coalesce_reset();
+#endif
+		if (!hold_interrupt) {
+			state.interrupt = INTERRUPT_INACTIVE_TO_ACTIVE;
+			interrupt_id = ++state.interrupt_id;
+		}
 	}
 	mutex_unlock(&state.lock);
 
+#ifdef CONFIG_MKBP_EVENT_COALESCE
+	if (arm_coalesce)
+		hook_call_deferred(&mkbp_coalesce_expire_data,
+				   coalesce.timeout_us);
+	else if (interrupt_id >= 0)
+		hook_call_deferred(&mkbp_coalesce_expire_data, -1);
+#endif
+
 	/* If we don't need to send an interrupt we are done */
 	if (interrupt_id < 0)
 		return;
@@ -272,6 +348,10 @@ static void force_mkbp_if_events(void)
 			toggled = 1;
 		}
 	}
+#ifdef CONFIG_MKBP_EVENT_COALESCE
+	/* The AP already waited long enough, do not hold the retry back. */
+	state.coalesce_expired = 1;
+#endif
 	mutex_unlock(&state.lock);
 
 	if (toggled)
@@ -280,6 +360,17 @@ static void force_mkbp_if_events(void)
 	activate_mkbp_with_events(0);
 }
 
+#ifdef CONFIG_MKBP_EVENT_COALESCE
+static void mkbp_coalesce_expire(void)
+{
+	mutex_lock(&state.lock);
+	state.coalesce_expired = 1;
+	mutex_unlock(&state.lock);
+
+	activate_mkbp_with_events(0);
+}
+#endif /* CONFIG_MKBP_EVENT_COALESCE */
+
 test_mockable int mkbp_send_event(uint8_t event_type)
 {
 	activate_mkbp_with_events(BIT(event_type));
@@ -296,6 +387,9 @@ static int set_inactive_if_no_events(void)
 	if (interrupt_cleared) {
 		state.interrupt = INTERRUPT_INACTIVE;
 		state.failed_attempts = 0;
+#ifdef CONFIG_MKBP_EVENT_COALESCE
+		coalesce_reset();
+#endif
 		/* Only simple tasks (i.e. gpio set or no-op) allowed here */
 		mkbp_set_host_active(0, NULL);
 	}
@@ -319,20 +413,29 @@ static int take_event_if_set(uint8_t event_type)
 	return taken;
 }
 
-static enum ec_status mkbp_get_next_event(struct host_cmd_handler_args *args)
+/*
+ * Take the next pending event, servicing the event sources in a round-robin
+ * way to make sure no event gets starved.
+ *
+ * @param event_type	Where to store the type of the event taken
+ * @param data		Where to store the event data, must hold at least
+ *			sizeof(union ec_response_get_next_data_v1)
+ * @param data_size	Where to store the size returned by the event source's
+ *			get_data(); negative on error
+ * @return EC_RES_SUCCESS if an event was taken, EC_RES_UNAVAILABLE if no event
+ *	   is pending, EC_RES_ERROR if the event has no source.
+ */
+static enum ec_status take_next_event(uint8_t *event_type, uint8_t *data,
+				      int *data_size)
 {
 	static int last;
 	int i, evt;
-	uint8_t *resp = args->response;
 	const struct mkbp_event_source *src;
 
-	int data_size = -EC_ERROR_BUSY;
+	*data_size = -EC_ERROR_BUSY;
 
 	do {
-		/*
-		 * Find the next event to service.  We do this in a round-robin
-		 * way to make sure no event gets starved.
-		 */
+		/* Find the next event to service. */
 		mutex_lock(&state.lock);
 		for (i = 0; i < EC_MKBP_EVENT_COUNT; ++i)
 			if (take_event_if_set((last + i) % EC_MKBP_EVENT_COUNT))
@@ -356,7 +459,7 @@ static enum ec_status mkbp_get_next_event(struct host_cmd_handler_args *args)
 		if (src == __mkbp_evt_srcs_end)
 			return EC_RES_ERROR;
 
-		resp[0] = evt; /* Event type */
+		*event_type = evt;
 
 		/*
 		 * get_data() can return -EC_ERROR_BUSY which indicates that the
@@ -366,13 +469,27 @@ static enum ec_status mkbp_get_next_event(struct host_cmd_handler_args *args)
 		 * event instead.  Therefore, we have to service that button
 		 * event first.
 		 */
-		data_size = src->get_data(resp + 1);
-		if (data_size == -EC_ERROR_BUSY) {
+		*data_size = src->get_data(data);
+		if (*data_size == -EC_ERROR_BUSY) {
 			mutex_lock(&state.lock);
 			state.events |= BIT(evt);
 			mutex_unlock(&state.lock);
 		}
-	} while (data_size == -EC_ERROR_BUSY);
+	} while (*data_size == -EC_ERROR_BUSY);
+
+	return EC_RES_SUCCESS;
+}
+
+static enum ec_status mkbp_get_next_event(struct host_cmd_handler_args *args)
+{
+	uint8_t *resp = args->response;
+	enum ec_status rv;
+	int data_size;
+
+	/* Event type goes in the first byte, followed by the event data. */
+	rv = take_next_event(&resp[0], resp + 1, &data_size);
+	if (rv != EC_RES_SUCCESS)
+		return rv;
 
 	/* If there are no more events and we support the "more" flag, set it */
 	if (!set_inactive_if_no_events() && args->version >= 2)
@@ -388,6 +505,72 @@ DECLARE_HOST_COMMAND(EC_CMD_GET_NEXT_EVENT,
 		     mkbp_get_next_event,
 		     EC_VER_MASK(0) | EC_VER_MASK(1) | EC_VER_MASK(2));
 
+static enum ec_status mkbp_get_next_events(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_get_next_events *p = args->params;
+	struct ec_response_get_next_events *r = args->response;
+	const size_t rec_hdr = offsetof(struct ec_mkbp_event_record, data);
+	int max_events = args->params_size >= sizeof(*p) && p->max_events ?
+			 p->max_events : UINT8_MAX;
+	size_t used = sizeof(*r);
+	enum ec_status rv = EC_RES_SUCCESS;
+	int data_size;
+
+	if (args->response_max < sizeof(*r))
+		return EC_RES_INVALID_PARAM;
+
+	r->count = 0;
+	r->flags = 0;
+
+	/*
+	 * Only take an event if a record of the largest size still fits, as
+	 * the event is consumed before its size is known.
+	 */
+	while (r->count < max_events &&
+	       used + sizeof(struct ec_mkbp_event_record) <=
+			args->response_max) {
+		struct ec_mkbp_event_record *rec =
+			(struct ec_mkbp_event_record *)((uint8_t *)r + used);
+
+		rv = take_next_event(&rec->event_type,
+				     (uint8_t *)&rec->data, &data_size);
+		if (rv != EC_RES_SUCCESS)
+			break;
+
+		if (data_size < 0) {
+			/*
+			 * Leave the failing event pending and return the
+			 * records gathered so far, the error is reported
+			 * when it is the first event of a request.
+			 */
+			if (r->count) {
+				mutex_lock(&state.lock);
+				state.events |= BIT(rec->event_type);
+				mutex_unlock(&state.lock);
+			}
+			rv = EC_RES_ERROR;
+			break;
+		}
+
+		rec->size = data_size;
+		used += rec_hdr + data_size;
+		r->count++;
+	}
+
+	if (!r->count)
+		return rv;
+
+	if (!set_inactive_if_no_events())
+		r->flags |= EC_MKBP_HAS_MORE_EVENTS;
+
+	args->response_size = used;
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_PRIVATE_HOST_COMMAND(EC_CMD_GET_NEXT_EVENTS,
+		     mkbp_get_next_events,
+		     EC_VER_MASK(0));
+
 #ifdef CONFIG_MKBP_HOST_EVENT_WAKEUP_MASK
 #ifdef CONFIG_MKBP_USE_HOST_EVENT
 static enum ec_status
@@ -510,3 +693,36 @@ DECLARE_CONSOLE_COMMAND(mkbpwakemask, command_mkbp_wake_mask,
 			"[event | hostevent] [new_mask]",
 			"Show or set MKBP event/hostevent wake mask");
 #endif /* CONFIG_MKBP_(HOST)?EVENT_WAKEUP_MASK */
+
+#ifdef CONFIG_MKBP_EVENT_COALESCE
+static int command_mkbp_coalesce(int argc, char **argv)
+{
+	char *e;
+
+	if (argc > 3)
+		return EC_ERROR_PARAM_COUNT;
+
+	if (argc > 1) {
+		int watermark = strtoi(argv[1], &e, 0);
+
+		if (*e || watermark < 0 || watermark > UINT8_MAX)
+			return EC_ERROR_PARAM1;
+		coalesce.watermark = watermark;
+	}
+
+	if (argc > 2) {
+		int timeout_us = strtoi(argv[2], &e, 0);
+
+		if (*e || timeout_us < 0)
+			return EC_ERROR_PARAM2;
+		coalesce.timeout_us = timeout_us;
+	}
+
+	ccprintf("MKBP coalescing: watermark %d, timeout %d us\n",
+		 coalesce.watermark, coalesce.timeout_us);
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(mkbpcoalesce, command_mkbp_coalesce,
+			"[watermark [timeout_us]]",
+			"Show or set MKBP interrupt coalescing");
+#endif /* CONFIG_MKBP_EVENT_COALESCE */
@@ -18,6 +18,7 @@
 #include "math_util.h"
 #include "motion_lid.h"
 #include "motion_sense.h"
+#include "motion_sense_decim.h"
 #include "power.h"
 #include "tablet_mode.h"
 #include "timer.h"
@@ -49,6 +50,29 @@ static int lid_angle_is_reliable;
 /* Smoothed vectors to increase accurency. */
 static intv3_t smoothed_base, smoothed_lid;
 
+/*
+ * Projections the last angle was computed from, to skip the trigonometry when
+ * the vectors did not move by more than LID_PROJ_CACHE_TOLERANCE.
+ */
+static intv3_t cached_proj_base, cached_proj_lid;
+static fp_t cached_lid_to_base_fp = FLOAT_TO_FP(-1);
+
+/*
+ * Largest change of a projection axis, in scaled units (1g is
+ * MOTION_SCALING_FACTOR), for which the cached angle is reused: about 0.1
+ * degree for a horizontal hinge, 0.25 degree at the hinge angle limit.
+ */
+#define LID_PROJ_CACHE_TOLERANCE (MOTION_SCALING_FACTOR / 512)
+
+#ifdef CONFIG_LID_ANGLE_STREAMING
+/*
+ * Filtered gravity vector of each half, multiplied by
+ * 2^CONFIG_LID_ANGLE_STREAMING_FILTER_SHIFT, and which ones have been seeded.
+ */
+static intv3_t gravity_base, gravity_lid;
+static uint32_t gravity_seeded;
+#endif
+
 /* 8.7 m/s^2 is the the maximum acceleration parallel to the hinge */
 #define SCALED_HINGE_VERTICAL_MAXIMUM  \
 	((int)((8.7f * MOTION_SCALING_FACTOR) / MOTION_ONE_G))
@@ -266,6 +290,16 @@ static void motion_lid_set_dptf_profile(int reliable)
 
 #endif /* CONFIG_DPTF_MULTI_PROFILE && CONFIG_DPTF_MOTION_LID_NO_GMR_SENSOR */
 
+static int proj_is_near(const intv3_t v, const intv3_t cached)
+{
+	int i;
+
+	for (i = X; i <= Z; i++)
+		if (ABS(v[i] - cached[i]) > LID_PROJ_CACHE_TOLERANCE)
+			return 0;
+	return 1;
+}
+
 /**
  * Calculate the lid angle using two acceleration vectors, one recorded in
  * the base and one in the lid.
@@ -376,6 +410,13 @@ static int calculate_lid_angle(const intv3_t base, const intv3_t lid,
 	proj_base[HINGE_AXIS] = 0;
 	proj_lid[HINGE_AXIS] = 0;
 
+	if (cached_lid_to_base_fp != FLOAT_TO_FP(-1) &&
+	    proj_is_near(proj_base, cached_proj_base) &&
+	    proj_is_near(proj_lid, cached_proj_lid)) {
+		lid_to_base_fp = cached_lid_to_base_fp;
+		goto check_lid_angle;
+	}
+
 	/* Calculate the clockwise angle */
 	lid_to_base_fp = arc_cos(cosine_of_angle_diff(proj_base, proj_lid));
 	cross_product(proj_base, proj_lid, cross);
@@ -403,6 +444,11 @@ static int calculate_lid_angle(const intv3_t base, const intv3_t lid,
 	if (lid_to_base_fp < 0)
 		lid_to_base_fp += FLOAT_TO_FP(360);
 
+	memcpy(cached_proj_base, proj_base, sizeof(intv3_t));
+	memcpy(cached_proj_lid, proj_lid, sizeof(intv3_t));
+	cached_lid_to_base_fp = lid_to_base_fp;
+
+check_lid_angle:
 #ifdef CONFIG_TABLET_MODE
 	/* Ignore large angles when the lid is closed. */
 	if (!lid_is_open() &&
@@ -478,21 +524,108 @@ int motion_lid_get_angle(void)
 		return LID_ANGLE_UNRELIABLE;
 }
 
-/*
- * Calculate lid angle and massage the results
- */
-void motion_lid_calc(void)
+static void motion_lid_calc_from(const intv3_t base, const intv3_t lid)
 {
 	/* Calculate angle of lid accel. */
-	lid_angle_is_reliable = calculate_lid_angle(
-			accel_base->xyz, accel_lid->xyz,
-			&lid_angle_deg);
+	lid_angle_is_reliable = calculate_lid_angle(base, lid, &lid_angle_deg);
 
 #ifdef CONFIG_LID_ANGLE_UPDATE
 	lid_angle_update(motion_lid_get_angle());
 #endif
 }
 
+/*
+ * Get the next sample of a lid angle sensor.
+ *
+ * @return 0 if the sample is decimated away.
+ */
+static int lid_sample(const struct motion_sensor_t *sensor, intv3_t v)
+{
+#ifdef CONFIG_MOTION_SENSE_DECIM
+	return motion_decim_sample(sensor, MOTION_DECIM_LID_ANGLE, v);
+#else
+	memcpy(v, sensor->xyz, sizeof(intv3_t));
+	return 1;
+#endif
+}
+
+/*
+ * Calculate lid angle and massage the results
+ */
+void motion_lid_calc(void)
+{
+	intv3_t base, lid;
+	/* Both halves are always fed together, their stages stay in step. */
+	int ready = lid_sample(accel_base, base);
+
+	ready &= lid_sample(accel_lid, lid);
+	if (ready)
+		motion_lid_calc_from(base, lid);
+}
+
+#ifdef CONFIG_LID_ANGLE_STREAMING
+/*
+ * Low-pass filter one half: the sum moves by the difference between the
+ * sample and the current output, so it settles exactly on a steady input
+ * whatever the sign of the difference.
+ */
+static void filter_gravity(intv3_t gravity, const intv3_t sample, int seed)
+{
+	const int shift = CONFIG_LID_ANGLE_STREAMING_FILTER_SHIFT;
+	int i;
+
+	for (i = X; i <= Z; i++) {
+		if (seed)
+			gravity[i] = sample[i] * (1 << shift);
+		else
+			gravity[i] += sample[i] - (gravity[i] >> shift);
+	}
+}
+
+void motion_lid_update(uint32_t updated)
+{
+	const uint32_t base_bit = BIT(CONFIG_LID_ANGLE_SENSOR_BASE);
+	const uint32_t lid_bit = BIT(CONFIG_LID_ANGLE_SENSOR_LID);
+	const int shift = CONFIG_LID_ANGLE_STREAMING_FILTER_SHIFT;
+	intv3_t v, base, lid;
+	int i;
+
+	/*
+	 * calculate_lid_angle() only smooths its inputs when the hinge is
+	 * close to vertical, filter each half here so that a half that reports
+	 * alone does not pass its noise straight to the angle.
+	 */
+	if ((updated & base_bit) && lid_sample(accel_base, v)) {
+		filter_gravity(gravity_base, v, !(gravity_seeded & base_bit));
+		gravity_seeded |= base_bit;
+	}
+	if ((updated & lid_bit) && lid_sample(accel_lid, v)) {
+		filter_gravity(gravity_lid, v, !(gravity_seeded & lid_bit));
+		gravity_seeded |= lid_bit;
+	}
+
+	/* Wait for both halves to have reported once. */
+	if (gravity_seeded != (base_bit | lid_bit))
+		return;
+
+	for (i = X; i <= Z; i++) {
+		base[i] = gravity_base[i] >> shift;
+		lid[i] = gravity_lid[i] >> shift;
+	}
+	motion_lid_calc_from(base, lid);
+}
+
+/*
+ * Sensors are reinitialized when the AP resumes, do not mix in samples from
+ * before the suspend.
+ */
+static void motion_lid_resume(void)
+{
+	gravity_seeded = 0;
+}
+DECLARE_HOOK(HOOK_CHIPSET_RESUME, motion_lid_resume, HOOK_PRIO_DEFAULT);
+#endif /* CONFIG_LID_ANGLE_STREAMING */
+
 /*****************************************************************************/
 /* Host commands */
 
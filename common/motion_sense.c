@@ -20,6 +20,7 @@
 #include "math_util.h"
 #include "mkbp_event.h"
 #include "motion_sense.h"
+#include "motion_sense_decim.h"
 #include "motion_sense_fifo.h"
 #include "motion_lid.h"
 #include "online_calibration.h"
@@ -178,6 +179,13 @@ int motion_sense_set_data_rate(struct motion_sensor_t *sensor)
 			sensor->drv->get_data_rate(sensor) / ap_odr_mhz);
 	else
 		sensor->oversampling_ratio = 0;
+#ifdef CONFIG_MOTION_SENSE_DECIM
+	/* Low-pass what the AP FIFO drops when it asked for a lower rate. */
+	motion_decim_init(motion_decim_get(sensor, MOTION_DECIM_AP_FIFO),
+			  sensor->oversampling_ratio,
+			  motion_decim_default_shift(
+				  sensor->oversampling_ratio));
+#endif
 
 	/*
 	 * Reset last collection: the last collection may be so much in the past
@@ -914,7 +922,12 @@ void motion_sense_task(void *u)
 		 * calculation are ready.
 		 */
 		ready_status &= lid_angle_sensors;
-		if (ready_status == lid_angle_sensors) {
+		if (IS_ENABLED(CONFIG_LID_ANGLE_STREAMING)) {
+			/* Use whichever half has a new sample. */
+			if (ready_status)
+				motion_lid_update(ready_status);
+			ready_status = 0;
+		} else if (ready_status == lid_angle_sensors) {
 			motion_lid_calc();
 			ready_status = 0;
 		}
@@ -0,0 +1,179 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+ * Per consumer decimation and low-pass stage for motion sensor samples.
+ *
+ * A sensor runs at the highest rate any of its consumers needs. Consumers
+ * that need less (AP FIFO when the EC runs the sensor faster, lid angle, body
+ * detection) get their own stream: every sample goes through a one pole
+ * fixed point IIR to avoid aliasing, and only one every ratio samples is
+ * passed on.
+ */
+
+#include "body_detection.h"
+#include "common.h"
+#include "console.h"
+#include "motion_sense.h"
+#include "motion_sense_decim.h"
+#include "task.h"
+#include "util.h"
+
+/* Default low-pass for a ratio, see motion_decim_default_shift() */
+#define DECIM_DEFAULT(R) {						\
+	.ratio = (R),							\
+	.shift = (R) > 1 ? (__fls(R) < MOTION_DECIM_MAX_SHIFT ?	\
+			    __fls(R) : MOTION_DECIM_MAX_SHIFT) : 0,	\
+}
+
+static struct motion_decim
+decim[MAX_MOTION_SENSORS][MOTION_DECIM_CONSUMER_COUNT] = {
+	[0 ... (MAX_MOTION_SENSORS - 1)] = {
+		[MOTION_DECIM_LID_ANGLE] =
+			DECIM_DEFAULT(CONFIG_LID_ANGLE_DECIM),
+		[MOTION_DECIM_BODY_DETECT] =
+			DECIM_DEFAULT(CONFIG_BODY_DETECTION_DECIM),
+	},
+};
+
+static const char * const consumer_names[] = {
+	[MOTION_DECIM_AP_FIFO] = "ap",
+	[MOTION_DECIM_LID_ANGLE] = "lid",
+	[MOTION_DECIM_BODY_DETECT] = "body",
+};
+BUILD_ASSERT(ARRAY_SIZE(consumer_names) == MOTION_DECIM_CONSUMER_COUNT);
+
+int motion_decim_default_shift(int ratio)
+{
+	return ratio > 1 ? MIN(__fls(ratio), MOTION_DECIM_MAX_SHIFT) : 0;
+}
+
+void motion_decim_init(struct motion_decim *d, int ratio, int shift)
+{
+	memset(d, 0, sizeof(*d));
+	d->ratio = ratio;
+	d->shift = MIN(shift, MOTION_DECIM_MAX_SHIFT);
+}
+
+bool motion_decim_push(struct motion_decim *d, const intv3_t in, intv3_t out)
+{
+	bool emit;
+	int i;
+
+	d->in++;
+
+	if (d->shift) {
+		if (!d->primed) {
+			for (i = X; i <= Z; i++)
+				d->acc[i] = in[i] * (1 << d->shift);
+			d->primed = 1;
+		} else {
+			for (i = X; i <= Z; i++)
+				d->acc[i] += in[i] - (d->acc[i] >> d->shift);
+		}
+	}
+
+	/* Pass the first input, like the AP FIFO oversampling always did. */
+	if (d->ratio > 1) {
+		emit = !d->count;
+		if (++d->count == d->ratio)
+			d->count = 0;
+		if (!emit)
+			return false;
+	}
+
+	for (i = X; i <= Z; i++)
+		out[i] = d->shift ? d->acc[i] >> d->shift : in[i];
+	d->out++;
+
+	return true;
+}
+
+struct motion_decim *motion_decim_get(const struct motion_sensor_t *sensor,
+				      enum motion_decim_consumer consumer)
+{
+	return &decim[sensor - motion_sensors][consumer];
+}
+
+bool motion_decim_sample(const struct motion_sensor_t *sensor,
+			 enum motion_decim_consumer consumer, intv3_t out)
+{
+	bool ret;
+
+	/* acceldecim and ODR changes reconfigure the stages under the lock. */
+	mutex_lock(&g_sensor_mutex);
+	ret = motion_decim_push(motion_decim_get(sensor, consumer),
+				sensor->xyz, out);
+	mutex_unlock(&g_sensor_mutex);
+
+	return ret;
+}
+
+#ifdef CONFIG_CMD_ACCELS
+static int command_motion_decim(int argc, char **argv)
+{
+	struct motion_decim *d;
+	int id, consumer, ratio, shift;
+	char *e;
+
+	if (argc == 1) {
+		for (id = 0; id < motion_sensor_count; id++) {
+			for (consumer = 0;
+			     consumer < MOTION_DECIM_CONSUMER_COUNT;
+			     consumer++) {
+				d = &decim[id][consumer];
+				ccprintf("%d %-4s ratio %d shift %d in %u "
+					 "out %u\n", id,
+					 consumer_names[consumer],
+					 MAX(d->ratio, 1), d->shift, d->in,
+					 d->out);
+			}
+		}
+		return EC_SUCCESS;
+	}
+
+	if (argc < 4 || argc > 5)
+		return EC_ERROR_PARAM_COUNT;
+
+	id = strtoi(argv[1], &e, 0);
+	if (*e || id < 0 || id >= motion_sensor_count)
+		return EC_ERROR_PARAM1;
+
+	for (consumer = 0; consumer < MOTION_DECIM_CONSUMER_COUNT; consumer++)
+		if (!strcasecmp(argv[2], consumer_names[consumer]))
+			break;
+	/* The AP FIFO stage follows the AP ODR, see motion_sense.c */
+	if (consumer == MOTION_DECIM_CONSUMER_COUNT ||
+	    consumer == MOTION_DECIM_AP_FIFO)
+		return EC_ERROR_PARAM2;
+
+	ratio = strtoi(argv[3], &e, 0);
+	if (*e || ratio < 1 || ratio > UINT16_MAX)
+		return EC_ERROR_PARAM3;
+
+	shift = motion_decim_default_shift(ratio);
+	if (argc == 5) {
+		shift = strtoi(argv[4], &e, 0);
+		if (*e || shift < 0 || shift > MOTION_DECIM_MAX_SHIFT)
+			return EC_ERROR_PARAM4;
+	}
+
+	mutex_lock(&g_sensor_mutex);
+	motion_decim_init(&decim[id][consumer], ratio, shift);
+	mutex_unlock(&g_sensor_mutex);
+
+#ifdef CONFIG_BODY_DETECTION
+	/* The detection window depends on the rate it gets samples at. */
+	if (consumer == MOTION_DECIM_BODY_DETECT &&
+	    id == CONFIG_BODY_DETECTION_SENSOR)
+		body_detect_reset();
+#endif
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(acceldecim, command_motion_decim,
+	"[id ap|lid|body ratio [shift]]",
+	"Show or set per consumer decimation of sensor samples");
+#endif /* CONFIG_CMD_ACCELS */
@@ -7,6 +7,7 @@
 #include "console.h"
 #include "hwtimer.h"
 #include "mkbp_event.h"
+#include "motion_sense_decim.h"
 #include "motion_sense_fifo.h"
 #include "tablet_mode.h"
 #include "task.h"
@@ -45,8 +46,18 @@ struct timestamp_state {
 	uint32_t next;
 };
 
+#ifdef CONFIG_ACCEL_FIFO_COMPACT
+/*
+ * Only stage data in the queue, committed data is moved to the compact ring
+ * below which uses the rest of the fifo RAM.
+ */
+#define FIFO_QUEUE_SIZE CONFIG_ACCEL_FIFO_COMPACT_STAGE_SIZE
+#else
+#define FIFO_QUEUE_SIZE CONFIG_ACCEL_FIFO_SIZE
+#endif
+
 /** Queue to hold the data to be sent to the AP. */
-static struct queue fifo = QUEUE_NULL(CONFIG_ACCEL_FIFO_SIZE,
+static struct queue fifo = QUEUE_NULL(FIFO_QUEUE_SIZE,
 				      struct ec_response_motion_sensor_data);
 /** Count of the number of entries lost due to a small queue. */
 static int fifo_lost;
@@ -67,6 +78,83 @@ static uint32_t next_timestamp_initialized;
 /** Need to wake up the AP. */
 static int wake_up_needed;
 
+#ifdef CONFIG_ACCEL_FIFO_COMPACT
+BUILD_ASSERT(CONFIG_ACCEL_FIFO_COMPACT_STAGE_SIZE < CONFIG_ACCEL_FIFO_SIZE);
+/* A timestamp and its data are staged together */
+BUILD_ASSERT(CONFIG_ACCEL_FIFO_COMPACT_STAGE_SIZE >= 2);
+
+#define RING_BYTES ((CONFIG_ACCEL_FIFO_SIZE - \
+		     CONFIG_ACCEL_FIFO_COMPACT_STAGE_SIZE) * \
+		    sizeof(struct ec_response_motion_sensor_data))
+
+/*
+ * Committed entries are stored as a stream of records, each starting with a
+ * tag byte:
+ * - REC_SAMPLE: a timestamp and the data that follows it, the timestamp being
+ *   the previous one of the same sensor plus its period. The tag is followed
+ *   by the 3 axis.
+ * - REC_SAMPLE_DELTA: same, but the tag is followed by the delta to the
+ *   previous timestamp of the sensor as a varint, which becomes the sensor
+ *   period, then by the 3 axis.
+ * - REC_TIMESTAMP: a timestamp whose data was not kept, the tag is followed
+ *   by its signed difference to the previous timestamp of the sensor as a
+ *   zigzag varint. It does not change the timestamp and period the sample
+ *   records of the sensor are based on.
+ * - REC_RAW: any other entry, stored as is after the tag.
+ */
+#define REC_TYPE_MASK		0xc0
+#define REC_SAMPLE		0x00
+#define REC_SAMPLE_DELTA	0x40
+#define REC_RAW			0x80
+#define REC_TIMESTAMP		0xc0
+#define REC_WAKEUP		BIT(5)
+#define REC_TABLET		BIT(4)
+#define REC_SENSOR_MASK		0x0f
+
+/* Tag, 5 bytes varint and 3 axis */
+#define REC_MAX_BYTES 12
+/* Tag and 1 byte varint, for a timestamp alone */
+#define REC_MIN_BYTES 2
+
+/*
+ * Most entries the ring can hold: all in the smallest records for one
+ * entry, plus the second entry of a record the AP only read half of.
+ * Reported to the AP as the FIFO size.
+ */
+#define RING_ENTRIES (RING_BYTES / REC_MIN_BYTES + 1)
+
+/**
+ * Position in the record stream and the per sensor state needed to decode
+ * the records that follow.
+ * @pos: Offset in the ring of the next record
+ * @ts: Last timestamp seen per sensor
+ * @period: Last timestamp delta seen per sensor
+ */
+struct ring_cursor {
+	int pos;
+	uint32_t ts[MAX_MOTION_SENSORS];
+	uint32_t period[MAX_MOTION_SENSORS];
+};
+
+/**
+ * Ring of committed records.
+ * @used: Number of bytes used in buf
+ * @entries: Number of legacy entries held, including pending
+ * @head: Where the next record is read from
+ * @tail: Where the next record is written to
+ * @pending: Second entry of a record the AP only had room for half of
+ */
+static struct {
+	uint8_t buf[RING_BYTES];
+	int used;
+	int entries;
+	struct ring_cursor head;
+	struct ring_cursor tail;
+	struct ec_response_motion_sensor_data pending;
+	bool has_pending;
+} ring;
+#endif /* CONFIG_ACCEL_FIFO_COMPACT */
+
 /**
  * Check whether or not a give sensor data entry is a timestamp or not.
  *
@@ -178,14 +266,34 @@ static void fifo_pop(void)
 	}
 }
 
+static void fifo_commit_locked(void);
+
 /**
- * Make sure that the fifo has at least 1 empty spot to stage data into.
+ * Make sure that the fifo has empty spots to stage data into.
+ *
+ * @param space Number of spots needed, only 1 is guaranteed without
+ *	  CONFIG_ACCEL_FIFO_COMPACT.
  */
-static void fifo_ensure_space(void)
+static void fifo_ensure_space(int space)
 {
 	/* If we already have space just bail. */
-	if (queue_space(&fifo) > fifo_staged.count)
+	if (queue_space(&fifo) >= fifo_staged.count + space)
+		return;
+
+	/*
+	 * With the compact fifo the queue only holds staged data: make room by
+	 * moving it to the ring rather than dropping it. Room for a timestamp
+	 * is made together with room for its data, so this never commits
+	 * between the two.
+	 */
+	if (IS_ENABLED(CONFIG_ACCEL_FIFO_COMPACT)) {
+		uint32_t read_ts = fifo_staged.read_ts;
+
+		fifo_commit_locked();
+		/* Spread the rest of the batch against the same read time. */
+		fifo_staged.read_ts = read_ts;
 		return;
+	}
 
 	/*
 	 * Pop at least 1 spot, but if all the following conditions are met we
@@ -222,11 +330,16 @@ static inline bool is_new_timestamp(uint8_t sensor_num)
  * Stage a single data unit to the motion sense fifo. Note that for the AP to
  * see this data, it must be committed.
  *
+ * WARNING: This function MUST be called from within a locked context of
+ * g_sensor_mutex.
+ *
  * @param data The data to stage.
  * @param sensor The sensor that generated the data
  * @param valid_data The number of readable data entries in the data.
+ * @return True if the data was not staged because of oversampling and should
+ *	   be passed to fifo_calibrate_unit() once the lock is released.
  */
-static void fifo_stage_unit(
+static bool fifo_stage_unit_locked(
 	struct ec_response_motion_sensor_data *data,
 	struct motion_sensor_t *sensor,
 	int valid_data)
@@ -234,8 +347,6 @@ static void fifo_stage_unit(
 	struct queue_chunk chunk;
 	int i;
 
-	mutex_lock(&g_sensor_mutex);
-
 	for (i = 0; i < valid_data; i++)
 		sensor->xyz[i] = data->data[i];
 
@@ -256,23 +367,32 @@ static void fifo_stage_unit(
 
 		if (sensor->oversampling_ratio == 0) {
 			removed = 1;
+		} else if (IS_ENABLED(CONFIG_MOTION_SENSE_DECIM) &&
+			   valid_data == 3) {
+			/*
+			 * The AP stage runs at the oversampling ratio: every
+			 * sample goes through its low-pass, the ones the AP
+			 * gets carry the filtered value.
+			 */
+			intv3_t v = { data->data[X], data->data[Y],
+				      data->data[Z] };
+
+			removed = !motion_decim_push(motion_decim_get(
+					sensor, MOTION_DECIM_AP_FIFO), v, v);
+			if (!removed)
+				for (i = X; i <= Z; i++)
+					data->data[i] = v[i];
 		} else {
 			removed = sensor->oversampling++;
 			sensor->oversampling %= sensor->oversampling_ratio;
 		}
-		if (removed) {
-			mutex_unlock(&g_sensor_mutex);
-			if (IS_ENABLED(CONFIG_ONLINE_CALIB) &&
-			    next_timestamp_initialized & BIT(data->sensor_num))
-				online_calibration_process_data(
-					data, sensor,
-					next_timestamp[data->sensor_num].next);
-			return;
-		}
+		if (removed)
+			return true;
 	}
 
-	/* Make sure we have room for the data */
-	fifo_ensure_space();
+	/* Make sure we have room for the data, and a timestamp's data */
+	fifo_ensure_space(IS_ENABLED(CONFIG_ACCEL_FIFO_COMPACT) &&
+			  is_timestamp(data) ? 2 : 1);
 
 	if (IS_ENABLED(CONFIG_TABLET_MODE))
 		data->flags |= (tablet_get_mode() ?
@@ -292,8 +412,7 @@ static void fifo_stage_unit(
 		 * address 0. Just don't add any data to the queue instead.
 		 */
 		CPRINTS("Failed to get write chunk for new fifo data!");
-		mutex_unlock(&g_sensor_mutex);
-		return;
+		return false;
 	}
 
 	/*
@@ -318,7 +437,46 @@ static void fifo_stage_unit(
 	    ++fifo_staged.sample_count[data->sensor_num] > 1)
 		fifo_staged.requires_spreading = 1;
 
+	return false;
+}
+
+/**
+ * Feed data that was removed by oversampling to the online calibration.
+ * Must be called without g_sensor_mutex held.
+ *
+ * @param data The data that was not staged.
+ * @param sensor The sensor that generated the data
+ */
+static void fifo_calibrate_unit(struct ec_response_motion_sensor_data *data,
+				struct motion_sensor_t *sensor)
+{
+	if (IS_ENABLED(CONFIG_ONLINE_CALIB) &&
+	    next_timestamp_initialized & BIT(data->sensor_num))
+		online_calibration_process_data(
+			data, sensor, next_timestamp[data->sensor_num].next);
+}
+
+/**
+ * Stage a single data unit to the motion sense fifo. Note that for the AP to
+ * see this data, it must be committed.
+ *
+ * @param data The data to stage.
+ * @param sensor The sensor that generated the data
+ * @param valid_data The number of readable data entries in the data.
+ */
+static void fifo_stage_unit(
+	struct ec_response_motion_sensor_data *data,
+	struct motion_sensor_t *sensor,
+	int valid_data)
+{
+	bool removed;
+
+	mutex_lock(&g_sensor_mutex);
+	removed = fifo_stage_unit_locked(data, sensor, valid_data);
 	mutex_unlock(&g_sensor_mutex);
+
+	if (removed)
+		fifo_calibrate_unit(data, sensor);
 }
 
 /**
@@ -352,6 +510,277 @@ peek_fifo_staged(size_t offset)
 		queue_get_write_chunk(&fifo, offset).buffer;
 }
 
+#ifdef CONFIG_ACCEL_FIFO_COMPACT
+static void ring_put(uint8_t byte)
+{
+	ring.buf[ring.tail.pos] = byte;
+	if (++ring.tail.pos == RING_BYTES)
+		ring.tail.pos = 0;
+	ring.used++;
+}
+
+static uint8_t ring_get(void)
+{
+	uint8_t byte = ring.buf[ring.head.pos];
+
+	if (++ring.head.pos == RING_BYTES)
+		ring.head.pos = 0;
+	ring.used--;
+	return byte;
+}
+
+static void ring_put_bytes(const void *data, int size)
+{
+	const uint8_t *p = data;
+
+	while (size--)
+		ring_put(*p++);
+}
+
+static void ring_get_bytes(void *data, int size)
+{
+	uint8_t *p = data;
+
+	while (size--)
+		*p++ = ring_get();
+}
+
+/**
+ * Decode the oldest record of the ring.
+ *
+ * @param out Entries decoded from the record.
+ * @return The number of entries decoded, 1 or 2.
+ */
+static int ring_pop(struct ec_response_motion_sensor_data out[2])
+{
+	uint8_t tag = ring_get();
+	int s = tag & REC_SENSOR_MASK;
+	uint32_t delta = 0;
+	int shift = 0;
+	uint8_t byte;
+
+	if ((tag & REC_TYPE_MASK) == REC_RAW) {
+		ring_get_bytes(out, sizeof(*out));
+		return 1;
+	}
+
+	if ((tag & REC_TYPE_MASK) != REC_SAMPLE) {
+		do {
+			byte = ring_get();
+			delta |= (uint32_t)(byte & 0x7f) << shift;
+			shift += 7;
+		} while (byte & 0x80);
+	}
+
+	if ((tag & REC_TYPE_MASK) == REC_TIMESTAMP) {
+		out[0].flags = MOTIONSENSE_SENSOR_FLAG_TIMESTAMP;
+		if (tag & REC_TABLET)
+			out[0].flags |= MOTIONSENSE_SENSOR_FLAG_TABLET_MODE;
+		out[0].sensor_num = s;
+		out[0].reserved = 0;
+		out[0].timestamp = ring.head.ts[s] +
+				   ((delta >> 1) ^ -(delta & 1));
+		return 1;
+	}
+
+	if ((tag & REC_TYPE_MASK) == REC_SAMPLE_DELTA)
+		ring.head.period[s] = delta;
+	ring.head.ts[s] += ring.head.period[s];
+
+	out[0].flags = MOTIONSENSE_SENSOR_FLAG_TIMESTAMP;
+	out[0].sensor_num = s;
+	out[0].reserved = 0;
+	out[0].timestamp = ring.head.ts[s];
+
+	out[1].flags = 0;
+	out[1].sensor_num = s;
+	ring_get_bytes(out[1].data, sizeof(out[1].data));
+
+	if (tag & REC_TABLET) {
+		out[0].flags |= MOTIONSENSE_SENSOR_FLAG_TABLET_MODE;
+		out[1].flags |= MOTIONSENSE_SENSOR_FLAG_TABLET_MODE;
+	}
+	if (tag & REC_WAKEUP)
+		out[1].flags |= MOTIONSENSE_SENSOR_FLAG_WAKEUP;
+
+	return 2;
+}
+
+/**
+ * Drop the oldest record of the ring to make room, accounting for the lost
+ * entries the same way fifo_pop() does.
+ */
+static void ring_drop_oldest(void)
+{
+	struct ec_response_motion_sensor_data entries[2];
+	int i, n;
+
+	n = ring_pop(entries);
+	ring.entries -= n;
+	for (i = 0; i < n; i++) {
+		if (entries[i].flags & MOTIONSENSE_SENSOR_FLAG_WAKEUP)
+			wake_up_needed = 1;
+		fifo_lost++;
+		if (!is_timestamp(&entries[i]))
+			motion_sensors[entries[i].sensor_num].lost++;
+	}
+}
+
+/**
+ * Check whether a timestamp and the data that follows can be stored as a
+ * single sample record.
+ */
+static bool is_compact_sample(const struct ec_response_motion_sensor_data *ts,
+			      const struct ec_response_motion_sensor_data *data)
+{
+	return is_timestamp(ts) && is_data(data) &&
+	       ts->sensor_num == data->sensor_num &&
+	       data->sensor_num <= REC_SENSOR_MASK &&
+	       data->sensor_num < MAX_MOTION_SENSORS &&
+	       !(data->flags & ~(MOTIONSENSE_SENSOR_FLAG_TABLET_MODE |
+				 MOTIONSENSE_SENSOR_FLAG_WAKEUP)) &&
+	       ts->flags == (MOTIONSENSE_SENSOR_FLAG_TIMESTAMP |
+			     (data->flags &
+			      MOTIONSENSE_SENSOR_FLAG_TABLET_MODE));
+}
+
+/**
+ * Check whether a timestamp without data can be stored as a timestamp record.
+ */
+static bool is_compact_timestamp(
+	const struct ec_response_motion_sensor_data *ts)
+{
+	return is_timestamp(ts) &&
+	       ts->sensor_num <= REC_SENSOR_MASK &&
+	       ts->sensor_num < MAX_MOTION_SENSORS &&
+	       !(ts->flags & ~(MOTIONSENSE_SENSOR_FLAG_TIMESTAMP |
+			       MOTIONSENSE_SENSOR_FLAG_TABLET_MODE));
+}
+
+static void ring_put_varint(uint32_t v)
+{
+	do {
+		ring_put((v & 0x7f) | (v > 0x7f ? 0x80 : 0));
+		v >>= 7;
+	} while (v);
+}
+
+/**
+ * Append entries to the ring, dropping the oldest records if needed.
+ *
+ * @param entry The entry to append.
+ * @param data If not NULL, the data entry following the timestamp in entry.
+ */
+static void ring_push(const struct ec_response_motion_sensor_data *entry,
+		      const struct ec_response_motion_sensor_data *data)
+{
+	int s;
+	uint32_t delta;
+	uint8_t tag;
+
+	while (RING_BYTES - ring.used < REC_MAX_BYTES)
+		ring_drop_oldest();
+
+	if (!data && is_compact_timestamp(entry)) {
+		int32_t diff;
+
+		s = entry->sensor_num;
+		diff = entry->timestamp - ring.tail.ts[s];
+		tag = REC_TIMESTAMP | s;
+		if (entry->flags & MOTIONSENSE_SENSOR_FLAG_TABLET_MODE)
+			tag |= REC_TABLET;
+		ring_put(tag);
+		/* Zigzag, small negative differences stay short */
+		ring_put_varint(((uint32_t)diff << 1) ^
+				(uint32_t)(diff >> 31));
+		ring.entries++;
+		return;
+	}
+
+	if (!data) {
+		ring_put(REC_RAW);
+		ring_put_bytes(entry, sizeof(*entry));
+		ring.entries++;
+		return;
+	}
+
+	s = data->sensor_num;
+	delta = entry->timestamp - ring.tail.ts[s];
+	tag = s;
+	if (data->flags & MOTIONSENSE_SENSOR_FLAG_TABLET_MODE)
+		tag |= REC_TABLET;
+	if (data->flags & MOTIONSENSE_SENSOR_FLAG_WAKEUP)
+		tag |= REC_WAKEUP;
+
+	if (delta == ring.tail.period[s]) {
+		ring_put(tag | REC_SAMPLE);
+	} else {
+		ring_put(tag | REC_SAMPLE_DELTA);
+		ring.tail.period[s] = delta;
+		ring_put_varint(delta);
+	}
+	ring.tail.ts[s] = entry->timestamp;
+	ring_put_bytes(data->data, sizeof(data->data));
+	ring.entries += 2;
+}
+
+/**
+ * Move all the staged entries to the ring.
+ *
+ * WARNING: This function MUST be called from within a locked context of
+ * g_sensor_mutex.
+ */
+static void ring_commit_staged(void)
+{
+	struct ec_response_motion_sensor_data *entry, *data;
+	int i;
+
+	for (i = 0; i < fifo_staged.count; i++) {
+		entry = peek_fifo_staged(i);
+		data = i + 1 < fifo_staged.count ? peek_fifo_staged(i + 1) :
+						   NULL;
+		if (data && is_compact_sample(entry, data)) {
+			ring_push(entry, data);
+			i++;
+		} else {
+			ring_push(entry, NULL);
+		}
+	}
+	queue_advance_tail(&fifo, fifo_staged.count);
+	queue_advance_head(&fifo, fifo_staged.count);
+}
+
+/**
+ * Read committed entries from the ring.
+ *
+ * WARNING: This function MUST be called from within a locked context of
+ * g_sensor_mutex.
+ */
+static int ring_read(int max_count, struct ec_response_motion_sensor_data *out)
+{
+	struct ec_response_motion_sensor_data entries[2];
+	int count = 0;
+
+	while (count < max_count) {
+		if (ring.has_pending) {
+			out[count++] = ring.pending;
+			ring.has_pending = false;
+		} else if (ring.used) {
+			if (ring_pop(entries) == 2) {
+				ring.pending = entries[1];
+				ring.has_pending = true;
+			}
+			out[count++] = entries[0];
+		} else {
+			break;
+		}
+		ring.entries--;
+	}
+
+	return count;
+}
+#endif /* CONFIG_ACCEL_FIFO_COMPACT */
+
 void motion_sense_fifo_init(void)
 {
 	if (IS_ENABLED(CONFIG_ONLINE_CALIB))
@@ -410,18 +839,70 @@ void motion_sense_fifo_stage_data(
 	fifo_stage_unit(data, sensor, valid_data);
 }
 
-void motion_sense_fifo_commit_data(void)
+void motion_sense_fifo_stage_batch(
+	struct ec_response_motion_sensor_data *data,
+	int count,
+	int valid_data,
+	uint32_t time)
+{
+	struct ec_response_motion_sensor_data timestamp;
+	uint32_t removed;
+	int base, n, i;
+
+	timestamp.flags = MOTIONSENSE_SENSOR_FLAG_TIMESTAMP;
+	timestamp.timestamp = time;
+
+	/*
+	 * Samples removed by oversampling are tracked in a bitmap so they can
+	 * be fed to the online calibration once the lock is dropped; take the
+	 * lock once per bitmap worth of samples.
+	 */
+	for (base = 0; base < count; base += n) {
+		n = MIN(count - base, 32);
+		removed = 0;
+
+		mutex_lock(&g_sensor_mutex);
+		/* First entry, save the time for spreading later. */
+		if (IS_ENABLED(CONFIG_SENSOR_TIGHT_TIMESTAMPS) &&
+		    !fifo_staged.count)
+			fifo_staged.read_ts = __hw_clock_source_read();
+
+		for (i = 0; i < n; i++) {
+			struct ec_response_motion_sensor_data *d =
+				&data[base + i];
+
+			if (IS_ENABLED(CONFIG_SENSOR_TIGHT_TIMESTAMPS)) {
+				timestamp.sensor_num = d->sensor_num;
+				fifo_stage_unit_locked(&timestamp, NULL, 0);
+			}
+			if (fifo_stage_unit_locked(
+				    d, &motion_sensors[d->sensor_num],
+				    valid_data))
+				removed |= BIT(i);
+		}
+		mutex_unlock(&g_sensor_mutex);
+
+		for (i = 0; removed; i++, removed >>= 1)
+			if (removed & 1)
+				fifo_calibrate_unit(
+					&data[base + i],
+					&motion_sensors[data[base + i].sensor_num]);
+	}
+}
+
+/**
+ * Commit all the currently staged data, see motion_sense_fifo_commit_data().
+ *
+ * WARNING: This function MUST be called from within a locked context of
+ * g_sensor_mutex.
+ */
+static void fifo_commit_locked(void)
 {
 	/* Cached data periods, static to store off stack. */
 	static uint32_t data_periods[MAX_MOTION_SENSORS];
 	struct ec_response_motion_sensor_data *data;
 	int i, window, sensor_num;
 
-	/* Nothing staged, no work to do. */
-	if (!fifo_staged.count)
-		return;
-
-	mutex_lock(&g_sensor_mutex);
 	/*
 	 * If per-sensor event counts are never more than 1, no spreading is
 	 * needed. This will also catch cases where tight timestamps aren't
@@ -528,11 +1009,24 @@ commit_data_end:
 	}
 
 	/* Advance the tail and clear the staged metadata. */
+#ifdef CONFIG_ACCEL_FIFO_COMPACT
+	ring_commit_staged();
+#else
 	queue_advance_tail(&fifo, fifo_staged.count);
+#endif
 
 	/* Reset metadata for next staging cycle. */
 	memset(&fifo_staged, 0, sizeof(fifo_staged));
+}
+
+void motion_sense_fifo_commit_data(void)
+{
+	/* Nothing staged, no work to do. */
+	if (!fifo_staged.count)
+		return;
 
+	mutex_lock(&g_sensor_mutex);
+	fifo_commit_locked();
 	mutex_unlock(&g_sensor_mutex);
 }
 
@@ -541,8 +1035,13 @@ void motion_sense_fifo_get_info(
 	int reset)
 {
 	mutex_lock(&g_sensor_mutex);
+#ifdef CONFIG_ACCEL_FIFO_COMPACT
+	fifo_info->size = RING_ENTRIES;
+	fifo_info->count = ring.entries;
+#else
 	fifo_info->size = fifo.buffer_units;
 	fifo_info->count = queue_count(&fifo);
+#endif
 	fifo_info->total_lost = fifo_lost;
 	mutex_unlock(&g_sensor_mutex);
 #ifdef CONFIG_MKBP_EVENT
@@ -569,7 +1068,13 @@ inline int motion_sense_fifo_over_thres(void)
 	int result;
 
 	mutex_lock(&g_sensor_mutex);
+#ifdef CONFIG_ACCEL_FIFO_COMPACT
+	/* Entries that still fit for sure, in the largest sample records */
+	result = (RING_BYTES - ring.used) / REC_MAX_BYTES * 2 <
+		 CONFIG_ACCEL_FIFO_THRES;
+#else
 	result = queue_space(&fifo) < CONFIG_ACCEL_FIFO_THRES;
+#endif
 	mutex_unlock(&g_sensor_mutex);
 
 	return result;
@@ -581,9 +1086,14 @@ int motion_sense_fifo_read(int capacity_bytes, int max_count, void *out,
 	int count;
 
 	mutex_lock(&g_sensor_mutex);
+#ifdef CONFIG_ACCEL_FIFO_COMPACT
+	count = ring_read(MIN(capacity_bytes / (int)fifo.unit_bytes,
+			      max_count), out);
+#else
 	count = MIN(capacity_bytes / fifo.unit_bytes,
 		    MIN(queue_count(&fifo), max_count));
 	count = queue_remove_units(&fifo, out, count);
+#endif
 	mutex_unlock(&g_sensor_mutex);
 	*out_size = count * fifo.unit_bytes;
 
@@ -594,6 +1104,9 @@ void motion_sense_fifo_reset(void)
 {
 	next_timestamp_initialized = 0;
 	memset(&fifo_staged, 0, sizeof(fifo_staged));
+#ifdef CONFIG_ACCEL_FIFO_COMPACT
+	memset(&ring, 0, sizeof(ring));
+#endif
 	motion_sense_fifo_init();
 	queue_init(&fifo);
 }
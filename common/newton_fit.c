@@ -4,75 +4,165 @@
  */
 
 #include "common.h"
-#include "console.h"
 #include "newton_fit.h"
 #include "math.h"
 #include "math_util.h"
 #include <string.h>
 
-#define CPRINTS(fmt, args...) cprints(CC_MOTION_SENSE, fmt, ##args)
+#define NO_SLOT 0
 
-static fp_t distance_squared(fpv3_t a, fpv3_t b)
+static struct newton_fit_orientation *slot_entry(struct newton_fit *fit,
+						 size_t slot)
 {
-	fpv3_t delta;
+	return (struct newton_fit_orientation *)(fit->orientations->buffer +
+						 slot *
+						 fit->orientations->unit_bytes);
+}
 
-	fpv3_init(delta, a[X] - b[X], a[Y] - b[Y], a[Z] - b[Z]);
-	return fpv3_dot(delta, delta);
+static size_t head_slot(struct newton_fit *fit)
+{
+	return fit->orientations->state->head &
+	       fit->orientations->buffer_units_mask;
 }
 
-static fp_t compute_error(struct newton_fit *fit, fpv3_t center)
+/*
+ * Quantize one coordinate to its index cell, and report whether it lies in
+ * the upper half of the cell (in which case a near orientation can only be
+ * in this cell or the next one up).
+ */
+static int cell_coord(struct newton_fit *fit, fp_t v, bool *upper)
 {
-	fp_t error = FLOAT_TO_FP(0.0f);
-	struct queue_iterator it;
-	struct newton_fit_orientation *_it;
+	fp_t q = fp_mul(v, fit->inv_cell_size);
+	int i = FP_TO_INT(q);
+
+	/* Round towards -inf */
+	if (q < INT_TO_FP(i))
+		i--;
+	*upper = q - INT_TO_FP(i) >= FLOAT_TO_FP(0.5f);
+	return i;
+}
 
-	for (queue_begin(fit->orientations, &it); it.ptr != NULL;
-	     queue_next(fit->orientations, &it)) {
-		fp_t e;
+static uint16_t cell_bucket(struct newton_fit *fit, int x, int y, int z)
+{
+	uint32_t h = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^
+		     (uint32_t)z * 83492791u;
 
-		_it = (struct newton_fit_orientation *)it.ptr;
-		e = FLOAT_TO_FP(1.0f) -
-			distance_squared(_it->orientation, center);
-		error += fp_mul(e, e);
+	return (h ^ (h >> 16)) & fit->orientations->buffer_units_mask;
+}
+
+static uint16_t orientation_bucket(struct newton_fit *fit, const fpv3_t v)
+{
+	bool upper;
+	int x = cell_coord(fit, v[X], &upper);
+	int y = cell_coord(fit, v[Y], &upper);
+	int z = cell_coord(fit, v[Z], &upper);
+
+	return cell_bucket(fit, x, y, z);
+}
+
+static void index_insert(struct newton_fit *fit, size_t slot)
+{
+	uint16_t b = orientation_bucket(fit, slot_entry(fit, slot)->orientation);
+
+	fit->slot_bucket[slot] = b;
+	fit->slot_next[slot] = fit->bucket_head[b];
+	fit->bucket_head[b] = slot + 1;
+}
+
+static void index_remove(struct newton_fit *fit, size_t slot)
+{
+	uint16_t *link = &fit->bucket_head[fit->slot_bucket[slot]];
+
+	while (*link != NO_SLOT) {
+		if (*link == slot + 1) {
+			*link = fit->slot_next[slot];
+			return;
+		}
+		link = &fit->slot_next[*link - 1];
 	}
+}
 
-	return error;
+/*
+ * Find the oldest orientation closer than nearness_threshold to v, which is
+ * the one a linear scan of the queue would find first.
+ */
+static struct newton_fit_orientation *find_near(struct newton_fit *fit,
+						const fpv3_t v, size_t *slot)
+{
+	const size_t mask = fit->orientations->buffer_units_mask;
+	const size_t head = head_slot(fit);
+	struct newton_fit_orientation *best = NULL;
+	size_t best_age = 0;
+	uint16_t visited[8];
+	int cell[3], step[3];
+	bool upper;
+	int i, j, k;
+
+	for (k = X; k <= Z; k++) {
+		cell[k] = cell_coord(fit, v[k], &upper);
+		step[k] = upper ? 1 : -1;
+	}
+
+	for (i = 0; i < 8; i++) {
+		uint16_t b = cell_bucket(fit, cell[X] + ((i & 1) ? step[X] : 0),
+					 cell[Y] + ((i & 2) ? step[Y] : 0),
+					 cell[Z] + ((i & 4) ? step[Z] : 0));
+		uint16_t s;
+
+		/* Neighbouring cells may share a bucket */
+		for (j = 0; j < i; j++)
+			if (visited[j] == b)
+				break;
+		visited[i] = b;
+		if (j < i)
+			continue;
+
+		for (s = fit->bucket_head[b]; s != NO_SLOT;
+		     s = fit->slot_next[s - 1]) {
+			struct newton_fit_orientation *e = slot_entry(fit, s - 1);
+			size_t age = (s - 1 - head) & mask;
+			fpv3_t delta;
+
+			if (best && age >= best_age)
+				continue;
+			fpv3_sub(delta, v, e->orientation);
+			if (fpv3_dot(delta, delta) >= fit->nearness_threshold)
+				continue;
+			best = e;
+			best_age = age;
+			*slot = s - 1;
+		}
+	}
+
+	return best;
 }
 
 static bool is_ready_to_compute(struct newton_fit *fit, bool prune)
 {
-	bool has_min_samples = true;
-	struct queue_iterator it;
-	struct newton_fit_orientation *_it;
+	size_t count = queue_count(fit->orientations);
 
 	/* Not full, not ready to compute. */
 	if (!queue_is_full(fit->orientations))
 		return false;
 
-	/* Inspect all the orientations. */
-	for (queue_begin(fit->orientations, &it); it.ptr != NULL;
-	     queue_next(fit->orientations, &it)) {
-		_it = (struct newton_fit_orientation *)it.ptr;
-		/* If an orientation has too few samples, flag that. */
-		CPRINTS("    orientation %u/%u", _it->nsamples,
-			fit->min_orientation_samples);
-		if (_it->nsamples < fit->min_orientation_samples) {
-			has_min_samples = false;
-			break;
-		}
-	}
-
 	/* If all orientations have the minimum samples, we're done and can
 	 * compute the bias.
 	 */
-	if (has_min_samples)
+	if (fit->ready_count == count)
 		return true;
 
 	/* If we got here and prune is true, then we need to remove the oldest
 	 * entry to make room for new orientations.
 	 */
-	if (prune)
+	if (prune) {
+		size_t slot = head_slot(fit);
+
+		if (slot_entry(fit, slot)->nsamples >=
+		    fit->min_orientation_samples)
+			fit->ready_count--;
+		index_remove(fit, slot);
 		queue_advance_head(fit->orientations, 1);
+	}
 
 	return false;
 }
@@ -80,35 +170,41 @@ static bool is_ready_to_compute(struct newton_fit *fit, bool prune)
 void newton_fit_reset(struct newton_fit *fit)
 {
 	queue_init(fit->orientations);
+	memset(fit->bucket_head, 0,
+	       fit->orientations->buffer_units * sizeof(*fit->bucket_head));
+	fit->ready_count = 0;
 }
 
 bool newton_fit_accumulate(struct newton_fit *fit, fp_t x, fp_t y, fp_t z)
 {
-	struct queue_iterator it;
 	struct newton_fit_orientation *_it;
-	fpv3_t v, delta;
+	fpv3_t v;
+	size_t slot;
+
+	if (!fit->inv_cell_size)
+		fit->inv_cell_size = fp_div(
+			FLOAT_TO_FP(0.5f), fp_sqrtf(fit->nearness_threshold));
 
 	fpv3_init(v, x, y, z);
 
 	/* Check if we can merge this new data point with an existing
 	 * orientation.
 	 */
-	for (queue_begin(fit->orientations, &it); it.ptr != NULL;
-	     queue_next(fit->orientations, &it)) {
-		_it = (struct newton_fit_orientation *)it.ptr;
-
-		fpv3_sub(delta, v, _it->orientation);
-		/* Skip entries that are too far away. */
-		if (fpv3_dot(delta, delta) >= fit->nearness_threshold)
-			continue;
-
+	_it = find_near(fit, v, &slot);
+	if (_it) {
 		/* Merge new data point with this orientation. */
 		fpv3_scalar_mul(_it->orientation,
 				FLOAT_TO_FP(1.0f) - fit->new_pt_weight);
 		fpv3_scalar_mul(v, fit->new_pt_weight);
 		fpv3_add(_it->orientation, _it->orientation, v);
-		if (_it->nsamples < 0xff)
+		if (_it->nsamples < 0xff) {
 			_it->nsamples++;
+			if (_it->nsamples == fit->min_orientation_samples)
+				fit->ready_count++;
+		}
+		/* The orientation moved, it may now be in another cell. */
+		index_remove(fit, slot);
+		index_insert(fit, slot);
 		return is_ready_to_compute(fit, false);
 	}
 
@@ -116,9 +212,14 @@ bool newton_fit_accumulate(struct newton_fit *fit, fp_t x, fp_t y, fp_t z)
 	if (!queue_is_full(fit->orientations)) {
 		struct newton_fit_orientation entry;
 
+		slot = fit->orientations->state->tail &
+		       fit->orientations->buffer_units_mask;
 		entry.nsamples = 1;
 		fpv3_init(entry.orientation, x, y, z);
 		queue_add_unit(fit->orientations, &entry);
+		index_insert(fit, slot);
+		if (entry.nsamples >= fit->min_orientation_samples)
+			fit->ready_count++;
 
 		return is_ready_to_compute(fit, false);
 	}
@@ -126,12 +227,47 @@ bool newton_fit_accumulate(struct newton_fit *fit, fp_t x, fp_t y, fp_t z)
 	return is_ready_to_compute(fit, true);
 }
 
+/*
+ * Single pass over the orientations for a given bias: returns the fit error
+ * and computes the (unscaled) Newton offset and the sum of the distances to
+ * the bias, so each iteration only needs to walk the orientations once.
+ */
+static fp_t newton_pass(struct newton_fit *fit, const fpv3_t bias,
+			fpv3_t offset, fp_t *mag_sum)
+{
+	const size_t count = queue_count(fit->orientations);
+	const size_t mask = fit->orientations->buffer_units_mask;
+	const size_t head = head_slot(fit);
+	fp_t error = FLOAT_TO_FP(0.0f);
+	size_t i;
+
+	fpv3_zero(offset);
+	*mag_sum = FLOAT_TO_FP(0.0f);
+
+	for (i = 0; i < count; i++) {
+		struct newton_fit_orientation *_it =
+			slot_entry(fit, (head + i) & mask);
+		fpv3_t delta;
+		fp_t dist2, mag, e;
+
+		fpv3_sub(delta, _it->orientation, bias);
+		dist2 = fpv3_dot(delta, delta);
+		e = FLOAT_TO_FP(1.0f) - dist2;
+		error += fp_mul(e, e);
+
+		mag = fp_sqrtf(dist2);
+		*mag_sum += mag;
+		fpv3_scalar_mul(delta, fp_div(mag - FLOAT_TO_FP(1.0f), mag));
+		fpv3_add(offset, offset, delta);
+	}
+
+	return error;
+}
+
 void newton_fit_compute(struct newton_fit *fit, fpv3_t bias, fp_t *radius)
 {
-	struct queue_iterator it;
-	struct newton_fit_orientation *_it;
-	fpv3_t new_bias, offset, delta;
-	fp_t error, new_error;
+	fpv3_t new_bias, offset, new_offset;
+	fp_t error, new_error, mag_sum, new_mag_sum;
 	uint32_t iteration = 0;
 	fp_t inv_orient_count;
 
@@ -142,45 +278,28 @@ void newton_fit_compute(struct newton_fit *fit, fpv3_t bias, fp_t *radius)
 				  queue_count(fit->orientations));
 
 	memcpy(new_bias, bias, sizeof(fpv3_t));
-	new_error = compute_error(fit, new_bias);
+	new_error = newton_pass(fit, new_bias, new_offset, &new_mag_sum);
 
 	do {
 		memcpy(bias, new_bias, sizeof(fpv3_t));
+		memcpy(offset, new_offset, sizeof(fpv3_t));
 		error = new_error;
-		fpv3_zero(offset);
-
-		for (queue_begin(fit->orientations, &it); it.ptr != NULL;
-		     queue_next(fit->orientations, &it)) {
-			fp_t mag;
-
-			_it = (struct newton_fit_orientation *)it.ptr;
-
-			fpv3_sub(delta, _it->orientation, bias);
-			mag = fpv3_norm(delta);
-			fpv3_scalar_mul(delta,
-					fp_div(mag - FLOAT_TO_FP(1.0f), mag));
-			fpv3_add(offset, offset, delta);
-		}
+		mag_sum = new_mag_sum;
 
 		fpv3_scalar_mul(offset, inv_orient_count);
 		fpv3_add(new_bias, bias, offset);
-		new_error = compute_error(fit, new_bias);
-		if (new_error > error)
+		new_error = newton_pass(fit, new_bias, new_offset,
+					&new_mag_sum);
+		if (new_error > error) {
 			memcpy(new_bias, bias, sizeof(fpv3_t));
+			new_mag_sum = mag_sum;
+		}
 		++iteration;
 	} while (iteration < fit->max_iterations && new_error < error &&
 		 new_error > fit->error_threshold);
 
 	memcpy(bias, new_bias, sizeof(fpv3_t));
 
-	if (radius) {
-		*radius = FLOAT_TO_FP(0.0f);
-		for (queue_begin(fit->orientations, &it); it.ptr != NULL;
-		     queue_next(fit->orientations, &it)) {
-			_it = (struct newton_fit_orientation *)it.ptr;
-			fpv3_sub(delta, _it->orientation, bias);
-			*radius += fpv3_norm(delta);
-		}
-		*radius *= inv_orient_count;
-	}
+	if (radius)
+		*radius = fp_mul(new_mag_sum, inv_orient_count);
 }
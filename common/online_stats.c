@@ -0,0 +1,86 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Single pass mean and variance of sensor samples. */
+
+#include "online_stats.h"
+#include "util.h"
+
+void online_stats_reset(struct online_stats *s)
+{
+	memset(s, 0, sizeof(*s));
+}
+
+void online_stats_update(struct online_stats *s, fp_t x, fp_t y, fp_t z)
+{
+	fp_t delta;
+
+	if (s->n++ == 0) {
+		s->shift[X] = x;
+		s->shift[Y] = y;
+		s->shift[Z] = z;
+	}
+
+	delta = x - s->shift[X];
+	s->sum[X] += delta;
+	s->sum_sq[X] += fp_sq(delta);
+
+	delta = y - s->shift[Y];
+	s->sum[Y] += delta;
+	s->sum_sq[Y] += fp_sq(delta);
+
+	delta = z - s->shift[Z];
+	s->sum[Z] += delta;
+	s->sum_sq[Z] += fp_sq(delta);
+}
+
+bool online_stats_compute(const struct online_stats *s, fpv3_t mean,
+			  fpv3_t var, bool unbiased)
+{
+	fp_t inv_n, inv_var, delta_mean;
+	int i;
+
+	if (s->n < (unbiased ? 2 : 1))
+		return false;
+
+	inv_n = fp_div(INT_TO_FP(1), INT_TO_FP(s->n));
+	inv_var = unbiased ? fp_div(INT_TO_FP(1), INT_TO_FP(s->n - 1)) : inv_n;
+
+	for (i = X; i <= Z; i++) {
+		/* var = (sum_sq - sum^2 / n) / (n or n - 1) */
+		delta_mean = fp_mul(s->sum[i], inv_n);
+		var[i] = fp_mul(s->sum_sq[i] - fp_mul(delta_mean, s->sum[i]),
+				inv_var);
+		if (mean)
+			mean[i] = delta_mean + s->shift[i];
+	}
+
+	return true;
+}
+
+void online_stats_window_init(struct online_stats_window *w, int32_t *history,
+			      int size)
+{
+	memset(w, 0, sizeof(*w));
+	w->history = history;
+	w->size = size;
+}
+
+void online_stats_window_update(struct online_stats_window *w, int32_t x)
+{
+	if (w->n < w->size) {
+		w->n++;
+	} else {
+		const int32_t x_0 = w->history[w->idx];
+
+		w->sum -= x_0;
+		w->sum_sq -= (int64_t)x_0 * x_0;
+	}
+
+	w->history[w->idx] = x;
+	w->sum += x;
+	w->sum_sq += (int64_t)x * x;
+	w->idx = (w->idx + 1 >= w->size) ? 0 : w->idx + 1;
+}
@@ -69,42 +69,6 @@ static void mont_mul_add(const struct rsa_public_key *key,
 		sub_mod(key, c);
 }
 
-#ifdef CONFIG_RSA_EXPONENT_3
-/**
- * Montgomery c[] += 0 * b[] / R % mod
- */
-static void mont_mul_add_0(const struct rsa_public_key *key,
-			 uint32_t *c,
-			 const uint32_t *b)
-{
-	uint32_t d0 = c[0] * key->n0inv;
-	uint64_t B = mula32(d0, key->n[0], c[0]);
-	uint32_t i;
-
-	for (i = 1; i < RSANUMWORDS; ++i) {
-		B = mulaa32(d0, key->n[i], c[i], B >> 32);
-		c[i - 1] = (uint32_t)B;
-	}
-
-	c[i - 1] = B >> 32;
-}
-
-/* Montgomery c[] = a[] * 1 / R % key. */
-static void mont_mul_1(const struct rsa_public_key *key,
-		       uint32_t *c,
-		       const uint32_t *a)
-{
-	int i;
-
-	for (i = 0; i < RSANUMWORDS; ++i)
-		c[i] = 0;
-
-	mont_mul_add(key, c, 1, a);
-	for (i = 1; i < RSANUMWORDS; ++i)
-		mont_mul_add_0(key, c, a);
-}
-#endif
-
 /**
  * Montgomery c[] = a[] * b[] / R % mod
  */
@@ -136,7 +100,11 @@ static void mod_pow(const struct rsa_public_key *key, uint8_t *inout,
 	uint32_t *a = workbuf32;
 	uint32_t *a_r = a + RSANUMWORDS;
 	uint32_t *aa_r = a_r + RSANUMWORDS;
+#ifdef CONFIG_RSA_EXPONENT_3
+	uint32_t *aaa = a_r;  /* Re-use location. */
+#else
 	uint32_t *aaa = aa_r;  /* Re-use location. */
+#endif
 	int i;
 
 	/* Convert from big endian byte array to little endian word array. */
@@ -149,12 +117,15 @@ static void mod_pow(const struct rsa_public_key *key, uint8_t *inout,
 		a[i] = tmp;
 	}
 
-	/* TODO(drinkcat): This operation could be precomputed to save time. */
+	/*
+	 * The key only holds what can be precomputed (n0inv, RR): converting
+	 * the signature to the Montgomery domain depends on the signature.
+	 * Multiplying by plain a in the last step converts back for free.
+	 */
 	mont_mul(key, a_r, a, key->rr);  /* a_r = a * RR / R mod M */
 #ifdef CONFIG_RSA_EXPONENT_3
-	mont_mul(key, aa_r, a_r, a_r);
-	mont_mul(key, a, aa_r, a_r);
-	mont_mul_1(key, aaa, a);
+	mont_mul(key, aa_r, a_r, a_r);	/* aa_r = a_r * a_r / R mod M */
+	mont_mul(key, aaa, aa_r, a);	/* aaa = aa_r * a / R mod M */
 #else
 	/* Exponent 65537 */
 	for (i = 0; i < 16; i += 2) {
@@ -4,10 +4,20 @@
  * found in the LICENSE file.
  */
 
-/* Malloc/free memory module for Chrome EC */
+/*
+ * Malloc/free memory module for Chrome EC
+ *
+ * Two level segregated fit allocator (TLSF, Masmano et al.). Free buffers are
+ * kept in lists by size class: the first level splits sizes by powers of two,
+ * the second level splits each power of two in SHM_SL_COUNT ranges. Bitmaps
+ * of the non-empty lists make finding a free buffer and merging a released
+ * buffer with its free neighbours take constant time, instead of walking all
+ * free buffers.
+ */
 #include <stdint.h>
 
 #include "common.h"
+#include "console.h"
 #include "hooks.h"
 #include "link_defs.h"
 #include "shared_mem.h"
@@ -24,18 +34,133 @@ static struct mutex shmem_lock;
 #define TEST_GLOBAL
 #endif
 
+/* Buffer sizes are multiples of this, so bit 0 can flag free buffers. */
+#define SHM_ALIGN sizeof(void *)
+#define SHM_FREE BIT(0)
+
+/* Header of allocated buffers, free buffers also hold the list links. */
+#define SHM_HDR_SIZE offsetof(struct shm_buffer, next_free)
+#define SHM_MIN_SIZE sizeof(struct shm_buffer)
+
 /*
- * At the beginning there is a single free memory chunk which includes all
- * memory available in the system. It then gets fragmented/defragmented based
- * on actual allocations/releases.
+ * Sizes below BIT(SHM_FL_MIN_LOG2) share first level 0, in SHM_SL_COUNT
+ * linear ranges.
  */
-TEST_GLOBAL struct shm_buffer *free_buf_chain;
+#define SHM_FL_MIN_LOG2 6
+BUILD_ASSERT(BIT(SHM_FL_MIN_LOG2) / SHM_SL_COUNT >= 2 * sizeof(void *));
+
+/* All the memory is a sequence of buffers, from shm_first to shm_end. */
+TEST_GLOBAL struct shm_buffer *shm_first;
+TEST_GLOBAL uintptr_t shm_end;
+
+/* Free buffer lists, and bitmaps of the non-empty ones. */
+TEST_GLOBAL struct shm_buffer *shm_free_lists[SHM_FL_COUNT][SHM_SL_COUNT];
+TEST_GLOBAL uint32_t shm_fl_bitmap;
+TEST_GLOBAL uint32_t shm_sl_bitmap[SHM_FL_COUNT];
+
+static struct {
+	/* Bytes in allocated buffers, headers included. */
+	size_t allocated;
+	size_t high_water;
+	/* The size of the biggest ever allocated buffer. */
+	int max_allocated_size;
+	/* Requests which could not be served. */
+	uint32_t failures;
+} stats;
+
+static inline size_t buf_size(const struct shm_buffer *buf)
+{
+	return buf->buffer_size & ~SHM_FREE;
+}
+
+static inline int buf_is_free(const struct shm_buffer *buf)
+{
+	return buf->buffer_size & SHM_FREE;
+}
+
+/* The buffer right above, NULL for the last one. */
+static inline struct shm_buffer *buf_next(const struct shm_buffer *buf)
+{
+	uintptr_t next = (uintptr_t)buf + buf_size(buf);
 
-/* At the beginning there is no allocated buffers */
-TEST_GLOBAL struct shm_buffer *allocced_buf_chain;
+	return next < shm_end ? (struct shm_buffer *)next : NULL;
+}
+
+/* Size class of a buffer of the given size. */
+static void mapping(size_t size, int *fl, int *sl)
+{
+	int log2;
 
-/* The size of the biggest ever allocated buffer. */
-static int max_allocated_size;
+	if (size < BIT(SHM_FL_MIN_LOG2)) {
+		*fl = 0;
+		*sl = size >> (SHM_FL_MIN_LOG2 - SHM_SL_LOG2);
+		return;
+	}
+
+	log2 = __fls(size);
+	*fl = log2 - SHM_FL_MIN_LOG2 + 1;
+	*sl = (size >> (log2 - SHM_SL_LOG2)) & (SHM_SL_COUNT - 1);
+	if (*fl >= SHM_FL_COUNT) {
+		/* The last class takes everything bigger. */
+		*fl = SHM_FL_COUNT - 1;
+		*sl = SHM_SL_COUNT - 1;
+	}
+}
+
+/*
+ * Lowest size class whose buffers are all at least size bytes: searching
+ * from there, the first free buffer found fits.
+ */
+static void mapping_search(size_t size, int *fl, int *sl)
+{
+	if (size < BIT(SHM_FL_MIN_LOG2))
+		size += BIT(SHM_FL_MIN_LOG2 - SHM_SL_LOG2) - 1;
+	else
+		size += BIT(__fls(size) - SHM_SL_LOG2) - 1;
+	mapping(size, fl, sl);
+}
+
+static void insert_free(struct shm_buffer *buf)
+{
+	int fl, sl;
+
+	mapping(buf_size(buf), &fl, &sl);
+	buf->buffer_size |= SHM_FREE;
+	buf->prev_free = NULL;
+	buf->next_free = shm_free_lists[fl][sl];
+	if (buf->next_free)
+		buf->next_free->prev_free = buf;
+	shm_free_lists[fl][sl] = buf;
+	shm_fl_bitmap |= BIT(fl);
+	shm_sl_bitmap[fl] |= BIT(sl);
+}
+
+static void remove_free(struct shm_buffer *buf)
+{
+	int fl, sl;
+
+	mapping(buf_size(buf), &fl, &sl);
+	buf->buffer_size &= ~SHM_FREE;
+	if (buf->next_free)
+		buf->next_free->prev_free = buf->prev_free;
+	if (buf->prev_free) {
+		set_map_bit(BIT(0));
+		buf->prev_free->next_free = buf->next_free;
+		return;
+	}
+
+	shm_free_lists[fl][sl] = buf->next_free;
+	if (buf->next_free) {
+		set_map_bit(BIT(1));
+		return;
+	}
+
+	/* The list is empty now. */
+	set_map_bit(BIT(2));
+	shm_sl_bitmap[fl] &= ~BIT(sl);
+	if (!shm_sl_bitmap[fl])
+		shm_fl_bitmap &= ~BIT(fl);
+}
 
 static void shared_mem_init(void)
 {
@@ -44,267 +169,156 @@ static void shared_mem_init(void)
 	 * allocated from the start of RAM, so we can use everything up to the
 	 * jump data at the end of RAM.
 	 */
-	free_buf_chain = (struct shm_buffer *)__shared_mem_buf;
-	free_buf_chain->next_buffer = NULL;
-	free_buf_chain->prev_buffer = NULL;
-	free_buf_chain->buffer_size = system_usable_ram_end() -
-		(uintptr_t)__shared_mem_buf;
+	shm_first = (struct shm_buffer *)__shared_mem_buf;
+	shm_end = ((uintptr_t)system_usable_ram_end()) & ~(SHM_ALIGN - 1);
+	shm_first->prev_phys = NULL;
+	shm_first->buffer_size = shm_end - (uintptr_t)shm_first;
+	insert_free(shm_first);
 }
 DECLARE_HOOK(HOOK_INIT, shared_mem_init, HOOK_PRIO_FIRST);
 
 /* Called with the mutex lock acquired. */
-static void do_release(struct shm_buffer *ptr)
+static struct shm_buffer *find_free(size_t size)
 {
-	struct shm_buffer *pfb;
-	struct shm_buffer *top;
-	size_t released_size;
-
-	/* Take the buffer out of the allocated buffers chain. */
-	if (ptr == allocced_buf_chain) {
-		if (ptr->next_buffer) {
-			set_map_bit(BIT(20));
-			ptr->next_buffer->prev_buffer = NULL;
-		} else {
-			set_map_bit(BIT(21));
-		}
-		allocced_buf_chain = ptr->next_buffer;
-	} else {
-		/*
-		 * Saninty check: verify that the buffer is in the allocated
-		 * buffers chain.
-		 */
-		for (pfb = allocced_buf_chain->next_buffer;
-		     pfb;
-		     pfb = pfb->next_buffer)
-			if (pfb == ptr)
-				break;
-		if (!pfb)
-			return;
-
-		ptr->prev_buffer->next_buffer = ptr->next_buffer;
-		if (ptr->next_buffer) {
-			set_map_bit(BIT(22));
-			ptr->next_buffer->prev_buffer = ptr->prev_buffer;
-		} else {
-			set_map_bit(BIT(23));
-		}
-	}
-
-	/*
-	 * Let's bring the released buffer back into the fold. Cache its size
-	 * for quick reference.
-	 */
-	released_size = ptr->buffer_size;
-	if (!free_buf_chain) {
-		/*
-		 * All memory had been allocated - this buffer is going to be
-		 * the only available free space.
-		 */
-		set_map_bit(BIT(0));
-		free_buf_chain = ptr;
-		free_buf_chain->buffer_size = released_size;
-		free_buf_chain->next_buffer = NULL;
-		free_buf_chain->prev_buffer = NULL;
-		return;
-	}
+	struct shm_buffer *buf;
+	uint32_t map;
+	int fl, sl;
 
-	if (ptr < free_buf_chain) {
-		/*
-		 * Insert this buffer in the beginning of the chain, possibly
-		 * merging it with the first buffer of the chain.
-		 */
-		pfb = (struct shm_buffer *)((uintptr_t)ptr + released_size);
-		if (pfb == free_buf_chain) {
-			set_map_bit(BIT(1));
-			/* Merge the two buffers. */
-			ptr->buffer_size = free_buf_chain->buffer_size +
-				released_size;
-			ptr->next_buffer =
-				free_buf_chain->next_buffer;
-		} else {
-			set_map_bit(BIT(2));
-			ptr->buffer_size = released_size;
-			ptr->next_buffer = free_buf_chain;
-			free_buf_chain->prev_buffer = ptr;
-		}
-		if (ptr->next_buffer) {
-			set_map_bit(BIT(3));
-			ptr->next_buffer->prev_buffer = ptr;
-		} else {
+	mapping_search(size, &fl, &sl);
+	map = shm_sl_bitmap[fl] & (~0U << sl);
+	if (map) {
+		set_map_bit(BIT(3));
+	} else {
+		/* Nothing left in this power of two, try the next ones. */
+		map = shm_fl_bitmap & (~0U << (fl + 1));
+		if (map) {
 			set_map_bit(BIT(4));
+			fl = __builtin_ctz(map);
+			map = shm_sl_bitmap[fl];
 		}
-		ptr->prev_buffer = NULL;
-		free_buf_chain = ptr;
-		return;
+	}
+	if (map) {
+		buf = shm_free_lists[fl][__builtin_ctz(map)];
+		/* Only buffers of the last class can be too small. */
+		if (buf_size(buf) >= size)
+			return buf;
 	}
 
 	/*
-	 * Need to merge the new free buffer into the existing chain. Find a
-	 * spot for it, it should be above the highest address buffer which is
-	 * still below the new one.
+	 * The class of the size itself may still hold a buffer big enough,
+	 * which matters when asking for the largest buffer available.
 	 */
-	pfb = free_buf_chain;
-	while (pfb->next_buffer && (pfb->next_buffer < ptr))
-		pfb = pfb->next_buffer;
-
-	top = (struct shm_buffer *)((uintptr_t)pfb + pfb->buffer_size);
-	if (top == ptr) {
-		/*
-		 * The returned buffer is adjacent to an existing free buffer,
-		 * below it, merge the two buffers.
-		 */
-		pfb->buffer_size += released_size;
-
-		/*
-		 * Is the returned buffer the exact gap between two free
-		 * buffers?
-		 */
-		top = (struct shm_buffer *)((uintptr_t)ptr + released_size);
-		if (top == pfb->next_buffer) {
-			/* Yes, it is. */
-			pfb->buffer_size += pfb->next_buffer->buffer_size;
-			pfb->next_buffer =
-				pfb->next_buffer->next_buffer;
-			if (pfb->next_buffer) {
-				set_map_bit(BIT(5));
-				pfb->next_buffer->prev_buffer = pfb;
-			} else {
-				set_map_bit(BIT(6));
-			}
+	mapping(size, &fl, &sl);
+	for (buf = shm_free_lists[fl][sl]; buf; buf = buf->next_free)
+		if (buf_size(buf) >= size) {
+			set_map_bit(BIT(5));
+			return buf;
 		}
-		return;
-	}
 
-	top = (struct shm_buffer *)((uintptr_t)ptr + released_size);
-	if (top == pfb->next_buffer) {
-		/* The new buffer is adjacent with the one right above it. */
-		set_map_bit(BIT(7));
-		ptr->buffer_size = released_size +
-			pfb->next_buffer->buffer_size;
-		ptr->next_buffer = pfb->next_buffer->next_buffer;
-	} else {
-		/* Just include the new free buffer into the chain. */
-		set_map_bit(BIT(8));
-		ptr->next_buffer = pfb->next_buffer;
-		ptr->buffer_size = released_size;
-	}
-	ptr->prev_buffer = pfb;
-	pfb->next_buffer = ptr;
-	if (ptr->next_buffer) {
-		set_map_bit(BIT(9));
-		ptr->next_buffer->prev_buffer = ptr;
-	} else {
-		set_map_bit(BIT(10));
-	}
+	set_map_bit(BIT(6));
+	return NULL;
 }
 
 /* Called with the mutex lock acquired. */
 static int do_acquire(int size, struct shm_buffer **dest_ptr)
 {
-	int headroom = 0x10000000; /* we'll never have this much. */
-	struct shm_buffer *pfb;
-	struct shm_buffer *candidate = 0;
+	struct shm_buffer *buf, *tail, *next;
+	size_t need;
 
-	/* To keep things simple let's align the size. */
-	size = (size + sizeof(int) - 1) & ~(sizeof(int) - 1);
+	/* Room for the header, aligned so that bit 0 stays free. */
+	need = (size + SHM_HDR_SIZE + SHM_ALIGN - 1) & ~(SHM_ALIGN - 1);
+	need = MAX(need, SHM_MIN_SIZE);
 
-	/* And let's allocate room to fit the buffer header. */
-	size += sizeof(struct shm_buffer);
+	buf = find_free(need);
+	if (!buf)
+		return EC_ERROR_BUSY;
+	remove_free(buf);
 
-	pfb = free_buf_chain;
-	while (pfb) {
-		if ((pfb->buffer_size >= size) &&
-		    ((pfb->buffer_size - size) < headroom)) {
-			/* this is a new candidate. */
-			headroom = pfb->buffer_size - size;
-			candidate = pfb;
-		}
-		pfb = pfb->next_buffer;
+	if (buf_size(buf) - need < SHM_MIN_SIZE) {
+		/* The tail could not hold a free buffer, hand it out too. */
+		set_map_bit(BIT(7));
+	} else {
+		/* The tail becomes a new free buffer. */
+		set_map_bit(BIT(8));
+		tail = (struct shm_buffer *)((uintptr_t)buf + need);
+		tail->prev_phys = buf;
+		tail->buffer_size = buf_size(buf) - need;
+		buf->buffer_size = need;
+		next = buf_next(tail);
+		if (next)
+			next->prev_phys = tail;
+		insert_free(tail);
 	}
 
-	if (!candidate) {
-		set_map_bit(BIT(11));
-		return EC_ERROR_BUSY;
-	}
+	*dest_ptr = buf;
+	return EC_SUCCESS;
+}
 
-	*dest_ptr = candidate;
-
-	/* Now let's take the candidate out of the free buffer chain. */
-	if (headroom <= sizeof(struct shm_buffer)) {
-		/*
-		 * The entire buffer should be allocated, there is no need to
-		 * re-define its tail as a new free buffer.
-		 */
-		if (candidate == free_buf_chain) {
-			/*
-			 * The next buffer becomes the head of the free buffer
-			 * chain.
-			 */
-			free_buf_chain = candidate->next_buffer;
-			if (free_buf_chain) {
-				set_map_bit(BIT(12));
-				free_buf_chain->prev_buffer = 0;
-			} else {
-				set_map_bit(BIT(13));
-			}
-		} else {
-			candidate->prev_buffer->next_buffer =
-				candidate->next_buffer;
-			if (candidate->next_buffer) {
-				set_map_bit(BIT(14));
-				candidate->next_buffer->prev_buffer =
-					candidate->prev_buffer;
-			} else {
-				set_map_bit(BIT(15));
-			}
-		}
-		return EC_SUCCESS;
-	}
+/* Called with the mutex lock acquired. */
+static void do_release(struct shm_buffer *ptr)
+{
+	struct shm_buffer *next;
 
-	candidate->buffer_size = size;
+	/*
+	 * Sanity check: the buffer must be allocated, and sit between its
+	 * neighbours.
+	 */
+	if ((uintptr_t)ptr < (uintptr_t)shm_first ||
+	    (uintptr_t)ptr >= shm_end || buf_is_free(ptr) ||
+	    (ptr->prev_phys ? buf_next(ptr->prev_phys) != ptr :
+			      ptr != shm_first))
+		return;
 
-	/* Candidate's tail becomes a new free buffer. */
-	pfb = (struct shm_buffer *)((uintptr_t)candidate + size);
-	pfb->buffer_size = headroom;
-	pfb->next_buffer = candidate->next_buffer;
-	pfb->prev_buffer = candidate->prev_buffer;
+	stats.allocated -= buf_size(ptr);
 
-	if (pfb->next_buffer) {
-		set_map_bit(BIT(16));
-		pfb->next_buffer->prev_buffer = pfb;
-	} else {
-		set_map_bit(BIT(17));
+	if (ptr->prev_phys && buf_is_free(ptr->prev_phys)) {
+		/* Merge with the free buffer below. */
+		set_map_bit(BIT(9));
+		remove_free(ptr->prev_phys);
+		ptr->prev_phys->buffer_size += buf_size(ptr);
+		ptr = ptr->prev_phys;
+	}
+
+	next = buf_next(ptr);
+	if (next && buf_is_free(next)) {
+		/* Merge with the free buffer above. */
+		set_map_bit(BIT(10));
+		remove_free(next);
+		ptr->buffer_size += buf_size(next);
+		next = buf_next(ptr);
 	}
 
-	if (candidate == free_buf_chain) {
-		set_map_bit(BIT(18));
-		free_buf_chain = pfb;
+	if (next) {
+		set_map_bit(BIT(11));
+		next->prev_phys = ptr;
 	} else {
-		set_map_bit(BIT(19));
-		pfb->prev_buffer->next_buffer = pfb;
+		set_map_bit(BIT(12));
 	}
-	return EC_SUCCESS;
+	insert_free(ptr);
 }
 
 int shared_mem_size(void)
 {
 	struct shm_buffer *pfb;
 	size_t max_available = 0;
+	int fl;
 
 	mutex_lock(&shmem_lock);
 
-	/* Find the maximum available buffer size. */
-	pfb = free_buf_chain;
-	while (pfb) {
-		if (pfb->buffer_size > max_available)
-			max_available = pfb->buffer_size;
-		pfb = pfb->next_buffer;
+	/* The largest buffer is in the highest non-empty class. */
+	if (shm_fl_bitmap) {
+		fl = __fls(shm_fl_bitmap);
+		pfb = shm_free_lists[fl][__fls(shm_sl_bitmap[fl])];
+		for (; pfb; pfb = pfb->next_free)
+			max_available = MAX(max_available, buf_size(pfb));
 	}
 
 	mutex_unlock(&shmem_lock);
+
 	/* Leave room for shmem header */
-	max_available -= sizeof(struct shm_buffer);
-	return max_available;
+	if (max_available < SHM_HDR_SIZE)
+		return 0;
+	return max_available - SHM_HDR_SIZE;
 }
 
 int shared_mem_acquire(int size, char **dest_ptr)
@@ -314,26 +328,20 @@ int shared_mem_acquire(int size, char **dest_ptr)
 
 	*dest_ptr = NULL;
 
-	if (in_interrupt_context())
+	if (in_interrupt_context() || size < 0)
 		return EC_ERROR_INVAL;
 
-	if (!free_buf_chain)
-		return EC_ERROR_BUSY;
-
 	mutex_lock(&shmem_lock);
 	rv = do_acquire(size, &new_buf);
 	if (rv == EC_SUCCESS) {
-		new_buf->next_buffer = allocced_buf_chain;
-		new_buf->prev_buffer = NULL;
-		if (allocced_buf_chain)
-			allocced_buf_chain->prev_buffer = new_buf;
+		*dest_ptr = (char *)new_buf + SHM_HDR_SIZE;
 
-		allocced_buf_chain = new_buf;
-
-		*dest_ptr = (void *)(new_buf + 1);
-
-		if (size > max_allocated_size)
-			max_allocated_size = size;
+		stats.allocated += buf_size(new_buf);
+		stats.high_water = MAX(stats.high_water, stats.allocated);
+		if (size > stats.max_allocated_size)
+			stats.max_allocated_size = size;
+	} else {
+		stats.failures++;
 	}
 	mutex_unlock(&shmem_lock);
 
@@ -342,11 +350,11 @@ int shared_mem_acquire(int size, char **dest_ptr)
 
 void shared_mem_release(void *ptr)
 {
-	if (in_interrupt_context())
+	if (in_interrupt_context() || !ptr)
 		return;
 
 	mutex_lock(&shmem_lock);
-	do_release((struct shm_buffer *)ptr - 1);
+	do_release((struct shm_buffer *)((char *)ptr - SHM_HDR_SIZE));
 	mutex_unlock(&shmem_lock);
 }
 
@@ -357,33 +365,46 @@ static int command_shmem(int argc, char **argv)
 	size_t allocated_size;
 	size_t free_size;
 	size_t max_free;
+	size_t high_water;
+	int free_bufs, used_bufs;
+	uint32_t failures;
 	struct shm_buffer *buf;
 
 	allocated_size = free_size = max_free = 0;
+	free_bufs = used_bufs = 0;
 
 	mutex_lock(&shmem_lock);
 
-	for (buf = free_buf_chain; buf; buf = buf->next_buffer) {
+	for (buf = shm_first; buf; buf = buf_next(buf)) {
 		size_t buf_room;
 
-		buf_room = buf->buffer_size;
+		buf_room = buf_size(buf);
 
-		free_size += buf_room;
-		if (buf_room > max_free)
-			max_free = buf_room;
+		if (buf_is_free(buf)) {
+			free_bufs++;
+			free_size += buf_room;
+			if (buf_room > max_free)
+				max_free = buf_room;
+		} else {
+			used_bufs++;
+			allocated_size += buf_room;
+		}
 	}
-
-	for (buf = allocced_buf_chain; buf;
-	     buf = buf->next_buffer)
-		allocated_size += buf->buffer_size;
+	high_water = stats.high_water;
+	failures = stats.failures;
 
 	mutex_unlock(&shmem_lock);
 
 	ccprintf("Total:         %6zd\n", allocated_size + free_size);
-	ccprintf("Allocated:     %6zd\n", allocated_size);
-	ccprintf("Free:          %6zd\n", free_size);
+	ccprintf("Allocated:     %6zd (%d bufs)\n", allocated_size, used_bufs);
+	ccprintf("Free:          %6zd (%d bufs)\n", free_size, free_bufs);
 	ccprintf("Max free buf:  %6zd\n", max_free);
-	ccprintf("Max allocated: %6d\n", max_allocated_size);
+	ccprintf("Max allocated: %6d\n", stats.max_allocated_size);
+	ccprintf("High water:    %6zd\n", high_water);
+	/* Share of the free memory the largest free buffer can't serve. */
+	ccprintf("Fragmentation: %6d%%\n",
+		 free_size ? (int)(100 - max_free * 100 / free_size) : 0);
+	ccprintf("Failed:        %6u\n", failures);
 	return EC_SUCCESS;
 }
 DECLARE_SAFE_CONSOLE_COMMAND(shmem, command_shmem,
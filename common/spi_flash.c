@@ -20,18 +20,61 @@
 #include "flash.h"
 
 /*
- * Time to sleep when chip is busy
+ * Longest time to sleep between status polls when chip is busy
  */
 #define SPI_FLASH_SLEEP_USEC	100
 
 /*
- * This is the max time for 32kb flash erase
+ * Shortest time to sleep between status polls, doubled at each poll
  */
-#define SPI_FLASH_TIMEOUT_USEC	(800*MSEC)
+#define SPI_FLASH_MIN_POLL_USEC	10
+
+/*
+ * This is the max time for 64kb flash erase
+ */
+#define SPI_FLASH_TIMEOUT_USEC	(2 * SECOND)
 
 /* Internal buffer used by SPI flash driver */
 static uint8_t buf[SPI_FLASH_MAX_MESSAGE_SIZE];
 
+enum spi_flash_op {
+	SPI_FLASH_OP_PROGRAM,
+	SPI_FLASH_OP_ERASE_4KB,
+	SPI_FLASH_OP_ERASE_32KB,
+	SPI_FLASH_OP_ERASE_64KB,
+	SPI_FLASH_OP_COUNT,
+	SPI_FLASH_OP_NONE = SPI_FLASH_OP_COUNT,
+};
+
+static const char * const op_names[SPI_FLASH_OP_COUNT] = {
+	"page", "4k", "32k", "64k",
+};
+
+/*
+ * Time the chip takes for each operation, starting from typical datasheet
+ * values and following what is measured. Waits sleep through most of it
+ * before polling the status register.
+ */
+static uint32_t op_time_us[SPI_FLASH_OP_COUNT] = {
+	400, 45 * MSEC, 120 * MSEC, 150 * MSEC,
+};
+
+/* Operation started by the last command, and when */
+static enum spi_flash_op pending_op = SPI_FLASH_OP_NONE;
+static timestamp_t pending_start;
+
+/* Erase units used and bytes found blank by the last spi_flash_erase() */
+static struct {
+	int count[SPI_FLASH_OP_COUNT];
+	int blank_bytes;
+} erase_stats;
+
+static void spi_flash_start_op(enum spi_flash_op op)
+{
+	pending_op = op;
+	pending_start = get_time();
+}
+
 /**
  * Waits for chip to finish current operation. Must be called after
  * erase/write operations to ensure successive commands are executed.
@@ -41,14 +84,42 @@ static uint8_t buf[SPI_FLASH_MAX_MESSAGE_SIZE];
 int spi_flash_wait(void)
 {
 	timestamp_t timeout;
+	uint32_t expected = 0, elapsed;
+	int poll_us = SPI_FLASH_SLEEP_USEC;
+	int max_poll_us = SPI_FLASH_SLEEP_USEC;
+
+	if (pending_op != SPI_FLASH_OP_NONE) {
+		expected = op_time_us[pending_op] * 3 / 4;
+		elapsed = get_time().val - pending_start.val;
+		if (elapsed < expected)
+			usleep(expected - elapsed);
+		/* Then poll often, backing off if it takes longer. */
+		poll_us = SPI_FLASH_MIN_POLL_USEC;
+		max_poll_us = MAX(op_time_us[pending_op] / 16,
+				  SPI_FLASH_SLEEP_USEC);
+	}
 
 	timeout.val = get_time().val + SPI_FLASH_TIMEOUT_USEC;
 	/* Wait until chip is not busy */
 	while (spi_flash_get_status1() & SPI_FLASH_SR1_BUSY) {
-		usleep(SPI_FLASH_SLEEP_USEC);
+		usleep(poll_us);
+		poll_us = MIN(poll_us * 2, max_poll_us);
 
-		if (get_time().val > timeout.val)
+		if (get_time().val > timeout.val) {
+			pending_op = SPI_FLASH_OP_NONE;
 			return EC_ERROR_TIMEOUT;
+		}
+	}
+
+	if (pending_op != SPI_FLASH_OP_NONE) {
+		/*
+		 * Follow slowly, a single slow operation should not make the
+		 * next waits oversleep.
+		 */
+		elapsed = get_time().val - pending_start.val;
+		op_time_us[pending_op] =
+			(op_time_us[pending_op] * 7 + elapsed) / 8;
+		pending_op = SPI_FLASH_OP_NONE;
 	}
 
 	return EC_SUCCESS;
@@ -174,22 +245,71 @@ int spi_flash_read(uint8_t *buf_usr, unsigned int offset, unsigned int bytes)
 	return ret;
 }
 
+#ifdef CONFIG_FLASH_READ_ASYNC
+int spi_flash_read_async(uint8_t *buf, unsigned int offset, unsigned int bytes)
+{
+	/* Sent by DMA, must outlive the call */
+	static uint8_t cmd[4];
+	int rv;
+
+	if (offset + bytes > CONFIG_FLASH_SIZE)
+		return EC_ERROR_INVAL;
+
+	spi_transaction_lock(SPI_FLASH_DEVICE, 1);
+
+	cmd[0] = SPI_FLASH_READ;
+	cmd[1] = (offset >> 16) & 0xFF;
+	cmd[2] = (offset >> 8) & 0xFF;
+	cmd[3] = offset & 0xFF;
+	rv = spi_transaction_async(SPI_FLASH_DEVICE, cmd, 4, buf, bytes);
+	if (rv) {
+		spi_transaction_flush(SPI_FLASH_DEVICE);
+		spi_transaction_lock(SPI_FLASH_DEVICE, 0);
+	}
+
+	return rv;
+}
+
+int spi_flash_read_flush(void)
+{
+	int rv = spi_transaction_flush(SPI_FLASH_DEVICE);
+
+	spi_transaction_lock(SPI_FLASH_DEVICE, 0);
+	return rv;
+}
+#endif /* CONFIG_FLASH_READ_ASYNC */
+
 /**
  * Erase a block of SPI flash.
  *
  * @param offset Flash offset to start erasing
- * @param block Block size in kb (4 or 32)
+ * @param block Block size in kb (4, 32 or 64)
  *
  * @return EC_SUCCESS, or non-zero if any error.
  */
 static int spi_flash_erase_block(unsigned int offset, unsigned int block)
 {
 	uint8_t cmd[4];
+	enum spi_flash_op op;
 	int rv = EC_SUCCESS;
 
-	/* Invalid block size */
-	if (block != 4 && block != 32)
+	switch (block) {
+	case 4:
+		cmd[0] = SPI_FLASH_ERASE_4KB;
+		op = SPI_FLASH_OP_ERASE_4KB;
+		break;
+	case 32:
+		cmd[0] = SPI_FLASH_ERASE_32KB;
+		op = SPI_FLASH_OP_ERASE_32KB;
+		break;
+	case 64:
+		cmd[0] = SPI_FLASH_ERASE_64KB;
+		op = SPI_FLASH_OP_ERASE_64KB;
+		break;
+	default:
+		/* Invalid block size */
 		return EC_ERROR_INVAL;
+	}
 
 	/* Not block aligned */
 	if ((offset % (block * 1024)) != 0)
@@ -201,7 +321,6 @@ static int spi_flash_erase_block(unsigned int offset, unsigned int block)
 		return rv;
 
 	/* Compose instruction */
-	cmd[0] = (block == 4) ? SPI_FLASH_ERASE_4KB : SPI_FLASH_ERASE_32KB;
 	cmd[1] = (offset >> 16) & 0xFF;
 	cmd[2] = (offset >> 8) & 0xFF;
 	cmd[3] = offset & 0xFF;
@@ -209,14 +328,53 @@ static int spi_flash_erase_block(unsigned int offset, unsigned int block)
 	rv = spi_transaction(SPI_FLASH_DEVICE, cmd, 4, NULL, 0);
 	if (rv)
 		return rv;
+	spi_flash_start_op(op);
+	erase_stats.count[op]++;
 
 	/* Wait for previous operation to complete */
 	return spi_flash_wait();
 }
 
+/**
+ * Count the erased (0xff) bytes at the start of a range of SPI flash.
+ *
+ * @param offset Flash offset to start reading
+ * @param bytes Number of bytes to check
+ * @param blank Number of erased bytes found
+ *
+ * @return EC_SUCCESS, or non-zero if any error.
+ */
+static int spi_flash_blank_bytes(unsigned int offset, unsigned int bytes,
+				 unsigned int *blank)
+{
+	uint8_t cmd[4] = { SPI_FLASH_READ };
+	int i, read_size, rv;
+
+	*blank = 0;
+	while (*blank < bytes) {
+		cmd[1] = (offset >> 16) & 0xFF;
+		cmd[2] = (offset >> 8) & 0xFF;
+		cmd[3] = offset & 0xFF;
+		read_size = MIN(bytes - *blank, SPI_FLASH_MAX_READ_SIZE);
+		rv = spi_transaction(SPI_FLASH_DEVICE, cmd, 4, buf, read_size);
+		if (rv)
+			return rv;
+
+		for (i = 0; i < read_size; i++, (*blank)++)
+			if (buf[i] != 0xff)
+				return EC_SUCCESS;
+		offset += read_size;
+	}
+
+	return EC_SUCCESS;
+}
+
 /**
  * Erase SPI flash.
  *
+ * Uses the largest block (64kb, 32kb or 4kb) the range is aligned to and
+ * covers, and skips sectors that already read as erased.
+ *
  * @param offset Flash offset to start erasing
  * @param bytes Number of bytes to erase
  *
@@ -224,6 +382,7 @@ static int spi_flash_erase_block(unsigned int offset, unsigned int block)
  */
 int spi_flash_erase(unsigned int offset, unsigned int bytes)
 {
+	unsigned int block, blank;
 	int rv = EC_SUCCESS;
 
 	/* Invalid input */
@@ -234,31 +393,48 @@ int spi_flash_erase(unsigned int offset, unsigned int bytes)
 	if (offset % 4096 || bytes % 4096)
 		return EC_ERROR_INVAL;
 
-	/* Largest unit is block (32kb) */
-	if (offset % (32 * 1024) == 0) {
-		while (bytes != (bytes % (32 * 1024))) {
-			rv = spi_flash_erase_block(offset, 32);
-			if (rv)
-				return rv;
-
-			bytes -= 32 * 1024;
-			offset += 32 * 1024;
-			/*
-			 * Refresh watchdog since we may be erasing a large
-			 * number of blocks.
-			 */
-			watchdog_reload();
+	memset(&erase_stats, 0, sizeof(erase_stats));
+
+	while (bytes) {
+		if (offset % (64 * 1024) == 0 && bytes >= 64 * 1024)
+			block = 64;
+		else if (offset % (32 * 1024) == 0 && bytes >= 32 * 1024)
+			block = 32;
+		else
+			block = 4;
+
+		/* Wait for previous operation to complete */
+		rv = spi_flash_wait();
+		if (rv)
+			return rv;
+
+		/*
+		 * Reading is much faster than erasing, skip the leading
+		 * sectors of the block that are already erased and pick
+		 * the block size again from there.
+		 */
+		rv = spi_flash_blank_bytes(offset, block * 1024, &blank);
+		if (rv)
+			return rv;
+		blank -= blank % 4096;
+		if (blank) {
+			erase_stats.blank_bytes += blank;
+			bytes -= blank;
+			offset += blank;
+			continue;
 		}
-	}
 
-	/* Largest unit is sector (4kb) */
-	while (bytes != (bytes % (4 * 1024))) {
-		rv = spi_flash_erase_block(offset, 4);
+		rv = spi_flash_erase_block(offset, block);
 		if (rv)
 			return rv;
 
-		bytes -= 4 * 1024;
-		offset += 4 * 1024;
+		bytes -= block * 1024;
+		offset += block * 1024;
+		/*
+		 * Refresh watchdog since we may be erasing a large
+		 * number of blocks.
+		 */
+		watchdog_reload();
 	}
 
 	return rv;
@@ -266,7 +442,9 @@ int spi_flash_erase(unsigned int offset, unsigned int bytes)
 
 /**
  * Write to SPI flash. Assumes already erased.
- * Limited to SPI_FLASH_MAX_WRITE_SIZE by chip.
+ *
+ * Any length can be written, it is split into page programs. The next page
+ * is copied to the send buffer while the chip programs the previous one.
  *
  * @param offset Flash offset to write
  * @param bytes Number of bytes to write
@@ -280,8 +458,7 @@ int spi_flash_write(unsigned int offset, unsigned int bytes,
 	int rv, write_size;
 
 	/* Invalid input */
-	if (!data || offset + bytes > CONFIG_FLASH_SIZE ||
-	    bytes > SPI_FLASH_MAX_WRITE_SIZE)
+	if (!data || offset + bytes > CONFIG_FLASH_SIZE)
 		return EC_ERROR_INVAL;
 
 	while (bytes > 0) {
@@ -290,6 +467,15 @@ int spi_flash_write(unsigned int offset, unsigned int bytes,
 		write_size = MIN(bytes, SPI_FLASH_MAX_WRITE_SIZE -
 		(offset & (SPI_FLASH_MAX_WRITE_SIZE - 1)));
 
+		/* Copy data to send buffer; buffers may overlap */
+		memmove(buf + 4, data, write_size);
+
+		/* Compose instruction */
+		buf[0] = SPI_FLASH_PAGE_PRGRM;
+		buf[1] = (offset) >> 16;
+		buf[2] = (offset) >> 8;
+		buf[3] = offset;
+
 		/* Wait for previous operation to complete */
 		rv = spi_flash_wait();
 		if (rv)
@@ -300,19 +486,11 @@ int spi_flash_write(unsigned int offset, unsigned int bytes,
 		if (rv)
 			return rv;
 
-		/* Copy data to send buffer; buffers may overlap */
-		memmove(buf + 4, data, write_size);
-
-		/* Compose instruction */
-		buf[0] = SPI_FLASH_PAGE_PRGRM;
-		buf[1] = (offset) >> 16;
-		buf[2] = (offset) >> 8;
-		buf[3] = offset;
-
 		rv = spi_transaction(SPI_FLASH_DEVICE,
 				     buf, 4 + write_size, NULL, 0);
 		if (rv)
 			return rv;
+		spi_flash_start_op(SPI_FLASH_OP_PROGRAM);
 
 		data += write_size;
 		offset += write_size;
@@ -481,7 +659,7 @@ static int command_spi_flashinfo(int argc, char **argv)
 {
 	uint8_t jedec[3];
 	uint8_t unique[8];
-	int rv;
+	int i, rv;
 
 	spi_enable(CONFIG_SPI_FLASH_PORT, 1);
 
@@ -499,6 +677,10 @@ static int command_spi_flashinfo(int argc, char **argv)
 		 unique[0], unique[1], unique[2], unique[3],
 		 unique[4], unique[5], unique[6], unique[7]);
 	ccprintf("Capacity: %4d kB\n", SPI_FLASH_SIZE(jedec[2]) / 1024);
+	ccprintf("Typical us:");
+	for (i = 0; i < SPI_FLASH_OP_COUNT; i++)
+		ccprintf(" %s %d", op_names[i], op_time_us[i]);
+	ccprintf("\n");
 
 	return rv;
 }
@@ -526,10 +708,20 @@ DECLARE_HOST_COMMAND(EC_CMD_FLASH_SPI_INFO,
 #endif  /* CONFIG_HOSTCMD_FLASH_SPI_INFO */
 
 #ifdef CONFIG_CMD_SPI_FLASH
+/* Print how long an operation on bytes took since start, and the rate. */
+static void print_throughput(const char *what, int bytes, timestamp_t start)
+{
+	uint32_t us = MAX(get_time().val - start.val, 1);
+
+	ccprintf("%s %d bytes in %d us, %d kB/s\n", what, bytes, us,
+		 (int)((uint64_t)bytes * SECOND / 1024 / us));
+}
+
 static int command_spi_flasherase(int argc, char **argv)
 {
 	int offset = -1;
 	int bytes = 4096;
+	timestamp_t start;
 	int rv = parse_offset_size(argc, argv, 1, &offset, &bytes);
 
 	if (rv)
@@ -542,7 +734,18 @@ static int command_spi_flasherase(int argc, char **argv)
 		return EC_ERROR_ACCESS_DENIED;
 
 	ccprintf("Erasing %d bytes at 0x%x...\n", bytes, offset);
-	return spi_flash_erase(offset, bytes);
+	start = get_time();
+	rv = spi_flash_erase(offset, bytes);
+	if (rv)
+		return rv;
+
+	print_throughput("Erased", bytes, start);
+	ccprintf("64k x%d, 32k x%d, 4k x%d, %d bytes already blank\n",
+		 erase_stats.count[SPI_FLASH_OP_ERASE_64KB],
+		 erase_stats.count[SPI_FLASH_OP_ERASE_32KB],
+		 erase_stats.count[SPI_FLASH_OP_ERASE_4KB],
+		 erase_stats.blank_bytes);
+	return EC_SUCCESS;
 }
 DECLARE_CONSOLE_COMMAND(spi_flasherase, command_spi_flasherase,
 	"offset [bytes]",
@@ -555,6 +758,8 @@ static int command_spi_flashwrite(int argc, char **argv)
 	int write_len;
 	int rv = EC_SUCCESS;
 	int i;
+	int total;
+	timestamp_t start;
 
 	rv = parse_offset_size(argc, argv, 1, &offset, &bytes);
 	if (rv)
@@ -566,16 +771,21 @@ static int command_spi_flashwrite(int argc, char **argv)
 	if (spi_flash_check_protect(offset, bytes))
 		return EC_ERROR_ACCESS_DENIED;
 
-	/* Fill the data buffer with a pattern */
-	for (i = 0; i < SPI_FLASH_MAX_WRITE_SIZE; i++)
-		buf[i] = i;
-
 	ccprintf("Writing %d bytes to 0x%x...\n", bytes, offset);
+	total = bytes;
+	start = get_time();
 	while (bytes > 0) {
 		/* First write multiples of 256, then (bytes % 256) last */
 		write_len = ((bytes % SPI_FLASH_MAX_WRITE_SIZE) == bytes) ?
 					bytes : SPI_FLASH_MAX_WRITE_SIZE;
 
+		/*
+		 * Fill the data buffer with a pattern, every time as writes
+		 * compose the instruction in it.
+		 */
+		for (i = 0; i < write_len; i++)
+			buf[i] = i;
+
 		/* Perform write */
 		rv = spi_flash_write(offset, write_len, buf);
 		if (rv)
@@ -586,6 +796,7 @@ static int command_spi_flashwrite(int argc, char **argv)
 	}
 
 	ASSERT(bytes == 0);
+	print_throughput("Wrote", total, start);
 
 	return rv;
 }
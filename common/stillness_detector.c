@@ -4,19 +4,17 @@
  */
 
 #include "common.h"
+#include "online_stats.h"
 #include "stillness_detector.h"
 #include "timer.h"
 #include <string.h>
 
 static void still_det_reset(struct still_det *still_det)
 {
-	still_det->num_samples = 0;
+	online_stats_reset(&still_det->stats);
 	still_det->acc_x = FLOAT_TO_FP(0.0f);
 	still_det->acc_y = FLOAT_TO_FP(0.0f);
 	still_det->acc_z = FLOAT_TO_FP(0.0f);
-	still_det->acc_xx = FLOAT_TO_FP(0.0f);
-	still_det->acc_yy = FLOAT_TO_FP(0.0f);
-	still_det->acc_zz = FLOAT_TO_FP(0.0f);
 }
 
 static bool stillness_batch_complete(struct still_det *still_det,
@@ -28,7 +26,7 @@ static bool stillness_batch_complete(struct still_det *still_det,
 
 	/* Checking if enough data is accumulated */
 	if (batch_window >= still_det->min_batch_window &&
-	    still_det->num_samples > still_det->min_batch_size) {
+	    still_det->stats.n > still_det->min_batch_size) {
 		if (batch_window <= still_det->max_batch_window) {
 			complete = true;
 		} else {
@@ -38,66 +36,41 @@ static bool stillness_batch_complete(struct still_det *still_det,
 			still_det_reset(still_det);
 		}
 	} else if (batch_window > still_det->min_batch_window &&
-		   still_det->num_samples < still_det->min_batch_size) {
+		   still_det->stats.n < still_det->min_batch_size) {
 		/* Not enough samples collected, reset and start over */
 		still_det_reset(still_det);
 	}
 	return complete;
 }
 
-static inline fp_t compute_variance(fp_t acc_squared, fp_t acc, fp_t inv)
-{
-	/* (acc^2 - (acc * acc * inv)) * inv */
-	return fp_mul((acc_squared - fp_mul(fp_sq(acc), inv)), inv);
-}
-
 bool still_det_update(struct still_det *still_det, uint32_t sample_time,
 		      fp_t x, fp_t y, fp_t z)
 {
-	fp_t inv = FLOAT_TO_FP(0.0f), var_x, var_y, var_z;
+	fp_t inv;
+	fpv3_t var;
 	bool complete = false;
 
-	/* Accumulate for mean and VAR */
+	/*
+	 * Accumulate for mean and VAR. The plain sums do not cancel out in
+	 * the mean, only the variance needs the shifted sums of online_stats.
+	 */
+	online_stats_update(&still_det->stats, x, y, z);
 	still_det->acc_x += x;
 	still_det->acc_y += y;
 	still_det->acc_z += z;
-	still_det->acc_xx += fp_mul(x, x);
-	still_det->acc_yy += fp_mul(y, y);
-	still_det->acc_zz += fp_mul(z, z);
 
-	switch (++still_det->num_samples) {
-	case 0:
-		/* If we rolled over, go back. */
-		still_det->num_samples--;
-		break;
-	case 1:
-		/* Set a new start time if new batch. */
+	/* Set a new start time if new batch. */
+	if (still_det->stats.n == 1)
 		still_det->window_start_time = sample_time;
-		break;
-	}
 
 	if (stillness_batch_complete(still_det, sample_time)) {
-		/*
-		 * Compute 1/num_samples and check for num_samples == 0 (should
-		 * never happen, but just in case)
-		 */
-		if (still_det->num_samples) {
-			inv = fp_div(1.0f, INT_TO_FP(still_det->num_samples));
-		} else {
-			still_det_reset(still_det);
-			return complete;
-		}
-		/* Calculating the VAR = sum(x^2)/n - sum(x)^2/n^2 */
-		var_x = compute_variance(
-			still_det->acc_xx, still_det->acc_x, inv);
-		var_y = compute_variance(
-			still_det->acc_yy, still_det->acc_y, inv);
-		var_z = compute_variance(
-			still_det->acc_zz, still_det->acc_z, inv);
+		/* Calculating the VAR = sum((x - mean)^2) / n */
+		online_stats_compute(&still_det->stats, NULL, var, false);
 		/* Checking if sensor is still */
-		if (var_x < still_det->var_threshold &&
-		    var_y < still_det->var_threshold &&
-		    var_z < still_det->var_threshold) {
+		if (var[X] < still_det->var_threshold &&
+		    var[Y] < still_det->var_threshold &&
+		    var[Z] < still_det->var_threshold) {
+			inv = fp_div(1.0f, INT_TO_FP(still_det->stats.n));
 			still_det->mean_x = fp_mul(still_det->acc_x, inv);
 			still_det->mean_y = fp_mul(still_det->acc_y, inv);
 			still_det->mean_z = fp_mul(still_det->acc_z, inv);
@@ -10,6 +10,9 @@
 #include <signal.h>
 #include <stdlib.h>
 #endif
+#ifdef EMU_BUILD
+#include <time.h>
+#endif
 
 #include "console.h"
 #include "hooks.h"
@@ -17,6 +20,7 @@
 #include "system.h"
 #include "task.h"
 #include "test_util.h"
+#include "timer.h"
 #include "util.h"
 
 struct test_util_tag {
@@ -173,6 +177,19 @@ uint32_t prng_no_seed(void)
 	return seed = prng(seed);
 }
 
+uint64_t test_bench_now_ns(void)
+{
+#ifdef EMU_BUILD
+	/* Host time is emulated, use the system clock there. */
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+	return get_time().val * 1000;
+#endif
+}
+
 static void restore_state(void)
 {
 	const struct test_util_tag *tag;
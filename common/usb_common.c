@@ -462,6 +462,11 @@ static void pd_send_hard_reset(int port)
 	task_set_event(PD_PORT_TO_TASK_ID(port), PD_EVENT_SEND_HARD_RESET, 0);
 }
 
+#ifdef CONFIG_CMD_TCPCI_ALERT_STATS
+/* Counted by every TCPC driver through TCPC_COUNT_I2C_XFER() */
+uint32_t tcpc_i2c_xfer_count[CONFIG_USB_PD_PORT_MAX_COUNT];
+#endif
+
 #ifdef CONFIG_USBC_PPC
 
 static uint32_t port_oc_reset_req;
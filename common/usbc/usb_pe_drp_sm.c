@@ -916,6 +916,49 @@ void pe_run(int port, int evt, int en)
 	}
 }
 
+uint64_t pe_get_next_timeout(int port, uint64_t since)
+{
+	const uint64_t timers[] = {
+		pe[port].timeout,
+		pe[port].no_response_timer,
+		pe[port].source_cap_timer,
+		pe[port].sender_response_timer,
+		pe[port].discover_identity_timer,
+		pe[port].sink_request_timer,
+		pe[port].pr_swap_wait_timer,
+		pe[port].vdm_response_timer,
+		pe[port].wait_and_add_jitter_timer,
+		pe[port].chunking_not_supported_timer,
+	};
+	uint64_t next = USBC_NO_DEADLINE;
+	int i;
+
+	/* A paused Policy Engine is restarted by the TypeC layer */
+	if (local_state[port] == SM_PAUSED)
+		return USBC_NO_DEADLINE;
+
+	/*
+	 * Only the Ready states are known to act solely on messages, DPM
+	 * requests and their timers; keep polling everywhere else.
+	 */
+	if (local_state[port] != SM_RUN ||
+	    (get_state_pe(port) != PE_SRC_READY &&
+	     get_state_pe(port) != PE_SNK_READY))
+		return since + USBC_EVENT_TIMEOUT;
+
+	/* Inputs which were posted after the Ready state last ran */
+	if (pe[port].dpm_request ||
+	    PE_CHK_FLAG(port, PE_FLAGS_MSG_RECEIVED |
+			      PE_FLAGS_VDM_REQUEST_CONTINUE |
+			      PE_FLAGS_FAST_ROLE_SWAP_SIGNALED))
+		return since + USBC_EVENT_TIMEOUT;
+
+	for (i = 0; i < ARRAY_SIZE(timers); i++)
+		next = sm_next_deadline(next, timers[i], since);
+
+	return next;
+}
+
 int pe_is_explicit_contract(int port)
 {
 	return PE_CHK_FLAG(port, PE_FLAGS_EXPLICIT_CONTRACT);
@@ -1205,6 +1248,10 @@ void pe_got_soft_reset(int port)
 void pd_dpm_request(int port, enum pd_dpm_request req)
 {
 	PE_SET_DPM_REQUEST(port, req);
+
+	/* The PD task may be sleeping until its next timer deadline */
+	if (IS_ENABLED(CONFIG_USB_PD_TICKLESS))
+		task_wake(PD_PORT_TO_TASK_ID(port));
 }
 
 void pe_vconn_swap_complete(int port)
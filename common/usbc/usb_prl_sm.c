@@ -697,6 +697,36 @@ void prl_run(int port, int evt, int en)
 	}
 }
 
+uint64_t prl_get_next_timeout(int port, uint64_t since)
+{
+	/* A paused Protocol Layer is restarted by the TypeC layer */
+	if (local_state[port] == SM_PAUSED)
+		return USBC_NO_DEADLINE;
+
+	/*
+	 * While waiting for requests, the Protocol Layer only moves on
+	 * messages from the TCPC (which wake the task) or requests from the
+	 * PE, which runs before it in the same task iteration.
+	 */
+	if (local_state[port] != SM_RUN ||
+	    prl_tx_get_state(port) != PRL_TX_WAIT_FOR_MESSAGE_REQUEST ||
+	    prl_hr_get_state(port) != PRL_HR_WAIT_FOR_REQUEST ||
+	    prl_is_busy(port))
+		return since + USBC_EVENT_TIMEOUT;
+
+	/* Work left over from the last run: queued RX or a PE request */
+	if (tcpm_has_pending_message(port) ||
+	    PRL_TX_CHK_FLAG(port, PRL_FLAGS_MSG_XMIT))
+		return since + USBC_EVENT_TIMEOUT;
+#ifdef CONFIG_USB_PD_EXTENDED_MESSAGES
+	if (TCH_CHK_FLAG(port, PRL_FLAGS_MSG_XMIT) ||
+	    RCH_CHK_FLAG(port, PRL_FLAGS_MSG_RECEIVED))
+		return since + USBC_EVENT_TIMEOUT;
+#endif /* CONFIG_USB_PD_EXTENDED_MESSAGES */
+
+	return USBC_NO_DEADLINE;
+}
+
 void prl_set_rev(int port, enum tcpm_transmit_type type,
 						enum pd_rev_type rev)
 {
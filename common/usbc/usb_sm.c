@@ -3,6 +3,7 @@
  * found in the LICENSE file.
  */
 
+#include "assert.h"
 #include "common.h"
 #include "console.h"
 #include "stdbool.h"
@@ -29,86 +30,48 @@ struct internal_ctx {
 BUILD_ASSERT(sizeof(struct internal_ctx) ==
 	     member_size(struct sm_ctx, internal));
 
-/* Gets the first shared parent state between a and b (inclusive) */
-static usb_state_ptr shared_parent_state(usb_state_ptr a, usb_state_ptr b)
-{
-	const usb_state_ptr orig_b = b;
-
-	/* There are no common ancestors */
-	if (b == NULL)
-		return NULL;
-
-	/* This assumes that both A and B are NULL terminated without cycles */
-	while (a != NULL) {
-		/* We found a match return */
-		if (a == b)
-			return a;
-
-		/*
-		 * Otherwise, increment b down the list for comparison until we
-		 * run out, then increment a and start over on b for comparison
-		 */
-		if (b->parent == NULL) {
-			a = a->parent;
-			b = orig_b;
-		} else {
-			b = b->parent;
-		}
-	}
-
-	return NULL;
-}
-
 /*
- * Call all entry functions of parents before children. If set_state is called
- * during one of the entry functions, then do not call any remaining entry
- * functions.
+ * Flattens the ancestry of a state into chain[], from the state itself up to
+ * its root, so that a transition can look up the ancestor at a given depth
+ * and enter parents before children without recursion. Returns the number of
+ * entries, i.e. the depth of the state, which must not exceed
+ * USB_SM_MAX_DEPTH (usb_sm_checks verifies it for all the state tables).
  */
-static void call_entry_functions(const int port,
-			       struct internal_ctx *const internal,
-			       const usb_state_ptr stop,
-			       const usb_state_ptr current)
+static int get_state_chain(usb_state_ptr state,
+			   usb_state_ptr chain[USB_SM_MAX_DEPTH])
 {
-	if (current == stop)
-		return;
+	int depth = 0;
 
-	call_entry_functions(port, internal, stop, current->parent);
-
-	/*
-	 * If the previous entry function called set_state, then don't enter
-	 * remaining states.
-	 */
-	if (!internal->enter)
-		return;
+	while (state != NULL && depth < USB_SM_MAX_DEPTH) {
+		chain[depth++] = state;
+		state = state->parent;
+	}
+	/* A deeper hierarchy would be entered and exited out of order. */
+	assert(state == NULL);
 
-	/* Track the latest state that was entered, so we can exit properly. */
-	internal->last_entered = current;
-	if (current->entry)
-		current->entry(port);
+	return depth;
 }
 
-/*
- * Call all exit functions of children before parents. Note set_state is ignored
- * during an exit function.
- */
-static void call_exit_functions(const int port, const usb_state_ptr stop,
-			      const usb_state_ptr current)
+/* Returns the number of levels in the hierarchy of a state */
+static int get_state_depth(usb_state_ptr state)
 {
-	if (current == stop)
-		return;
+	int depth = 0;
 
-	if (current->exit)
-		current->exit(port);
+	for (; state != NULL; state = state->parent)
+		depth++;
 
-	call_exit_functions(port, stop, current->parent);
+	return depth;
 }
 
 void set_state(const int port, struct sm_ctx *const ctx,
 	       const usb_state_ptr new_state)
 {
 	struct internal_ctx * const internal = (void *) ctx->internal;
+	usb_state_ptr new_chain[USB_SM_MAX_DEPTH];
 	usb_state_ptr last_state;
-	usb_state_ptr shared_parent;
+	int last_depth;
+	int new_depth;
+	int i;
 
 	/*
 	 * It does not make sense to call set_state in an exit phase of a state
@@ -127,27 +90,43 @@ void set_state(const int port, struct sm_ctx *const ctx,
 	 * shouldn't exit any states that weren't fully entered.
 	 */
 	last_state = internal->enter ? internal->last_entered : ctx->current;
-
-	/* We don't exit and re-enter shared parent states */
-	shared_parent = shared_parent_state(last_state, new_state);
+	last_depth = get_state_depth(last_state);
+	new_depth = get_state_chain(new_state, new_chain);
 
 	/*
-	 * Exit all of the non-common states from the last state.
+	 * Exit all of the non-common states from the last state, children
+	 * before parents, until reaching the first shared parent state at the
+	 * same depth in both hierarchies. We don't exit and re-enter shared
+	 * parent states. Note set_state is ignored during an exit function.
 	 */
 	internal->exit = true;
-	call_exit_functions(port, shared_parent, last_state);
+	for (; last_depth > 0; last_depth--) {
+		if (last_depth <= new_depth &&
+		    last_state == new_chain[new_depth - last_depth])
+			break;
+		if (last_state->exit)
+			last_state->exit(port);
+		last_state = last_state->parent;
+	}
 	internal->exit = false;
 
 	ctx->previous = ctx->current;
 	ctx->current = new_state;
 
 	/*
-	 * Enter all new non-common states. last_entered will contain the last
-	 * state that successfully entered before another set_state was called.
+	 * Enter all new non-common states, parents before children. If
+	 * set_state is called during one of the entry functions, then do not
+	 * call any remaining entry functions. last_entered will contain the
+	 * last state that successfully entered before another set_state was
+	 * called, so we can exit properly.
 	 */
 	internal->last_entered = NULL;
 	internal->enter = true;
-	call_entry_functions(port, internal, shared_parent, ctx->current);
+	for (i = new_depth - last_depth - 1; i >= 0 && internal->enter; i--) {
+		internal->last_entered = new_chain[i];
+		if (new_chain[i]->entry)
+			new_chain[i]->entry(port);
+	}
 	/*
 	 * Setting enter to false ensures that all pending entry calls will be
 	 * skipped (in the case of a parent state calling set_state, which means
@@ -170,33 +149,20 @@ void set_state(const int port, struct sm_ctx *const ctx,
 		task_wake(PD_PORT_TO_TASK_ID(port));
 }
 
-/*
- * Call all run functions of children before parents. If set_state is called
- * during one of the entry functions, then do not call any remaining entry
- * functions.
- */
-static void call_run_functions(const int port,
-			     const struct internal_ctx *const internal,
-			     const usb_state_ptr current)
-{
-	if (!current)
-		return;
-
-	/* If set_state is called during run, don't call remain functions. */
-	if (!internal->running)
-		return;
-
-	if (current->run)
-		current->run(port);
-
-	call_run_functions(port, internal, current->parent);
-}
-
 void run_state(const int port, struct sm_ctx *const ctx)
 {
 	struct internal_ctx * const internal = (void *) ctx->internal;
+	usb_state_ptr current;
 
+	/*
+	 * Call all run functions of children before parents. If set_state is
+	 * called during one of the run functions, then do not call any
+	 * remaining run functions.
+	 */
 	internal->running = true;
-	call_run_functions(port, internal, ctx->current);
+	for (current = ctx->current; current && internal->running;
+	     current = current->parent)
+		if (current->run)
+			current->run(port);
 	internal->running = false;
 }
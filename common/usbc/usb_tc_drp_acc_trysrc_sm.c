@@ -3456,6 +3456,38 @@ void tc_run(const int port)
 	run_state(port, &tc[port].ctx);
 }
 
+uint64_t tc_get_next_timeout(int port, uint64_t since)
+{
+	uint64_t next = USBC_NO_DEADLINE;
+
+	/*
+	 * Only the Attached states are known to act solely on CC/VBUS events
+	 * from the TCPC, requests from the PE and their timers; keep polling
+	 * everywhere else.  A sink needs the TCPC to report VBUS changes for
+	 * detach detection.
+	 */
+	if (!IS_ATTACHED_SRC(port) &&
+	    !(IS_ATTACHED_SNK(port) &&
+	      IS_ENABLED(CONFIG_USB_PD_VBUS_DETECT_TCPC)))
+		return since + USBC_EVENT_TIMEOUT;
+
+	if (TC_CHK_FLAG(port, TC_FLAGS_SUSPEND |
+			      TC_FLAGS_HARD_RESET_REQUESTED |
+			      TC_FLAGS_PR_SWAP_IN_PROGRESS |
+			      TC_FLAGS_REQUEST_PR_SWAP |
+			      TC_FLAGS_REQUEST_DR_SWAP |
+			      TC_FLAGS_REQUEST_VC_SWAP_ON |
+			      TC_FLAGS_REQUEST_VC_SWAP_OFF))
+		return since + USBC_EVENT_TIMEOUT;
+
+	next = sm_next_deadline(next, tc[port].timeout, since);
+	next = sm_next_deadline(next, tc[port].cc_debounce, since);
+	next = sm_next_deadline(next, tc[port].pd_debounce, since);
+	next = sm_next_deadline(next, tc[port].vbus_debounce_time, since);
+
+	return next;
+}
+
 static void pd_chipset_resume(void)
 {
 	int i;
@@ -32,13 +32,23 @@
 #include "usbc_ppc.h"
 #include "version.h"
 
-#define USBC_EVENT_TIMEOUT (5 * MSEC)
-
 #define CPRINTF(format, args...) cprintf(CC_USBPD, format, ## args)
 #define CPRINTS(format, args...) cprints(CC_USBPD, format, ## args)
 
 static uint8_t paused[CONFIG_USB_PD_PORT_MAX_COUNT];
 
+#ifdef CONFIG_USB_PD_TICKLESS
+/* Time at which the state machines last started running */
+static uint64_t last_run[CONFIG_USB_PD_PORT_MAX_COUNT];
+#endif
+/* Number of times the PD task woke up, for measuring idle behaviour */
+static uint32_t wakeups[CONFIG_USB_PD_PORT_MAX_COUNT];
+
+uint32_t pd_task_get_wakeups(int port)
+{
+	return wakeups[port];
+}
+
 void tc_pause_event_loop(int port)
 {
 	paused[port] = 1;
@@ -73,13 +83,53 @@ static void pd_task_init(int port)
 		schedule_deferred_pd_interrupt(port);
 }
 
+/*
+ * Returns how long the PD task may sleep before the state machines need to
+ * run again.  Without CONFIG_USB_PD_TICKLESS they are polled every
+ * USBC_EVENT_TIMEOUT; otherwise the task sleeps until the earliest timer
+ * deadline and relies on TCPC, PE and DPM events to wake it earlier.
+ */
+static int pd_task_timeout(int port)
+{
+#ifdef CONFIG_USB_PD_TICKLESS
+	const uint64_t since = last_run[port];
+	uint64_t next = USBC_NO_DEADLINE;
+	uint64_t now;
+
+	if (IS_ENABLED(CONFIG_USB_TYPEC_SM))
+		next = MIN(next, tc_get_next_timeout(port, since));
+	if (IS_ENABLED(CONFIG_USB_PE_SM))
+		next = MIN(next, pe_get_next_timeout(port, since));
+	if (IS_ENABLED(CONFIG_USB_PRL_SM))
+		next = MIN(next, prl_get_next_timeout(port, since));
+
+	now = get_time().val;
+	if (next <= now)
+		return 1;
+	if (next - now > CONFIG_USB_PD_TICKLESS_MAX_SLEEP)
+		return CONFIG_USB_PD_TICKLESS_MAX_SLEEP;
+	return next - now;
+#else
+	return USBC_EVENT_TIMEOUT;
+#endif
+}
+
 static bool pd_task_loop(int port)
 {
 	/* wait for next event/packet or timeout expiration */
 	const uint32_t evt =
 		task_wait_event(paused[port]
 					? -1
-					: USBC_EVENT_TIMEOUT);
+					: pd_task_timeout(port));
+
+	wakeups[port]++;
+#ifdef CONFIG_USB_PD_TICKLESS
+	/*
+	 * Timers which expire while the state machines run are picked up by
+	 * the next iteration, so take the reference time before running them.
+	 */
+	last_run[port] = get_time().val;
+#endif
 
 	/*
 	 * Re-use TASK_EVENT_RESET_DONE in tests to restart the USB task
@@ -33,11 +33,18 @@ struct vboot_hash_tag {
 #define VBOOT_HASH_SYSJUMP_TAG 0x5648 /* "VH" */
 #define VBOOT_HASH_SYSJUMP_VERSION 1
 
-#define CHUNK_SIZE 1024       /* Bytes to hash per deferred call */
+#if !defined(CONFIG_MAPPED_STORAGE) && defined(CONFIG_FLASH_READ_ASYNC)
+/* Read the next chunk while hashing the current one */
+#define CHUNK_BUFS 2
+#else
+#define CHUNK_BUFS 1
+#endif
+
+#define CHUNK_SIZE (1024 / CHUNK_BUFS) /* Bytes to read and hash at a time */
 #define WORK_INTERVAL_US 100  /* Delay between deferred calls */
 
-/* Check that CHUNK_SIZE fits in shared memory. */
-SHARED_MEM_CHECK_SIZE(CHUNK_SIZE);
+/* Check that the chunk buffers fit in shared memory. */
+SHARED_MEM_CHECK_SIZE(CHUNK_BUFS * CHUNK_SIZE);
 
 static uint32_t data_offset;
 static uint32_t data_size;
@@ -45,6 +52,8 @@ static uint32_t curr_pos;
 static const uint8_t *hash;   /* Hash, or NULL if not valid */
 static int want_abort;
 static int in_progress;
+static timestamp_t hash_start_time;
+static uint32_t hash_time_us;
 #define VBOOT_HASH_DEFERRED	true
 #define VBOOT_HASH_BLOCKING	false
 
@@ -73,80 +82,161 @@ void vboot_hash_abort(void)
 static void vboot_hash_next_chunk(void);
 DECLARE_DEFERRED(vboot_hash_next_chunk);
 
-#ifndef CONFIG_MAPPED_STORAGE
+#ifdef CONFIG_CONSOLE_VERBOSE
+#define SHA256_PRINT_SIZE SHA256_DIGEST_SIZE
+#else
+#define SHA256_PRINT_SIZE 4
+#endif
 
-static int read_and_hash_chunk(int offset, int size)
+#ifdef CONFIG_MAPPED_STORAGE
+
+/*
+ * Hash chunks from curr_pos on, until the data is done or the deadline
+ * has passed.
+ */
+static int hash_slice(timestamp_t deadline)
 {
-	char *buf;
-	int rv;
+	int size;
 
-	if (size == 0)
-		return EC_SUCCESS;
+	flash_lock_mapped_storage(1);
+	do {
+		size = MIN(CHUNK_SIZE, data_size - curr_pos);
+		SHA256_update(&ctx, (const uint8_t *)(CONFIG_MAPPED_STORAGE_BASE +
+						      data_offset + curr_pos),
+			      size);
+		curr_pos += size;
+	} while (curr_pos < data_size && !timestamp_expired(deadline, NULL));
+	flash_lock_mapped_storage(0);
+
+	return EC_SUCCESS;
+}
+
+#else
+
+/*
+ * Get the chunk buffers. If someone else holds shared memory, try again
+ * later.
+ */
+static int acquire_chunk_bufs(char **buf)
+{
+	int rv = shared_mem_acquire(CHUNK_BUFS * CHUNK_SIZE, buf);
 
-	rv = shared_mem_acquire(size, &buf);
-	if (rv == EC_ERROR_BUSY) {
-		/* Couldn't update hash right now; try again later */
+	if (rv == EC_ERROR_BUSY)
 		hook_call_deferred(&vboot_hash_next_chunk_data,
 				   WORK_INTERVAL_US);
-		return rv;
-	} else if (rv != EC_SUCCESS) {
+	else if (rv != EC_SUCCESS)
 		vboot_hash_abort();
+	return rv;
+}
+
+#ifdef CONFIG_FLASH_READ_ASYNC
+
+/*
+ * Same as above, reading from flash in the background: the next chunk is on
+ * its way to one buffer while the other one is hashed. No read is started
+ * once the deadline has passed, so nothing is left in flight when the slice
+ * ends.
+ */
+static int hash_slice(timestamp_t deadline)
+{
+	char *buf;
+	int cur = 0, size, next_size, rv;
+
+	rv = acquire_chunk_bufs(&buf);
+	if (rv != EC_SUCCESS)
 		return rv;
+
+	size = MIN(CHUNK_SIZE, data_size - curr_pos);
+	rv = flash_physical_read_async(data_offset + curr_pos, size, buf);
+	while (rv == EC_SUCCESS) {
+		rv = flash_physical_read_flush();
+		if (rv != EC_SUCCESS)
+			break;
+
+		next_size = MIN(CHUNK_SIZE, data_size - curr_pos - size);
+		if (want_abort || timestamp_expired(deadline, NULL))
+			next_size = 0;
+		if (next_size)
+			rv = flash_physical_read_async(
+				data_offset + curr_pos + size, next_size,
+				buf + (cur ^ 1) * CHUNK_SIZE);
+
+		SHA256_update(&ctx, (const uint8_t *)buf + cur * CHUNK_SIZE,
+			      size);
+		curr_pos += size;
+
+		if (!next_size)
+			break;
+		cur ^= 1;
+		size = next_size;
 	}
 
-	rv = flash_read(offset, size, buf);
-	if (rv == EC_SUCCESS)
-		SHA256_update(&ctx, (const uint8_t *)buf, size);
-	else
+	if (rv != EC_SUCCESS)
 		vboot_hash_abort();
 
 	shared_mem_release(buf);
 	return rv;
 }
 
-#endif
-
-#ifdef CONFIG_CONSOLE_VERBOSE
-#define SHA256_PRINT_SIZE SHA256_DIGEST_SIZE
 #else
-#define SHA256_PRINT_SIZE 4
-#endif
 
-static void hash_next_chunk(size_t size)
+static int hash_slice(timestamp_t deadline)
 {
-#ifdef CONFIG_MAPPED_STORAGE
-	flash_lock_mapped_storage(1);
-	SHA256_update(&ctx, (const uint8_t *)(CONFIG_MAPPED_STORAGE_BASE +
-					      data_offset + curr_pos), size);
-	flash_lock_mapped_storage(0);
-#else
-	if (read_and_hash_chunk(data_offset + curr_pos, size) != EC_SUCCESS)
-		return;
-#endif
-}
+	char *buf;
+	int size, rv;
+
+	rv = acquire_chunk_bufs(&buf);
+	if (rv != EC_SUCCESS)
+		return rv;
 
-static void vboot_hash_all_chunks(void)
-{
 	do {
-		size_t size = MIN(CHUNK_SIZE, data_size - curr_pos);
-		hash_next_chunk(size);
+		size = MIN(CHUNK_SIZE, data_size - curr_pos);
+		rv = flash_read(data_offset + curr_pos, size, buf);
+		if (rv != EC_SUCCESS) {
+			vboot_hash_abort();
+			break;
+		}
+		SHA256_update(&ctx, (const uint8_t *)buf, size);
 		curr_pos += size;
-	} while (curr_pos < data_size);
+	} while (curr_pos < data_size && !timestamp_expired(deadline, NULL));
+
+	shared_mem_release(buf);
+	return rv;
+}
+
+#endif /* CONFIG_FLASH_READ_ASYNC */
+#endif /* CONFIG_MAPPED_STORAGE */
 
+/* Store the final hash */
+static void vboot_hash_done(void)
+{
 	hash = SHA256_final(&ctx);
-	CPRINTS("hash done %ph", HEX_BUF(hash, SHA256_PRINT_SIZE));
+	hash_time_us = get_time().val - hash_start_time.val;
+	CPRINTS("hash done %ph in %d us", HEX_BUF(hash, SHA256_PRINT_SIZE),
+		hash_time_us);
+
 	in_progress = 0;
+
 	clock_enable_module(MODULE_FAST_CPU, 0);
+}
 
-	return;
+static void vboot_hash_all_chunks(void)
+{
+	const timestamp_t forever = { .val = UINT64_MAX };
+
+	while (curr_pos < data_size)
+		if (hash_slice(forever) != EC_SUCCESS)
+			return;
+
+	vboot_hash_done();
 }
 
 /**
- * Do next chunk of hashing work, if any.
+ * Do next slice of hashing work, if any.
  */
 static void vboot_hash_next_chunk(void)
 {
-	int size;
+	timestamp_t deadline;
 
 	/* Handle abort */
 	if (want_abort) {
@@ -156,19 +246,13 @@ static void vboot_hash_next_chunk(void)
 		return;
 	}
 
-	/* Compute the next chunk of hash */
-	size = MIN(CHUNK_SIZE, data_size - curr_pos);
-	hash_next_chunk(size);
+	/* Hash for up to CONFIG_VBOOT_HASH_SLICE_US */
+	deadline.val = get_time().val + CONFIG_VBOOT_HASH_SLICE_US;
+	if (curr_pos < data_size && hash_slice(deadline) != EC_SUCCESS)
+		return;
 
-	curr_pos += size;
 	if (curr_pos >= data_size) {
-		/* Store the final hash */
-		hash = SHA256_final(&ctx);
-		CPRINTS("hash done %ph", HEX_BUF(hash, SHA256_PRINT_SIZE));
-
-		in_progress = 0;
-
-		clock_enable_module(MODULE_FAST_CPU, 0);
+		vboot_hash_done();
 
 		/* Handle receiving abort during finalize */
 		if (want_abort)
@@ -221,6 +305,7 @@ static int vboot_hash_start(uint32_t offset, uint32_t size,
 	hash = NULL;
 	want_abort = 0;
 	in_progress = 1;
+	hash_start_time = get_time();
 
 	/* Restart the hash computation */
 	CPRINTS("hash start 0x%08x 0x%08x", offset, size);
@@ -380,6 +465,8 @@ static int command_hash(int argc, char **argv)
 			ccprintf("%ph\n", HEX_BUF(hash, SHA256_DIGEST_SIZE));
 		else
 			ccprintf("(invalid)\n");
+		if (hash && hash_time_us)
+			ccprintf("Time:   %d us\n", hash_time_us);
 
 		return EC_SUCCESS;
 	}
@@ -16,6 +16,7 @@
 #include "math_util.h"
 #include "motion_sense_fifo.h"
 #include "spi.h"
+#include "task.h"
 
 #define CPUTS(outstr) cputs(CC_ACCEL, outstr)
 #define CPRINTF(format, args...) cprintf(CC_ACCEL, format, ## args)
@@ -387,7 +388,9 @@ int bmi_decode_header(struct motion_sensor_t *accel,
 {
 	if ((hdr & BMI_FH_MODE_MASK) == BMI_FH_EMPTY &&
 			(hdr & BMI_FH_PARM_MASK) != 0) {
-		int i, size = 0;
+		struct ec_response_motion_sensor_data
+			vector[MOTIONSENSE_TYPE_MAG + 1];
+		int i, n = 0, size = 0;
 		/* Check if there is enough space for the data frame */
 		for (i = MOTIONSENSE_TYPE_MAG; i >= MOTIONSENSE_TYPE_ACCEL;
 		     i--) {
@@ -404,24 +407,24 @@ int bmi_decode_header(struct motion_sensor_t *accel,
 			struct motion_sensor_t *s = accel + i;
 
 			if (hdr & (1 << (i + BMI_FH_PARM_OFFSET))) {
-				struct ec_response_motion_sensor_data vector;
 				int *v = s->raw_xyz;
 
-				vector.flags = 0;
+				vector[n].flags = 0;
 				bmi_normalize(s, v, *bp);
 				if (IS_ENABLED(CONFIG_ACCEL_SPOOF_MODE) &&
 					s->flags &
 					MOTIONSENSE_FLAG_IN_SPOOF_MODE)
 					v = s->spoof_xyz;
-				vector.data[X] = v[X];
-				vector.data[Y] = v[Y];
-				vector.data[Z] = v[Z];
-				vector.sensor_num = s - motion_sensors;
-				motion_sense_fifo_stage_data(&vector, s, 3,
-						last_ts);
+				vector[n].data[X] = v[X];
+				vector[n].data[Y] = v[Y];
+				vector[n].data[Z] = v[Z];
+				vector[n].sensor_num = s - motion_sensors;
+				n++;
 				*bp += (i == MOTIONSENSE_TYPE_MAG ? 8 : 6);
 			}
 		}
+		/* Stage all the samples of the frame at once */
+		motion_sense_fifo_stage_batch(vector, n, 3, last_ts);
 
 		return 1;
 	} else {
@@ -437,82 +440,23 @@ enum fifo_state {
 };
 
 #define BMI_FIFO_BUFFER 64
-static uint8_t bmi_buffer[BMI_FIFO_BUFFER];
+#ifdef CONFIG_I2C_ASYNC
+/* One buffer on the bus while the other one is decoded. */
+static uint8_t bmi_buffer[2][BMI_FIFO_BUFFER];
+#else
+static uint8_t bmi_buffer[1][BMI_FIFO_BUFFER];
+#endif
 
-int bmi_load_fifo(struct motion_sensor_t *s, uint32_t last_ts)
+/*
+ * Decode a block read from the FIFO. A frame cut at the end of the block is
+ * sent again by the sensor on the next read.
+ */
+static int bmi_decode_fifo(struct motion_sensor_t *s, uint32_t last_ts,
+			   uint8_t *buffer, int length)
 {
-	struct bmi_drv_data_t *data = BMI_GET_DATA(s);
-	uint16_t length;
 	enum fifo_state state = FIFO_HEADER;
-	uint8_t *bp = bmi_buffer;
-	uint8_t *ep;
-	uint32_t beginning;
-
-
-	if (s->type != MOTIONSENSE_TYPE_ACCEL)
-		return EC_SUCCESS;
-
-	if (!(data->flags &
-	     (BMI_FIFO_ALL_MASK << BMI_FIFO_FLAG_OFFSET))) {
-		/*
-		 * The FIFO was disabled while we were processing it.
-		 *
-		 * Flush potential left over:
-		 * When sensor is resumed, we won't read old data.
-		 */
-		bmi_write8(s->port, s->i2c_spi_addr_flags,
-			   BMI_CMD_REG(V(s)), BMI_CMD_FIFO_FLUSH);
-		return EC_SUCCESS;
-	}
-
-	bmi_read_n(s->port, s->i2c_spi_addr_flags,
-		   BMI_FIFO_LENGTH_0(V(s)),
-		   (uint8_t *)&length, sizeof(length));
-	length &= BMI_FIFO_LENGTH_MASK(V(s));
-
-	/*
-	 * We have not requested timestamp, no extra frame to read.
-	 * if we have too much to read, read the whole buffer.
-	 */
-	if (length == 0) {
-		/*
-		 * Disable this message on BMI260, due to this seems to always
-		 * happen after we complete to read the data.
-		 * TODO(chingkang): check why this happen on BMI260.
-		 */
-		if (V(s) == 0)
-			CPRINTS("unexpected empty FIFO");
-		return EC_SUCCESS;
-	}
-
-	/* Add one byte to get an empty FIFO frame.*/
-	length++;
-
-	if (length > sizeof(bmi_buffer))
-		CPRINTS("unexpected large FIFO: %d", length);
-	length = MIN(length, sizeof(bmi_buffer));
-
-	bmi_read_n(s->port, s->i2c_spi_addr_flags,
-		   BMI_FIFO_DATA(V(s)), bmi_buffer, length);
-	beginning = *(uint32_t *)bmi_buffer;
-	ep = bmi_buffer + length;
-	/*
-	 * FIFO is invalid when reading while the sensors are all
-	 * suspended.
-	 * Instead of returning the empty frame, it can return a
-	 * pattern that looks like a valid header: 84 or 40.
-	 * If we see those, assume the sensors have been disabled
-	 * while this thread was running.
-	 */
-	if (beginning == 0x84848484 ||
-			(beginning & 0xdcdcdcdc) == 0x40404040) {
-		CPRINTS("Suspended FIFO: accel ODR/rate: %d/%d: 0x%08x",
-				BASE_ODR(s->config[SENSOR_CONFIG_AP].odr),
-				BMI_GET_SAVED_DATA(s)->odr,
-				beginning);
-		return EC_SUCCESS;
-	}
-
+	uint8_t *bp = buffer;
+	uint8_t *ep = buffer + length;
 
 	while (bp < ep) {
 		switch (state) {
@@ -537,7 +481,7 @@ int bmi_load_fifo(struct motion_sensor_t *s, uint32_t last_ts)
 				break;
 			default:
 				CPRINTS("Unknown header: 0x%02x @ %zd",
-						hdr, bp - bmi_buffer);
+						hdr, bp - buffer);
 				bmi_write8(s->port, s->i2c_spi_addr_flags,
 						BMI_CMD_REG(V(s)),
 						BMI_CMD_FIFO_FLUSH);
@@ -547,13 +491,13 @@ int bmi_load_fifo(struct motion_sensor_t *s, uint32_t last_ts)
 		}
 		case FIFO_DATA_SKIP:
 			CPRINTS("@ %zd - %d, skipped %d frames",
-					bp - bmi_buffer, length, *bp);
+					bp - buffer, length, *bp);
 			bp++;
 			state = FIFO_HEADER;
 			break;
 		case FIFO_DATA_CONFIG:
 			CPRINTS("@ %zd - %d, config change: 0x%02x",
-					bp - bmi_buffer, length, *bp);
+					bp - buffer, length, *bp);
 			bp++;
 			if (V(s))
 				state = FIFO_DATA_TIME;
@@ -580,6 +524,157 @@ int bmi_load_fifo(struct motion_sensor_t *s, uint32_t last_ts)
 	return EC_SUCCESS;
 }
 
+/*
+ * FIFO is invalid when reading while the sensors are all suspended.
+ * Instead of returning the empty frame, it can return a pattern that looks
+ * like a valid header: 84 or 40.
+ * If we see those, assume the sensors have been disabled while this thread
+ * was running.
+ */
+static bool bmi_fifo_suspended(struct motion_sensor_t *s,
+			       const uint8_t *buffer)
+{
+	uint32_t beginning = *(uint32_t *)buffer;
+
+	if (beginning == 0x84848484 ||
+			(beginning & 0xdcdcdcdc) == 0x40404040) {
+		CPRINTS("Suspended FIFO: accel ODR/rate: %d/%d: 0x%08x",
+				BASE_ODR(s->config[SENSOR_CONFIG_AP].odr),
+				BMI_GET_SAVED_DATA(s)->odr,
+				beginning);
+		return true;
+	}
+	return false;
+}
+
+#ifdef CONFIG_I2C_ASYNC
+static struct i2c_async_xfer bmi_fifo_xfer[2];
+static uint8_t bmi_fifo_reg;
+
+static int bmi_fifo_read_async(struct motion_sensor_t *s, int i, int len)
+{
+	struct i2c_async_xfer *xfer = &bmi_fifo_xfer[i];
+
+	xfer->port = s->port;
+	xfer->slave_addr_flags = s->i2c_spi_addr_flags;
+	xfer->out = &bmi_fifo_reg;
+	xfer->out_size = 1;
+	xfer->in = bmi_buffer[i];
+	xfer->in_size = len;
+	xfer->task = task_get_current();
+	xfer->event = TASK_EVENT_MOTION_BUS_DONE;
+	return i2c_xfer_async(xfer);
+}
+
+/*
+ * Read the whole FIFO in blocks of BMI_FIFO_BUFFER: the next block is on the
+ * bus while the current one is decoded.
+ */
+static int bmi_load_fifo_async(struct motion_sensor_t *s, uint32_t last_ts,
+			       int length)
+{
+	int i = 0, len, next_len, rv;
+	bool first = true, stop;
+
+	bmi_fifo_reg = BMI_FIFO_DATA(V(s));
+	len = MIN(length, BMI_FIFO_BUFFER);
+	length -= len;
+	rv = bmi_fifo_read_async(s, i, len);
+	if (rv != EC_SUCCESS)
+		return rv;
+
+	for (;;) {
+		rv = i2c_xfer_async_wait(&bmi_fifo_xfer[i], -1);
+		if (rv != EC_SUCCESS)
+			return rv;
+
+		next_len = MIN(length, BMI_FIFO_BUFFER);
+		length -= next_len;
+		if (next_len && bmi_fifo_read_async(s, !i, next_len))
+			next_len = 0;
+
+		if (first && bmi_fifo_suspended(s, bmi_buffer[i])) {
+			stop = true;
+		} else {
+			rv = bmi_decode_fifo(s, last_ts, bmi_buffer[i], len);
+			stop = rv != EC_SUCCESS;
+		}
+
+		if (!next_len)
+			return rv;
+		if (stop) {
+			/* The block in flight still owns its buffer. */
+			i2c_xfer_async_wait(&bmi_fifo_xfer[!i], -1);
+			return rv;
+		}
+		i = !i;
+		len = next_len;
+		first = false;
+	}
+}
+#endif /* CONFIG_I2C_ASYNC */
+
+int bmi_load_fifo(struct motion_sensor_t *s, uint32_t last_ts)
+{
+	struct bmi_drv_data_t *data = BMI_GET_DATA(s);
+	uint16_t length;
+
+	if (s->type != MOTIONSENSE_TYPE_ACCEL)
+		return EC_SUCCESS;
+
+	if (!(data->flags &
+	     (BMI_FIFO_ALL_MASK << BMI_FIFO_FLAG_OFFSET))) {
+		/*
+		 * The FIFO was disabled while we were processing it.
+		 *
+		 * Flush potential left over:
+		 * When sensor is resumed, we won't read old data.
+		 */
+		bmi_write8(s->port, s->i2c_spi_addr_flags,
+			   BMI_CMD_REG(V(s)), BMI_CMD_FIFO_FLUSH);
+		return EC_SUCCESS;
+	}
+
+	bmi_read_n(s->port, s->i2c_spi_addr_flags,
+		   BMI_FIFO_LENGTH_0(V(s)),
+		   (uint8_t *)&length, sizeof(length));
+	length &= BMI_FIFO_LENGTH_MASK(V(s));
+
+	/*
+	 * We have not requested timestamp, no extra frame to read.
+	 * if we have too much to read, read the whole buffer.
+	 */
+	if (length == 0) {
+		/*
+		 * Disable this message on BMI260, due to this seems to always
+		 * happen after we complete to read the data.
+		 * TODO(chingkang): check why this happen on BMI260.
+		 */
+		if (V(s) == 0)
+			CPRINTS("unexpected empty FIFO");
+		return EC_SUCCESS;
+	}
+
+	/* Add one byte to get an empty FIFO frame.*/
+	length++;
+
+#ifdef CONFIG_I2C_ASYNC
+	if (!SLAVE_IS_SPI(s->i2c_spi_addr_flags))
+		return bmi_load_fifo_async(s, last_ts, length);
+#endif
+
+	if (length > sizeof(bmi_buffer[0]))
+		CPRINTS("unexpected large FIFO: %d", length);
+	length = MIN(length, sizeof(bmi_buffer[0]));
+
+	bmi_read_n(s->port, s->i2c_spi_addr_flags,
+		   BMI_FIFO_DATA(V(s)), bmi_buffer[0], length);
+	if (bmi_fifo_suspended(s, bmi_buffer[0]))
+		return EC_SUCCESS;
+
+	return bmi_decode_fifo(s, last_ts, bmi_buffer[0], length);
+}
+
 int bmi_set_range(const struct motion_sensor_t *s, int range, int rnd)
 {
 	int ret, range_tbl_size;
@@ -162,32 +162,35 @@ out_unlock:
 	return ret;
 }
 
-static void __maybe_unused icm426xx_push_fifo_data(struct motion_sensor_t *s,
-						const uint8_t *raw, uint32_t ts)
+/* Return 1 when vect has been filled, 0 when the sample is not valid */
+static int __maybe_unused icm426xx_decode_fifo_data(
+	struct motion_sensor_t *s, const uint8_t *raw,
+	struct ec_response_motion_sensor_data *vect)
 {
 	intv3_t v;
-	struct ec_response_motion_sensor_data vect;
 	int ret;
 
 	if (s == NULL)
-		return;
+		return 0;
 
 	ret = icm426xx_normalize(s, v, raw);
-	if (ret == EC_SUCCESS) {
-		vect.data[X] = v[X];
-		vect.data[Y] = v[Y];
-		vect.data[Z] = v[Z];
-		vect.flags = 0;
-		vect.sensor_num = s - motion_sensors;
-		motion_sense_fifo_stage_data(&vect, s, 3, ts);
-	}
+	if (ret != EC_SUCCESS)
+		return 0;
+
+	vect->data[X] = v[X];
+	vect->data[Y] = v[Y];
+	vect->data[Z] = v[Z];
+	vect->flags = 0;
+	vect->sensor_num = s - motion_sensors;
+	return 1;
 }
 
 static int __maybe_unused icm426xx_load_fifo(struct motion_sensor_t *s,
 					     uint32_t ts)
 {
 	struct icm_drv_data_t *st = ICM_GET_DATA(s);
-	int count, i, size;
+	struct ec_response_motion_sensor_data vect[8];
+	int count, i, n = 0, size = 0;
 	const uint8_t *accel, *gyro;
 	int ret;
 
@@ -217,14 +220,22 @@ static int __maybe_unused icm426xx_load_fifo(struct motion_sensor_t *s,
 				&accel, &gyro);
 		/* exit if error or FIFO is empty */
 		if (size <= 0)
-			return -size;
+			break;
 		if (accel != NULL)
-			icm426xx_push_fifo_data(st->accel, accel, ts);
+			n += icm426xx_decode_fifo_data(st->accel, accel,
+						       &vect[n]);
 		if (gyro != NULL)
-			icm426xx_push_fifo_data(st->gyro, gyro, ts);
+			n += icm426xx_decode_fifo_data(st->gyro, gyro,
+						       &vect[n]);
+		/* Keep room for the 2 samples of the next packet */
+		if (n > ARRAY_SIZE(vect) - 2) {
+			motion_sense_fifo_stage_batch(vect, n, 3, ts);
+			n = 0;
+		}
 	}
+	motion_sense_fifo_stage_batch(vect, n, 3, ts);
 
-	return EC_SUCCESS;
+	return size < 0 ? -size : EC_SUCCESS;
 }
 
 #ifdef CONFIG_ACCEL_INTERRUPTS
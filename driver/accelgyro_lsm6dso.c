@@ -106,12 +106,13 @@ static int fifo_enable(const struct motion_sensor_t *s)
 }
 
 /**
- * push_fifo_data - Scan data pattern and push upside
+ * decode_fifo_data - Scan data pattern and convert it to a sample
+ *
+ * Return 1 when vect has been filled, 0 when the sample is discarded.
  */
-static void push_fifo_data(struct motion_sensor_t *main_s, uint8_t *fifo,
-			   uint32_t saved_ts)
+static int decode_fifo_data(struct motion_sensor_t *main_s, uint8_t *fifo,
+			    struct ec_response_motion_sensor_data *vect)
 {
-	struct ec_response_motion_sensor_data vect;
 	struct motion_sensor_t *sensor;
 	uint8_t tag;
 	int id;
@@ -140,7 +141,7 @@ static void push_fifo_data(struct motion_sensor_t *main_s, uint8_t *fifo,
 	/* Discard samples every ODR changes. */
 	if (samples_to_discard[id] > 0) {
 		samples_to_discard[id]--;
-		return;
+		return 0;
 	}
 
 	sensor = main_s + id;
@@ -148,13 +149,13 @@ static void push_fifo_data(struct motion_sensor_t *main_s, uint8_t *fifo,
 
 	/* Apply precision, sensitivity and rotation. */
 	st_normalize(sensor, axis, ptr);
-	vect.data[X] = axis[X];
-	vect.data[Y] = axis[Y];
-	vect.data[Z] = axis[Z];
+	vect->data[X] = axis[X];
+	vect->data[Y] = axis[Y];
+	vect->data[Z] = axis[Z];
 
-	vect.flags = 0;
-	vect.sensor_num = sensor - motion_sensors;
-	motion_sense_fifo_stage_data(&vect, sensor, 3, saved_ts);
+	vect->flags = 0;
+	vect->sensor_num = sensor - motion_sensors;
+	return 1;
 }
 
 static inline int load_fifo(struct motion_sensor_t *s,
@@ -162,7 +163,8 @@ static inline int load_fifo(struct motion_sensor_t *s,
 			    uint32_t saved_ts)
 {
 	uint8_t fifo[FIFO_READ_LEN], *ptr;
-	int i, err, read_len = 0, word_len, fifo_len;
+	struct ec_response_motion_sensor_data vect[8];
+	int i, n = 0, err, read_len = 0, word_len, fifo_len;
 	uint16_t fifo_depth;
 
 	fifo_depth = fsts->len & LSM6DSO_FIFO_DIFF_MASK;
@@ -172,15 +174,24 @@ static inline int load_fifo(struct motion_sensor_t *s,
 		err = st_raw_read_n_noinc(s->port, s->i2c_spi_addr_flags,
 					  LSM6DSO_FIFO_DATA_ADDR_TAG,
 					  fifo, word_len);
-		if (err != EC_SUCCESS)
+		if (err != EC_SUCCESS) {
+			motion_sense_fifo_stage_batch(vect, n, 3, saved_ts);
 			return err;
+		}
 
 		for (i = 0; i < word_len; i += LSM6DSO_FIFO_SAMPLE_SIZE) {
 			ptr = &fifo[i];
-			push_fifo_data(LSM6DSO_MAIN_SENSOR(s), ptr, saved_ts);
+			n += decode_fifo_data(LSM6DSO_MAIN_SENSOR(s), ptr,
+					      &vect[n]);
+			if (n == ARRAY_SIZE(vect)) {
+				motion_sense_fifo_stage_batch(vect, n, 3,
+							      saved_ts);
+				n = 0;
+			}
 		}
 		read_len += word_len;
 	}
+	motion_sense_fifo_stage_batch(vect, n, 3, saved_ts);
 
 	return read_len;
 }
@@ -10,6 +10,7 @@
 #include "compile_time_macros.h"
 #include "console.h"
 #include "ec_commands.h"
+#include "host_command.h"
 #include "ps8xxx.h"
 #include "task.h"
 #include "tcpci.h"
@@ -120,6 +121,7 @@ int tcpc_addr_write(int port, int i2c_addr, int reg, int val)
 	int rv;
 
 	pd_wait_exit_low_power(port);
+	TCPC_COUNT_I2C_XFER(port, 1);
 
 	if (IS_ENABLED(DEBUG_I2C_FAULT_LAST_WRITE_OP)) {
 		last_write_op[port].addr = i2c_addr;
@@ -140,6 +142,7 @@ int tcpc_addr_write16(int port, int i2c_addr, int reg, int val)
 	int rv;
 
 	pd_wait_exit_low_power(port);
+	TCPC_COUNT_I2C_XFER(port, 1);
 
 	if (IS_ENABLED(DEBUG_I2C_FAULT_LAST_WRITE_OP)) {
 		last_write_op[port].addr = i2c_addr;
@@ -160,6 +163,7 @@ int tcpc_addr_read(int port, int i2c_addr, int reg, int *val)
 	int rv;
 
 	pd_wait_exit_low_power(port);
+	TCPC_COUNT_I2C_XFER(port, 1);
 
 	rv = i2c_read8(tcpc_config[port].i2c_info.port,
 		       i2c_addr, reg, val);
@@ -173,6 +177,7 @@ int tcpc_addr_read16(int port, int i2c_addr, int reg, int *val)
 	int rv;
 
 	pd_wait_exit_low_power(port);
+	TCPC_COUNT_I2C_XFER(port, 1);
 
 	rv = i2c_read16(tcpc_config[port].i2c_info.port,
 			i2c_addr, reg, val);
@@ -186,6 +191,7 @@ int tcpc_read_block(int port, int reg, uint8_t *in, int size)
 	int rv;
 
 	pd_wait_exit_low_power(port);
+	TCPC_COUNT_I2C_XFER(port, 1);
 
 	rv = i2c_read_block(tcpc_config[port].i2c_info.port,
 			    tcpc_config[port].i2c_info.addr_flags,
@@ -200,6 +206,7 @@ int tcpc_write_block(int port, int reg, const uint8_t *out, int size)
 	int rv;
 
 	pd_wait_exit_low_power(port);
+	TCPC_COUNT_I2C_XFER(port, 1);
 
 	rv = i2c_write_block(tcpc_config[port].i2c_info.port,
 			     tcpc_config[port].i2c_info.addr_flags,
@@ -227,6 +234,8 @@ int tcpc_xfer_unlocked(int port, const uint8_t *out, int out_size,
 	int rv;
 
 	pd_wait_exit_low_power(port);
+	if (flags & I2C_XFER_START)
+		TCPC_COUNT_I2C_XFER(port, 1);
 
 	rv = i2c_xfer_unlocked(tcpc_config[port].i2c_info.port,
 			       tcpc_config[port].i2c_info.addr_flags,
@@ -244,6 +253,7 @@ int tcpc_update8(int port, int reg,
 	const int i2c_addr = tcpc_config[port].i2c_info.addr_flags;
 
 	pd_wait_exit_low_power(port);
+	TCPC_COUNT_I2C_XFER(port, 2);
 
 	if (IS_ENABLED(DEBUG_I2C_FAULT_LAST_WRITE_OP)) {
 		last_write_op[port].addr = i2c_addr;
@@ -267,6 +277,7 @@ int tcpc_update16(int port, int reg,
 	const int i2c_addr = tcpc_config[port].i2c_info.addr_flags;
 
 	pd_wait_exit_low_power(port);
+	TCPC_COUNT_I2C_XFER(port, 2);
 
 	if (IS_ENABLED(DEBUG_I2C_FAULT_LAST_WRITE_OP)) {
 		last_write_op[port].addr = i2c_addr;
@@ -670,12 +681,6 @@ static int tcpm_alert_status(int port, int *alert)
 	return tcpc_read16(port, TCPC_REG_ALERT, alert);
 }
 
-static int tcpm_alert_ext_status(int port, int *alert_ext)
-{
-	/* Read TCPC Extended Alert register */
-	return tcpc_read(port, TCPC_REG_ALERT_EXT, alert_ext);
-}
-
 static int tcpm_ext_status(int port, int *ext_status)
 {
 	/* Read TCPC Extended Status register */
@@ -848,11 +853,15 @@ int tcpci_tcpm_get_message_raw(int port, uint32_t *payload, int *head)
 	return tcpci_rev1_0_tcpm_get_message_raw(port, payload, head);
 }
 
-/* Cache depth needs to be power of 2 */
-/* TODO: Keep track of the high water mark */
-#define CACHE_DEPTH BIT(3)
-#define CACHE_DEPTH_MASK (CACHE_DEPTH - 1)
+#define RX_DEPTH CONFIG_USB_PD_TCPM_RX_DEPTH
+#define RX_DEPTH_MASK (RX_DEPTH - 1)
+BUILD_ASSERT(POWER_OF_TWO(RX_DEPTH));
 
+/*
+ * Single producer, single consumer ring of received messages. Only the alert
+ * handler (producer) moves head and only the PD task (consumer) moves tail,
+ * so neither side needs a lock.
+ */
 struct queue {
 	/*
 	 * Head points to the index of the first empty slot to put a new RX
@@ -864,7 +873,14 @@ struct queue {
 	 * consume. Must be masked before used in lookup.
 	 */
 	uint32_t tail;
-	struct cached_tcpm_message buffer[CACHE_DEPTH];
+	/*
+	 * Statistics, only updated by the producer. The host command resets
+	 * them with interrupts off.
+	 */
+	uint32_t high_water;
+	uint32_t received;
+	uint32_t lost;
+	struct cached_tcpm_message buffer[RX_DEPTH];
 };
 static struct queue cached_messages[CONFIG_USB_PD_PORT_MAX_COUNT];
 
@@ -872,12 +888,24 @@ static struct queue cached_messages[CONFIG_USB_PD_PORT_MAX_COUNT];
 int tcpm_enqueue_message(const int port)
 {
 	int rv;
+	uint32_t pending;
 	struct queue *const q = &cached_messages[port];
 	struct cached_tcpm_message *const head =
-		&q->buffer[q->head & CACHE_DEPTH_MASK];
+		&q->buffer[q->head & RX_DEPTH_MASK];
+
+	pending = q->head - q->tail;
+	if (pending == RX_DEPTH) {
+		struct cached_tcpm_message discard;
 
-	if (q->head - q->tail == CACHE_DEPTH) {
+		/*
+		 * Pull the message off the TCPC anyway so it can keep
+		 * receiving. The TCPC already sent GoodCRC, so the partner
+		 * will not retry: the message is lost.
+		 */
+		q->lost++;
 		CPRINTS("C%d RX EC Buffer full!", port);
+		tcpc_config[port].drv->get_message_raw(port, discard.payload,
+						       &discard.header);
 		return EC_ERROR_OVERFLOW;
 	}
 
@@ -891,6 +919,10 @@ int tcpm_enqueue_message(const int port)
 		return rv;
 	}
 
+	q->received++;
+	if (pending + 1 > q->high_water)
+		q->high_water = pending + 1;
+
 	/* Increment atomically to ensure get_message_raw happens-before */
 	deprecated_atomic_add(&q->head, 1);
 
@@ -912,7 +944,7 @@ int tcpm_dequeue_message(const int port, uint32_t *const payload,
 {
 	struct queue *const q = &cached_messages[port];
 	struct cached_tcpm_message *const tail =
-		&q->buffer[q->tail & CACHE_DEPTH_MASK];
+		&q->buffer[q->tail & RX_DEPTH_MASK];
 
 	if (!tcpm_has_pending_message(port)) {
 		CPRINTS("C%d No message in RX buffer!", port);
@@ -936,6 +968,40 @@ void tcpm_clear_pending_messages(int port)
 	q->tail = q->head;
 }
 
+static enum ec_status hc_typec_rx_stats(struct host_cmd_handler_args *args)
+{
+	const struct ec_params_typec_rx_stats *p = args->params;
+	struct ec_response_typec_rx_stats *r = args->response;
+	struct queue *q;
+
+	if (p->port >= board_get_usb_pd_port_count())
+		return EC_RES_INVALID_PARAM;
+
+	q = &cached_messages[p->port];
+	memset(r, 0, sizeof(*r));
+	r->depth = RX_DEPTH;
+
+	/* The alert handler may enqueue from an interrupt or another task. */
+	interrupt_disable();
+	r->pending = q->head - q->tail;
+	r->high_water = q->high_water;
+	r->received = q->received;
+	r->lost = q->lost;
+
+	if (p->flags & EC_TYPEC_RX_STATS_RESET) {
+		q->high_water = r->pending;
+		q->received = 0;
+		q->lost = 0;
+	}
+	interrupt_enable();
+
+	args->response_size = sizeof(*r);
+
+	return EC_RES_SUCCESS;
+}
+DECLARE_PRIVATE_HOST_COMMAND(EC_CMD_TYPEC_RX_STATS, hc_typec_rx_stats,
+		     EC_VER_MASK(0));
+
 int tcpci_tcpm_transmit(int port, enum tcpm_transmit_type type,
 			uint16_t header, const uint32_t *data)
 {
@@ -1011,29 +1077,73 @@ int tcpci_tcpm_transmit(int port, enum tcpm_transmit_type type,
 			  TCPC_REG_TRANSMIT_SET_WITH_RETRY(type));
 }
 
+/*
+ * Registers from ALERT through ALERT_EXTENDED hold everything the alert handler
+ * needs to decode an alert. TCPCs with TCPC_FLAGS_ALERT_BURST_READ return the
+ * whole block in a single auto-incrementing I2C read.
+ */
+#define TCPCI_ALERT_BLOCK_SIZE (TCPC_REG_ALERT_EXT - TCPC_REG_ALERT + 1)
+
+/*
+ * Reads the Alert register. If snapshot is not NULL, the rest of the alert
+ * register block is read into it with the same I2C transaction.
+ */
+static int tcpci_read_alert(int port, int *alert, uint8_t *snapshot)
+{
+	int rv;
+
+	if (snapshot == NULL)
+		return tcpm_alert_status(port, alert);
+
+	rv = tcpc_read_block(port, TCPC_REG_ALERT, snapshot,
+			     TCPCI_ALERT_BLOCK_SIZE);
+	if (rv == EC_SUCCESS)
+		*alert = UINT16_FROM_BYTE_ARRAY_LE(snapshot, 0);
+
+	return rv;
+}
+
+/*
+ * Reads an 8-bit register of the alert register block, from the burst read
+ * snapshot if there is one.
+ */
+static int tcpci_alert_reg(int port, const uint8_t *snapshot, int reg,
+			   int *val)
+{
+	if (snapshot == NULL)
+		return tcpc_read(port, reg, val);
+
+	*val = snapshot[reg - TCPC_REG_ALERT];
+	return EC_SUCCESS;
+}
+
 /*
  * Returns true if TCPC has reset based on reading mask registers.
  */
-static int register_mask_reset(int port)
+static int register_mask_reset(int port, const uint8_t *snapshot)
 {
 	int mask;
 
 	mask = 0;
-	tcpc_read16(port, TCPC_REG_ALERT_MASK, &mask);
+	if (snapshot)
+		mask = UINT16_FROM_BYTE_ARRAY_LE(snapshot,
+				TCPC_REG_ALERT_MASK - TCPC_REG_ALERT);
+	else
+		tcpc_read16(port, TCPC_REG_ALERT_MASK, &mask);
 	if (mask == TCPC_REG_ALERT_MASK_ALL)
 		return 1;
 
 	mask = 0;
-	tcpc_read(port, TCPC_REG_POWER_STATUS_MASK, &mask);
+	tcpci_alert_reg(port, snapshot, TCPC_REG_POWER_STATUS_MASK, &mask);
 	if (mask == TCPC_REG_POWER_STATUS_MASK_ALL)
 		return 1;
 
 	return 0;
 }
 
-static int tcpci_get_fault(int port, int *fault)
+static int tcpci_get_fault(int port, const uint8_t *snapshot, int *fault)
 {
-	return tcpc_read(port, TCPC_REG_FAULT_STATUS, fault);
+	return tcpci_alert_reg(port, snapshot, TCPC_REG_FAULT_STATUS, fault);
 }
 
 static int tcpci_handle_fault(int port, int fault)
@@ -1076,7 +1186,9 @@ static int tcpci_clear_fault(int port, int fault)
 	return tcpc_write16(port, TCPC_REG_ALERT, TCPC_REG_ALERT_FAULT);
 }
 
-static void tcpci_check_vbus_changed(int port, int alert, uint32_t *pd_event)
+static void tcpci_check_vbus_changed(int port, int alert,
+				     const uint8_t *snapshot,
+				     uint32_t *pd_event)
 {
 	/*
 	 * Check for VBus change
@@ -1087,7 +1199,8 @@ static void tcpci_check_vbus_changed(int port, int alert, uint32_t *pd_event)
 		int ext_status = 0;
 
 		/* Determine if Safe0V was detected */
-		tcpm_ext_status(port, &ext_status);
+		tcpci_alert_reg(port, snapshot, TCPC_REG_EXT_STATUS,
+				&ext_status);
 		if (ext_status & TCPC_REG_EXT_STATUS_SAFE0V)
 			/* Safe0V=1 and Present=0 */
 			tcpc_vbus[port] = BIT(VBUS_SAFE0V);
@@ -1097,7 +1210,8 @@ static void tcpci_check_vbus_changed(int port, int alert, uint32_t *pd_event)
 		int pwr_status = 0;
 
 		/* Determine reason for power status change */
-		tcpci_tcpm_get_power_status(port, &pwr_status);
+		tcpci_alert_reg(port, snapshot, TCPC_REG_POWER_STATUS,
+				&pwr_status);
 		if (pwr_status & TCPC_REG_POWER_STATUS_VBUS_PRES)
 			/* Safe0V=0 and Present=1 */
 			tcpc_vbus[port] = BIT(VBUS_PRESENT);
@@ -1135,28 +1249,62 @@ static void tcpci_check_vbus_changed(int port, int alert, uint32_t *pd_event)
  */
 #define MAX_ALLOW_FAILED_RX_READS 10
 
-void tcpci_tcpc_alert(int port)
+#ifdef CONFIG_CMD_TCPCI_ALERT_STATS
+static struct {
+	uint32_t alerts;
+	uint32_t xfers;
+	uint16_t last;
+	uint16_t max;
+} alert_stats[CONFIG_USB_PD_PORT_MAX_COUNT];
+
+/*
+ * Note that TCPC accesses by other tasks which preempt the alert handler are
+ * counted as part of the alert.
+ */
+static void tcpci_update_alert_stats(int port, uint32_t start)
+{
+	const uint32_t xfers = tcpc_i2c_xfer_count[port] - start;
+
+	alert_stats[port].alerts++;
+	alert_stats[port].xfers += xfers;
+	alert_stats[port].last = xfers;
+	alert_stats[port].max = MAX(alert_stats[port].max, xfers);
+}
+
+int tcpci_get_last_alert_xfers(int port)
 {
+	return alert_stats[port].last;
+}
+#endif /* CONFIG_CMD_TCPCI_ALERT_STATS */
+
+static void tcpci_handle_alert(int port)
+{
+	uint8_t block[TCPCI_ALERT_BLOCK_SIZE];
+	uint8_t *snapshot = NULL;
 	int alert = 0;
 	int alert_ext = 0;
 	int failed_attempts;
+	int rv;
 	uint32_t pd_event = 0;
 
+	if (tcpc_config[port].flags & TCPC_FLAGS_ALERT_BURST_READ)
+		snapshot = block;
+
 	/* Read the Alert register from the TCPC */
-	if (tcpm_alert_status(port, &alert)) {
+	if (tcpci_read_alert(port, &alert, snapshot)) {
 		CPRINTS("C%d: Failed to read alert register", port);
 		return;
 	}
 
 	/* Get Extended Alert register if needed */
 	if (alert & TCPC_REG_ALERT_ALERT_EXT)
-		tcpm_alert_ext_status(port, &alert_ext);
+		tcpci_alert_reg(port, snapshot, TCPC_REG_ALERT_EXT, &alert_ext);
 
 	/* Clear any pending faults */
 	if (alert & TCPC_REG_ALERT_FAULT) {
 		int fault;
 
-		if (tcpci_get_fault(port, &fault) == EC_SUCCESS &&
+		if (tcpci_get_fault(port, snapshot, &fault) == EC_SUCCESS &&
 		    fault != 0 &&
 		    tcpci_handle_fault(port, fault) == EC_SUCCESS &&
 		    tcpci_clear_fault(port, fault) == EC_SUCCESS)
@@ -1173,12 +1321,22 @@ void tcpci_tcpc_alert(int port)
 					   TCPC_TX_COMPLETE_SUCCESS :
 					   TCPC_TX_COMPLETE_FAILED);
 
-	/* Pull all RX messages from TCPC into EC memory */
+	/*
+	 * Pull all RX messages from TCPC into EC memory. With burst reads, the
+	 * Alert register read following each message refreshes the whole
+	 * snapshot, so the status registers decoded below stay consistent
+	 * with the final alert without any further reads.
+	 */
 	failed_attempts = 0;
 	while (alert & TCPC_REG_ALERT_RX_STATUS) {
-		if (tcpm_enqueue_message(port))
+		/*
+		 * A full queue still drains the TCPC, so it is not a failure
+		 * to make progress.
+		 */
+		rv = tcpm_enqueue_message(port);
+		if (rv && rv != EC_ERROR_OVERFLOW)
 			++failed_attempts;
-		if (tcpm_alert_status(port, &alert))
+		if (tcpci_read_alert(port, &alert, snapshot))
 			++failed_attempts;
 
 		/* Ensure we don't loop endlessly */
@@ -1216,8 +1374,18 @@ void tcpci_tcpc_alert(int port)
 			 * is connected to the port. So, get the
 			 * CC line status and only generate a
 			 * PD_EVENT_CC if something is connected.
+			 * A line is open if and only if its CC_STATUS
+			 * field reads open, so the snapshot is enough.
 			 */
-			tcpci_tcpm_get_cc(port, &cc1, &cc2);
+			if (snapshot) {
+				const int status = snapshot[TCPC_REG_CC_STATUS -
+							    TCPC_REG_ALERT];
+
+				cc1 = TCPC_REG_CC_STATUS_CC1(status);
+				cc2 = TCPC_REG_CC_STATUS_CC2(status);
+			} else {
+				tcpci_tcpm_get_cc(port, &cc1, &cc2);
+			}
 			if (cc1 != TYPEC_CC_VOLT_OPEN ||
 			    cc2 != TYPEC_CC_VOLT_OPEN)
 				/* CC status cchanged, wake task */
@@ -1228,7 +1396,7 @@ void tcpci_tcpc_alert(int port)
 		}
 	}
 
-	tcpci_check_vbus_changed(port, alert, &pd_event);
+	tcpci_check_vbus_changed(port, alert, snapshot, &pd_event);
 
 	/* Check for Hard Reset received */
 	if (alert & TCPC_REG_ALERT_RX_HARD_RST) {
@@ -1255,7 +1423,7 @@ void tcpci_tcpc_alert(int port)
 	 * Check registers to see if we can tell that the TCPC has reset. If
 	 * so, perform a tcpc_init.
 	 */
-	if (register_mask_reset(port))
+	if (register_mask_reset(port, snapshot))
 		pd_event |= PD_EVENT_TCPC_RESET;
 
 	/*
@@ -1269,6 +1437,50 @@ void tcpci_tcpc_alert(int port)
 		task_set_event(PD_PORT_TO_TASK_ID(port), pd_event, 0);
 }
 
+void tcpci_tcpc_alert(int port)
+{
+#ifdef CONFIG_CMD_TCPCI_ALERT_STATS
+	const uint32_t start = tcpc_i2c_xfer_count[port];
+
+	tcpci_handle_alert(port);
+	tcpci_update_alert_stats(port, start);
+#else
+	tcpci_handle_alert(port);
+#endif
+}
+
+#ifdef CONFIG_CMD_TCPCI_ALERT_STATS
+static int command_tcpci_alert(int argc, char **argv)
+{
+	int port;
+
+	if (argc > 1) {
+		if (strcasecmp(argv[1], "reset"))
+			return EC_ERROR_PARAM1;
+		memset(alert_stats, 0, sizeof(alert_stats));
+		return EC_SUCCESS;
+	}
+
+	for (port = 0; port < board_get_usb_pd_port_count(); port++) {
+		/* Only ports whose driver relies on tcpci_tcpc_alert() */
+		if (!alert_stats[port].alerts)
+			continue;
+
+		ccprintf("C%d: %s alerts %u, I2C xfers %u (last %u, max %u)\n",
+			 port,
+			 tcpc_config[port].flags & TCPC_FLAGS_ALERT_BURST_READ ?
+			 "burst" : "single", alert_stats[port].alerts,
+			 alert_stats[port].xfers, alert_stats[port].last,
+			 alert_stats[port].max);
+	}
+
+	return EC_SUCCESS;
+}
+DECLARE_CONSOLE_COMMAND(tcpcialert, command_tcpci_alert,
+			"[reset]",
+			"Show I2C transactions per TCPCI alert");
+#endif /* CONFIG_CMD_TCPCI_ALERT_STATS */
+
 /*
  * This call will wake up the TCPC if it is in low power mode upon accessing the
  * i2c bus (but the pd state machine should put it back into low power mode).
@@ -1436,7 +1648,7 @@ int tcpci_tcpm_init(int port)
 	 */
 	tcpci_check_vbus_changed(port,
 		TCPC_REG_ALERT_POWER_STATUS | TCPC_REG_ALERT_EXT_STATUS,
-		NULL);
+		NULL, NULL);
 
 	error = init_alert_mask(port);
 	if (error)
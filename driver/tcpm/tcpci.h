@@ -214,6 +214,10 @@ void tcpci_set_cached_pull(int port, enum tcpc_cc_pull pull);
 enum tcpc_cc_pull tcpci_get_cached_pull(int port);
 
 void tcpci_tcpc_alert(int port);
+#ifdef CONFIG_CMD_TCPCI_ALERT_STATS
+/* Number of I2C transactions the last call to tcpci_tcpc_alert() needed */
+int tcpci_get_last_alert_xfers(int port);
+#endif
 int tcpci_tcpm_init(int port);
 int tcpci_tcpm_get_cc(int port, enum tcpc_cc_voltage_status *cc1,
 	enum tcpc_cc_voltage_status *cc2);
@@ -8,6 +8,7 @@
 #ifndef __CROS_EC_USB_PD_TCPM_TCPM_H
 #define __CROS_EC_USB_PD_TCPM_TCPM_H
 
+#include "atomic.h"
 #include "common.h"
 #include "ec_commands.h"
 #include "gpio.h"
@@ -23,28 +24,44 @@
 
 #ifndef CONFIG_USB_PD_TCPC
 
+#ifdef CONFIG_CMD_TCPCI_ALERT_STATS
+/*
+ * Number of I2C transactions issued to each TCPC, see tcpci_tcpc_alert().
+ * Defined in usb_common.c, as TCPCs are accessed from several tasks.
+ */
+extern uint32_t tcpc_i2c_xfer_count[];
+#define TCPC_COUNT_I2C_XFER(port, n) \
+	deprecated_atomic_add(&tcpc_i2c_xfer_count[port], (n))
+#else
+#define TCPC_COUNT_I2C_XFER(port, n) do { } while (0)
+#endif
+
 /* I2C wrapper functions - get I2C port / slave addr from config struct. */
 #ifndef CONFIG_USB_PD_TCPC_LOW_POWER
 static inline int tcpc_addr_write(int port, int i2c_addr, int reg, int val)
 {
+	TCPC_COUNT_I2C_XFER(port, 1);
 	return i2c_write8(tcpc_config[port].i2c_info.port,
 			  i2c_addr, reg, val);
 }
 
 static inline int tcpc_addr_write16(int port, int i2c_addr, int reg, int val)
 {
+	TCPC_COUNT_I2C_XFER(port, 1);
 	return i2c_write16(tcpc_config[port].i2c_info.port,
 			   i2c_addr, reg, val);
 }
 
 static inline int tcpc_addr_read(int port, int i2c_addr, int reg, int *val)
 {
+	TCPC_COUNT_I2C_XFER(port, 1);
 	return i2c_read8(tcpc_config[port].i2c_info.port,
 			 i2c_addr, reg, val);
 }
 
 static inline int tcpc_addr_read16(int port, int i2c_addr, int reg, int *val)
 {
+	TCPC_COUNT_I2C_XFER(port, 1);
 	return i2c_read16(tcpc_config[port].i2c_info.port,
 			  i2c_addr, reg, val);
 }
@@ -52,6 +69,7 @@ static inline int tcpc_addr_read16(int port, int i2c_addr, int reg, int *val)
 static inline int tcpc_xfer(int port, const uint8_t *out, int out_size,
 			    uint8_t *in, int in_size)
 {
+	TCPC_COUNT_I2C_XFER(port, 1);
 	return i2c_xfer(tcpc_config[port].i2c_info.port,
 			tcpc_config[port].i2c_info.addr_flags,
 			out, out_size, in, in_size);
@@ -60,6 +78,8 @@ static inline int tcpc_xfer(int port, const uint8_t *out, int out_size,
 static inline int tcpc_xfer_unlocked(int port, const uint8_t *out, int out_size,
 			    uint8_t *in, int in_size, int flags)
 {
+	if (flags & I2C_XFER_START)
+		TCPC_COUNT_I2C_XFER(port, 1);
 	return i2c_xfer_unlocked(tcpc_config[port].i2c_info.port,
 				 tcpc_config[port].i2c_info.addr_flags,
 				 out, out_size, in, in_size, flags);
@@ -67,6 +87,7 @@ static inline int tcpc_xfer_unlocked(int port, const uint8_t *out, int out_size,
 
 static inline int tcpc_read_block(int port, int reg, uint8_t *in, int size)
 {
+	TCPC_COUNT_I2C_XFER(port, 1);
 	return i2c_read_block(tcpc_config[port].i2c_info.port,
 			      tcpc_config[port].i2c_info.addr_flags,
 			      reg, in, size);
@@ -75,6 +96,7 @@ static inline int tcpc_read_block(int port, int reg, uint8_t *in, int size)
 static inline int tcpc_write_block(int port, int reg,
 		const uint8_t *out, int size)
 {
+	TCPC_COUNT_I2C_XFER(port, 1);
 	return i2c_write_block(tcpc_config[port].i2c_info.port,
 			       tcpc_config[port].i2c_info.addr_flags,
 			       reg, out, size);
@@ -84,6 +106,7 @@ static inline int tcpc_update8(int port, int reg,
 			       uint8_t mask,
 			       enum mask_update_action action)
 {
+	TCPC_COUNT_I2C_XFER(port, 2);
 	return i2c_update8(tcpc_config[port].i2c_info.port,
 			   tcpc_config[port].i2c_info.addr_flags,
 			   reg, mask, action);
@@ -93,6 +116,7 @@ static inline int tcpc_update16(int port, int reg,
 				uint16_t mask,
 				enum mask_update_action action)
 {
+	TCPC_COUNT_I2C_XFER(port, 2);
 	return i2c_update16(tcpc_config[port].i2c_info.port,
 			    tcpc_config[port].i2c_info.addr_flags,
 			    reg, mask, action);
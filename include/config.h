@@ -53,6 +53,23 @@
 /* The amount of free entries that trigger an interrupt to the AP. */
 #undef CONFIG_ACCEL_FIFO_THRES
 
+/*
+ * Keep committed sensor FIFO entries in a compact encoding instead of an array
+ * of struct ec_response_motion_sensor_data. A timestamp and the sample that
+ * follows it take 7 bytes instead of 16 when the sensor keeps a steady rate,
+ * so the same RAM holds 2-3x more samples. Reads still return the legacy
+ * format.
+ */
+#undef CONFIG_ACCEL_FIFO_COMPACT
+
+/*
+ * With CONFIG_ACCEL_FIFO_COMPACT, the number of entries, taken out of
+ * CONFIG_ACCEL_FIFO_SIZE, used to stage data before it is committed. Staged
+ * data is committed early when this fills up. Must be a power of 2, defaults
+ * to a sixteenth of the fifo.
+ */
+#undef CONFIG_ACCEL_FIFO_COMPACT_STAGE_SIZE
+
 /*
  * Sensors in this mask are in forced mode: they needed to be polled
  * at their data rate frequency.
@@ -200,6 +217,12 @@
 /* The threshold duration to change to off_body */
 #undef CONFIG_BODY_DETECTION_STATIONARY_DURATION
 
+/*
+ * With CONFIG_MOTION_SENSE_DECIM, body_detection only gets one low-passed
+ * sample every CONFIG_BODY_DETECTION_DECIM samples of its sensor.
+ */
+#undef CONFIG_BODY_DETECTION_DECIM
+
 /*
  * Use the old standard reference frame for accelerometers. The old
  * reference frame is:
@@ -1390,6 +1413,11 @@
 #undef  CONFIG_CMD_TASK_RESET
 #undef  CONFIG_CMD_TASKREADY
 #undef  CONFIG_CMD_TCPC_DUMP
+/*
+ * Count I2C transactions issued to each TCPC and report how many the TCPCI
+ * alert handler needs per alert with the 'tcpcialert' console command.
+ */
+#undef  CONFIG_CMD_TCPCI_ALERT_STATS
 #define CONFIG_CMD_TEMP_SENSOR
 #define CONFIG_CMD_TIMERINFO
 #define CONFIG_CMD_TYPEC
@@ -1792,6 +1820,12 @@
  */
 #undef CONFIG_FLASH_PSTATE_LOCKED
 
+/*
+ * The flash driver can run reads in the background, it provides
+ * flash_physical_read_async() and flash_physical_read_flush().
+ */
+#undef CONFIG_FLASH_READ_ASYNC
+
 /*
  * Enable readout protection.
  */
@@ -2042,6 +2076,36 @@
  */
 #undef CONFIG_LID_ANGLE_UPDATE
 
+/*
+ * Update the lid angle as soon as either the base or the lid accelerometer
+ * has a new sample, instead of waiting for both to be read in the same
+ * motion sense loop. Each half keeps a low-pass filtered gravity vector, so
+ * the two sensors can run at a lower or different ODR.
+ */
+#undef CONFIG_LID_ANGLE_STREAMING
+
+/*
+ * Strength of the per half gravity filter when CONFIG_LID_ANGLE_STREAMING is
+ * defined: each new sample moves the filtered vector by 1/2^shift of the
+ * difference. 0 disables filtering.
+ */
+#undef CONFIG_LID_ANGLE_STREAMING_FILTER_SHIFT
+
+/*
+ * With CONFIG_MOTION_SENSE_DECIM, the lid angle is computed from one
+ * low-passed sample every CONFIG_LID_ANGLE_DECIM samples of each sensor.
+ */
+#undef CONFIG_LID_ANGLE_DECIM
+
+/*
+ * Give each consumer of motion sensor samples (AP FIFO, lid angle, body
+ * detection) its own decimated and low-passed stream, so the sensor can run
+ * at the rate of its fastest consumer. The AP FIFO stage low-passes the
+ * samples dropped when the EC runs a sensor faster than the AP asked for.
+ * See the acceldecim console command.
+ */
+#undef CONFIG_MOTION_SENSE_DECIM
+
 /*
  * Defer the (re)configuration of motion sensors after the suspend event or
  * resume event.  Sensor power rails may be powered up or down asynchronously
@@ -2229,6 +2293,19 @@
 /* Enable the software routine for CRC computation */
 #undef CONFIG_SW_CRC
 
+/*
+ * Bytes the software CRC-32 folds per step: 1 (1 KiB table), 4 or 8
+ * (slicing-by-4/8, 4 or 8 KiB of tables, about 2x and 4x faster).
+ * Defaults to 1 if not defined.
+ */
+#undef CONFIG_SW_CRC_SLICE
+
+/*
+ * Let the software CRC-32 hand large aligned buffers to the chip DMA CRC
+ * engine, see crc32_dma_hash().
+ */
+#undef CONFIG_DMA_CRC
+
 /*****************************************************************************/
 
 /* Enable system hibernate */
@@ -2336,6 +2413,29 @@
  */
 #undef CONFIG_I2C_MASTER
 
+/*
+ * Asynchronous I2C transactions, see i2c_xfer_async(). Transactions are queued
+ * per port and run by the I2C_ASYNC task, which the board adds to its
+ * ec.tasklist at a higher priority than the tasks submitting them:
+ *
+ *   TASK_ALWAYS(I2C_ASYNC, i2c_async_task, NULL, TASK_STACK_SIZE)
+ */
+#undef CONFIG_I2C_ASYNC
+
+/*
+ * Profile I2C traffic: per port bus busy time, lock wait time and recoveries,
+ * and per slave transaction, byte, busy time, error and retry counts, since
+ * boot or the last reset of the sampling window. See the i2cprof console
+ * command and EC_CMD_I2C_PROFILE.
+ */
+#undef CONFIG_I2C_PROFILE
+
+/*
+ * Number of slaves, over all ports, the profiler keeps counters for. Traffic
+ * to slaves past that is only counted per port.
+ */
+#undef CONFIG_I2C_PROFILE_SLAVES
+
 /* EC uses an I2C slave interface */
 #undef CONFIG_I2C_SLAVE
 
@@ -3015,6 +3115,28 @@
  */
 #undef CONFIG_MKBP_EVENT_WAKEUP_MASK
 
+/*
+ * Coalesce MKBP interrupts to the AP.  Instead of raising the interrupt for
+ * every event, wait until CONFIG_MKBP_EVENT_COALESCE_WATERMARK events are
+ * queued or CONFIG_MKBP_EVENT_COALESCE_TIMEOUT_US has elapsed since the first
+ * one, whichever comes first.  Events in CONFIG_MKBP_EVENT_COALESCE_IMMEDIATE
+ * (a mask of BIT(EC_MKBP_EVENT_*)) always raise the interrupt right away.
+ * Pairs well with EC_CMD_GET_NEXT_EVENTS on the AP side.
+ */
+#undef CONFIG_MKBP_EVENT_COALESCE
+#define CONFIG_MKBP_EVENT_COALESCE_WATERMARK 4
+#define CONFIG_MKBP_EVENT_COALESCE_TIMEOUT_US (2 * MSEC)
+#define CONFIG_MKBP_EVENT_COALESCE_IMMEDIATE \
+	(BIT(EC_MKBP_EVENT_BUTTON) | BIT(EC_MKBP_EVENT_SWITCH))
+
+/*
+ * Depth of the common MKBP event FIFO (keyboard, buttons and switches).
+ * Defaults to 16, or to 32 with CONFIG_MKBP_EVENT_COALESCE: a 256 byte
+ * EC_CMD_GET_NEXT_EVENTS response holds 13 key records, so events can keep
+ * coming while a full batch is being read.
+ */
+#undef CONFIG_MKBP_FIFO_DEPTH
+
 /* Support memory protection unit (MPU) */
 #undef CONFIG_MPU
 
@@ -3283,7 +3405,7 @@
 /* Support verifying 2048-bit RSA signature */
 #undef CONFIG_RSA
 
-/* Define the RSA key size. */
+/* Define the RSA key size: 2048 (default), 3072, 4096 or 8192 bits. */
 #undef CONFIG_RSA_KEY_SIZE
 
 /* Use RSA exponent 3 instead of F4 (65537) */
@@ -3371,6 +3493,12 @@
 /* Unroll some loops in SHA256_transform for better performance. */
 #undef CONFIG_SHA256_UNROLLED
 
+/*
+ * Run the SHA-256 compression function on the chip hash engine, which
+ * provides SHA256_hw_transform().
+ */
+#undef CONFIG_SHA256_HW_ACCELERATE
+
 /* Emulate the CLZ (Count Leading Zeros) in software for CPU lacking support */
 #undef CONFIG_SOFTWARE_CLZ
 
@@ -3926,6 +4054,22 @@
 #define CONFIG_USB_PRL_SM
 #define CONFIG_USB_PE_SM
 
+/*
+ * Let the TCPMv2 PD task sleep until the next state machine timer expires
+ * instead of waking every 5ms, once the TypeC, Protocol and Policy Engine
+ * layers have settled in states that only wait on events and timers (e.g. an
+ * explicit contract in PE_SRC_READY/PE_SNK_READY). States which poll the TCPC
+ * still run at the regular interval. Only supported with
+ * CONFIG_USB_DRP_ACC_TRYSRC.
+ */
+#undef CONFIG_USB_PD_TICKLESS
+
+/*
+ * Upper bound on how long a tickless PD task sleeps without any deadline, as
+ * a safety net for inputs that are only noticed by polling.
+ */
+#define CONFIG_USB_PD_TICKLESS_MAX_SLEEP (100 * MSEC)
+
 /* Enables PD Console commands */
 #define CONFIG_USB_PD_CONSOLE_CMD
 
@@ -4200,6 +4344,14 @@
 /* Enable runtime config the TCPC */
 #undef CONFIG_USB_PD_TCPC_RUNTIME_CONFIG
 
+/*
+ * Number of received PD messages the TCPM can hold per port between the TCPC
+ * alert handler pulling them off the TCPC and the protocol layer consuming
+ * them. Must be a power of two. Chatty partners (docks issuing VDMs, EPR
+ * negotiation) may need more than the default.
+ */
+#define CONFIG_USB_PD_TCPM_RX_DEPTH 8
+
 /*
  * Choose one of the following TCPMs (type-C port manager) to manage TCPC. The
  * TCPM stub is used to make direct function calls to TCPC when TCPC is on
@@ -4702,6 +4854,12 @@
 /* Support computing hash of code for verified boot */
 #undef CONFIG_VBOOT_HASH
 
+/*
+ * CPU time the hash module spends hashing per deferred call, in us, before
+ * it lets other hooks run.
+ */
+#undef CONFIG_VBOOT_HASH_SLICE_US
+
 /* Support for secure temporary storage for verified boot */
 #undef CONFIG_VSTORE
 
@@ -4961,6 +5119,9 @@
 #if defined(CONFIG_USB_PD_TCPMV2) && !defined(CONFIG_USB_PD_DECODE_SOP)
 #error CONFIG_USB_PD_DECODE_SOP must be enabled with the TCPMV2 PD state machine
 #endif
+#if defined(CONFIG_USB_PD_TICKLESS) && !defined(CONFIG_USB_DRP_ACC_TRYSRC)
+#error CONFIG_USB_PD_TICKLESS requires the DRP_ACC_TRYSRC TCPMv2 device type
+#endif
 #endif
 
 /******************************************************************************/
@@ -5701,6 +5862,15 @@
 #define CONFIG_SLEEP_TIMEOUT_MS 10000
 #endif
 
+/* Default depth of the MKBP FIFO, see CONFIG_MKBP_FIFO_DEPTH */
+#ifndef CONFIG_MKBP_FIFO_DEPTH
+#ifdef CONFIG_MKBP_EVENT_COALESCE
+#define CONFIG_MKBP_FIFO_DEPTH 32
+#else
+#define CONFIG_MKBP_FIFO_DEPTH 16
+#endif
+#endif
+
 #ifdef CONFIG_PWM_KBLIGHT
 #define CONFIG_KEYBOARD_BACKLIGHT
 #endif
@@ -5720,11 +5890,42 @@
 
 #endif
 
+#if defined(CONFIG_LID_ANGLE_STREAMING) && \
+	!defined(CONFIG_LID_ANGLE_STREAMING_FILTER_SHIFT)
+#define CONFIG_LID_ANGLE_STREAMING_FILTER_SHIFT 1
+#endif
+
+#if defined(CONFIG_I2C_PROFILE) && !defined(CONFIG_I2C_PROFILE_SLAVES)
+#define CONFIG_I2C_PROFILE_SLAVES 16
+#endif
+
+#if defined(CONFIG_VBOOT_HASH) && !defined(CONFIG_VBOOT_HASH_SLICE_US)
+#define CONFIG_VBOOT_HASH_SLICE_US 1000
+#endif
+
+#if defined(CONFIG_SW_CRC) && !defined(CONFIG_SW_CRC_SLICE)
+#define CONFIG_SW_CRC_SLICE 1
+#endif
+
+#ifdef CONFIG_MOTION_SENSE_DECIM
+#ifndef CONFIG_LID_ANGLE_DECIM
+#define CONFIG_LID_ANGLE_DECIM 1
+#endif
+#ifndef CONFIG_BODY_DETECTION_DECIM
+#define CONFIG_BODY_DETECTION_DECIM 1
+#endif
+#endif
+
 #ifdef CONFIG_ACCEL_FIFO
 #if !defined(CONFIG_ACCEL_FIFO_SIZE) || !defined(CONFIG_ACCEL_FIFO_THRES)
 #error "Using CONFIG_ACCEL_FIFO, must define _SIZE and _THRES"
 #endif
 
+#if defined(CONFIG_ACCEL_FIFO_COMPACT) && \
+	!defined(CONFIG_ACCEL_FIFO_COMPACT_STAGE_SIZE)
+#define CONFIG_ACCEL_FIFO_COMPACT_STAGE_SIZE (CONFIG_ACCEL_FIFO_SIZE / 16)
+#endif
+
 #ifndef CONFIG_TEMP_CACHE_STALE_THRES
 #ifdef CONFIG_ONLINE_CALIB
 /*
@@ -36,6 +36,37 @@ void crc32_ctx_hash8(uint32_t *ctx, uint8_t val);
 
 uint32_t crc32_ctx_result(uint32_t *ctx);
 
+/**
+ * Add a buffer to the CRC.
+ *
+ * Large buffers go through the DMA engine when CONFIG_DMA_CRC is defined.
+ *
+ * @param ctx	CRC context
+ * @param buf	Data, any alignment
+ * @param size	Number of bytes
+ */
+void crc32_ctx_hash(uint32_t *ctx, const void *buf, int size);
+
+/**
+ * CRC-32 of a buffer, same as crc32_ctx_init/hash/result.
+ *
+ * @param buf	Data, any alignment
+ * @param size	Number of bytes
+ * @return	The CRC-32 of buf
+ */
+uint32_t crc32_buf(const void *buf, int size);
+
+/**
+ * Chip hook for CONFIG_DMA_CRC: add words to the CRC with the DMA engine.
+ *
+ * @param ctx	CRC context, only updated on success
+ * @param buf	Data, 4 byte aligned
+ * @param size	Number of bytes, multiple of 4
+ * @return	EC_SUCCESS, or an error code if the engine is not available and
+ *		software should be used instead.
+ */
+int crc32_dma_hash(uint32_t *ctx, const void *buf, int size);
+
 #endif /* CONFIG_HW_CRC */
 
 #endif /* __CROS_EC_CRC_H */
@@ -3782,6 +3782,46 @@ struct ec_response_get_next_event_v1 {
 	union ec_response_get_next_data_v1 data;
 } __ec_align1;
 
+/*
+ * Get as many pending MKBP events as fit in the response, so that the host
+ * can drain a burst of events (e.g. keyboard and sensor FIFO notifications)
+ * with a single round trip instead of one EC_CMD_GET_NEXT_EVENT per event.
+ *
+ * Returns EC_RES_UNAVAILABLE if there is no event pending.
+ *
+ * Not an upstream command: it is a private command, sent as
+ * EC_PRIVATE_HOST_COMMAND_VALUE(EC_CMD_GET_NEXT_EVENTS). Private commands
+ * shared by all boards are numbered down from the top of the range, board
+ * commands up from EC_CMD_BOARD_SPECIFIC_BASE.
+ */
+#define EC_CMD_GET_NEXT_EVENTS 0x01FF
+
+struct ec_params_get_next_events {
+	/* Maximum number of events to return, 0 means as many as fit. */
+	uint8_t max_events;
+} __ec_align1;
+
+/* Header of each event record in ec_response_get_next_events */
+struct ec_mkbp_event_record {
+	uint8_t event_type;
+	/* Number of valid bytes in data */
+	uint8_t size;
+	/* Only 'size' bytes of data are present in the response */
+	union ec_response_get_next_data_v1 data;
+} __ec_align1;
+
+struct ec_response_get_next_events {
+	/* Number of event records that follow */
+	uint8_t count;
+	/* EC_MKBP_HAS_MORE_EVENTS if events remain pending after this one */
+	uint8_t flags;
+	/*
+	 * Followed by 'count' packed records, each made of event_type, size
+	 * and 'size' bytes of data (see struct ec_mkbp_event_record).
+	 */
+	uint8_t records[0];
+} __ec_align1;
+
 /* Bit indices for buttons and switches.*/
 /* Buttons */
 #define EC_MKBP_POWER_BUTTON	0
@@ -6567,6 +6607,75 @@ struct ec_response_typec_status {
 	/* TODO(b/167700356): Add revisions and source cap PDOs */
 } __ec_align1;
 
+/*
+ * Get the statistics of the TCPM receive queue of a port, which holds PD
+ * messages pulled off the TCPC until the protocol layer consumes them.
+ *
+ * Private command, see EC_CMD_GET_NEXT_EVENTS.
+ */
+#define EC_CMD_TYPEC_RX_STATS 0x01FE
+
+/* Clear the counters after reporting them */
+#define EC_TYPEC_RX_STATS_RESET BIT(0)
+
+struct ec_params_typec_rx_stats {
+	uint8_t port;
+	uint8_t flags;		/* EC_TYPEC_RX_STATS_* */
+} __ec_align1;
+
+struct ec_response_typec_rx_stats {
+	uint16_t depth;		/* Number of messages the queue can hold */
+	uint16_t pending;	/* Messages currently waiting to be consumed */
+	uint16_t high_water;	/* Most messages ever pending at once */
+	uint16_t reserved;
+	uint32_t received;	/* Messages queued */
+	uint32_t lost;		/* Messages acknowledged but discarded, queue full */
+} __ec_align4;
+
+/*
+ * Get the I2C profiler counters of a port, see CONFIG_I2C_PROFILE. Counters
+ * cover the sampling window, which starts at boot or when the counters are
+ * reset. Slaves are reported from index first on, as many as fit.
+ *
+ * Private command, see EC_CMD_GET_NEXT_EVENTS.
+ */
+#define EC_CMD_I2C_PROFILE 0x01FD
+
+/* Start a new sampling window, on all ports, after reporting the counters */
+#define EC_I2C_PROFILE_RESET BIT(0)
+
+struct ec_params_i2c_profile {
+	uint8_t port;		/* I2C port number */
+	uint8_t flags;		/* EC_I2C_PROFILE_* */
+	uint8_t first;		/* Index of the first slave to report */
+} __ec_align1;
+
+struct ec_i2c_profile_slave {
+	uint16_t addr_flags;	/* Slave address */
+	uint16_t errors;	/* Transfers which failed */
+	uint32_t xfers;		/* Transfers, including failed ones */
+	uint32_t bytes;		/* Bytes written and read */
+	uint32_t retries;	/* Transfers retried after a NACK */
+	uint32_t max_us;	/* Longest transfer */
+	uint64_t busy_us;	/* Total transfer time */
+} __ec_align4;
+
+struct ec_response_i2c_profile {
+	uint64_t window_us;	/* Length of the sampling window */
+	uint64_t busy_us;	/* Total transfer time on the port */
+	uint64_t lock_wait_us;	/* Total time spent waiting for the port */
+	uint32_t xfers;		/* Transfers on the port */
+	uint32_t locks;		/* Times the port was locked */
+	uint32_t lock_wait_max_us;	/* Longest wait for the port */
+	uint32_t untracked;	/* Transfers to slaves past the slave table */
+	uint16_t unwedges;	/* Bus recoveries */
+	uint16_t unwedge_fails;	/* Bus recoveries which failed */
+	uint8_t slave_count;	/* Slaves seen on the port */
+	uint8_t num_slaves;	/* Slaves reported below */
+	uint16_t reserved;
+	struct ec_i2c_profile_slave slaves[];
+} __ec_align4;
+
 /*****************************************************************************/
 /* The command range 0x200-0x2FF is reserved for Rotor. */
 
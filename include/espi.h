@@ -9,6 +9,7 @@
 #define __CROS_EC_ESPI_H
 
 #include "gpio_signal.h"
+#include "task_id.h"
 
 /* Signal through VW */
 enum espi_vw_signal {
@@ -94,8 +95,55 @@ const char *espi_vw_get_wire_name(enum espi_vw_signal signal);
 int espi_signal_is_vw(int signal);
 
 
-int espi_oob_build_peci_command(uint8_t srcAddr, uint8_t destAddr, uint8_t cmdCode,
-		uint8_t nWrite, uint8_t *writeBuf, uint8_t *readBuf);
+/* PECI transaction over the eSPI OOB channel */
+struct espi_oob_peci_req {
+	/* SMBus source and destination slave address, OOB command code */
+	uint8_t src_addr;
+	uint8_t dest_addr;
+	uint8_t cmd_code;
+	/* Message sent, starting with the PECI target address */
+	uint8_t n_write;
+	const uint8_t *write_buf;
+	/* Reply data, up to read_size bytes */
+	uint8_t read_size;
+	uint8_t *read_buf;
+
+	/* Private to the driver */
+	volatile uint8_t pending;
+	task_id_t task;
+	int rv;
+	uint32_t submit;
+	struct espi_oob_peci_req *next;
+};
+
+/**
+ * Queue a PECI transaction on the OOB channel.
+ *
+ * Transactions run in order, each one starts as soon as the previous one
+ * completes. The request and its buffers must stay valid until
+ * espi_oob_peci_wait() returns.
+ *
+ * @param req	Transaction
+ * @return EC_SUCCESS, or EC_ERROR_INVAL if the message doesn't fit
+ */
+int espi_oob_peci_submit(struct espi_oob_peci_req *req);
+
+/**
+ * Wait for a queued transaction to complete, from the task which queued it.
+ * On timeout the transaction is dropped. If it was already on the wire, the
+ * next one waits for its late reply to be discarded.
+ *
+ * @param req		Transaction
+ * @param timeout_us	Time to wait for, queueing included
+ * @return EC_SUCCESS, EC_ERROR_TIMEOUT or another error
+ */
+int espi_oob_peci_wait(struct espi_oob_peci_req *req, int timeout_us);
+
+/**
+ * Run a PECI transaction on the OOB channel, espi_oob_peci_submit() then
+ * espi_oob_peci_wait().
+ */
+int espi_oob_peci_xfer(struct espi_oob_peci_req *req, int timeout_us);
 
 
 #endif  /* __CROS_EC_ESPI_H */
@@ -132,6 +132,23 @@ enum flash_region {
  */
 int flash_physical_read(int offset, int size, char *data);
 
+/**
+ * Start reading from physical flash, with CONFIG_FLASH_READ_ASYNC.
+ *
+ * The read runs in the background; flash_physical_read_flush() must be called
+ * before data is used and before any other flash access.
+ *
+ * @param offset	Flash offset to read.
+ * @param size	        Number of bytes to read.
+ * @param data          Destination buffer for data.  Must be 32-bit aligned.
+ */
+int flash_physical_read_async(int offset, int size, char *data);
+
+/**
+ * Wait for the read started by flash_physical_read_async() to complete.
+ */
+int flash_physical_read_flush(void);
+
 /**
  * Write to physical flash.
  *
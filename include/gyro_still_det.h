@@ -8,6 +8,7 @@
 
 #include "common.h"
 #include "math_util.h"
+#include "online_stats.h"
 #include "stdbool.h"
 #include "vec3.h"
 
@@ -50,10 +51,10 @@ struct gyro_still_det {
 	 * Accumulator variables for computing the window sample mean and
 	 * variance for the current window (used for stillness detection).
 	 */
-	uint32_t num_acc_win_samples;
+	struct online_stats win_stats;
+
+	/** Latest computed window mean. */
 	fpv3_t win_mean;
-	fpv3_t assumed_mean;
-	fpv3_t acc_var;
 
 	/** Stillness period mean (used for look-ahead). */
 	fpv3_t prev_mean;
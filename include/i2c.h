@@ -12,6 +12,7 @@
 #include "gpio.h"
 #include "host_command.h"
 #include "stddef.h"
+#include "task_id.h"
 
 /*
  * I2C Slave Address encoding
@@ -197,6 +198,99 @@ int i2c_xfer_unlocked(const int port,
 		      const uint8_t *out, int out_size,
 		      uint8_t *in, int in_size, int flags);
 
+/* Flags for struct i2c_msg */
+#define I2C_MSG_READ BIT(0)     /* Read into buf, write from it otherwise */
+#define I2C_MSG_NOSTART BIT(1)  /* Continue the previous message, no START */
+#define I2C_MSG_STOP BIT(2)     /* STOP after this message */
+
+/* One segment of a transaction, see i2c_xfer_msgs(). */
+struct i2c_msg {
+	uint16_t addr_flags;
+	uint16_t flags;
+	uint8_t *buf;
+	int len;
+};
+
+/**
+ * Run a sequence of messages as one transaction on a locked bus.
+ *
+ * Each message starts with a START (repeated START if the bus is still held)
+ * unless I2C_MSG_NOSTART continues the previous one in the same direction.
+ * The bus is released with a STOP after a message flagged I2C_MSG_STOP and
+ * after the last one. Other tasks can't access the port in between, so
+ * several registers can be written without copying them to one buffer.
+ *
+ * @param port		Port to access
+ * @param msgs		Messages
+ * @param count		Number of messages
+ * @return EC_SUCCESS, or non-zero if error. Messages after a failing one are
+ *         not run.
+ */
+int i2c_xfer_msgs(const int port, struct i2c_msg *msgs, int count);
+
+/**
+ * Same as i2c_xfer_msgs, but the bus is not implicitly locked.  It must be
+ * called between i2c_lock(port, 1) and i2c_lock(port, 0).
+ */
+int i2c_xfer_msgs_unlocked(const int port, struct i2c_msg *msgs, int count);
+
+/*
+ * Asynchronous transaction, see i2c_xfer_async(). The descriptor and the
+ * buffers it points to belong to the I2C layer until the transaction is done.
+ */
+struct i2c_async_xfer {
+	int port;
+	uint16_t slave_addr_flags;
+	const uint8_t *out;
+	int out_size;
+	uint8_t *in;
+	int in_size;
+
+	/**
+	 * Called from the I2C_ASYNC task once the transaction is done, may be
+	 * NULL.
+	 */
+	void (*complete)(struct i2c_async_xfer *xfer);
+
+	/** Events set on task once the transaction is done, 0 for none. */
+	task_id_t task;
+	uint32_t event;
+
+	/** Result of the transaction, valid once pending is cleared. */
+	int rv;
+	volatile uint8_t pending;
+
+	struct i2c_async_xfer *next;
+};
+
+/**
+ * Queue a transaction, I2C_XFER_SINGLE like i2c_xfer(). Transactions on a
+ * port run in submission order in the I2C_ASYNC task; the caller keeps
+ * running while the bus is busy.
+ *
+ * @param xfer		Transaction, must not be pending
+ * @return EC_SUCCESS if queued, EC_ERROR_INVAL for a bad port,
+ *         EC_ERROR_BUSY if xfer is already pending.
+ */
+int i2c_xfer_async(struct i2c_async_xfer *xfer);
+
+/**
+ * Wait for a transaction queued with xfer->task set to the current task, and
+ * consume its event. After a timeout, the event is still posted once the
+ * transaction is done.
+ *
+ * @param xfer		Transaction
+ * @param timeout_us	How long to wait, -1 for ever
+ * @return Result of the transaction, EC_ERROR_TIMEOUT if still pending,
+ *         EC_ERROR_INVAL if xfer->event is 0.
+ */
+int i2c_xfer_async_wait(struct i2c_async_xfer *xfer, int timeout_us);
+
+/**
+ * Task running queued transactions.
+ */
+void i2c_async_task(void *u);
+
 #define I2C_LINE_SCL_HIGH BIT(0)
 #define I2C_LINE_SDA_HIGH BIT(1)
 #define I2C_LINE_IDLE (I2C_LINE_SCL_HIGH | I2C_LINE_SDA_HIGH)
@@ -566,6 +660,43 @@ void i2c_trace_notify(int port, uint16_t slave_addr_flags,
 		      const uint8_t *out_data, size_t out_size,
 		      const uint8_t *in_data, size_t in_size);
 
+/**
+ * Defined in common/i2c_profile.c, used by i2c master to account a chip
+ * transfer. Called with the port locked.
+ *
+ * @param port: I2C port number
+ * @param slave_addr_flags: slave device address
+ * @param bytes: number of bytes written and read
+ * @param busy_us: time the transfer took
+ * @param rv: result of the transfer
+ */
+void i2c_profile_xfer(int port, uint16_t slave_addr_flags, int bytes,
+		      uint32_t busy_us, int rv);
+
+/**
+ * Account a transfer retried after the slave NACKed it.
+ *
+ * @param port: I2C port number
+ * @param slave_addr_flags: slave device address
+ */
+void i2c_profile_retry(int port, uint16_t slave_addr_flags);
+
+/**
+ * Account the time spent waiting for the port lock, called once it is held.
+ *
+ * @param port: I2C port number
+ * @param wait_us: time spent waiting
+ */
+void i2c_profile_lock(int port, uint32_t wait_us);
+
+/**
+ * Account a bus recovery.
+ *
+ * @param port: I2C port number
+ * @param rv: EC_SUCCESS if the bus was recovered
+ */
+void i2c_profile_unwedge(int port, int rv);
+
 /**
  * Set bus speed. Only support for ports with I2C_PORT_FLAG_DYNAMIC_SPEED
  * flag.
@@ -34,6 +34,13 @@ enum ec_status host_cmd_motion_lid(struct host_cmd_handler_args *args);
 
 void motion_lid_calc(void);
 
+/**
+ * Feed new lid angle sensor samples to the streaming lid angle estimator.
+ *
+ * @param updated Mask of the lid angle sensors that have a new sample.
+ */
+void motion_lid_update(uint32_t updated);
+
 #endif  /* __CROS_EC_MOTION_LID_H */
 
 
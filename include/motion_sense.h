@@ -58,11 +58,14 @@ enum sensor_config {
 
 /* Internal events to motion sense task.*/
 #define TASK_EVENT_MOTION_FIRST_INTERNAL_EVENT TASK_EVENT_MOTION_INTERRUPT_NUM
-#define TASK_EVENT_MOTION_INTERNAL_EVENT_NUM    2
+#define TASK_EVENT_MOTION_INTERNAL_EVENT_NUM    3
 #define TASK_EVENT_MOTION_FLUSH_PENDING \
 	TASK_EVENT_CUSTOM_BIT(TASK_EVENT_MOTION_FIRST_INTERNAL_EVENT)
 #define TASK_EVENT_MOTION_ODR_CHANGE \
 	TASK_EVENT_CUSTOM_BIT(TASK_EVENT_MOTION_FIRST_INTERNAL_EVENT + 1)
+/* Asynchronous bus transaction done, see i2c_xfer_async(). */
+#define TASK_EVENT_MOTION_BUS_DONE \
+	TASK_EVENT_CUSTOM_BIT(TASK_EVENT_MOTION_FIRST_INTERNAL_EVENT + 2)
 
 /* Activity events */
 #define TASK_EVENT_MOTION_FIRST_SW_EVENT   \
@@ -0,0 +1,105 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Per consumer decimation and low-pass stage for motion sensor samples. */
+
+#ifndef __CROS_EC_MOTION_SENSE_DECIM_H
+#define __CROS_EC_MOTION_SENSE_DECIM_H
+
+#include "common.h"
+#include "math_util.h"
+#include "motion_sense.h"
+#include "stdbool.h"
+
+/* Maximum low-pass shift, keeps the filter state within 24 bits. */
+#define MOTION_DECIM_MAX_SHIFT 8
+
+/* Consumers of motion sensor samples running at their own rate. */
+enum motion_decim_consumer {
+	MOTION_DECIM_AP_FIFO,
+	MOTION_DECIM_LID_ANGLE,
+	MOTION_DECIM_BODY_DETECT,
+	MOTION_DECIM_CONSUMER_COUNT,
+};
+
+struct motion_decim {
+	/** Filter state, scaled by 2^shift. */
+	int32_t acc[3];
+
+	/** Samples received and produced, for statistics. */
+	uint32_t in;
+	uint32_t out;
+
+	/** One output every ratio inputs, 0 and 1 pass every sample. */
+	uint16_t ratio;
+
+	/** Position in the ratio cycle, an output is produced at 0. */
+	uint16_t count;
+
+	/**
+	 * One pole IIR low-pass, y += (x - y) / 2^shift, run on every input.
+	 * 0 disables filtering.
+	 */
+	uint8_t shift;
+
+	/** Set once the filter state holds a sample. */
+	uint8_t primed;
+};
+
+/**
+ * Configure a stage and reset its state.
+ *
+ * Stages of motion_sensors[] must be configured with g_sensor_mutex held.
+ *
+ * @param d Stage to configure.
+ * @param ratio Decimation ratio.
+ * @param shift Low-pass shift, up to MOTION_DECIM_MAX_SHIFT.
+ */
+void motion_decim_init(struct motion_decim *d, int ratio, int shift);
+
+/**
+ * Run a sample through a stage.
+ *
+ * Stages of motion_sensors[] must be fed with g_sensor_mutex held.
+ *
+ * @param d Stage.
+ * @param in New sample.
+ * @param out Filtered sample, only written when one is produced.
+ * @return True if a sample was produced.
+ */
+bool motion_decim_push(struct motion_decim *d, const intv3_t in, intv3_t out);
+
+/**
+ * Low-pass shift matching a decimation ratio: the cutoff lands below the
+ * Nyquist frequency of the decimated stream.
+ *
+ * @param ratio Decimation ratio.
+ * @return Low-pass shift.
+ */
+int motion_decim_default_shift(int ratio);
+
+/**
+ * Get the stage of a sensor for a consumer.
+ *
+ * @param sensor Sensor the samples come from.
+ * @param consumer Consumer of the samples.
+ * @return Stage.
+ */
+struct motion_decim *motion_decim_get(const struct motion_sensor_t *sensor,
+				      enum motion_decim_consumer consumer);
+
+/**
+ * Run the last sample of a sensor through its stage for a consumer.
+ * Takes g_sensor_mutex.
+ *
+ * @param sensor Sensor, its xyz holds the new sample.
+ * @param consumer Consumer of the samples.
+ * @param out Filtered sample, only written when one is produced.
+ * @return True if a sample was produced.
+ */
+bool motion_decim_sample(const struct motion_sensor_t *sensor,
+			 enum motion_decim_consumer consumer, intv3_t out);
+
+#endif /* __CROS_EC_MOTION_SENSE_DECIM_H */
@@ -66,6 +66,25 @@ void motion_sense_fifo_stage_data(
 	int valid_data,
 	uint32_t time);
 
+/**
+ * Stage a batch of samples read from a sensor hardware FIFO. This is
+ * equivalent to calling motion_sense_fifo_stage_data() on each entry, but
+ * g_sensor_mutex is only taken once for up to 32 samples. The data will not be
+ * available to the AP until motion_sense_fifo_commit_data is called.
+ *
+ * @param data samples to insert in the FIFO, sensor_num must be set for each
+ *             of them as it selects the sensor the sample comes from
+ * @param count number of samples in data
+ * @param valid_data data should be copied into the public sensor vectors
+ * @param time accurate time (ideally measured in an interrupt) the batch was
+ *             read at, spread over the samples when the data is committed
+ */
+void motion_sense_fifo_stage_batch(
+	struct ec_response_motion_sensor_data *data,
+	int count,
+	int valid_data,
+	uint32_t time);
+
 /**
  * Commit all the currently staged data to the fifo. Doing so makes it readable
  * to the AP.
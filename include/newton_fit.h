@@ -63,6 +63,28 @@ struct newton_fit {
 	 * Queue of newton_fit_orientation structs.
 	 */
 	struct queue *orientations;
+
+	/**
+	 * Spatial index of the orientations. The space is split into cubic
+	 * cells of twice sqrt(nearness_threshold) per side and each cell is
+	 * hashed to one of max_orientations buckets, so only the 8 cells around
+	 * a new sample need to be looked at to find a near orientation. Each
+	 * array has max_orientations entries. Queue slots are stored plus one
+	 * so that 0 means empty.
+	 */
+	uint16_t *bucket_head;
+	uint16_t *slot_next;
+	uint16_t *slot_bucket;
+
+	/**
+	 * Inverse of the index cell size, computed on first use.
+	 */
+	fp_t inv_cell_size;
+
+	/**
+	 * Number of orientations with at least min_orientation_samples.
+	 */
+	uint16_t ready_count;
 };
 
 #define NEWTON_FIT(SIZE, NSAMPLES, NEAR_THRES, NEW_PT_WEIGHT, ERROR_THRESHOLD, \
@@ -76,6 +98,9 @@ struct newton_fit {
 		.min_orientation_samples = NSAMPLES,                           \
 		.orientations = (struct queue *)&QUEUE_NULL(                   \
 			SIZE, struct newton_fit_orientation),                  \
+		.bucket_head = (uint16_t[SIZE]){},                             \
+		.slot_next = (uint16_t[SIZE]){},                               \
+		.slot_bucket = (uint16_t[SIZE]){},                             \
 	})
 
 /**
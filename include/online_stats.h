@@ -0,0 +1,137 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/* Single pass mean and variance of sensor samples. */
+
+#ifndef __CROS_EC_ONLINE_STATS_H
+#define __CROS_EC_ONLINE_STATS_H
+
+#include "common.h"
+#include "math_util.h"
+#include "stdbool.h"
+#include "vec3.h"
+
+/*
+ * Mean and variance of a growing batch of 3 axis samples.
+ *
+ * Samples are accumulated relative to the first one of the batch (method of
+ * the assumed mean, en.wikipedia.org/wiki/Assumed_mean). While the data stays
+ * close to its first sample, which is what stillness detection looks for,
+ * the sum of squares does not cancel out the way sum(x^2) - sum(x)^2 / n
+ * does, and unlike Welford's method no division is needed per sample.
+ */
+struct online_stats {
+	/** Number of samples in the batch. */
+	uint32_t n;
+
+	/** First sample of the batch, the assumed mean. */
+	fpv3_t shift;
+
+	/** sum(x - shift) */
+	fpv3_t sum;
+
+	/** sum((x - shift)^2) */
+	fpv3_t sum_sq;
+};
+
+/**
+ * Start a new batch.
+ *
+ * @param s Statistics to reset.
+ */
+void online_stats_reset(struct online_stats *s);
+
+/**
+ * Add a sample to the batch.
+ *
+ * @param s Statistics to update.
+ * @param x The x component of the sample.
+ * @param y The y component of the sample.
+ * @param z The z component of the sample.
+ */
+void online_stats_update(struct online_stats *s, fp_t x, fp_t y, fp_t z);
+
+/**
+ * Compute the mean and variance of the batch.
+ *
+ * @param s Statistics of the batch.
+ * @param mean Mean of the samples, may be NULL.
+ * @param var Variance of the samples.
+ * @param unbiased Divide by n - 1 (sample variance) instead of n.
+ * @return False if the batch does not have enough samples, mean and var are
+ *         left untouched.
+ */
+bool online_stats_compute(const struct online_stats *s, fpv3_t mean,
+			  fpv3_t var, bool unbiased);
+
+/*
+ * Mean and variance of the last samples of an integer signal, updated in O(1)
+ * per sample.
+ *
+ * Plain integer sums are kept: the result is exact and, unlike updating
+ * n^2 * var directly, no 64 bit division is needed per sample. With 16 bit
+ * samples, sum_sq stays below 2^47 for windows up to 2^16 samples.
+ */
+struct online_stats_window {
+	/** Last samples, size entries provided by the caller. */
+	int32_t *history;
+
+	/** Window size. */
+	uint16_t size;
+
+	/** Number of samples in the window, up to size. */
+	uint16_t n;
+
+	/** Slot of the oldest sample. */
+	uint16_t idx;
+
+	/** sum(history) */
+	int32_t sum;
+
+	/** sum(history^2) */
+	int64_t sum_sq;
+};
+
+/**
+ * Set up an empty window.
+ *
+ * @param w Window to set up.
+ * @param history Storage for size samples.
+ * @param size Window size.
+ */
+void online_stats_window_init(struct online_stats_window *w, int32_t *history,
+			      int size);
+
+/**
+ * Add a sample, dropping the oldest one once the window is full.
+ *
+ * @param w Window to update.
+ * @param x New sample.
+ */
+void online_stats_window_update(struct online_stats_window *w, int32_t x);
+
+/**
+ * @param w Window.
+ * @return True once the window holds size samples.
+ */
+static inline bool online_stats_window_full(
+		const struct online_stats_window *w)
+{
+	return w->n == w->size;
+}
+
+/**
+ * Scaled variance of the samples in the window.
+ *
+ * @param w Window.
+ * @return n^2 * var(history), exact.
+ */
+static inline uint64_t online_stats_window_n2_var(
+		const struct online_stats_window *w)
+{
+	return (uint64_t)(w->n * w->sum_sq - (int64_t)w->sum * w->sum);
+}
+
+#endif /* __CROS_EC_ONLINE_STATS_H */
@@ -26,6 +26,38 @@ void SHA256_init(struct sha256_ctx *ctx);
 void SHA256_update(struct sha256_ctx *ctx, const uint8_t *data, uint32_t len);
 uint8_t *SHA256_final(struct sha256_ctx *ctx);
 
+/* One of the buffers hashed by SHA256_hash_bufs() */
+struct sha256_buf {
+	const uint8_t *data;
+	uint32_t len;
+};
+
+/**
+ * Hash the concatenation of several buffers.
+ *
+ * @param bufs		Buffers, in order
+ * @param count		Number of buffers
+ * @param digest	SHA256_DIGEST_SIZE bytes of output
+ */
+void SHA256_hash_bufs(const struct sha256_buf *bufs, int count,
+		      uint8_t *digest);
+
+#ifdef CONFIG_SHA256_HW_ACCELERATE
+/**
+ * Run the compression function of the chip hash engine.
+ *
+ * Provided by the chip when CONFIG_SHA256_HW_ACCELERATE is defined, the rest
+ * of the SHA-256 and HMAC code is common.
+ *
+ * @param h		Hash state, updated
+ * @param blocks	block_nb blocks of SHA256_BLOCK_SIZE bytes, may be
+ *			unaligned
+ * @param block_nb	Number of blocks
+ */
+void SHA256_hw_transform(uint32_t *h, const uint8_t *blocks,
+			 unsigned int block_nb);
+#endif
+
 void hmac_SHA256(uint8_t *output, const uint8_t *key, const int key_len,
 		 const uint8_t *message, const int message_len);
 
@@ -58,15 +58,27 @@ int shared_mem_acquire(int size, char **dest_ptr);
 void shared_mem_release(void *ptr);
 
 /*
- * This structure is allocated at the base of the free memory chunk and every
- * allocated buffer.
+ * This structure is allocated at the base of every buffer, allocated or free.
+ * Allocated buffers only keep the fields before next_free.
  */
 struct shm_buffer {
-	struct shm_buffer *next_buffer;
-	struct shm_buffer *prev_buffer;
+	/* Buffer right below this one, NULL for the first one. */
+	struct shm_buffer *prev_phys;
+	/* Buffer size, header included. Bit 0 is set in free buffers. */
 	size_t buffer_size;
+	/* Free buffers of the same size class. */
+	struct shm_buffer *next_free;
+	struct shm_buffer *prev_free;
 };
 
+/*
+ * Free buffer size classes: SHM_FL_COUNT powers of two, each split in
+ * SHM_SL_COUNT ranges.
+ */
+#define SHM_FL_COUNT 16
+#define SHM_SL_LOG2 2
+#define SHM_SL_COUNT BIT(SHM_SL_LOG2)
+
 #ifdef TEST_SHMALLOC
 
 /*
@@ -78,11 +90,14 @@ struct shm_buffer {
  * possible paths have been executed.
  */
 
-#define MAX_MASK_BIT 24
+#define MAX_MASK_BIT 13
 #define ALL_PATHS_MASK ((1 << (MAX_MASK_BIT + 1)) - 1)
 void set_map_bit(uint32_t mask);
-extern struct shm_buffer *free_buf_chain;
-extern struct shm_buffer *allocced_buf_chain;
+extern struct shm_buffer *shm_first;
+extern uintptr_t shm_end;
+extern struct shm_buffer *shm_free_lists[SHM_FL_COUNT][SHM_SL_COUNT];
+extern uint32_t shm_fl_bitmap;
+extern uint32_t shm_sl_bitmap[SHM_FL_COUNT];
 #endif
 
 #endif  /* __CROS_EC_SHARED_MEM_H */
@@ -105,6 +105,14 @@ int spi_transaction_flush(const struct spi_device_t *spi_device);
 /* Wait for async response received but do not de-assert chip select */
 int spi_transaction_wait(const struct spi_device_t *spi_device);
 
+/*
+ * Lock or unlock the SPI port of spi_device, so that a series of
+ * spi_transaction_async() calls isn't interleaved with spi_transaction()
+ * calls from other tasks. Only async transactions may be used while the port
+ * is locked.
+ */
+void spi_transaction_lock(const struct spi_device_t *spi_device, int lock);
+
 /*
  * Get SPI protocol information. This function is called in runtime if board's
  * host command transport is SPI.
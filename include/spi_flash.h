@@ -99,9 +99,34 @@ int spi_flash_set_status(int reg1, int reg2);
  */
 int spi_flash_read(uint8_t *buf, unsigned int offset, unsigned int bytes);
 
+/**
+ * Start reading SPI flash, the data is moved to buf by DMA.
+ *
+ * The SPI port stays locked until spi_flash_read_flush() is called, which
+ * must happen before buf is used.
+ *
+ * @param buf Buffer to write flash contents
+ * @param offset Flash offset to start reading from
+ * @param bytes Number of bytes to read
+ *
+ * @return EC_SUCCESS, or non-zero if the read could not be started.
+ */
+int spi_flash_read_async(uint8_t *buf, unsigned int offset,
+			 unsigned int bytes);
+
+/**
+ * Wait for the read started by spi_flash_read_async() to complete.
+ *
+ * @return EC_SUCCESS, or non-zero if any error.
+ */
+int spi_flash_read_flush(void);
+
 /**
  * Erase SPI flash.
  *
+ * Uses the largest block (64kb, 32kb or 4kb) the range is aligned to and
+ * covers, and skips sectors that already read as erased.
+ *
  * @param offset Flash offset to start erasing
  * @param bytes Number of bytes to erase
  *
@@ -111,7 +136,7 @@ int spi_flash_erase(unsigned int offset, unsigned int bytes);
 
 /**
  * Write to SPI flash. Assumes already erased.
- * Limited to SPI_FLASH_MAX_WRITE_SIZE by chip.
+ * Any length, split into SPI_FLASH_MAX_WRITE_SIZE page programs.
  *
  * @param offset Flash offset to write
  * @param bytes Number of bytes to write
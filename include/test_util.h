@@ -191,6 +191,12 @@ uint32_t prng(uint32_t seed);
 
 uint32_t prng_no_seed(void);
 
+/*
+ * Wall clock time in ns for benchmarks, as time is emulated on the host.
+ * Benchmarks only print their results, they do not check them.
+ */
+uint64_t test_bench_now_ns(void);
+
 /* Number of failed tests */
 extern int __test_error_count;
 
@@ -28,6 +28,19 @@ enum pe_error {
  */
 void pe_run(int port, int evt, int en);
 
+/**
+ * Returns the earliest time at which the Policy Engine needs to run again,
+ * so that the PD task can sleep until then (see CONFIG_USB_PD_TICKLESS).
+ *
+ * @param port  USB-C port number
+ * @param since Time the state machines were last run; deadlines at or before
+ *		this time were already observed by that run
+ * @return absolute time in us, USBC_NO_DEADLINE if only events can move the
+ *	   state machine, or since + USBC_EVENT_TIMEOUT while it polls or
+ *	   has work pending
+ */
+uint64_t pe_get_next_timeout(int port, uint64_t since);
+
 /**
  * Sets the debug level for the PRL layer
  *
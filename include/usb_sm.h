@@ -35,6 +35,13 @@ struct usb_state {
 
 typedef const struct usb_state *usb_state_ptr;
 
+/*
+ * Maximum number of levels in a state hierarchy, counting the state itself.
+ * set_state() flattens the ancestry of the new state into an array of this
+ * size; test_*_no_parent_cycles() checks each state machine against it.
+ */
+#define USB_SM_MAX_DEPTH 4
+
 /* Defines the current context of the usb statemachine. */
 struct sm_ctx {
 	usb_state_ptr current;
@@ -43,6 +50,38 @@ struct sm_ctx {
 	intptr_t internal[2];
 };
 
+/*
+ * Interval at which the USB-C state machines are run while any of them is in
+ * a state that polls hardware instead of waiting on events and timers.
+ */
+#define USBC_EVENT_TIMEOUT (5 * MSEC)
+
+/*
+ * Deadline reported by a state machine that only waits on events, see
+ * CONFIG_USB_PD_TICKLESS.
+ */
+#define USBC_NO_DEADLINE UINT64_MAX
+
+/**
+ * Folds a state machine timer into the next deadline reported to the PD task.
+ * State machines consider a timer expired once the time is strictly past it,
+ * so the deadline is timer + 1. Timers before 'since' had expired when the
+ * state machine last ran, so they are either stale or were acted upon; a timer
+ * equal to 'since' had not expired yet.
+ *
+ * @param next  Earliest deadline found so far
+ * @param timer Absolute expiry time of the timer, USBC_NO_DEADLINE if disabled
+ * @param since Time the state machines were last run
+ * @return the earliest of next and timer + 1
+ */
+static inline uint64_t sm_next_deadline(uint64_t next, uint64_t timer,
+					uint64_t since)
+{
+	if (timer == USBC_NO_DEADLINE || timer < since)
+		return next;
+	return (timer + 1 < next) ? timer + 1 : next;
+}
+
 /* Local state machine states */
 enum sm_local_state {
 	SM_INIT = 0, /* Ensure static variables initialize to SM_INIT */
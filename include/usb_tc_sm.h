@@ -289,6 +289,19 @@ void tc_event_check(int port, int evt);
  */
 void tc_run(const int port);
 
+/**
+ * Returns the earliest time at which the TypeC layer needs to run again,
+ * so that the PD task can sleep until then (see CONFIG_USB_PD_TICKLESS).
+ *
+ * @param port  USB-C port number
+ * @param since Time the state machines were last run; deadlines at or before
+ *		this time were already observed by that run
+ * @return absolute time in us, USBC_NO_DEADLINE if only events can move the
+ *	   state machine, or since + USBC_EVENT_TIMEOUT while it polls or
+ *	   has work pending
+ */
+uint64_t tc_get_next_timeout(int port, uint64_t since);
+
 /**
  * Sets the debug level for the TC layer
  *
@@ -331,6 +344,14 @@ void tc_start_event_loop(int port);
  */
 void tc_pause_event_loop(int port);
 
+/**
+ * Returns the number of times the PD task of a port has woken up.
+ *
+ * @param port USB-C port number
+ * @return wakeup count since boot
+ */
+uint32_t pd_task_get_wakeups(int port);
+
 /**
  * Allow system to override the control of TrySrc
  *
@@ -11,6 +11,8 @@
 #include "common.h"
 #include "motion_common.h"
 #include "motion_sense.h"
+#include "motion_sense_decim.h"
+#include "online_stats.h"
 #include "test_util.h"
 #include "util.h"
 
@@ -106,11 +108,163 @@ static int test_body_detect(void)
 	return EC_SUCCESS;
 }
 
+#define WINDOW_TEST_SAMPLES 20000
+#define WINDOW_TEST_SIZE 50
+
+/* Pseudo random accelerometer reading around 1g, 16 bit full scale. */
+static int32_t window_test_sample(int i)
+{
+	return 16384 + (int32_t)((i * 2654435761u) >> 20) % 2048 - 1024;
+}
+
+/*
+ * n^2 * var recurrence body detection used before the sums were kept, one 64
+ * bit division per sample.
+ */
+static void legacy_window_update(int32_t *history, int *idx, int *sum,
+				 uint64_t *n2_var, int x_n)
+{
+	const int n = WINDOW_TEST_SIZE;
+	const int x_0 = history[*idx];
+	const int new_sum = *sum + (x_n - x_0);
+
+	*n2_var = *n2_var + POW2((int64_t)new_sum - *sum) +
+		  (POW2((int64_t)x_n * n - new_sum) -
+		   POW2((int64_t)x_0 * n - new_sum)) / n;
+	*sum = new_sum;
+	history[*idx] = x_n;
+	*idx = (*idx + 1 >= n) ? 0 : *idx + 1;
+}
+
+/* Exact n^2 * var of the last WINDOW_TEST_SIZE samples up to i. */
+static uint64_t reference_n2_var(int i)
+{
+	int64_t sum = 0, sum_sq = 0, x;
+	int j;
+
+	for (j = i - WINDOW_TEST_SIZE + 1; j <= i; j++) {
+		x = window_test_sample(j);
+		sum += x;
+		sum_sq += x * x;
+	}
+	return WINDOW_TEST_SIZE * sum_sq - sum * sum;
+}
+
+static int test_window_stats_exact(void)
+{
+	int32_t history[WINDOW_TEST_SIZE], legacy_history[WINDOW_TEST_SIZE];
+	struct online_stats_window w;
+	uint64_t legacy_n2_var = 0, ref;
+	int legacy_idx = 0, legacy_sum = 0;
+	int i;
+
+	memset(legacy_history, 0, sizeof(legacy_history));
+	online_stats_window_init(&w, history, WINDOW_TEST_SIZE);
+
+	for (i = 0; i < WINDOW_TEST_SAMPLES; i++) {
+		online_stats_window_update(&w, window_test_sample(i));
+		legacy_window_update(legacy_history, &legacy_idx, &legacy_sum,
+				     &legacy_n2_var, window_test_sample(i));
+		TEST_EQ(online_stats_window_full(&w),
+			i >= WINDOW_TEST_SIZE - 1, "%d");
+		if (i < WINDOW_TEST_SIZE - 1 || i % 1000)
+			continue;
+		TEST_ASSERT(online_stats_window_n2_var(&w) ==
+			    reference_n2_var(i));
+	}
+
+	ref = reference_n2_var(i - 1);
+	TEST_ASSERT(online_stats_window_n2_var(&w) == ref);
+	TEST_ASSERT(legacy_n2_var == ref);
+
+	return EC_SUCCESS;
+}
+
+static int test_benchmark_window_stats(void)
+{
+	int32_t history[WINDOW_TEST_SIZE], legacy_history[WINDOW_TEST_SIZE];
+	struct online_stats_window w;
+	uint64_t legacy_n2_var = 0, legacy_ns, window_ns, t0;
+	int legacy_idx = 0, legacy_sum = 0;
+	int i;
+
+	memset(legacy_history, 0, sizeof(legacy_history));
+	t0 = test_bench_now_ns();
+	for (i = 0; i < WINDOW_TEST_SAMPLES; i++)
+		legacy_window_update(legacy_history, &legacy_idx, &legacy_sum,
+				     &legacy_n2_var, window_test_sample(i));
+	legacy_ns = test_bench_now_ns() - t0;
+
+	online_stats_window_init(&w, history, WINDOW_TEST_SIZE);
+	t0 = test_bench_now_ns();
+	for (i = 0; i < WINDOW_TEST_SAMPLES; i++)
+		online_stats_window_update(&w, window_test_sample(i));
+	window_ns = test_bench_now_ns() - t0;
+
+	ccprints("window variance update: recurrence %d ps/sample, "
+		 "exact sums %d ps/sample",
+		 (int)(legacy_ns * 1000 / WINDOW_TEST_SAMPLES),
+		 (int)(window_ns * 1000 / WINDOW_TEST_SAMPLES));
+	TEST_ASSERT(legacy_n2_var && online_stats_window_n2_var(&w));
+
+	return EC_SUCCESS;
+}
+
+#ifdef CONFIG_MOTION_SENSE_DECIM
+static int test_decim_stage(void)
+{
+	struct motion_decim d;
+	intv3_t in, out;
+	int i, outputs, peak;
+
+	/* Ratio 1 without low-pass passes samples through. */
+	motion_decim_init(&d, 1, 0);
+	in[X] = -3;
+	in[Y] = 1000;
+	in[Z] = 32767;
+	TEST_ASSERT(motion_decim_push(&d, in, out));
+	TEST_ASSERT_ARRAY_EQ(out, in, 3);
+
+	/* One output every ratio inputs, unity gain on a constant input. */
+	motion_decim_init(&d, 4, motion_decim_default_shift(4));
+	TEST_EQ(d.shift, 2, "%d");
+	for (i = 0, outputs = 0; i < 16; i++) {
+		if (!motion_decim_push(&d, in, out))
+			continue;
+		/* The first input of each cycle is passed on. */
+		TEST_EQ(i % 4, 0, "%d");
+		outputs++;
+		TEST_ASSERT_ARRAY_EQ(out, in, 3);
+	}
+	TEST_EQ(outputs, 4, "%d");
+	TEST_EQ(d.in, 16, "%u");
+	TEST_EQ(d.out, 4, "%u");
+
+	/*
+	 * A full scale signal at the input Nyquist rate is what aliases when
+	 * dropping samples, the low-pass must attenuate it.
+	 */
+	motion_decim_init(&d, 4, motion_decim_default_shift(4));
+	for (i = 0, peak = 0; i < 64; i++) {
+		in[X] = in[Y] = in[Z] = (i & 1) ? 16384 : -16384;
+		if (motion_decim_push(&d, in, out) && i > 8)
+			peak = MAX(peak, ABS(out[X]));
+	}
+	TEST_LT(peak, 16384 / 4, "%d");
+
+	return EC_SUCCESS;
+}
+#endif
 
 void run_test(int argc, char **argv)
 {
 	test_reset();
 
+#ifdef CONFIG_MOTION_SENSE_DECIM
+	RUN_TEST(test_decim_stage);
+#endif
+	RUN_TEST(test_window_stats_exact);
+	RUN_TEST(test_benchmark_window_stats);
 	RUN_TEST(test_body_detect);
 
 	test_print_result();
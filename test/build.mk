@@ -18,6 +18,7 @@ test-list-host += battery_get_params_smart
 test-list-host += bklight_lid
 test-list-host += bklight_passthru
 test-list-host += body_detection
+test-list-host += body_detection_decim
 test-list-host += button
 test-list-host += cbi
 test-list-host += cec
@@ -27,10 +28,13 @@ test-list-host += charge_ramp
 test-list-host += compile_time_macros
 test-list-host += console_edit
 test-list-host += crc32
+test-list-host += crc32_slice4
+test-list-host += crc32_slice8
 test-list-host += entropy
 test-list-host += extpwr_gpio
 test-list-host += fan
 test-list-host += flash
+test-list-host += flash_storage
 test-list-host += float
 test-list-host += fp
 test-list-host += fpsensor
@@ -39,7 +43,10 @@ test-list-host += fpsensor_state
 test-list-host += gyro_cal
 test-list-host += hooks
 test-list-host += host_command
+test-list-host += i2c_async
 test-list-host += i2c_bitbang
+test-list-host += i2c_msgs
+test-list-host += i2c_profile
 test-list-host += inductive_charging
 test-list-host += interrupt
 test-list-host += is_enabled
@@ -55,7 +62,9 @@ test-list-host += math_util
 test-list-host += motion_angle
 test-list-host += motion_angle_tablet
 test-list-host += motion_lid
+test-list-host += motion_lid_streaming
 test-list-host += motion_sense_fifo
+test-list-host += motion_sense_fifo_compact
 test-list-host += mutex
 test-list-host += newton_fit
 test-list-host += online_calibration
@@ -65,6 +74,7 @@ test-list-host += printf
 test-list-host += queue
 test-list-host += rsa
 test-list-host += rsa3
+test-list-host += rsa3072
 test-list-host += rtc
 test-list-host += sbs_charging_v2
 test-list-host += sha256
@@ -91,6 +101,7 @@ test-list-host += usb_typec_ctvpd
 test-list-host += usb_typec_drp_acc_trysrc
 test-list-host += usb_prl_old
 test-list-host += usb_tcpmv2_tcpci
+test-list-host += usb_tcpmv2_tcpci_tickless
 test-list-host += usb_prl
 test-list-host += usb_prl_noextended
 test-list-host += usb_pe_drp_old
@@ -126,6 +137,8 @@ battery_get_params_smart-y=battery_get_params_smart.o
 bklight_lid-y=bklight_lid.o
 bklight_passthru-y=bklight_passthru.o
 body_detection-y=body_detection.o body_detection_data_literals.o motion_common.o
+body_detection_decim-y=body_detection.o body_detection_data_literals.o \
+	motion_common.o
 button-y=button.o
 cbi-y=cbi.o
 cec-y=cec.o
@@ -135,11 +148,14 @@ charge_ramp-y+=charge_ramp.o
 compile_time_macros-y=compile_time_macros.o
 console_edit-y=console_edit.o
 crc32-y=crc32.o
+crc32_slice4-y=crc32.o
+crc32_slice8-y=crc32.o
 entropy-y=entropy.o
 extpwr_gpio-y=extpwr_gpio.o
 fan-y=fan.o
 flash-y=flash.o
 flash_physical-y=flash_physical.o
+flash_storage-y=flash_storage.o ../baseboard/fwk/flash_storage.o
 flash_write_protect-y=flash_write_protect.o
 fpsensor-y=fpsensor.o
 fpsensor_crypto-y=fpsensor_crypto.o
@@ -147,7 +163,10 @@ fpsensor_state-y=fpsensor_state.o
 gyro_cal-y=gyro_cal.o
 hooks-y=hooks.o
 host_command-y=host_command.o
+i2c_async-y=i2c_async.o
 i2c_bitbang-y=i2c_bitbang.o
+i2c_msgs-y=i2c_msgs.o
+i2c_profile-y=i2c_profile.o
 inductive_charging-y=inductive_charging.o
 interrupt-y=interrupt.o
 is_enabled-y=is_enabled.o
@@ -161,7 +180,9 @@ math_util-y=math_util.o
 motion_angle-y=motion_angle.o motion_angle_data_literals.o motion_common.o
 motion_angle_tablet-y=motion_angle_tablet.o motion_angle_data_literals_tablet.o motion_common.o
 motion_lid-y=motion_lid.o
+motion_lid_streaming-y=motion_lid.o
 motion_sense_fifo-y=motion_sense_fifo.o
+motion_sense_fifo_compact-y=motion_sense_fifo.o
 online_calibration-y=online_calibration.o
 kasa-y=kasa.o
 mpu-y=mpu.o
@@ -176,6 +197,7 @@ rollback-y=rollback.o
 rollback_entropy-y=rollback_entropy.o
 rsa-y=rsa.o
 rsa3-y=rsa.o
+rsa3072-y=rsa.o
 rtc-y=rtc.o
 scratchpad-y=scratchpad.o
 sbs_charging-y=sbs_charging.o
@@ -213,6 +235,8 @@ usb_pe_drp_old_noextended-y=usb_pe_drp_old.o usb_sm_checks.o fake_usbc.o
 usb_pe_drp-y=usb_pe_drp.o usb_sm_checks.o
 usb_pe_drp_noextended-y=usb_pe_drp_noextended.o usb_sm_checks.o
 usb_tcpmv2_tcpci-y=usb_tcpmv2_tcpci.o vpd_api.o usb_sm_checks.o
+usb_tcpmv2_tcpci_tickless-y=usb_tcpmv2_tcpci_tickless.o vpd_api.o \
+	usb_sm_checks.o
 utils-y=utils.o
 utils_str-y=utils_str.o
 vboot-y=vboot.o
@@ -221,6 +245,9 @@ fp-y=fp.o
 x25519-y=x25519.o
 stillness_detector-y=stillness_detector.o
 
+# Board code under test, built from its own directory
+dirs-y += baseboard/fwk
+
 host-is_enabled_error: TEST_SCRIPT=is_enabled_error.sh
 is_enabled_error-y=is_enabled_error.o.cmd
 
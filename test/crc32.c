@@ -5,10 +5,12 @@
  * Tests crc32 sw implementation.
  */
 
+#include "clock.h"
 #include "common.h"
 #include "console.h"
 #include "crc.h"
 #include "test_util.h"
+#include "timer.h"
 #include "util.h"
 
 // test that static version matches context version
@@ -63,6 +65,84 @@ static int test_kat0(void)
 	return EC_SUCCESS;
 }
 
+// bit at a time reference
+static uint32_t crc32_ref(const uint8_t *p, int size)
+{
+	uint32_t crc = 0xffffffff;
+	int i;
+
+	while (size--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+
+	return crc ^ 0xffffffff;
+}
+
+static uint8_t data[4096 + 8] __aligned(4);
+
+// test that buffers match the reference for every alignment and tail length
+static int test_buf(void)
+{
+	uint32_t crc;
+	int offset, size;
+
+	for (size = 0; size < sizeof(data) - 8; size++)
+		data[size] = size * 7 + (size >> 8);
+
+	for (offset = 0; offset < 8; offset++)
+		for (size = 0; size < 80; size++)
+			TEST_EQ(crc32_buf(data + offset, size),
+				crc32_ref(data + offset, size), "0x%08x");
+
+	TEST_EQ(crc32_buf(data + 3, sizeof(data) - 8),
+		crc32_ref(data + 3, sizeof(data) - 8), "0x%08x");
+
+	// split in chunks of odd sizes
+	crc32_ctx_init(&crc);
+	for (offset = 0; offset < sizeof(data) - 8; offset += size) {
+		size = MIN(offset % 61 + 1, sizeof(data) - 8 - offset);
+		crc32_ctx_hash(&crc, data + offset, size);
+	}
+	TEST_EQ(crc32_ctx_result(&crc), crc32_ref(data, sizeof(data) - 8),
+		"0x%08x");
+
+	return EC_SUCCESS;
+}
+
+static int test_kat_buf(void)
+{
+	const char input[] = "The quick brown fox jumps over the lazy dog";
+
+	TEST_EQ(crc32_buf(input, strlen(input)), 0x414fa339, "0x%08x");
+	TEST_EQ(crc32_buf("123456789", 9), 0xcbf43926, "0x%08x");
+
+	return EC_SUCCESS;
+}
+
+static void test_crc32_speed(void)
+{
+	const int iterations = 256;
+	const int bytes = iterations * (sizeof(data) - 8);
+	uint32_t crc;
+	uint64_t ns;
+	int i, mbps10, cpb10;
+
+	ns = test_bench_now_ns();
+	crc32_ctx_init(&crc);
+	for (i = 0; i < iterations; i++)
+		crc32_ctx_hash(&crc, data, sizeof(data) - 8);
+	ns = MAX(test_bench_now_ns() - ns, 1);
+
+	/* In tenths, MB/s is what matters on host, cycles/byte on target */
+	mbps10 = (uint64_t)bytes * 10 * 1000000000 / ns / (1024 * 1024);
+	cpb10 = ns * 10 / 1000 * (clock_get_freq() / SECOND) / bytes;
+	ccprintf("CRC32 slice %d: %lld us, %d.%d MB/s, %d.%d cycles/byte\n",
+		 CONFIG_SW_CRC_SLICE, (long long)(ns / 1000),
+		 mbps10 / 10, mbps10 % 10, cpb10 / 10, cpb10 % 10);
+}
+
 void run_test(int argc, char **argv)
 {
 	test_reset();
@@ -70,6 +150,11 @@ void run_test(int argc, char **argv)
 	RUN_TEST(test_static_version);
 	RUN_TEST(test_8);
 	RUN_TEST(test_kat0);
+	RUN_TEST(test_kat_buf);
+	RUN_TEST(test_buf);
+
+	/* do not check result, just as a benchmark */
+	test_crc32_speed();
 
 	test_print_result();
 }
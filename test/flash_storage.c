@@ -0,0 +1,408 @@
+/* Copyright 2022 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test the fwk flash flags log on an emulated SPI flash.
+ */
+
+#include "common.h"
+#include "crc8.h"
+#include "ec_commands.h"
+#include "spi_flash.h"
+#include "test_util.h"
+#include "util.h"
+
+#include "../baseboard/fwk/flash_storage.h"
+
+#define HDR_SIZE sizeof(struct flash_storage_sector_header)
+#define RECORD_SIZE sizeof(struct flash_storage_record)
+/* Records a sector holds */
+#define SECTOR_RECORDS ((FLASH_STORAGE_SECTOR_SIZE - HDR_SIZE) / RECORD_SIZE)
+
+/*
+ * NOR flash: erase sets bytes to 0xff, programming only clears bits. Once
+ * write_budget bytes are programmed the power goes, nothing more is written.
+ */
+static uint8_t flash[FLASH_STORAGE_SECTORS * FLASH_STORAGE_SECTOR_SIZE];
+static int write_budget = -1;
+
+static int flash_range(unsigned int offset, unsigned int bytes)
+{
+	return offset >= SPI_FLAGS_REGION &&
+	       offset + bytes <= SPI_FLAGS_REGION + sizeof(flash);
+}
+
+int spi_flash_read(uint8_t *buf, unsigned int offset, unsigned int bytes)
+{
+	if (!flash_range(offset, bytes))
+		return EC_ERROR_INVAL;
+	memcpy(buf, &flash[offset - SPI_FLAGS_REGION], bytes);
+	return EC_SUCCESS;
+}
+
+int spi_flash_erase(unsigned int offset, unsigned int bytes)
+{
+	if (!flash_range(offset, bytes) ||
+	    offset % FLASH_STORAGE_SECTOR_SIZE ||
+	    bytes % FLASH_STORAGE_SECTOR_SIZE)
+		return EC_ERROR_INVAL;
+	if (!write_budget)
+		return EC_ERROR_UNKNOWN;
+	memset(&flash[offset - SPI_FLAGS_REGION], 0xff, bytes);
+	return EC_SUCCESS;
+}
+
+int spi_flash_write(unsigned int offset, unsigned int bytes,
+		    const uint8_t *data)
+{
+	int i;
+
+	if (!flash_range(offset, bytes))
+		return EC_ERROR_INVAL;
+	for (i = 0; i < bytes; i++) {
+		if (!write_budget)
+			return EC_ERROR_UNKNOWN;
+		if (write_budget > 0)
+			write_budget--;
+		flash[offset - SPI_FLAGS_REGION + i] &= data[i];
+	}
+	return EC_SUCCESS;
+}
+
+void spi_mux_control(int enable)
+{
+}
+
+static void flash_write_header(int sector, uint32_t seq)
+{
+	struct flash_storage_sector_header hdr = {
+		.magic = FLASH_STORAGE_LOG_MAGIC,
+		.seq = seq,
+	};
+
+	memcpy(&flash[sector * FLASH_STORAGE_SECTOR_SIZE], &hdr, sizeof(hdr));
+}
+
+static void flash_read_header(int sector,
+			      struct flash_storage_sector_header *hdr)
+{
+	memcpy(hdr, &flash[sector * FLASH_STORAGE_SECTOR_SIZE], sizeof(*hdr));
+}
+
+static void flash_read_legacy(struct ec_flash_flags_info *info)
+{
+	memcpy(info, flash, sizeof(*info));
+}
+
+/* Commit the way images before the log did */
+static void flash_commit_legacy(struct ec_flash_flags_info *info)
+{
+	info->update_number++;
+	memset(flash, 0xff, FLASH_STORAGE_SECTOR_SIZE);
+	memcpy(flash, info, sizeof(*info));
+}
+
+/* Start from a blank log holding flag 1 = 3 in sector 1 */
+static int start_log(void)
+{
+	struct flash_storage_sector_header hdr;
+
+	flash_storage_initialize();
+	TEST_EQ(flash_storage_update(1, 3), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+
+	flash_read_header(1, &hdr);
+	TEST_EQ(hdr.magic, FLASH_STORAGE_LOG_MAGIC, "0x%x");
+	TEST_EQ(hdr.seq, 1, "%u");
+
+	return EC_SUCCESS;
+}
+
+static int test_legacy_import(void)
+{
+	struct ec_flash_flags_info legacy = {
+		.magic = FLASH_FLAGS_MAGIC,
+		.length = sizeof(legacy) - 8,
+		.version = FLASH_FLAGS_VERSION,
+		.update_number = 7,
+	};
+	struct flash_storage_sector_header hdr;
+
+	legacy.flags[FLASH_FLAGS_ACPOWERON] = 1;
+	legacy.flags[FLASH_FLAGS_STANDALONE] = 2;
+	memcpy(flash, &legacy, sizeof(legacy));
+
+	TEST_EQ(flash_storage_initialize(), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_get(FLASH_FLAGS_ACPOWERON), 1, "%d");
+	TEST_EQ(flash_storage_get(FLASH_FLAGS_STANDALONE), 2, "%d");
+
+	/*
+	 * The log starts after the old structure, numbered after it, and the
+	 * structure gets the new values.
+	 */
+	TEST_EQ(flash_storage_update(5, 7), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+	flash_read_header(1, &hdr);
+	TEST_EQ(hdr.magic, FLASH_STORAGE_LOG_MAGIC, "0x%x");
+	TEST_EQ(hdr.seq, 8, "%u");
+	legacy.flags[5] = 7;
+	legacy.update_number = 8;
+	TEST_ASSERT_ARRAY_EQ(flash, (uint8_t *)&legacy, sizeof(legacy));
+
+	TEST_EQ(flash_storage_initialize(), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_get(FLASH_FLAGS_ACPOWERON), 1, "%d");
+	TEST_EQ(flash_storage_get(FLASH_FLAGS_STANDALONE), 2, "%d");
+	TEST_EQ(flash_storage_get(5), 7, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_append_replay(void)
+{
+	struct flash_storage_record r;
+
+	TEST_EQ(start_log(), EC_SUCCESS, "%d");
+
+	/* One record per changed flag, after the one written by start_log */
+	TEST_EQ(flash_storage_update(0, 4), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_update(9, 5), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+	memcpy(&r, &flash[FLASH_STORAGE_SECTOR_SIZE + HDR_SIZE + RECORD_SIZE],
+	       sizeof(r));
+	TEST_EQ(r.idx, 0, "%d");
+	TEST_EQ(r.value, 4, "%d");
+	memcpy(&r, &flash[FLASH_STORAGE_SECTOR_SIZE + HDR_SIZE +
+			  2 * RECORD_SIZE], sizeof(r));
+	TEST_EQ(r.idx, 9, "%d");
+	TEST_EQ(r.value, 5, "%d");
+
+	/* Later records win */
+	TEST_EQ(flash_storage_update(0, 6), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+
+	/* Nothing changed, nothing written */
+	TEST_EQ(flash_storage_update(0, 6), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+	TEST_EQ(flash[FLASH_STORAGE_SECTOR_SIZE + HDR_SIZE + 4 * RECORD_SIZE],
+		0xff, "0x%x");
+
+	/* Uncommitted changes are lost */
+	TEST_EQ(flash_storage_update(9, 8), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_initialize(), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_get(0), 6, "%d");
+	TEST_EQ(flash_storage_get(1), 3, "%d");
+	TEST_EQ(flash_storage_get(9), 5, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_compaction(void)
+{
+	struct flash_storage_sector_header hdr;
+	int i;
+
+	TEST_EQ(start_log(), EC_SUCCESS, "%d");
+
+	/* Sector 1 takes the first record and SECTOR_RECORDS - 1 more */
+	for (i = 0; i < SECTOR_RECORDS; i++) {
+		TEST_EQ(flash_storage_update(0, i % 2 ? 10 : 11), EC_SUCCESS,
+			"%d");
+		TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+	}
+
+	/* The last one did not fit, the live values moved to sector 2 */
+	flash_read_header(2, &hdr);
+	TEST_EQ(hdr.magic, FLASH_STORAGE_LOG_MAGIC, "0x%x");
+	TEST_EQ(hdr.seq, 2, "%u");
+	TEST_EQ(flash[2 * FLASH_STORAGE_SECTOR_SIZE + HDR_SIZE +
+		      2 * RECORD_SIZE], 0xff, "0x%x");
+
+	TEST_EQ(flash_storage_initialize(), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_get(0), 10, "%d");
+	TEST_EQ(flash_storage_get(1), 3, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_legacy_refresh(void)
+{
+	struct ec_flash_flags_info legacy;
+	struct flash_storage_sector_header hdr;
+	int i;
+
+	TEST_EQ(start_log(), EC_SUCCESS, "%d");
+	flash_read_legacy(&legacy);
+	TEST_EQ(legacy.magic, FLASH_FLAGS_MAGIC, "0x%x");
+	TEST_EQ(legacy.update_number, 1, "%u");
+	TEST_EQ(legacy.flags[1], 3, "%d");
+
+	/* Appending a record leaves it alone */
+	TEST_EQ(flash_storage_update(0, 4), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+	flash_read_legacy(&legacy);
+	TEST_EQ(legacy.flags[0], 0, "%d");
+
+	/* The log rotates through sectors 1 to 3, sector 0 follows it */
+	for (i = 0; i < 3 * SECTOR_RECORDS; i++) {
+		TEST_EQ(flash_storage_update(0, i % 2 ? 10 : 11), EC_SUCCESS,
+			"%d");
+		TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+	}
+	flash_read_header(1, &hdr);
+	TEST_EQ(hdr.seq, 4, "%u");
+	flash_read_legacy(&legacy);
+	TEST_EQ(legacy.magic, FLASH_FLAGS_MAGIC, "0x%x");
+	TEST_EQ(legacy.update_number, 4, "%u");
+	TEST_EQ(legacy.flags[1], 3, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_rollback(void)
+{
+	struct ec_flash_flags_info legacy;
+
+	TEST_EQ(start_log(), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_update(0, 4), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+
+	/* An older image sees the values of the last compaction */
+	flash_read_legacy(&legacy);
+	TEST_EQ(legacy.flags[1], 3, "%d");
+	legacy.flags[1] = 9;
+	flash_commit_legacy(&legacy);
+
+	/* Back on this image, its commit wins over the log */
+	TEST_EQ(flash_storage_initialize(), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_get(1), 9, "%d");
+	TEST_EQ(flash_storage_get(0), 0, "%d");
+
+	/* And moves to the log with the next change */
+	TEST_EQ(flash_storage_update(2, 5), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_initialize(), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_get(1), 9, "%d");
+	TEST_EQ(flash_storage_get(2), 5, "%d");
+	flash_read_legacy(&legacy);
+	TEST_EQ(legacy.flags[2], 5, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_no_legacy_refresh(void)
+{
+	/* Power goes once the new sector is done, before sector 0 */
+	TEST_EQ(start_log(), EC_SUCCESS, "%d");
+	flash_storage_load_defaults();
+	TEST_EQ(flash_storage_update(0, 1), EC_SUCCESS, "%d");
+	write_budget = RECORD_SIZE + HDR_SIZE;
+	TEST_NE(flash_storage_commit(), EC_SUCCESS, "%d");
+	write_budget = -1;
+
+	/* The older structure does not override the newer log */
+	TEST_EQ(flash_storage_initialize(), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_get(0), 1, "%d");
+	TEST_EQ(flash_storage_get(1), 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_torn_record(void)
+{
+	TEST_EQ(start_log(), EC_SUCCESS, "%d");
+
+	/* Power goes halfway through the record */
+	TEST_EQ(flash_storage_update(1, 0x42), EC_SUCCESS, "%d");
+	write_budget = RECORD_SIZE / 2;
+	TEST_NE(flash_storage_commit(), EC_SUCCESS, "%d");
+	write_budget = -1;
+
+	/* It fails the CRC and is skipped, the next one goes after it */
+	TEST_EQ(flash_storage_initialize(), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_get(1), 3, "%d");
+	TEST_EQ(flash_storage_update(2, 1), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+	TEST_EQ(flash[FLASH_STORAGE_SECTOR_SIZE + HDR_SIZE + 2 * RECORD_SIZE],
+		2, "%d");
+
+	TEST_EQ(flash_storage_initialize(), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_get(1), 3, "%d");
+	TEST_EQ(flash_storage_get(2), 1, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_no_header(void)
+{
+	struct flash_storage_sector_header hdr;
+
+	TEST_EQ(start_log(), EC_SUCCESS, "%d");
+
+	/* Start over in sector 2, power goes once the records are out */
+	flash_storage_load_defaults();
+	TEST_EQ(flash_storage_update(0, 1), EC_SUCCESS, "%d");
+	write_budget = RECORD_SIZE;
+	TEST_NE(flash_storage_commit(), EC_SUCCESS, "%d");
+	write_budget = -1;
+	flash_read_header(2, &hdr);
+	TEST_NE(hdr.magic, FLASH_STORAGE_LOG_MAGIC, "0x%x");
+
+	/* Sector 1 is still the one in use */
+	TEST_EQ(flash_storage_initialize(), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_get(0), 0, "%d");
+	TEST_EQ(flash_storage_get(1), 3, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_seq_wrap(void)
+{
+	struct flash_storage_record r = { .idx = 0, .value = 1 };
+	struct flash_storage_sector_header hdr;
+
+	r.crc = crc8((const uint8_t *)&r, offsetof(struct flash_storage_record,
+						   crc));
+	flash_write_header(2, UINT32_MAX - 1);
+	flash_write_header(3, UINT32_MAX);
+	memcpy(&flash[3 * FLASH_STORAGE_SECTOR_SIZE + HDR_SIZE], &r,
+	       sizeof(r));
+
+	TEST_EQ(flash_storage_initialize(), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_get(0), 1, "%d");
+
+	/* The next sector is 1 with seq 0, and still the newest */
+	flash_storage_load_defaults();
+	TEST_EQ(flash_storage_update(0, 2), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_commit(), EC_SUCCESS, "%d");
+	flash_read_header(1, &hdr);
+	TEST_EQ(hdr.magic, FLASH_STORAGE_LOG_MAGIC, "0x%x");
+	TEST_EQ(hdr.seq, 0, "%u");
+
+	TEST_EQ(flash_storage_initialize(), EC_SUCCESS, "%d");
+	TEST_EQ(flash_storage_get(0), 2, "%d");
+
+	return EC_SUCCESS;
+}
+
+void before_test(void)
+{
+	memset(flash, 0xff, sizeof(flash));
+	write_budget = -1;
+}
+
+void run_test(int argc, char **argv)
+{
+	test_reset();
+
+	RUN_TEST(test_legacy_import);
+	RUN_TEST(test_append_replay);
+	RUN_TEST(test_compaction);
+	RUN_TEST(test_legacy_refresh);
+	RUN_TEST(test_rollback);
+	RUN_TEST(test_no_legacy_refresh);
+	RUN_TEST(test_torn_record);
+	RUN_TEST(test_no_header);
+	RUN_TEST(test_seq_wrap);
+
+	test_print_result();
+}
@@ -0,0 +1,242 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test asynchronous I2C transactions.
+ */
+
+#include "common.h"
+#include "i2c.h"
+#include "task.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+#define TEST_PORT 0
+#define TEST_ADDR_FLAGS 0x2a
+#define TEST_EVENT TASK_EVENT_CUSTOM_BIT(0)
+#define GATE_EVENT TASK_EVENT_CUSTOM_BIT(1)
+
+/* Transactions seen by the device and completions, by first byte sent. */
+static uint8_t dev_log[8], done_log[8];
+static int dev_count, done_count;
+
+/* While set, the device holds transactions on the bus until gate_open(). */
+static volatile int dev_gated;
+
+/* Fills the read buffer with the byte sent plus its index. */
+static int test_dev_xfer(int port, uint16_t addr_flags,
+			 const uint8_t *out, int out_size,
+			 uint8_t *in, int in_size, int flags)
+{
+	int i;
+
+	if (port != TEST_PORT || addr_flags != TEST_ADDR_FLAGS)
+		return EC_ERROR_INVAL;
+	if (out_size < 1)
+		return EC_ERROR_UNKNOWN;
+
+	/* Runs in the I2C_ASYNC task, the test task keeps running. */
+	while (dev_gated)
+		task_wait_event_mask(GATE_EVENT, -1);
+	if (dev_count < ARRAY_SIZE(dev_log))
+		dev_log[dev_count++] = out[0];
+	for (i = 0; i < in_size; i++)
+		in[i] = out[0] + i;
+
+	return EC_SUCCESS;
+}
+DECLARE_TEST_I2C_XFER(test_dev_xfer);
+
+static void test_complete(struct i2c_async_xfer *xfer)
+{
+	if (done_count < ARRAY_SIZE(done_log))
+		done_log[done_count++] = xfer->out[0];
+}
+
+static void gate_open(void)
+{
+	dev_gated = 0;
+	task_set_event(TASK_ID_I2C_ASYNC, GATE_EVENT, 0);
+}
+
+static int event_pending(void)
+{
+	return *task_get_event_bitmap(task_get_current()) & TEST_EVENT;
+}
+
+static void init_xfer(struct i2c_async_xfer *xfer, const uint8_t *out,
+		      uint8_t *in, int in_size)
+{
+	memset(xfer, 0, sizeof(*xfer));
+	xfer->port = TEST_PORT;
+	xfer->slave_addr_flags = TEST_ADDR_FLAGS;
+	xfer->out = out;
+	xfer->out_size = 1;
+	xfer->in = in;
+	xfer->in_size = in_size;
+	xfer->complete = test_complete;
+	xfer->task = task_get_current();
+	xfer->event = TEST_EVENT;
+}
+
+static int test_order(void)
+{
+	static const uint8_t out[3] = { 0x10, 0x20, 0x30 };
+	struct i2c_async_xfer xfer[3];
+	uint8_t in[3][4];
+	int i, j;
+
+	for (i = 0; i < 3; i++) {
+		init_xfer(&xfer[i], &out[i], in[i], sizeof(in[i]));
+		TEST_EQ(i2c_xfer_async(&xfer[i]), EC_SUCCESS, "%d");
+	}
+
+	/* Queued behind each other, the last one done means all done. */
+	TEST_EQ(i2c_xfer_async_wait(&xfer[2], -1), EC_SUCCESS, "%d");
+	for (i = 0; i < 3; i++) {
+		TEST_ASSERT(!xfer[i].pending);
+		TEST_EQ(xfer[i].rv, EC_SUCCESS, "%d");
+		TEST_EQ(dev_log[i], out[i], "0x%x");
+		TEST_EQ(done_log[i], out[i], "0x%x");
+		for (j = 0; j < sizeof(in[i]); j++)
+			TEST_EQ(in[i][j], out[i] + j, "0x%x");
+	}
+	TEST_EQ(dev_count, 3, "%d");
+	TEST_EQ(done_count, 3, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_errors(void)
+{
+	static const uint8_t out = 0x40;
+	struct i2c_async_xfer xfer;
+	uint8_t in;
+
+	init_xfer(&xfer, &out, &in, 1);
+	xfer.port = 7;
+	TEST_EQ(i2c_xfer_async(&xfer), EC_ERROR_INVAL, "%d");
+
+	/* A descriptor can only be queued once at a time. */
+	init_xfer(&xfer, &out, &in, 1);
+	TEST_EQ(i2c_xfer_async(&xfer), EC_SUCCESS, "%d");
+	TEST_EQ(i2c_xfer_async(&xfer), EC_ERROR_BUSY, "%d");
+	TEST_EQ(i2c_xfer_async_wait(&xfer, -1), EC_SUCCESS, "%d");
+
+	/* Bus errors are reported through the descriptor. */
+	init_xfer(&xfer, &out, &in, 1);
+	xfer.slave_addr_flags = TEST_ADDR_FLAGS + 1;
+	TEST_EQ(i2c_xfer_async(&xfer), EC_SUCCESS, "%d");
+	TEST_NE(i2c_xfer_async_wait(&xfer, -1), EC_SUCCESS, "%d");
+	TEST_EQ(done_count, 2, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_timeout(void)
+{
+	static const uint8_t out = 0x50;
+	struct i2c_async_xfer xfer;
+	uint8_t in;
+
+	dev_gated = 1;
+	init_xfer(&xfer, &out, &in, 1);
+	TEST_EQ(i2c_xfer_async(&xfer), EC_SUCCESS, "%d");
+	TEST_EQ(i2c_xfer_async_wait(&xfer, 5 * MSEC), EC_ERROR_TIMEOUT, "%d");
+	TEST_ASSERT(xfer.pending);
+	gate_open();
+	TEST_EQ(i2c_xfer_async_wait(&xfer, -1), EC_SUCCESS, "%d");
+	TEST_EQ(in, out, "0x%x");
+
+	return EC_SUCCESS;
+}
+
+static int test_event_consumed(void)
+{
+	static const uint8_t out = 0x58;
+	struct i2c_async_xfer xfer;
+	uint8_t in;
+	int i;
+
+	/*
+	 * The event is posted after pending is cleared, the wait must take it
+	 * so it does not wake the caller again once it has moved on.
+	 */
+	for (i = 0; i < 4; i++) {
+		init_xfer(&xfer, &out, &in, 1);
+		TEST_EQ(i2c_xfer_async(&xfer), EC_SUCCESS, "%d");
+		TEST_EQ(i2c_xfer_async_wait(&xfer, -1), EC_SUCCESS, "%d");
+		TEST_ASSERT(!xfer.pending);
+		TEST_ASSERT(!event_pending());
+	}
+
+	/* Same when the transaction is done before the caller waits. */
+	init_xfer(&xfer, &out, &in, 1);
+	TEST_EQ(i2c_xfer_async(&xfer), EC_SUCCESS, "%d");
+	while (xfer.pending)
+		task_wait_event_mask(TASK_EVENT_TIMER, 100);
+	TEST_ASSERT(event_pending());
+	TEST_EQ(i2c_xfer_async_wait(&xfer, -1), EC_SUCCESS, "%d");
+	TEST_ASSERT(!event_pending());
+
+	/* Waiting needs an event to wait for. */
+	init_xfer(&xfer, &out, &in, 1);
+	xfer.event = 0;
+	TEST_EQ(i2c_xfer_async_wait(&xfer, -1), EC_ERROR_INVAL, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_overlap(void)
+{
+	static const uint8_t out[2] = { 0x60, 0x70 };
+	struct i2c_async_xfer xfer[2];
+	uint8_t in[2];
+
+	/*
+	 * Double buffering: while one transaction is on the bus, the caller
+	 * works on the previous result. The device holds the bus until the
+	 * caller is done with its work, so the work ran during the transfer.
+	 */
+	init_xfer(&xfer[0], &out[0], &in[0], 1);
+	init_xfer(&xfer[1], &out[1], &in[1], 1);
+
+	TEST_EQ(i2c_xfer_async(&xfer[0]), EC_SUCCESS, "%d");
+	TEST_EQ(i2c_xfer_async_wait(&xfer[0], -1), EC_SUCCESS, "%d");
+
+	dev_gated = 1;
+	TEST_EQ(i2c_xfer_async(&xfer[1]), EC_SUCCESS, "%d");
+	/* Process the first block while the second one is on the bus. */
+	TEST_EQ(in[0], out[0], "0x%x");
+	TEST_ASSERT(xfer[1].pending);
+	TEST_EQ(done_count, 1, "%d");
+	gate_open();
+
+	TEST_EQ(i2c_xfer_async_wait(&xfer[1], -1), EC_SUCCESS, "%d");
+	TEST_EQ(in[1], out[1], "0x%x");
+	TEST_EQ(done_count, 2, "%d");
+	TEST_ASSERT(!event_pending());
+
+	return EC_SUCCESS;
+}
+
+void before_test(void)
+{
+	dev_count = 0;
+	done_count = 0;
+	dev_gated = 0;
+}
+
+void run_test(int argc, char **argv)
+{
+	test_reset();
+
+	RUN_TEST(test_order);
+	RUN_TEST(test_errors);
+	RUN_TEST(test_timeout);
+	RUN_TEST(test_event_consumed);
+	RUN_TEST(test_overlap);
+
+	test_print_result();
+}
@@ -0,0 +1,281 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test multi-message I2C transactions.
+ */
+
+#include "common.h"
+#include "i2c.h"
+#include "test_util.h"
+#include "util.h"
+
+#define TEST_PORT 0
+#define TEST_ADDR_FLAGS 0x2a
+
+/*
+ * Register file with an auto-incremented pointer, written by the first byte
+ * after a START. Calls to the device and their flags are logged.
+ */
+static uint8_t regs[32];
+static int reg_ptr;
+static int calls;
+static int call_flags[8];
+static int call_out[8], call_in[8];
+static int fail_reg = -1;
+static int nack_cont;
+
+static int test_dev_xfer(int port, uint16_t addr_flags,
+			 const uint8_t *out, int out_size,
+			 uint8_t *in, int in_size, int flags)
+{
+	int i;
+
+	if (port != TEST_PORT || addr_flags != TEST_ADDR_FLAGS)
+		return EC_ERROR_INVAL;
+
+	if (calls < ARRAY_SIZE(call_flags)) {
+		call_flags[calls] = flags;
+		call_out[calls] = out_size;
+		call_in[calls] = in_size;
+	}
+	calls++;
+
+	/* NACK the data continuing a write, as a busy device would */
+	if (!(flags & I2C_XFER_START) && nack_cont) {
+		nack_cont--;
+		return EC_ERROR_BUSY;
+	}
+
+	for (i = 0; i < out_size; i++) {
+		if ((flags & I2C_XFER_START) && i == 0) {
+			reg_ptr = out[0];
+			if (reg_ptr == fail_reg)
+				return EC_ERROR_UNKNOWN;
+			continue;
+		}
+		regs[reg_ptr++ % ARRAY_SIZE(regs)] = out[i];
+	}
+	for (i = 0; i < in_size; i++)
+		in[i] = regs[reg_ptr++ % ARRAY_SIZE(regs)];
+
+	return EC_SUCCESS;
+}
+DECLARE_TEST_I2C_XFER(test_dev_xfer);
+
+static int test_two_blocks(void)
+{
+	uint8_t reg0[] = { 4 }, reg1[] = { 16 };
+	uint8_t data0[] = { 0xa0, 0xa1, 0xa2 }, data1[] = { 0xb0, 0xb1 };
+	struct i2c_msg msgs[] = {
+		{ TEST_ADDR_FLAGS, 0, reg0, sizeof(reg0) },
+		{ TEST_ADDR_FLAGS, I2C_MSG_NOSTART, data0, sizeof(data0) },
+		{ TEST_ADDR_FLAGS, 0, reg1, sizeof(reg1) },
+		{ TEST_ADDR_FLAGS, I2C_MSG_NOSTART, data1, sizeof(data1) },
+	};
+
+	TEST_EQ(i2c_xfer_msgs(TEST_PORT, msgs, ARRAY_SIZE(msgs)), EC_SUCCESS,
+		"%d");
+	TEST_ASSERT_ARRAY_EQ(&regs[4], data0, sizeof(data0));
+	TEST_ASSERT_ARRAY_EQ(&regs[16], data1, sizeof(data1));
+
+	/* START, continue, repeated START, continue then STOP */
+	TEST_EQ(calls, 4, "%d");
+	TEST_EQ(call_flags[0], I2C_XFER_START, "%d");
+	TEST_EQ(call_flags[1], 0, "%d");
+	TEST_EQ(call_flags[2], I2C_XFER_START, "%d");
+	TEST_EQ(call_flags[3], I2C_XFER_STOP, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_write_read(void)
+{
+	uint8_t reg[] = { 8 }, in[4];
+	struct i2c_msg msgs[] = {
+		{ TEST_ADDR_FLAGS, 0, reg, sizeof(reg) },
+		{ TEST_ADDR_FLAGS, I2C_MSG_READ, in, sizeof(in) },
+	};
+	int i;
+
+	for (i = 0; i < sizeof(in); i++)
+		regs[8 + i] = 0x80 + i;
+
+	/* Handed to the chip driver as one write-then-read */
+	TEST_EQ(i2c_xfer_msgs(TEST_PORT, msgs, ARRAY_SIZE(msgs)), EC_SUCCESS,
+		"%d");
+	TEST_EQ(calls, 1, "%d");
+	TEST_EQ(call_flags[0], I2C_XFER_SINGLE, "%d");
+	TEST_EQ(call_out[0], 1, "%d");
+	TEST_EQ(call_in[0], 4, "%d");
+	TEST_ASSERT_ARRAY_EQ(in, &regs[8], sizeof(in));
+
+	return EC_SUCCESS;
+}
+
+static int test_continued_write_read(void)
+{
+	uint8_t reg[] = { 10 }, data[] = { 0xe0 }, in[2];
+	struct i2c_msg msgs[] = {
+		{ TEST_ADDR_FLAGS, 0, reg, sizeof(reg) },
+		{ TEST_ADDR_FLAGS, I2C_MSG_NOSTART, data, sizeof(data) },
+		{ TEST_ADDR_FLAGS, I2C_MSG_READ, in, sizeof(in) },
+	};
+
+	/* The read gets its own repeated START after the continued write */
+	TEST_EQ(i2c_xfer_msgs(TEST_PORT, msgs, ARRAY_SIZE(msgs)), EC_SUCCESS,
+		"%d");
+	TEST_EQ(calls, 3, "%d");
+	TEST_EQ(call_flags[0], I2C_XFER_START, "%d");
+	TEST_EQ(call_flags[1], 0, "%d");
+	TEST_EQ(call_out[1], 1, "%d");
+	TEST_EQ(call_in[1], 0, "%d");
+	TEST_EQ(call_flags[2], I2C_XFER_SINGLE, "%d");
+	TEST_EQ(call_in[2], 2, "%d");
+	TEST_EQ(regs[10], 0xe0, "%x");
+
+	return EC_SUCCESS;
+}
+
+static int test_stop_between(void)
+{
+	uint8_t reg0[] = { 0, 0x11 }, reg1[] = { 1, 0x22 };
+	struct i2c_msg msgs[] = {
+		{ TEST_ADDR_FLAGS, I2C_MSG_STOP, reg0, sizeof(reg0) },
+		{ TEST_ADDR_FLAGS, 0, reg1, sizeof(reg1) },
+	};
+
+	TEST_EQ(i2c_xfer_msgs(TEST_PORT, msgs, ARRAY_SIZE(msgs)), EC_SUCCESS,
+		"%d");
+	TEST_EQ(calls, 2, "%d");
+	TEST_EQ(call_flags[0], I2C_XFER_SINGLE, "%d");
+	TEST_EQ(call_flags[1], I2C_XFER_SINGLE, "%d");
+	TEST_EQ(regs[0], 0x11, "%x");
+	TEST_EQ(regs[1], 0x22, "%x");
+
+	return EC_SUCCESS;
+}
+
+static int test_invalid(void)
+{
+	uint8_t buf[2];
+	struct i2c_msg first[] = {
+		{ TEST_ADDR_FLAGS, I2C_MSG_NOSTART, buf, sizeof(buf) },
+	};
+	struct i2c_msg turn[] = {
+		{ TEST_ADDR_FLAGS, 0, buf, 1 },
+		{ TEST_ADDR_FLAGS, I2C_MSG_READ | I2C_MSG_NOSTART, buf, 1 },
+	};
+	struct i2c_msg stopped[] = {
+		{ TEST_ADDR_FLAGS, I2C_MSG_STOP, buf, 1 },
+		{ TEST_ADDR_FLAGS, I2C_MSG_NOSTART, buf, 1 },
+	};
+
+	buf[0] = 0;
+	TEST_EQ(i2c_xfer_msgs(TEST_PORT, first, ARRAY_SIZE(first)),
+		EC_ERROR_INVAL, "%d");
+	TEST_EQ(i2c_xfer_msgs(TEST_PORT, turn, ARRAY_SIZE(turn)),
+		EC_ERROR_INVAL, "%d");
+	TEST_EQ(i2c_xfer_msgs(TEST_PORT, stopped, ARRAY_SIZE(stopped)),
+		EC_ERROR_INVAL, "%d");
+	TEST_EQ(calls, 0, "%d");
+
+	/* The emulated bus rejects a continuation once released */
+	i2c_lock(TEST_PORT, 1);
+	TEST_EQ(i2c_xfer_unlocked(TEST_PORT, TEST_ADDR_FLAGS, buf, 1,
+				  NULL, 0, I2C_XFER_STOP),
+		EC_ERROR_UNKNOWN, "%d");
+	i2c_lock(TEST_PORT, 0);
+
+	return EC_SUCCESS;
+}
+
+static int test_error_stops(void)
+{
+	uint8_t reg0[] = { 2, 0x33 }, reg1[] = { 5, 0x44 }, reg2[] = { 3, 0x55 };
+	struct i2c_msg msgs[] = {
+		{ TEST_ADDR_FLAGS, 0, reg0, sizeof(reg0) },
+		{ TEST_ADDR_FLAGS, 0, reg1, sizeof(reg1) },
+		{ TEST_ADDR_FLAGS, 0, reg2, sizeof(reg2) },
+	};
+
+	fail_reg = 5;
+	TEST_EQ(i2c_xfer_msgs(TEST_PORT, msgs, ARRAY_SIZE(msgs)),
+		EC_ERROR_UNKNOWN, "%d");
+	fail_reg = -1;
+	TEST_EQ(calls, 2, "%d");
+	TEST_EQ(regs[2], 0x33, "%x");
+	TEST_EQ(regs[3], 0, "%x");
+
+	/* The bus was released, the next transaction starts cleanly */
+	TEST_EQ(i2c_xfer_msgs(TEST_PORT, &msgs[2], 1), EC_SUCCESS, "%d");
+	TEST_EQ(regs[3], 0x55, "%x");
+
+	return EC_SUCCESS;
+}
+
+static int test_nack_restarts(void)
+{
+	uint8_t reg0[] = { 6 }, reg1[] = { 20 };
+	uint8_t data0[] = { 0xc0, 0xc1 }, data1[] = { 0xd0 };
+	struct i2c_msg msgs[] = {
+		{ TEST_ADDR_FLAGS, 0, reg0, sizeof(reg0) },
+		{ TEST_ADDR_FLAGS, I2C_MSG_NOSTART, data0, sizeof(data0) },
+		{ TEST_ADDR_FLAGS, 0, reg1, sizeof(reg1) },
+		{ TEST_ADDR_FLAGS, I2C_MSG_NOSTART, data1, sizeof(data1) },
+	};
+
+	/* The bus was released: retry from the START, not the data */
+	nack_cont = 1;
+	TEST_EQ(i2c_xfer_msgs(TEST_PORT, msgs, ARRAY_SIZE(msgs)), EC_SUCCESS,
+		"%d");
+	TEST_EQ(calls, 6, "%d");
+	TEST_EQ(call_flags[1], 0, "%d");
+	TEST_EQ(call_flags[2], I2C_XFER_START, "%d");
+	TEST_EQ(call_out[2], 1, "%d");
+	TEST_ASSERT_ARRAY_EQ(&regs[6], data0, sizeof(data0));
+	TEST_ASSERT_ARRAY_EQ(&regs[20], data1, sizeof(data1));
+
+	/* Retries are bounded */
+	calls = 0;
+	nack_cont = CONFIG_I2C_NACK_RETRY_COUNT + 1;
+	TEST_EQ(i2c_xfer_msgs(TEST_PORT, msgs, ARRAY_SIZE(msgs)),
+		EC_ERROR_BUSY, "%d");
+	TEST_EQ(calls, 2 * (CONFIG_I2C_NACK_RETRY_COUNT + 1), "%d");
+
+	/* A lone continuation is not replayed without its START */
+	calls = 0;
+	nack_cont = 1;
+	i2c_lock(TEST_PORT, 1);
+	TEST_EQ(i2c_xfer_unlocked(TEST_PORT, TEST_ADDR_FLAGS, reg0, 1,
+				  NULL, 0, I2C_XFER_START), EC_SUCCESS, "%d");
+	TEST_EQ(i2c_xfer_unlocked(TEST_PORT, TEST_ADDR_FLAGS, data0, 1,
+				  NULL, 0, I2C_XFER_STOP), EC_ERROR_BUSY, "%d");
+	i2c_lock(TEST_PORT, 0);
+	TEST_EQ(calls, 2, "%d");
+
+	return EC_SUCCESS;
+}
+
+void before_test(void)
+{
+	memset(regs, 0, sizeof(regs));
+	calls = 0;
+	fail_reg = -1;
+	nack_cont = 0;
+}
+
+void run_test(int argc, char **argv)
+{
+	test_reset();
+
+	RUN_TEST(test_two_blocks);
+	RUN_TEST(test_write_read);
+	RUN_TEST(test_continued_write_read);
+	RUN_TEST(test_stop_between);
+	RUN_TEST(test_invalid);
+	RUN_TEST(test_error_stops);
+	RUN_TEST(test_nack_restarts);
+
+	test_print_result();
+}
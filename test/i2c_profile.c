@@ -0,0 +1,230 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * Test the I2C profiler.
+ */
+
+#include "common.h"
+#include "console.h"
+#include "ec_commands.h"
+#include "i2c.h"
+#include "task.h"
+#include "test_util.h"
+#include "timer.h"
+#include "util.h"
+
+#define TEST_PORT 0
+#define TEST_ADDR_FLAGS 0x2a
+#define PROFILE_CMD EC_PRIVATE_HOST_COMMAND_VALUE(EC_CMD_I2C_PROFILE)
+
+/* Each transfer takes that long, NACKs are returned while nacks is set. */
+static int dev_delay_us;
+static int nacks;
+
+/* Answers 0x2a to 0x2c. */
+static int test_dev_xfer(int port, uint16_t addr_flags,
+			 const uint8_t *out, int out_size,
+			 uint8_t *in, int in_size, int flags)
+{
+	if (port != TEST_PORT || addr_flags < TEST_ADDR_FLAGS ||
+	    addr_flags > TEST_ADDR_FLAGS + 2)
+		return EC_ERROR_INVAL;
+
+	if (dev_delay_us)
+		udelay(dev_delay_us);
+	if (nacks) {
+		nacks--;
+		return EC_ERROR_BUSY;
+	}
+	memset(in, 0x5a, in_size);
+
+	return EC_SUCCESS;
+}
+DECLARE_TEST_I2C_XFER(test_dev_xfer);
+
+/* Holds the port for 10ms when woken up. */
+static volatile int holding;
+
+void holder_task(void *p)
+{
+	while (1) {
+		task_wait_event(-1);
+		i2c_lock(TEST_PORT, 1);
+		holding = 1;
+		msleep(10);
+		holding = 0;
+		i2c_lock(TEST_PORT, 0);
+	}
+}
+
+static int get_profile(struct ec_response_i2c_profile *r, int size,
+		       int flags)
+{
+	struct ec_params_i2c_profile p = {
+		.port = TEST_PORT,
+		.flags = flags,
+	};
+
+	return test_send_host_command(PROFILE_CMD, 0, &p, sizeof(p),
+				      r, size);
+}
+
+static struct {
+	struct ec_response_i2c_profile r;
+	struct ec_i2c_profile_slave slaves[CONFIG_I2C_PROFILE_SLAVES];
+} resp;
+
+static int test_counts(void)
+{
+	uint8_t out[2] = { 0 }, in[4];
+	int i;
+
+	dev_delay_us = 500;
+	for (i = 0; i < 3; i++)
+		TEST_EQ(i2c_xfer(TEST_PORT, TEST_ADDR_FLAGS, out, sizeof(out),
+				 in, sizeof(in)), EC_SUCCESS, "%d");
+
+	TEST_EQ(get_profile(&resp.r, sizeof(resp), 0), EC_RES_SUCCESS, "%d");
+	TEST_EQ(resp.r.xfers, 3, "%d");
+	TEST_EQ(resp.r.locks, 3, "%d");
+	TEST_EQ(resp.r.slave_count, 1, "%d");
+	TEST_EQ(resp.r.num_slaves, 1, "%d");
+	TEST_EQ(resp.slaves[0].addr_flags, TEST_ADDR_FLAGS, "0x%x");
+	TEST_EQ(resp.slaves[0].xfers, 3, "%d");
+	TEST_EQ(resp.slaves[0].bytes, 18, "%d");
+	TEST_EQ(resp.slaves[0].errors, 0, "%d");
+	TEST_GE(resp.slaves[0].max_us, 500, "%d");
+	TEST_GE((int)resp.slaves[0].busy_us, 1500, "%d");
+	TEST_EQ((int)resp.r.busy_us, (int)resp.slaves[0].busy_us, "%d");
+	TEST_GE((int)resp.r.window_us, (int)resp.r.busy_us, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_errors_retries(void)
+{
+	uint8_t out = 0;
+
+	/* Two NACKs are retried, the third attempt goes through. */
+	nacks = 2;
+	TEST_EQ(i2c_xfer(TEST_PORT, TEST_ADDR_FLAGS, &out, 1, NULL, 0),
+		EC_SUCCESS, "%d");
+	/* Three NACKs fail the transfer. */
+	nacks = 3;
+	TEST_EQ(i2c_xfer(TEST_PORT, TEST_ADDR_FLAGS, &out, 1, NULL, 0),
+		EC_ERROR_BUSY, "%d");
+
+	TEST_EQ(get_profile(&resp.r, sizeof(resp), 0), EC_RES_SUCCESS, "%d");
+	TEST_EQ(resp.slaves[0].xfers, 6, "%d");
+	TEST_EQ(resp.slaves[0].errors, 5, "%d");
+	TEST_EQ(resp.slaves[0].retries, 4, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_lock_wait(void)
+{
+	uint8_t out = 0;
+
+	/* Wakes sent before the task first runs are dropped, retry. */
+	while (!holding) {
+		task_wake(TASK_ID_HOLDER);
+		msleep(1);
+	}
+	TEST_EQ(i2c_xfer(TEST_PORT, TEST_ADDR_FLAGS, &out, 1, NULL, 0),
+		EC_SUCCESS, "%d");
+
+	TEST_EQ(get_profile(&resp.r, sizeof(resp), 0), EC_RES_SUCCESS, "%d");
+	TEST_EQ(resp.r.locks, 2, "%d");
+	TEST_GE(resp.r.lock_wait_max_us, 5000, "%d");
+	TEST_GE((int)resp.r.lock_wait_us, (int)resp.r.lock_wait_max_us, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_untracked(void)
+{
+	uint8_t out = 0;
+	int i;
+
+	for (i = 0; i < 3; i++)
+		TEST_EQ(i2c_xfer(TEST_PORT, TEST_ADDR_FLAGS + i, &out, 1,
+				 NULL, 0), EC_SUCCESS, "%d");
+
+	/* The table holds two slaves, the third one is only counted. */
+	TEST_EQ(get_profile(&resp.r, sizeof(resp), 0), EC_RES_SUCCESS, "%d");
+	TEST_EQ(resp.r.xfers, 3, "%d");
+	TEST_EQ(resp.r.untracked, 1, "%d");
+	TEST_EQ(resp.r.slave_count, 2, "%d");
+	TEST_EQ(resp.slaves[1].addr_flags, TEST_ADDR_FLAGS + 1, "0x%x");
+	TEST_EQ(resp.slaves[1].xfers, 1, "%d");
+
+	/* Reporting from the second slave on */
+	{
+		struct ec_params_i2c_profile p = {
+			.port = TEST_PORT,
+			.first = 1,
+		};
+
+		TEST_EQ(test_send_host_command(PROFILE_CMD, 0, &p,
+					       sizeof(p), &resp, sizeof(resp)),
+			EC_RES_SUCCESS, "%d");
+		TEST_EQ(resp.r.num_slaves, 1, "%d");
+		TEST_EQ(resp.slaves[0].addr_flags, TEST_ADDR_FLAGS + 1,
+			"0x%x");
+	}
+
+	return EC_SUCCESS;
+}
+
+static int test_window_reset(void)
+{
+	uint8_t out = 0;
+
+	TEST_EQ(i2c_xfer(TEST_PORT, TEST_ADDR_FLAGS, &out, 1, NULL, 0),
+		EC_SUCCESS, "%d");
+	TEST_EQ(get_profile(&resp.r, sizeof(resp), EC_I2C_PROFILE_RESET),
+		EC_RES_SUCCESS, "%d");
+	TEST_EQ(resp.r.xfers, 1, "%d");
+
+	/* Slaves keep their slot, their counters start over. */
+	TEST_EQ(get_profile(&resp.r, sizeof(resp), 0), EC_RES_SUCCESS, "%d");
+	TEST_EQ(resp.r.xfers, 0, "%d");
+	TEST_EQ(resp.r.slave_count, 2, "%d");
+	TEST_EQ(resp.slaves[0].xfers, 0, "%d");
+	TEST_EQ(resp.slaves[1].xfers, 0, "%d");
+	TEST_LT((int)resp.r.window_us, 1000, "%d");
+
+	TEST_EQ(get_profile(&resp.r, sizeof(resp.r) - 1, 0),
+		EC_RES_RESPONSE_TOO_BIG, "%d");
+	{
+		struct ec_params_i2c_profile p = { .port = 1 };
+
+		TEST_EQ(test_send_host_command(PROFILE_CMD, 0, &p,
+					       sizeof(p), &resp, sizeof(resp)),
+			EC_RES_INVALID_PARAM, "%d");
+	}
+
+	return EC_SUCCESS;
+}
+
+void before_test(void)
+{
+	dev_delay_us = 0;
+	nacks = 0;
+	get_profile(&resp.r, sizeof(resp), EC_I2C_PROFILE_RESET);
+}
+
+void run_test(int argc, char **argv)
+{
+	test_reset();
+
+	RUN_TEST(test_counts);
+	RUN_TEST(test_errors_retries);
+	RUN_TEST(test_lock_wait);
+	RUN_TEST(test_untracked);
+	RUN_TEST(test_window_reset);
+
+	test_print_result();
+}
@@ -141,6 +141,48 @@ int verify_key_v2(int c, int r, int pressed, int expect_more)
 	return 1;
 }
 
+int verify_keys_batched(int expect_count, int expect_more)
+{
+	struct host_cmd_handler_args args;
+	struct ec_params_get_next_events params;
+	uint8_t resp[sizeof(struct ec_response_get_next_events) +
+		     8 * sizeof(struct ec_mkbp_event_record)];
+	struct ec_response_get_next_events *r = (void *)resp;
+	const uint8_t *rec = r->records;
+	int i;
+
+	params.max_events = 0;
+	args.version = 0;
+	args.command = EC_PRIVATE_HOST_COMMAND_VALUE(EC_CMD_GET_NEXT_EVENTS);
+	args.params = &params;
+	args.params_size = sizeof(params);
+	args.response = resp;
+	args.response_max = sizeof(resp);
+	args.response_size = 0;
+
+	ccprintf("Verify %d batched events. Expect %smore.\n", expect_count,
+		 expect_more ? "" : "no ");
+	if (host_command_process(&args) != EC_RES_SUCCESS)
+		return 0;
+
+	if (r->count != expect_count ||
+	    !!(r->flags & EC_MKBP_HAS_MORE_EVENTS) != expect_more)
+		return 0;
+
+	for (i = 0; i < r->count; i++) {
+		const struct ec_mkbp_event_record *e = (const void *)rec;
+
+		if (e->event_type != EC_MKBP_EVENT_KEY_MATRIX ||
+		    e->size != KEYBOARD_COLS_MAX)
+			return 0;
+		rec += offsetof(struct ec_mkbp_event_record, data) + e->size;
+	}
+
+	/* The last record holds the latest matrix state */
+	rec -= KEYBOARD_COLS_MAX;
+	return !memcmp(rec, state, KEYBOARD_COLS_MAX);
+}
+
 int mkbp_config(struct ec_params_mkbp_set_config params)
 {
 	struct host_cmd_handler_args args;
@@ -237,6 +279,24 @@ int single_key_press_v2(void)
 	return EC_SUCCESS;
 }
 
+int batched_key_press(void)
+{
+	keyboard_clear_buffer();
+	clear_state();
+	TEST_ASSERT(press_key(0, 0, 1) == EC_SUCCESS);
+	TEST_ASSERT(press_key(1, 1, 1) == EC_SUCCESS);
+	TEST_ASSERT(press_key(0, 0, 0) == EC_SUCCESS);
+	TEST_ASSERT(press_key(1, 1, 0) == EC_SUCCESS);
+	TEST_ASSERT(FIFO_NOT_EMPTY());
+
+	/* All four events fit in a single response. */
+	TEST_ASSERT(verify_keys_batched(4, 0));
+	TEST_ASSERT(FIFO_EMPTY());
+	TEST_ASSERT(verify_key(-1, -1, -1));
+
+	return EC_SUCCESS;
+}
+
 int test_fifo_size(void)
 {
 	keyboard_clear_buffer();
@@ -295,6 +355,7 @@ void run_test(int argc, char **argv)
 	clear_mkbp_events();
 	RUN_TEST(single_key_press);
 	RUN_TEST(single_key_press_v2);
+	RUN_TEST(batched_key_press);
 	RUN_TEST(test_fifo_size);
 	RUN_TEST(test_enable);
 	RUN_TEST(fifo_underrun);
@@ -33,7 +33,7 @@ static int accel_get_range(const struct motion_sensor_t *s)
 
 static int accel_get_resolution(const struct motion_sensor_t *s)
 {
-#ifdef TEST_BODY_DETECTION
+#ifdef CONFIG_BODY_DETECTION
 	/* Assume we are using BMI160 */
 	return BMI_RESOLUTION;
 #endif
@@ -55,7 +55,7 @@ static int accel_get_data_rate(const struct motion_sensor_t *s)
 	return test_data_rate[s - motion_sensors];
 }
 
-#ifdef TEST_BODY_DETECTION
+#ifdef CONFIG_BODY_DETECTION
 static int accel_get_rms_noise(const struct motion_sensor_t *s)
 {
 	/* Assume we are using BMI160 */
@@ -157,16 +157,30 @@ const unsigned int motion_sensor_count = ARRAY_SIZE(motion_sensors);
 
 /*****************************************************************************/
 /* Test utilities */
+/*
+ * With CONFIG_LID_ANGLE_STREAMING, the filtered gravity vectors need a few
+ * samples to settle on a new position.
+ */
+#ifdef CONFIG_LID_ANGLE_STREAMING
+#define TEST_LID_SETTLE_SAMPLES 16
+#else
+#define TEST_LID_SETTLE_SAMPLES 1
+#endif
+
 static void wait_for_valid_sample(void)
 {
 	uint8_t sample;
 	uint8_t *lpc_status = host_get_memmap(EC_MEMMAP_ACC_STATUS);
-
-	sample = *lpc_status & EC_MEMMAP_ACC_STATUS_SAMPLE_ID_MASK;
-	usleep(TEST_LID_EC_RATE);
-	task_wake(TASK_ID_MOTIONSENSE);
-	while ((*lpc_status & EC_MEMMAP_ACC_STATUS_SAMPLE_ID_MASK) == sample)
-		usleep(TEST_LID_SLEEP_RATE);
+	int i;
+
+	for (i = 0; i < TEST_LID_SETTLE_SAMPLES; i++) {
+		sample = *lpc_status & EC_MEMMAP_ACC_STATUS_SAMPLE_ID_MASK;
+		usleep(TEST_LID_EC_RATE);
+		task_wake(TASK_ID_MOTIONSENSE);
+		while ((*lpc_status & EC_MEMMAP_ACC_STATUS_SAMPLE_ID_MASK) ==
+		       sample)
+			usleep(TEST_LID_SLEEP_RATE);
+	}
 }
 
 static int test_lid_angle(void)
@@ -331,12 +345,81 @@ static int test_lid_angle(void)
 	return EC_SUCCESS;
 }
 
+#ifdef CONFIG_LID_ANGLE_STREAMING
+static int test_lid_angle_streaming(void)
+{
+	struct motion_sensor_t *base = &motion_sensors[
+		CONFIG_LID_ANGLE_SENSOR_BASE];
+	struct motion_sensor_t *lid = &motion_sensors[
+		CONFIG_LID_ANGLE_SENSOR_LID];
+	int i;
+
+	/*
+	 * The motion sense task does not run while the test is busy, so
+	 * after the lid switch settles the estimator is fed directly.
+	 */
+	base->xyz[X] = 0;
+	base->xyz[Y] = 0;
+	base->xyz[Z] = ONE_G_MEASURED;
+	lid->xyz[X] = 0;
+	lid->xyz[Y] = ONE_G_MEASURED;
+	lid->xyz[Z] = 0;
+	gpio_set_level(GPIO_LID_OPEN, 1);
+	msleep(100);
+	for (i = 0; i < TEST_LID_SETTLE_SAMPLES; i++)
+		motion_lid_update(BIT(CONFIG_LID_ANGLE_SENSOR_BASE) |
+				  BIT(CONFIG_LID_ANGLE_SENSOR_LID));
+	TEST_EQ(motion_lid_get_angle(), 90, "%d");
+
+	/* Only the lid reports: the angle follows without a base sample. */
+	lid->xyz[Y] = 0;
+	lid->xyz[Z] = ONE_G_MEASURED;
+	for (i = 0; i < TEST_LID_SETTLE_SAMPLES; i++)
+		motion_lid_update(BIT(CONFIG_LID_ANGLE_SENSOR_LID));
+	TEST_EQ(motion_lid_get_angle(), 180, "%d");
+
+	/* A lone noisy sample only moves the angle half of its 6 degrees. */
+	lid->xyz[Y] = -ONE_G_MEASURED * 0.1;
+	motion_lid_update(BIT(CONFIG_LID_ANGLE_SENSOR_LID));
+	TEST_EQ(motion_lid_get_angle(), 182, "%d");
+	lid->xyz[Y] = 0;
+	for (i = 0; i < TEST_LID_SETTLE_SAMPLES; i++)
+		motion_lid_update(BIT(CONFIG_LID_ANGLE_SENSOR_LID));
+	TEST_EQ(motion_lid_get_angle(), 180, "%d");
+
+	/* Same for the base alone, tilting the whole device. */
+	base->xyz[Y] = ONE_G_MEASURED * 0.707106;
+	base->xyz[Z] = ONE_G_MEASURED * 0.707106;
+	for (i = 0; i < TEST_LID_SETTLE_SAMPLES; i++)
+		motion_lid_update(BIT(CONFIG_LID_ANGLE_SENSOR_BASE));
+	TEST_EQ(motion_lid_get_angle(), 225, "%d");
+
+	/* Noise below the cache tolerance keeps the cached angle. */
+	base->xyz[Y] += 3;
+	for (i = 0; i < TEST_LID_SETTLE_SAMPLES; i++)
+		motion_lid_update(BIT(CONFIG_LID_ANGLE_SENSOR_BASE) |
+				  BIT(CONFIG_LID_ANGLE_SENSOR_LID));
+	TEST_EQ(motion_lid_get_angle(), 225, "%d");
+
+	/* A small real move goes past the tolerance. */
+	base->xyz[Y] = ONE_G_MEASURED * 0.731354;
+	base->xyz[Z] = ONE_G_MEASURED * 0.681998;
+	for (i = 0; i < TEST_LID_SETTLE_SAMPLES; i++)
+		motion_lid_update(BIT(CONFIG_LID_ANGLE_SENSOR_BASE));
+	TEST_EQ(motion_lid_get_angle(), 227, "%d");
+
+	return EC_SUCCESS;
+}
+#endif
 
 void run_test(int argc, char **argv)
 {
 	test_reset();
 
 	RUN_TEST(test_lid_angle);
+#ifdef CONFIG_LID_ANGLE_STREAMING
+	RUN_TEST(test_lid_angle_streaming);
+#endif
 
 	test_print_result();
 }
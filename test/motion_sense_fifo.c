@@ -175,6 +175,7 @@ static int test_stage_data_remove_all_oversampling(void)
 	return EC_SUCCESS;
 }
 
+#ifndef CONFIG_ACCEL_FIFO_COMPACT
 static int test_stage_data_evicts_data_with_timestamp(void)
 {
 	int i, read_count;
@@ -198,6 +199,7 @@ static int test_stage_data_evicts_data_with_timestamp(void)
 
 	return EC_SUCCESS;
 }
+#endif
 
 static int test_add_data_no_spreading_when_different_sensors(void)
 {
@@ -343,6 +345,285 @@ static int test_commit_non_data_or_timestamp_entries(void)
 	return EC_SUCCESS;
 }
 
+/* Two sensors at 400Hz, drained 8 samples each per interrupt */
+#define BATCH_ODR_PERIOD 2500
+#define BATCH_SAMPLES 16
+#define BENCH_ITERATIONS 20000
+
+static struct ec_response_motion_sensor_data batch[BATCH_SAMPLES];
+static struct ec_response_motion_sensor_data
+	batch_out[CONFIG_ACCEL_FIFO_SIZE];
+
+static void setup_batch(void)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		motion_sensors[i].oversampling_ratio = 1;
+		motion_sensors[i].collection_rate = BATCH_ODR_PERIOD;
+	}
+	for (i = 0; i < BATCH_SAMPLES; i++) {
+		batch[i].flags = 0;
+		batch[i].sensor_num = i & 1;
+		batch[i].data[X] = i;
+		batch[i].data[Y] = -i;
+		batch[i].data[Z] = 1000 + i;
+	}
+}
+
+static void stage_single(uint32_t ts)
+{
+	int i;
+
+	for (i = 0; i < BATCH_SAMPLES; i++)
+		motion_sense_fifo_stage_data(
+			&batch[i], &motion_sensors[batch[i].sensor_num], 3,
+			ts);
+}
+
+static int test_stage_batch_matches_single(void)
+{
+	uint32_t ts = __hw_clock_source_read() - 100000;
+	int single_count, read_count, i;
+
+	setup_batch();
+	stage_single(ts);
+	motion_sense_fifo_commit_data();
+	single_count = motion_sense_fifo_read(
+		sizeof(data), CONFIG_ACCEL_FIFO_SIZE, data, &data_bytes_read);
+	TEST_EQ(single_count, 2 * BATCH_SAMPLES, "%d");
+
+	motion_sense_fifo_reset();
+	motion_sense_fifo_stage_batch(batch, BATCH_SAMPLES, 3, ts);
+	motion_sense_fifo_commit_data();
+	read_count = motion_sense_fifo_read(
+		sizeof(batch_out), CONFIG_ACCEL_FIFO_SIZE, batch_out,
+		&data_bytes_read);
+	TEST_EQ(read_count, single_count, "%d");
+	for (i = 0; i < read_count; i++) {
+		TEST_EQ(batch_out[i].sensor_num, data[i].sensor_num, "%d");
+		TEST_EQ(batch_out[i].flags, data[i].flags, "0x%x");
+		if (data[i].flags & MOTIONSENSE_SENSOR_FLAG_TIMESTAMP) {
+			TEST_EQ(batch_out[i].timestamp, data[i].timestamp,
+				"%u");
+		} else {
+			TEST_EQ(batch_out[i].data[X], data[i].data[X], "%d");
+			TEST_EQ(batch_out[i].data[Y], data[i].data[Y], "%d");
+			TEST_EQ(batch_out[i].data[Z], data[i].data[Z], "%d");
+		}
+	}
+
+	/* The last sample of each sensor is the public one */
+	TEST_EQ(motion_sensors[0].xyz[X], BATCH_SAMPLES - 2, "%d");
+	TEST_EQ(motion_sensors[1].xyz[X], BATCH_SAMPLES - 1, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_benchmark_stage_batch(void)
+{
+	uint32_t ts = __hw_clock_source_read();
+	uint64_t single_ns, batch_ns, t0;
+	int i;
+
+	setup_batch();
+
+	t0 = test_bench_now_ns();
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		stage_single(ts);
+		motion_sense_fifo_commit_data();
+		motion_sense_fifo_read(sizeof(data), CONFIG_ACCEL_FIFO_SIZE,
+				       data, &data_bytes_read);
+		ts += BATCH_ODR_PERIOD * BATCH_SAMPLES / 2;
+	}
+	single_ns = test_bench_now_ns() - t0;
+
+	t0 = test_bench_now_ns();
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		motion_sense_fifo_stage_batch(batch, BATCH_SAMPLES, 3, ts);
+		motion_sense_fifo_commit_data();
+		motion_sense_fifo_read(sizeof(data), CONFIG_ACCEL_FIFO_SIZE,
+				       data, &data_bytes_read);
+		ts += BATCH_ODR_PERIOD * BATCH_SAMPLES / 2;
+	}
+	batch_ns = test_bench_now_ns() - t0;
+
+	ccprints("2 sensors @ %d Hz, %d samples per drain: "
+		 "single %d ns/sample, batch %d ns/sample",
+		 SECOND / BATCH_ODR_PERIOD, BATCH_SAMPLES,
+		 (int)(single_ns / (BENCH_ITERATIONS * BATCH_SAMPLES)),
+		 (int)(batch_ns / (BENCH_ITERATIONS * BATCH_SAMPLES)));
+
+	return EC_SUCCESS;
+}
+
+#ifdef CONFIG_ACCEL_FIFO_COMPACT
+static int test_compact_holds_more_samples(void)
+{
+	struct ec_response_motion_sense_fifo_info info;
+	uint32_t ts = __hw_clock_source_read() - 1000000;
+	uint32_t last_ts[2] = { 0 };
+	/* Twice what the legacy layout holds, a timestamp and data each */
+	const int samples = CONFIG_ACCEL_FIFO_SIZE;
+	int i, n, entry = 0, sample = 0;
+
+	setup_batch();
+	motion_sense_fifo_get_info(&info, 1);
+	for (i = 0; i < samples / BATCH_SAMPLES; i++) {
+		motion_sense_fifo_stage_batch(batch, BATCH_SAMPLES, 3, ts);
+		motion_sense_fifo_commit_data();
+		ts += BATCH_ODR_PERIOD * BATCH_SAMPLES / 2;
+	}
+
+	motion_sense_fifo_get_info(&info, 0);
+	TEST_EQ(info.total_lost, 0, "%d");
+	TEST_EQ(info.count, 2 * samples, "%d");
+	TEST_LE(info.count, info.size, "%d");
+
+	/* Read back in odd sized chunks to split some records */
+	do {
+		n = motion_sense_fifo_read(3 * sizeof(data[0]), 3, data,
+					   &data_bytes_read);
+		for (i = 0; i < n; i++, entry++) {
+			int s = sample & 1;
+
+			TEST_EQ(data[i].sensor_num, s, "%d");
+			if (entry & 1) {
+				TEST_BITS_CLEARED(data[i].flags,
+					MOTIONSENSE_SENSOR_FLAG_TIMESTAMP);
+				TEST_EQ(data[i].data[X], sample % BATCH_SAMPLES,
+					"%d");
+				TEST_EQ(data[i].data[Z],
+					1000 + sample % BATCH_SAMPLES, "%d");
+				sample++;
+				continue;
+			}
+			TEST_BITS_SET(data[i].flags,
+				      MOTIONSENSE_SENSOR_FLAG_TIMESTAMP);
+			if (sample >= 2)
+				TEST_EQ(data[i].timestamp - last_ts[s],
+					BATCH_ODR_PERIOD, "%u");
+			last_ts[s] = data[i].timestamp;
+		}
+	} while (n);
+	TEST_EQ(sample, samples, "%d");
+
+	motion_sense_fifo_get_info(&info, 0);
+	TEST_EQ(info.count, 0, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_compact_thres_before_loss(void)
+{
+	struct ec_response_motion_sense_fifo_info info;
+	uint32_t ts = __hw_clock_source_read() - 1000000;
+	int i;
+
+	setup_batch();
+	motion_sense_fifo_get_info(&info, 1);
+	TEST_EQ(motion_sense_fifo_over_thres(), 0, "%d");
+
+	/*
+	 * Fill up until the AP would be asked to drain the FIFO, committing
+	 * fewer entries at once than the threshold.
+	 */
+	for (i = 0; i < info.size && !motion_sense_fifo_over_thres(); i++) {
+		motion_sense_fifo_stage_batch(batch, 4, 3, ts);
+		motion_sense_fifo_commit_data();
+		ts += BATCH_ODR_PERIOD * 4 / 2;
+	}
+	TEST_EQ(motion_sense_fifo_over_thres(), 1, "%d");
+
+	/* Nothing was lost and at least the threshold still fits */
+	motion_sense_fifo_get_info(&info, 0);
+	TEST_EQ(info.total_lost, 0, "%d");
+	TEST_LE(info.count, info.size, "%d");
+	TEST_GE(info.size - info.count, CONFIG_ACCEL_FIFO_THRES, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_compact_oversampled_timestamps(void)
+{
+	struct ec_response_motion_sense_fifo_info info;
+	uint32_t ts = __hw_clock_source_read() - 1000000;
+	uint32_t batch_ts[CONFIG_ACCEL_FIFO_SIZE / BATCH_SAMPLES];
+	/* Per batch: a timestamp per sample, data for every other one */
+	const int batch_entries = BATCH_SAMPLES * 3 / 2;
+	int i, n, entry = 0;
+
+	setup_batch();
+	motion_sensors[0].oversampling_ratio = 2;
+	motion_sensors[1].oversampling_ratio = 2;
+	motion_sense_fifo_get_info(&info, 1);
+
+	/* More entries than the legacy layout holds */
+	for (i = 0; i < ARRAY_SIZE(batch_ts); i++) {
+		batch_ts[i] = ts;
+		motion_sense_fifo_stage_batch(batch, BATCH_SAMPLES, 3, ts);
+		motion_sense_fifo_commit_data();
+		ts += BATCH_ODR_PERIOD * BATCH_SAMPLES / 2;
+	}
+	motion_sense_fifo_get_info(&info, 0);
+	TEST_EQ(info.total_lost, 0, "%d");
+	TEST_EQ(info.count, (int)ARRAY_SIZE(batch_ts) * batch_entries, "%d");
+	TEST_GT(info.count, CONFIG_ACCEL_FIFO_SIZE, "%d");
+
+	/* Timestamps without data are not spread, they come back as is */
+	do {
+		n = motion_sense_fifo_read(sizeof(data), CONFIG_ACCEL_FIFO_SIZE,
+					   data, &data_bytes_read);
+		for (i = 0; i < n; i++, entry++) {
+			/* Followed by a timestamp, its data was dropped */
+			if (i + 1 < n &&
+			    (data[i].flags & data[i + 1].flags &
+			     MOTIONSENSE_SENSOR_FLAG_TIMESTAMP))
+				TEST_EQ(data[i].timestamp,
+					batch_ts[entry / batch_entries], "%u");
+		}
+	} while (n);
+	TEST_EQ(entry, (int)ARRAY_SIZE(batch_ts) * batch_entries, "%d");
+
+	return EC_SUCCESS;
+}
+
+static int test_compact_stage_full_on_timestamp(void)
+{
+	uint32_t ts = __hw_clock_source_read() - 100000;
+	uint32_t last = 0;
+	int i, n, kept = 0;
+
+	/*
+	 * One sensor dropping every other sample, all with the drain time:
+	 * the stage fills up right after a timestamp.
+	 */
+	setup_batch();
+	motion_sensors[0].oversampling_ratio = 2;
+	for (i = 0; i < 4 * CONFIG_ACCEL_FIFO_COMPACT_STAGE_SIZE; i++)
+		motion_sense_fifo_stage_data(&batch[0], &motion_sensors[0], 3,
+					     ts);
+	motion_sense_fifo_commit_data();
+
+	/* Each kept sample still follows its own, spread, timestamp */
+	n = motion_sense_fifo_read(sizeof(data), CONFIG_ACCEL_FIFO_SIZE, data,
+				   &data_bytes_read);
+	for (i = 1; i < n; i++) {
+		if (data[i].flags & MOTIONSENSE_SENSOR_FLAG_TIMESTAMP)
+			continue;
+		TEST_BITS_SET(data[i - 1].flags,
+			      MOTIONSENSE_SENSOR_FLAG_TIMESTAMP);
+		if (kept++)
+			TEST_EQ(data[i - 1].timestamp - last, BATCH_ODR_PERIOD,
+				"%u");
+		last = data[i - 1].timestamp;
+	}
+	TEST_EQ(kept, 2 * CONFIG_ACCEL_FIFO_COMPACT_STAGE_SIZE, "%d");
+
+	return EC_SUCCESS;
+}
+#endif
+
 void before_test(void)
 {
 	motion_sense_fifo_commit_data();
@@ -365,13 +646,23 @@ void run_test(int argc, char **argv)
 	RUN_TEST(test_stage_data_sets_xyz);
 	RUN_TEST(test_stage_data_removed_oversample);
 	RUN_TEST(test_stage_data_remove_all_oversampling);
+#ifndef CONFIG_ACCEL_FIFO_COMPACT
 	RUN_TEST(test_stage_data_evicts_data_with_timestamp);
+#endif
 	RUN_TEST(test_add_data_no_spreading_when_different_sensors);
 	RUN_TEST(test_add_data_no_spreading_different_timestamps);
 	RUN_TEST(test_spread_data_in_window);
 	RUN_TEST(test_spread_data_by_collection_rate);
 	RUN_TEST(test_spread_double_commit_same_timestamp);
 	RUN_TEST(test_commit_non_data_or_timestamp_entries);
+	RUN_TEST(test_stage_batch_matches_single);
+	RUN_TEST(test_benchmark_stage_batch);
+#ifdef CONFIG_ACCEL_FIFO_COMPACT
+	RUN_TEST(test_compact_holds_more_samples);
+	RUN_TEST(test_compact_thres_before_loss);
+	RUN_TEST(test_compact_oversampled_timestamps);
+	RUN_TEST(test_compact_stage_full_on_timestamp);
+#endif
 
 	test_print_result();
 }
@@ -7,6 +7,7 @@
 #include "newton_fit.h"
 #include "motion_sense.h"
 #include "test_util.h"
+#include <math.h>
 #include <stdio.h>
 
 /*
@@ -126,6 +127,130 @@ static int test_newton_fit_calculate(void)
 	return EC_SUCCESS;
 }
 
+/*
+ * Reference merge: linear scan of the queue for the first near orientation,
+ * which the bucketed index must reproduce.
+ */
+#define REF_SIZE 64
+
+static struct newton_fit_orientation ref[REF_SIZE];
+static int ref_count;
+
+static void ref_accumulate(struct newton_fit *fit, fp_t x, fp_t y, fp_t z)
+{
+	fpv3_t v, delta;
+	int i;
+
+	fpv3_init(v, x, y, z);
+	for (i = 0; i < ref_count; i++) {
+		fpv3_sub(delta, v, ref[i].orientation);
+		if (fpv3_dot(delta, delta) >= fit->nearness_threshold)
+			continue;
+		fpv3_scalar_mul(ref[i].orientation,
+				FLOAT_TO_FP(1.0f) - fit->new_pt_weight);
+		fpv3_scalar_mul(v, fit->new_pt_weight);
+		fpv3_add(ref[i].orientation, ref[i].orientation, v);
+		ref[i].nsamples++;
+		return;
+	}
+	if (ref_count < REF_SIZE) {
+		fpv3_init(ref[ref_count].orientation, x, y, z);
+		ref[ref_count++].nsamples = 1;
+	}
+}
+
+/* Point i of n spread evenly over the unit sphere. */
+static void sphere_point(int i, int n, fpv3_t v)
+{
+	float z = 1.0f - (2.0f * i + 1.0f) / n;
+	float r = sqrtf(1.0f - z * z);
+	float phi = i * 2.39996323f;
+
+	fpv3_init(v, r * cosf(phi), r * sinf(phi), z);
+}
+
+static int test_newton_fit_index_matches_scan(void)
+{
+	struct newton_fit fit =
+		NEWTON_FIT(REF_SIZE, 200, 0.01f, 0.25f, 1.0e-8f, 100);
+	struct queue_iterator it;
+	fpv3_t v;
+	int i, j;
+
+	newton_fit_reset(&fit);
+	ref_count = 0;
+
+	/*
+	 * Points that are near several orientations at once, so the merge
+	 * target depends on the order orientations were added.
+	 */
+	for (i = 0; i < 2000; i++) {
+		sphere_point((i * 37) % 50, 50, v);
+		fpv3_init(v, v[X] + 0.04f * sinf(i), v[Y] + 0.04f * cosf(i),
+			  v[Z] - 0.03f * sinf(i * 0.5f));
+		newton_fit_accumulate(&fit, v[X], v[Y], v[Z]);
+		ref_accumulate(&fit, v[X], v[Y], v[Z]);
+	}
+
+	TEST_EQ(queue_count(fit.orientations), (size_t)ref_count, "%zu");
+	queue_begin(fit.orientations, &it);
+	for (j = 0; j < ref_count; j++) {
+		struct newton_fit_orientation *o = it.ptr;
+
+		TEST_EQ(o->nsamples, ref[j].nsamples, "%u");
+		TEST_EQ(o->orientation[X], ref[j].orientation[X], "%f");
+		TEST_EQ(o->orientation[Y], ref[j].orientation[Y], "%f");
+		TEST_EQ(o->orientation[Z], ref[j].orientation[Z], "%f");
+		queue_next(fit.orientations, &it);
+	}
+
+	return EC_SUCCESS;
+}
+
+#define BENCH_ORIENTATIONS 256
+#define BENCH_SAMPLES 20
+
+static int test_benchmark_newton_fit(void)
+{
+	struct newton_fit fit = NEWTON_FIT(BENCH_ORIENTATIONS, BENCH_SAMPLES,
+					   0.0025f, 0.25f, 1.0e-8f, 100);
+	uint64_t accumulate_ns, compute_ns, t0;
+	fpv3_t v, bias;
+	float radius;
+	int i;
+
+	newton_fit_reset(&fit);
+
+	t0 = test_bench_now_ns();
+	for (i = 0; i < BENCH_ORIENTATIONS * BENCH_SAMPLES; i++) {
+		sphere_point(i % BENCH_ORIENTATIONS, BENCH_ORIENTATIONS, v);
+		/* Offset the sphere so there is a bias to find */
+		newton_fit_accumulate(&fit, v[X] + 0.02f, v[Y] - 0.01f,
+				      v[Z] + 0.03f);
+	}
+	accumulate_ns = test_bench_now_ns() - t0;
+	TEST_EQ(queue_count(fit.orientations), (size_t)BENCH_ORIENTATIONS,
+		"%zu");
+
+	fpv3_init(bias, 0.0f, 0.0f, 0.0f);
+	t0 = test_bench_now_ns();
+	newton_fit_compute(&fit, bias, &radius);
+	compute_ns = test_bench_now_ns() - t0;
+
+	TEST_NEAR(bias[X], 0.02f, 0.001f, "%f");
+	TEST_NEAR(bias[Y], -0.01f, 0.001f, "%f");
+	TEST_NEAR(bias[Z], 0.03f, 0.001f, "%f");
+	TEST_NEAR(radius, 1.0f, 0.001f, "%f");
+
+	ccprints("%d orientations: accumulate %d ns/sample, compute %d us",
+		 BENCH_ORIENTATIONS,
+		 (int)(accumulate_ns /
+		       (BENCH_ORIENTATIONS * BENCH_SAMPLES)),
+		 (int)(compute_ns / 1000));
+
+	return EC_SUCCESS;
+}
+
 void run_test(int argc, char **argv)
 {
 	test_reset();
@@ -135,6 +260,8 @@ void run_test(int argc, char **argv)
 	RUN_TEST(test_newton_fit_accumulate_merge);
 	RUN_TEST(test_newton_fit_accumulate_prune);
 	RUN_TEST(test_newton_fit_calculate);
+	RUN_TEST(test_newton_fit_index_matches_scan);
+	RUN_TEST(test_benchmark_newton_fit);
 
 	test_print_result();
 }
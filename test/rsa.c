@@ -5,13 +5,17 @@
  * Tests RSA implementation.
  */
 
+#include "clock.h"
 #include "console.h"
 #include "common.h"
 #include "rsa.h"
 #include "test_util.h"
+#include "timer.h"
 #include "util.h"
 
-#ifdef TEST_RSA3
+#ifdef TEST_RSA3072
+#include "rsa3072-3.h"
+#elif defined(TEST_RSA3)
 #include "rsa2048-3.h"
 #else
 #include "rsa2048-F4.h"
@@ -19,6 +23,24 @@
 
 static uint32_t rsa_workbuf[3 * RSANUMBYTES/4];
 
+static void test_rsa_speed(void)
+{
+	const int iterations = 20;
+	uint64_t ns;
+	int i;
+
+	ns = test_bench_now_ns();
+	for (i = 0; i < iterations; i++)
+		rsa_verify(rsa_key, sig, hash, rsa_workbuf);
+	ns = (test_bench_now_ns() - ns) / iterations;
+
+	ccprintf("RSA-%d verify (%s) %lld us, %lld kcycles\n",
+		 CONFIG_RSA_KEY_SIZE,
+		 IS_ENABLED(CONFIG_RSA_EXPONENT_3) ? "e=3" : "F4",
+		 (long long)(ns / 1000),
+		 (long long)(ns * (clock_get_freq() / SECOND) / 1000000));
+}
+
 void run_test(int argc, char **argv)
 {
 	int good;
@@ -49,6 +71,9 @@ void run_test(int argc, char **argv)
 	}
 	ccprintf("RSA verify FAILED (as expected)\n");
 
+	/* do not check result, just as a benchmark */
+	test_rsa_speed();
+
 	test_pass();
 }
 
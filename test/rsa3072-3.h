@@ -0,0 +1,141 @@
+/* Copyright 2020 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ *
+ * RSA 3072 with 3 exponent public key and verification.
+ * Private key in rsa3072-3.pem.
+ */
+
+/* First generate a key:
+ * # openssl genrsa -3 -out key.pem 3072
+ * # openssl rsa -in key.pem -pubout > key.pub
+ * Then dump the key:
+ * # dumpRSAPublicKey -pub key.pub | xxd -i
+ */
+const uint8_t rsa_data[] = {
+	0x60, 0x00, 0x00, 0x00, 0xed, 0xa7, 0xb9, 0xf0, 0x1b, 0x32, 0x3b, 0x7e,
+	0x5f, 0xf4, 0xbe, 0x26, 0x92, 0x33, 0xa6, 0x30, 0xd3, 0xf2, 0x53, 0xc0,
+	0xf2, 0x22, 0xe5, 0x4e, 0x16, 0xe1, 0x5e, 0x90, 0x11, 0x19, 0xc7, 0xbe,
+	0x94, 0x47, 0x22, 0x98, 0xc4, 0x93, 0xfc, 0xb2, 0x95, 0x5e, 0xb1, 0xef,
+	0xc1, 0x6b, 0x7a, 0x11, 0x93, 0xb6, 0xe0, 0x22, 0x9f, 0x2e, 0xa4, 0x60,
+	0x67, 0x8e, 0xdd, 0xf5, 0x1f, 0x0d, 0x9e, 0x1d, 0x54, 0x9e, 0xbd, 0x97,
+	0x45, 0x8a, 0x27, 0x25, 0x09, 0xce, 0x64, 0xcc, 0xea, 0xbb, 0x08, 0xe4,
+	0x26, 0xdd, 0xd8, 0xfc, 0x42, 0x4b, 0x6a, 0xbc, 0xe5, 0x18, 0xba, 0xed,
+	0xf5, 0x5d, 0xbf, 0x45, 0x4f, 0x90, 0x3a, 0xd2, 0xf4, 0x27, 0xf5, 0x53,
+	0xfc, 0x76, 0x04, 0xeb, 0x2a, 0x58, 0xb1, 0x05, 0x26, 0x7e, 0x31, 0x13,
+	0xcc, 0x3a, 0x63, 0x6c, 0x95, 0x05, 0xc1, 0x9f, 0xf0, 0x3a, 0xe9, 0xab,
+	0x54, 0xb9, 0x23, 0xbf, 0xb8, 0xb6, 0x86, 0xdc, 0x71, 0xbe, 0xf1, 0x8e,
+	0x27, 0x88, 0xe5, 0xf9, 0xac, 0x17, 0x4d, 0x73, 0x49, 0x24, 0xfd, 0x5a,
+	0xc6, 0x32, 0xeb, 0x01, 0x73, 0x61, 0x1e, 0xbd, 0x6f, 0xb2, 0xa3, 0xe5,
+	0x09, 0x6c, 0x1f, 0x1a, 0x68, 0x77, 0x61, 0x8d, 0x5c, 0x20, 0x9a, 0x73,
+	0xcf, 0xf4, 0x0b, 0x0f, 0xd2, 0xaf, 0x8d, 0x54, 0xad, 0x2a, 0x8e, 0xfe,
+	0x12, 0xc0, 0xf2, 0x41, 0xdf, 0x1c, 0x96, 0x09, 0x5b, 0x25, 0x70, 0x60,
+	0x3b, 0x2c, 0x13, 0x62, 0x74, 0x2a, 0xb3, 0x53, 0x90, 0xd3, 0x87, 0x54,
+	0x08, 0x1f, 0x6c, 0x83, 0xdf, 0x95, 0x05, 0xef, 0x6e, 0x11, 0x62, 0x98,
+	0x9e, 0xdb, 0xb3, 0x09, 0x7a, 0xc2, 0xbd, 0xb4, 0x06, 0x33, 0xc9, 0x26,
+	0x4b, 0x77, 0x40, 0x0a, 0xad, 0xa3, 0xfa, 0xd4, 0xaa, 0x01, 0x20, 0x8b,
+	0xa6, 0x18, 0x36, 0x8a, 0x41, 0xba, 0x70, 0x80, 0x64, 0x11, 0xb6, 0x62,
+	0x62, 0x2f, 0x63, 0xa3, 0xfd, 0x77, 0x30, 0x18, 0x71, 0x21, 0x26, 0x9d,
+	0xe5, 0xdb, 0x0c, 0xc8, 0xec, 0x59, 0x4f, 0x8d, 0xd5, 0x42, 0xb4, 0x5c,
+	0x9d, 0x83, 0x4f, 0x77, 0xa2, 0xfe, 0xe7, 0xc0, 0x36, 0xad, 0x6d, 0x31,
+	0xff, 0x53, 0x7e, 0x29, 0xa9, 0x10, 0x37, 0xe5, 0xe5, 0x81, 0x82, 0x4c,
+	0xa6, 0xa5, 0x3b, 0x13, 0x30, 0x8e, 0x90, 0xa8, 0x82, 0xf7, 0xa9, 0x00,
+	0xac, 0x0b, 0x96, 0xdd, 0x0e, 0x4e, 0xbf, 0x26, 0xed, 0xa0, 0xf9, 0x38,
+	0x60, 0x5f, 0xae, 0x7d, 0xa0, 0x90, 0xa2, 0x96, 0x3e, 0x36, 0x9c, 0x3c,
+	0x8e, 0x63, 0xfb, 0xc9, 0xc6, 0x2b, 0x70, 0x90, 0x56, 0x3f, 0x70, 0x52,
+	0x97, 0xa2, 0xa5, 0xa4, 0x4b, 0xf3, 0x0c, 0xb4, 0xe7, 0x17, 0x4b, 0xbe,
+	0x97, 0xa7, 0x10, 0x32, 0x3e, 0x83, 0x30, 0xad, 0xb8, 0xa9, 0x80, 0x4f,
+	0x7a, 0x7f, 0xb0, 0xaf, 0x84, 0xab, 0xcc, 0xc2, 0x8a, 0x21, 0xcb, 0xa7,
+	0x39, 0xfe, 0x9d, 0xc2, 0xf8, 0x02, 0xbc, 0xb2, 0x82, 0x09, 0xcb, 0x85,
+	0xd3, 0xdc, 0x69, 0xf0, 0x8c, 0x9b, 0x98, 0x1c, 0x05, 0x6f, 0xb3, 0xd0,
+	0x7c, 0x29, 0x4a, 0xdf, 0x39, 0x9c, 0x3b, 0xd1, 0x04, 0xd0, 0xa5, 0xaa,
+	0xda, 0x27, 0xd8, 0x17, 0xa3, 0x43, 0x14, 0x59, 0xc7, 0xed, 0xe8, 0xb6,
+	0xfc, 0x36, 0x6e, 0xb1, 0xc6, 0x0e, 0x73, 0x03, 0x88, 0x4d, 0x3d, 0x01,
+	0xda, 0x26, 0xea, 0x91, 0xca, 0x4e, 0xde, 0x20, 0x51, 0xfe, 0x1b, 0xf4,
+	0xb1, 0x4e, 0xb7, 0x85, 0xeb, 0x9a, 0x18, 0xba, 0x12, 0x2c, 0x1d, 0x04,
+	0x70, 0xd5, 0xbe, 0xaf, 0xc1, 0x5d, 0x84, 0xab, 0xfb, 0x5b, 0x8f, 0xd6,
+	0xe8, 0x42, 0x99, 0xe6, 0x1f, 0xb7, 0xb3, 0x1c, 0xee, 0xe3, 0x81, 0x81,
+	0xd0, 0x49, 0x98, 0xbf, 0x62, 0xdb, 0x5c, 0x72, 0xcb, 0x0b, 0x0b, 0xa3,
+	0xd0, 0x64, 0xfc, 0x86, 0x34, 0xd9, 0x47, 0xec, 0xa9, 0x8a, 0xa2, 0x09,
+	0x0a, 0x4c, 0xba, 0x56, 0xbf, 0xd6, 0x2b, 0x9b, 0x74, 0xa7, 0xf6, 0xb0,
+	0x4b, 0x98, 0x88, 0x56, 0xda, 0xea, 0x8c, 0x5a, 0x02, 0x46, 0x43, 0xba,
+	0xc6, 0x9a, 0x1c, 0x01, 0x00, 0x65, 0x65, 0x30, 0x98, 0x40, 0x6e, 0x47,
+	0x46, 0xa2, 0x3b, 0x16, 0xcd, 0x80, 0xab, 0xd3, 0x98, 0xe2, 0x0a, 0x29,
+	0xc6, 0x16, 0x30, 0xb8, 0x1e, 0x59, 0xb0, 0x97, 0xfe, 0xfe, 0xb9, 0x5b,
+	0x34, 0x8e, 0x59, 0x35, 0x18, 0x60, 0x1c, 0x1b, 0x7c, 0xdf, 0x40, 0x9c,
+	0x71, 0x3d, 0xc9, 0x11, 0xad, 0x68, 0x88, 0x6b, 0xe9, 0x1d, 0xd4, 0xdb,
+	0x56, 0x1b, 0xb8, 0x63, 0x07, 0x3c, 0x2e, 0xb2, 0x85, 0x36, 0xc0, 0x3b,
+	0xed, 0x06, 0x16, 0x85, 0xb7, 0xcb, 0x23, 0x00, 0x7d, 0xa1, 0x07, 0xdd,
+	0x58, 0xb9, 0xea, 0xf1, 0xfc, 0xeb, 0xe2, 0x63, 0x47, 0x1b, 0x15, 0x36,
+	0xf0, 0x5d, 0x7b, 0xaf, 0xf6, 0x43, 0xda, 0x00, 0xbc, 0xd3, 0x38, 0x7d,
+	0x1b, 0x6b, 0x80, 0x64, 0x71, 0xb6, 0xc7, 0x4f, 0xdb, 0xd1, 0x07, 0xbf,
+	0xbb, 0x9b, 0xf2, 0x80, 0x20, 0xc7, 0x7c, 0x6c, 0x09, 0x3b, 0x4f, 0xc6,
+	0x5c, 0xcf, 0x43, 0xea, 0x4d, 0xc1, 0xee, 0x8e, 0xae, 0x73, 0xdf, 0x43,
+	0x8e, 0x02, 0x69, 0x0a, 0x6f, 0x3d, 0xa6, 0x6f, 0xdb, 0x39, 0x45, 0x0a,
+	0xb7, 0x39, 0x9f, 0xee, 0xd4, 0x71, 0x0a, 0x7c, 0x00, 0xcc, 0x45, 0xd7,
+	0x71, 0x1b, 0x97, 0xad, 0x71, 0x06, 0xae, 0xfc, 0x6d, 0xd4, 0xc0, 0x55,
+	0xa6, 0x24, 0x82, 0xee, 0xbb, 0x35, 0x16, 0x4d, 0x8c, 0x58, 0x05, 0xb1,
+	0x69, 0x26, 0xd1, 0x7a, 0xea, 0x6d, 0xfc, 0xaf, 0xa1, 0xcc, 0x03, 0x2f,
+	0x72, 0xb2, 0xb0, 0xb3, 0x64, 0xef, 0xd6, 0xed, 0x5a, 0xda, 0x62, 0xb9,
+	0x17, 0xa0, 0x3f, 0x88, 0x10, 0x44, 0x38, 0xad
+};
+
+const struct rsa_public_key *rsa_key = (struct rsa_public_key *)rsa_data;
+BUILD_ASSERT(sizeof(*rsa_key) == sizeof(rsa_data));
+
+/* SHA-256 sum to verify:
+ * # sha256sum README | sed -e 's/\(..\)/0x\1, /mg'
+ */
+const uint8_t hash[] = {
+	0x6c, 0x5f, 0xef, 0x7f, 0x63, 0x1d, 0xb4, 0x35, 0x6c, 0xae, 0x8b, 0x2a,
+	0x4e, 0xde, 0xc5, 0xeb, 0x11, 0xba, 0x1f, 0x44, 0x40, 0xb6, 0x3a, 0x52,
+	0xf2, 0x70, 0xef, 0xee, 0x44, 0x4b, 0x57, 0x62
+};
+
+/* Incorrect hash to test the negative case */
+const uint8_t hash_wrong[] = {
+	0x61, 0x1b, 0xd2, 0x44, 0xc7, 0x18, 0xa7, 0x2d, 0x0f, 0x2d, 0x3d, 0x0f,
+	0xe3, 0xb3, 0xc5, 0xe4, 0x12, 0xc2, 0x7b, 0x1e, 0x05, 0x2c, 0x6f, 0xad,
+	0xc4, 0xac, 0x71, 0x55, 0xe8, 0x80, 0x5c, 0x38
+};
+
+/* Generate the PKCS#1 v1.5 signature of the hash above:
+ * # openssl pkeyutl -sign -inkey key.pem -pkeyopt digest:sha256 \
+ *   -in README.sha256 | xxd -i
+ */
+const uint8_t sig[] = {
+	0xa3, 0xc1, 0x55, 0x53, 0x01, 0xff, 0xd0, 0xe3, 0xbd, 0x9d, 0x05, 0xbd,
+	0x6e, 0xbd, 0xf0, 0x29, 0xce, 0x55, 0x84, 0x4c, 0x34, 0x6d, 0x79, 0xbe,
+	0x15, 0xc7, 0xe6, 0xa7, 0x6f, 0x95, 0x9f, 0x38, 0x7c, 0xba, 0xa6, 0xff,
+	0x31, 0x7d, 0x0c, 0x3b, 0x0e, 0x6a, 0x6f, 0xb1, 0x56, 0x5e, 0xa7, 0xec,
+	0xb2, 0xd8, 0x2a, 0xae, 0x92, 0xa0, 0xe7, 0x7b, 0xbc, 0x82, 0x8f, 0x66,
+	0x5e, 0xe7, 0x1d, 0xbb, 0x89, 0x3d, 0x27, 0x96, 0x98, 0x05, 0xf7, 0xfd,
+	0x9c, 0x32, 0xd8, 0x28, 0x21, 0x9f, 0x00, 0xb3, 0x2f, 0xad, 0x7a, 0x9f,
+	0xb8, 0xaf, 0x58, 0xc1, 0x8b, 0x3d, 0xb4, 0x14, 0x67, 0xa7, 0x23, 0x5c,
+	0x49, 0xf7, 0x13, 0xdc, 0xd3, 0x37, 0xa4, 0x47, 0x77, 0x4a, 0x01, 0x59,
+	0x14, 0x44, 0x76, 0x6d, 0xf8, 0xe6, 0x52, 0x1d, 0x74, 0x53, 0xd1, 0x61,
+	0xd3, 0x65, 0xf6, 0xec, 0x43, 0x20, 0xfa, 0xce, 0x87, 0x9f, 0x8f, 0x93,
+	0x43, 0xfe, 0xe1, 0xa5, 0xe1, 0x53, 0x65, 0x8d, 0xa2, 0xb6, 0xc5, 0x35,
+	0x0b, 0xe4, 0x55, 0x3a, 0x10, 0xda, 0x33, 0x95, 0x4c, 0x5a, 0x93, 0x76,
+	0x68, 0xaf, 0xc2, 0xeb, 0xce, 0xbd, 0x27, 0x9e, 0x78, 0xeb, 0x87, 0x93,
+	0xe3, 0x0a, 0x97, 0xd1, 0x68, 0x77, 0xc8, 0xe6, 0x37, 0xf4, 0x63, 0x8f,
+	0x7e, 0x8d, 0x1e, 0x9b, 0x67, 0x06, 0x53, 0xd0, 0x92, 0x47, 0x17, 0xf9,
+	0xc4, 0x16, 0x11, 0x36, 0xaf, 0x2d, 0xde, 0x22, 0xd9, 0x4a, 0x53, 0x77,
+	0xa3, 0x7f, 0xbe, 0x08, 0xba, 0x7e, 0xe1, 0xd7, 0xc5, 0xbf, 0x5d, 0xe0,
+	0xb2, 0x0f, 0xb8, 0x76, 0xac, 0x23, 0x0c, 0x27, 0xa5, 0x73, 0x44, 0xd4,
+	0xbd, 0xe8, 0xdf, 0x29, 0xc8, 0x11, 0xea, 0x3e, 0x4d, 0x81, 0x36, 0xfb,
+	0x21, 0xe9, 0xd2, 0x76, 0x37, 0x4f, 0x18, 0x0e, 0xd3, 0xb0, 0x22, 0xcf,
+	0x43, 0xae, 0xfc, 0xbf, 0xe0, 0x6c, 0x8f, 0xd1, 0x29, 0x20, 0xa6, 0x63,
+	0xbf, 0x31, 0xd5, 0x1c, 0xfb, 0x9b, 0x13, 0xe4, 0xfc, 0x3f, 0x9f, 0xeb,
+	0x04, 0x48, 0x18, 0x11, 0xfa, 0xc1, 0x2b, 0xd4, 0xba, 0xe9, 0xa6, 0xd9,
+	0xd1, 0xfb, 0x31, 0xf0, 0x42, 0xcf, 0xe2, 0xfb, 0x5e, 0x2c, 0xcc, 0x4a,
+	0x72, 0xc7, 0xeb, 0x3f, 0x63, 0x1a, 0x0d, 0x83, 0x2e, 0x5d, 0xe6, 0xa9,
+	0x9f, 0xaf, 0x0b, 0xa3, 0x70, 0xb4, 0x71, 0x53, 0x62, 0xb0, 0xb3, 0xfb,
+	0x01, 0xe0, 0x13, 0xc1, 0x54, 0xf8, 0x24, 0x6f, 0xef, 0x55, 0xc1, 0x9b,
+	0x84, 0x8e, 0x80, 0xdb, 0xef, 0x98, 0x97, 0x7a, 0x72, 0x4f, 0x0e, 0xf9,
+	0x65, 0xea, 0xa9, 0x72, 0x14, 0x5c, 0x9f, 0xe7, 0xe8, 0xc1, 0x14, 0x86,
+	0x95, 0xc1, 0x9a, 0xa0, 0x58, 0x71, 0x5b, 0xfb, 0x61, 0x53, 0xeb, 0x7c,
+	0xf3, 0x22, 0xd6, 0xe8, 0x47, 0x65, 0xa7, 0x19, 0x6a, 0xd0, 0xd8, 0x49,
+	/* Padding */
+	0x00
+};
@@ -5,10 +5,12 @@
  * Tests SHA256 implementation.
  */
 
+#include "clock.h"
 #include "console.h"
 #include "common.h"
 #include "sha256.h"
 #include "test_util.h"
+#include "timer.h"
 #include "util.h"
 
 /* Short Msg from NIST FIPS 180-4 (Len = 8) */
@@ -125,6 +127,8 @@ static const uint8_t hmac_medium_output[] = {
 	0xaa, 0x57, 0x17, 0x89, 0x6c, 0xb7, 0x0d, 0xdf
 };
 
+static uint8_t unaligned[sizeof(sha256_2888_input) + 1] __aligned(4);
+
 static int test_sha256(const uint8_t *input, int input_len,
 		       const uint8_t *output)
 {
@@ -153,9 +157,68 @@ static int test_sha256(const uint8_t *input, int input_len,
 		return 0;
 	}
 
+	/* Unaligned input goes through the byte loads. */
+	memcpy(unaligned + 1, input, input_len);
+	SHA256_init(&ctx);
+	SHA256_update(&ctx, unaligned + 1, input_len);
+	tmp = SHA256_final(&ctx);
+
+	if (memcmp(tmp, output, SHA256_DIGEST_SIZE) != 0) {
+		ccprintf("SHA256 test failed (unaligned)\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+static int test_sha256_bufs(const uint8_t *input, int input_len,
+			    const uint8_t *output)
+{
+	/* Three pieces, the second one starts unaligned */
+	const struct sha256_buf bufs[] = {
+		{ input, 13 },
+		{ input + 13, input_len / 2 },
+		{ input + 13 + input_len / 2, input_len - 13 - input_len / 2 },
+	};
+	uint8_t digest[SHA256_DIGEST_SIZE];
+
+	SHA256_hash_bufs(bufs, ARRAY_SIZE(bufs), digest);
+
+	if (memcmp(digest, output, SHA256_DIGEST_SIZE) != 0) {
+		ccprintf("SHA256_hash_bufs test failed\n");
+		return 0;
+	}
+
 	return 1;
 }
 
+static void test_sha256_speed(void)
+{
+	static uint8_t data[4096] __aligned(4);
+	const int iterations = 64;
+	struct sha256_ctx ctx;
+	uint64_t ns, bytes;
+	int i, mbps10, cpb10;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i;
+
+	ns = test_bench_now_ns();
+	SHA256_init(&ctx);
+	for (i = 0; i < iterations; i++)
+		SHA256_update(&ctx, data, sizeof(data));
+	SHA256_final(&ctx);
+	ns = MAX(test_bench_now_ns() - ns, 1);
+	bytes = (uint64_t)iterations * sizeof(data);
+
+	/* In tenths, MB/s is what matters on host, cycles/byte on target */
+	mbps10 = bytes * 10 * 1000000000 / ns / (1024 * 1024);
+	cpb10 = ns * 10 / 1000 * (clock_get_freq() / SECOND) / bytes;
+	ccprintf("SHA256 duration %lld us, %d.%d MB/s, %d.%d cycles/byte\n",
+		 (long long)(ns / 1000), mbps10 / 10, mbps10 % 10,
+		 cpb10 / 10, cpb10 % 10);
+}
+
 static int test_hmac(const uint8_t *key, int key_len,
 		     const uint8_t *input, int input_len,
 		     const uint8_t *output)
@@ -195,6 +258,13 @@ void run_test(int argc, char **argv)
 		return;
 	}
 
+	ccprintf("Testing long message in several buffers\n");
+	if (!test_sha256_bufs(sha256_2888_input, sizeof(sha256_2888_input),
+			      sha256_2888_output)) {
+		test_fail();
+		return;
+	}
+
 	ccprintf("HMAC: Testing short key\n");
 	if (!test_hmac(hmac_short_key, sizeof(hmac_short_key),
 		       hmac_short_msg, sizeof(hmac_short_msg),
@@ -216,5 +286,8 @@ void run_test(int argc, char **argv)
 	 * 64 bytes keys.
 	 */
 
+	/* do not check result, just as a benchmark */
+	test_sha256_speed();
+
 	test_pass();
 }
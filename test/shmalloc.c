@@ -15,6 +15,7 @@
 #include "link_defs.h"
 #include "shared_mem.h"
 #include "test_util.h"
+#include "util.h"
 
 /*
  * Total size of memory in the malloc pool (shared between free and allocated
@@ -45,140 +46,180 @@ static struct {
 	size_t buffer_size;
 } allocations[12];  /* Up to 12 buffers could be allocated concurrently. */
 
+/* Header of allocated buffers, see struct shm_buffer. */
+#define HDR_SIZE offsetof(struct shm_buffer, next_free)
+
+static size_t buf_size(const struct shm_buffer *buf)
+{
+	return buf->buffer_size & ~1;
+}
+
+static int buf_is_free(const struct shm_buffer *buf)
+{
+	return buf->buffer_size & 1;
+}
+
 /*
- * Verify that allocated and free buffers do not overlap, and that our and
- * malloc's ideas of the number of allocated buffers match.
+ * Verify that every buffer we allocated is an allocated buffer of the right
+ * size, and that our and malloc's ideas of the number of allocated buffers
+ * match.
  */
 
-static int check_for_overlaps(void)
+static int check_for_overlaps(int allocated_count)
 {
 	int i;
-	int allocation_match;
-	int allocations_count, allocated_count;
+	int allocations_count = 0;
 
-	allocations_count = allocated_count = 0;
 	for (i = 0; i < ARRAY_SIZE(allocations); i++) {
-		struct shm_buffer *allocced_buf;
+		struct shm_buffer *allocced_buf, *pbuf;
+		int allocated_size, allocation_size;
 
 		if (!allocations[i].buf)
 			continue;
 
-		/*
-		 * Indication of finding the allocated buffer in internal
-		 * malloc structures.
-		 */
-		allocation_match = 0;
-
 		/* number of buffers allocated by the test program. */
 		allocations_count++;
 
+		allocced_buf = (struct shm_buffer *)
+			((uintptr_t)allocations[i].buf - HDR_SIZE);
+		for (pbuf = shm_first; pbuf && pbuf != allocced_buf;
+		     pbuf = (struct shm_buffer *)((uintptr_t)pbuf +
+						  buf_size(pbuf)))
+			if ((uintptr_t)pbuf >= shm_end)
+				pbuf = NULL;
+		if (!pbuf || buf_is_free(pbuf)) {
+			ccprintf("missing match %pP!\n", allocations[i].buf);
+			return 0;
+		}
+
+		allocated_size = buf_size(allocced_buf) - HDR_SIZE;
+		allocation_size = allocations[i].buffer_size;
+
 		/*
-		 * Number of allocated buffers malloc knows about, calculated
-		 * multiple times to keep things simple.
+		 * Verify that size requested by the allocator matches
+		 * the value used by malloc, i.e. does not exceed the
+		 * allocated size and is no less than a buffer structure
+		 * plus alignment lower (which can happen when the
+		 * tail was too small to be a free buffer).
 		 */
-		allocated_count = 0;
-		for (allocced_buf = allocced_buf_chain;
-		     allocced_buf;
-		     allocced_buf = allocced_buf->next_buffer) {
-			int allocated_size, allocation_size;
+		if ((allocation_size > allocated_size) ||
+		    ((allocated_size - allocation_size) >=
+		     (sizeof(struct shm_buffer) + sizeof(void *)))) {
+			ccprintf("inconsistency: allocated (size %d)"
+				 " allocation %d(size %d)\n",
+				 allocated_size, i, allocation_size);
+			return 0;
+		}
+	}
+	if (allocations_count != allocated_count) {
+		ccprintf("count mismatch (%d != %d)!\n",
+			 allocations_count, allocated_count);
+		return 0;
+	}
+	return 1;
+}
 
-			allocated_count++;
-			if (allocations[i].buf != (allocced_buf + 1))
-				continue;
+/*
+ * Verify that the free lists hold exactly the free buffers, and that their
+ * bitmaps match.
+ */
+static int free_lists_ok(int free_count)
+{
+	int fl, sl, count = 0;
 
-			allocated_size = allocced_buf->buffer_size;
-			allocation_size = allocations[i].buffer_size;
+	for (fl = 0; fl < SHM_FL_COUNT; fl++) {
+		for (sl = 0; sl < SHM_SL_COUNT; sl++) {
+			struct shm_buffer *pbuf = shm_free_lists[fl][sl];
+			int empty = !pbuf;
 
-			/*
-			 * Verify that size requested by the allocator matches
-			 * the value used by malloc, i.e. does not exceed the
-			 * allocated size and is no less than two buffer
-			 * structures lower (which can happen when the
-			 * requested size was rounded up to cover gaps smaller
-			 * than the buffer header structure size).
-			 */
-			if ((allocation_size > allocated_size) ||
-			    ((allocated_size - allocation_size) >=
-			     (2 * sizeof(struct shm_buffer) + sizeof(int)))) {
-				ccprintf("inconsistency: allocated (size %d)"
-					 " allocation %d(size %d)\n",
-					 allocated_size, i, allocation_size);
+			if (empty == !!(shm_sl_bitmap[fl] & BIT(sl))) {
+				ccprintf("bad bitmap for class %d/%d\n",
+					 fl, sl);
 				return 0;
 			}
-
-			if (allocation_match++) {
-				ccprintf("inconsistency: duplicated match\n");
+			if (pbuf && pbuf->prev_free) {
+				ccprintf("bad free list start %pP\n", pbuf);
 				return 0;
 			}
+			for (; pbuf; pbuf = pbuf->next_free) {
+				if (count++ > free_count ||
+				    !buf_is_free(pbuf) ||
+				    (pbuf->next_free &&
+				     pbuf->next_free->prev_free != pbuf)) {
+					ccprintf("bad free buffer %pP\n",
+						 pbuf);
+					return 0;
+				}
+			}
 		}
-		if (!allocation_match) {
-			ccprintf("missing match %pP!\n", allocations[i].buf);
+		if (!shm_sl_bitmap[fl] == !!(shm_fl_bitmap & BIT(fl))) {
+			ccprintf("bad bitmap for class %d\n", fl);
 			return 0;
 		}
 	}
-	if (allocations_count != allocated_count) {
-		ccprintf("count mismatch (%d != %d)!\n",
-			 allocations_count, allocated_count);
+
+	if (count != free_count) {
+		ccprintf("free count mismatch (%d != %d)!\n",
+			 count, free_count);
 		return 0;
 	}
 	return 1;
 }
 
 /*
- * Verify that shared memory is in a consistent state, i.e. that there is no
- * overlaps between allocated and free buffers, and that all memory is
- * accounted for (is either allocated or available).
+ * Verify that shared memory is in a consistent state, i.e. that buffers
+ * follow each other with no overlap or gap, that no two free buffers are
+ * left unmerged, and that all memory is accounted for (is either allocated
+ * or available).
  */
 
 static int shmem_is_ok(int line)
 {
-	int count = 0;
+	int free_count = 0, allocated_count = 0;
 	int running_size = 0;
-	struct shm_buffer *pbuf = free_buf_chain;
-
-	if (pbuf && pbuf->prev_buffer) {
-		ccprintf("Bad free buffer list start %pP\n", pbuf);
-		goto bailout;
-	}
-
-	while (pbuf) {
-		struct shm_buffer *top;
-
-		running_size += pbuf->buffer_size;
-		if (count++ > 100)
-			goto bailout;  /* Is there a loop? */
-
-		top = (struct shm_buffer *)((uintptr_t)pbuf +
-					     pbuf->buffer_size);
-		if (pbuf->next_buffer) {
-			if (top >= pbuf->next_buffer) {
-				ccprintf("%s:%d"
-					 " - inconsistent buffer size at %pP\n",
-					 __func__, __LINE__, pbuf);
-				goto bailout;
-			}
-			if (pbuf->next_buffer->prev_buffer != pbuf) {
+	struct shm_buffer *pbuf = shm_first;
+	struct shm_buffer *prev = NULL;
+
+	while ((uintptr_t)pbuf < shm_end) {
+		if (pbuf->prev_phys != prev) {
+			ccprintf("%s:%d"
+				 " - inconsistent prev buffer at %pP\n",
+				 __func__, __LINE__, pbuf);
+			goto bailout;
+		}
+		if (buf_size(pbuf) < sizeof(struct shm_buffer) ||
+		    buf_size(pbuf) % sizeof(void *)) {
+			ccprintf("%s:%d"
+				 " - inconsistent buffer size at %pP\n",
+				 __func__, __LINE__, pbuf);
+			goto bailout;
+		}
+		if (buf_is_free(pbuf)) {
+			if (prev && buf_is_free(prev)) {
 				ccprintf("%s:%d"
-					 " - inconsistent next buffer at %pP\n",
+					 " - unmerged free buffers at %pP\n",
 					 __func__, __LINE__, pbuf);
 				goto bailout;
 			}
+			free_count++;
+		} else {
+			allocated_count++;
 		}
-		pbuf = pbuf->next_buffer;
+
+		running_size += buf_size(pbuf);
+		prev = pbuf;
+		pbuf = (struct shm_buffer *)((uintptr_t)pbuf +
+					     buf_size(pbuf));
 	}
 
-	if (pbuf) { /* Must be a loop. */
-		ccprintf("Too many buffers in the chain\n");
+	if ((uintptr_t)pbuf != shm_end) {
+		ccprintf("Last buffer overflows\n");
 		goto bailout;
 	}
 
-	/* Make sure there were at least 5 buffers allocated at one point. */
-	if (count > 5)
-		set_map_bit(1 << 24);
-
-	/* Add allocated sizes. */
-	for (pbuf = allocced_buf_chain; pbuf; pbuf = pbuf->next_buffer)
-		running_size += pbuf->buffer_size;
+	/* Make sure there were at least 5 free buffers at one point. */
+	if (free_count > 5)
+		set_map_bit(BIT(MAX_MASK_BIT));
 
 	if (total_size) {
 		if (total_size != running_size)
@@ -188,7 +229,10 @@ static int shmem_is_ok(int line)
 		total_size = running_size;
 	}
 
-	if (!check_for_overlaps())
+	if (!free_lists_ok(free_count))
+		goto bailout;
+
+	if (!check_for_overlaps(allocated_count))
 		goto bailout;
 
 	return 1;
@@ -200,6 +244,39 @@ static int shmem_is_ok(int line)
 	return 0;
 }
 
+/*
+ * The largest buffer can be allocated, and releasing everything merges the
+ * memory back into a single buffer.
+ */
+static int test_largest(void)
+{
+	const int shmem_size = shared_mem_size();
+	char *ptr[3];
+	int i;
+
+	TEST_ASSERT(shared_mem_acquire(shmem_size, &ptr[0]) == EC_SUCCESS);
+	TEST_ASSERT(shared_mem_size() == 0);
+	TEST_ASSERT(shared_mem_acquire(1, &ptr[1]) == EC_ERROR_BUSY);
+	shared_mem_release(ptr[0]);
+	TEST_ASSERT(shared_mem_size() == shmem_size);
+
+	/* Release out of order, the middle one last. */
+	for (i = 0; i < ARRAY_SIZE(ptr); i++)
+		TEST_ASSERT(shared_mem_acquire(100, &ptr[i]) == EC_SUCCESS);
+	shared_mem_release(ptr[0]);
+	shared_mem_release(ptr[2]);
+	/* A buffer of the same size goes back in the first hole. */
+	TEST_ASSERT(shared_mem_acquire(100, &ptr[0]) == EC_SUCCESS);
+	shared_mem_release(ptr[0]);
+	shared_mem_release(ptr[1]);
+	/* Releasing twice is ignored. */
+	shared_mem_release(ptr[1]);
+	TEST_ASSERT(shmem_is_ok(__LINE__));
+	TEST_ASSERT(shared_mem_size() == shmem_size);
+
+	return EC_SUCCESS;
+}
+
 /*
  * Bitmap used to keep track of branches taken by malloc/free routines. Once
  * all bits in the 0..(MAX_MASK_BIT - 1) range are set, consider the test
@@ -212,6 +289,12 @@ void run_test(int argc, char **argv)
 	int index;
 	const int shmem_size = shared_mem_size();
 
+	if (test_largest() != EC_SUCCESS) {
+		ccprintf("test_largest failed\n");
+		test_fail();
+		return;
+	}
+
 	while (counter--) {
 		char *shptr;
 		uint32_t r_data;
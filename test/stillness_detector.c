@@ -5,8 +5,10 @@
 
 #include "stillness_detector.h"
 #include "motion_sense.h"
+#include "online_stats.h"
 #include "test_util.h"
 #include "timer.h"
+#include <math.h>
 #include <stdio.h>
 
 /*****************************************************************************/
@@ -123,6 +125,132 @@ static int test_resets(void)
 	return EC_SUCCESS;
 }
 
+#define STATS_SAMPLES 200
+#define BENCH_ITERATIONS 2000
+
+/*
+ * An accelerometer at rest reads about 1g plus noise in the 1e-3g range,
+ * which is where sum(x^2) - sum(x)^2 / n cancels out.
+ */
+static void fill_still_samples(fp_t samples[STATS_SAMPLES][3])
+{
+	int i;
+
+	for (i = 0; i < STATS_SAMPLES; i++) {
+		samples[i][X] = 0.05f + 0.002f * sinf(i * 0.37f);
+		samples[i][Y] = -0.03f + 0.001f * cosf(i * 1.13f);
+		samples[i][Z] = 9.81f + 0.003f * sinf(i * 0.71f + 0.5f);
+	}
+}
+
+/* Variance the way still_det used to compute it, from raw sums. */
+static fp_t raw_sums_variance(fp_t samples[STATS_SAMPLES][3], int axis)
+{
+	fp_t acc = 0.0f, acc_sq = 0.0f, inv;
+	int i;
+
+	for (i = 0; i < STATS_SAMPLES; i++) {
+		acc += samples[i][axis];
+		acc_sq += fp_mul(samples[i][axis], samples[i][axis]);
+	}
+	inv = fp_div(1.0f, INT_TO_FP(STATS_SAMPLES));
+	return fp_mul(acc_sq - fp_mul(fp_sq(acc), inv), inv);
+}
+
+static int test_online_stats_accuracy(void)
+{
+	fp_t samples[STATS_SAMPLES][3];
+	struct online_stats stats;
+	fpv3_t mean, var, unbiased;
+	double ref_mean, ref_var;
+	int err_ppm, raw_err_ppm;
+	int i, axis;
+
+	fill_still_samples(samples);
+
+	online_stats_reset(&stats);
+	TEST_ASSERT(!online_stats_compute(&stats, mean, var, false));
+	for (i = 0; i < STATS_SAMPLES; i++)
+		online_stats_update(&stats, samples[i][X], samples[i][Y],
+				    samples[i][Z]);
+	TEST_EQ(stats.n, STATS_SAMPLES, "%u");
+	TEST_ASSERT(online_stats_compute(&stats, mean, var, false));
+	TEST_ASSERT(online_stats_compute(&stats, NULL, unbiased, true));
+
+	for (axis = X; axis <= Z; axis++) {
+		ref_mean = 0;
+		for (i = 0; i < STATS_SAMPLES; i++)
+			ref_mean += samples[i][axis];
+		ref_mean /= STATS_SAMPLES;
+		ref_var = 0;
+		for (i = 0; i < STATS_SAMPLES; i++)
+			ref_var += (samples[i][axis] - ref_mean) *
+				   (samples[i][axis] - ref_mean);
+		ref_var /= STATS_SAMPLES;
+
+		/* Relative errors, in parts per million. */
+		err_ppm = fabs(var[axis] - ref_var) / ref_var * 1000000;
+		raw_err_ppm = fabs(raw_sums_variance(samples, axis) -
+				   ref_var) / ref_var * 1000000;
+		ccprints("axis %d: variance error %d ppm, raw sums %d ppm",
+			 axis, err_ppm, raw_err_ppm);
+
+		TEST_NEAR(mean[axis], ref_mean, 0.0001f, "%f");
+		TEST_LT(err_ppm, 1000, "%d");
+		TEST_LE(err_ppm, raw_err_ppm, "%d");
+		TEST_NEAR(unbiased[axis],
+			  ref_var * STATS_SAMPLES / (STATS_SAMPLES - 1),
+			  ref_var * 0.001f, "%f");
+	}
+
+	return EC_SUCCESS;
+}
+
+static int test_benchmark_online_stats(void)
+{
+	fp_t samples[STATS_SAMPLES][3];
+	fp_t acc[3], acc_sq[3];
+	struct online_stats stats;
+	fpv3_t mean, var;
+	uint64_t raw_ns, online_ns, t0;
+	int i, j;
+
+	fill_still_samples(samples);
+
+	t0 = test_bench_now_ns();
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		memset(acc, 0, sizeof(acc));
+		memset(acc_sq, 0, sizeof(acc_sq));
+		for (j = 0; j < STATS_SAMPLES; j++) {
+			acc[X] += samples[j][X];
+			acc[Y] += samples[j][Y];
+			acc[Z] += samples[j][Z];
+			acc_sq[X] += fp_mul(samples[j][X], samples[j][X]);
+			acc_sq[Y] += fp_mul(samples[j][Y], samples[j][Y]);
+			acc_sq[Z] += fp_mul(samples[j][Z], samples[j][Z]);
+		}
+		/* Keep the compiler from dropping the loop. */
+		__asm__ volatile("" : : "r"(acc), "r"(acc_sq) : "memory");
+	}
+	raw_ns = test_bench_now_ns() - t0;
+
+	t0 = test_bench_now_ns();
+	for (i = 0; i < BENCH_ITERATIONS; i++) {
+		online_stats_reset(&stats);
+		for (j = 0; j < STATS_SAMPLES; j++)
+			online_stats_update(&stats, samples[j][X],
+					    samples[j][Y], samples[j][Z]);
+	}
+	online_stats_compute(&stats, mean, var, false);
+	online_ns = test_bench_now_ns() - t0;
+
+	ccprints("variance update: raw sums %d ps/sample, online %d ps/sample",
+		 (int)(raw_ns * 1000 / (BENCH_ITERATIONS * STATS_SAMPLES)),
+		 (int)(online_ns * 1000 / (BENCH_ITERATIONS * STATS_SAMPLES)));
+
+	return EC_SUCCESS;
+}
+
 void run_test(int argc, char **argv)
 {
 	test_reset();
@@ -134,6 +262,8 @@ void run_test(int argc, char **argv)
 	RUN_TEST(test_is_still_all_axes);
 	RUN_TEST(test_not_still_one_axis);
 	RUN_TEST(test_resets);
+	RUN_TEST(test_online_stats_accuracy);
+	RUN_TEST(test_benchmark_online_stats);
 
 	test_print_result();
 }
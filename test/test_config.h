@@ -99,12 +99,16 @@
 #define CONFIG_SHA256
 #endif
 
-#ifdef TEST_MOTION_SENSE_FIFO
+#if defined(TEST_MOTION_SENSE_FIFO) || defined(TEST_MOTION_SENSE_FIFO_COMPACT)
 #define CONFIG_ACCEL_FIFO
 #define CONFIG_ACCEL_FIFO_SIZE 256
 #define CONFIG_ACCEL_FIFO_THRES 10
 #endif
 
+#ifdef TEST_MOTION_SENSE_FIFO_COMPACT
+#define CONFIG_ACCEL_FIFO_COMPACT
+#endif
+
 #ifdef TEST_KASA
 #define CONFIG_FPU
 #define CONFIG_ONLINE_CALIB
@@ -156,10 +160,13 @@
 
 #if defined(CONFIG_ONLINE_CALIB) || \
 	defined(TEST_BODY_DETECTION) || \
+	defined(TEST_BODY_DETECTION_DECIM) || \
 	defined(TEST_MOTION_ANGLE) || \
 	defined(TEST_MOTION_ANGLE_TABLET) || \
 	defined(TEST_MOTION_LID) || \
-	defined(TEST_MOTION_SENSE_FIFO)
+	defined(TEST_MOTION_LID_STREAMING) || \
+	defined(TEST_MOTION_SENSE_FIFO) || \
+	defined(TEST_MOTION_SENSE_FIFO_COMPACT)
 enum sensor_id {
 	BASE,
 	LID,
@@ -181,17 +188,26 @@ enum sensor_id {
 #define CONFIG_ACCEL_STD_REF_FRAME_OLD
 #endif
 
+#if defined(TEST_MOTION_LID_STREAMING)
+#define CONFIG_LID_ANGLE_STREAMING
+#endif
+
 #if defined(TEST_MOTION_ANGLE_TABLET)
 #define CONFIG_ACCEL_FORCE_MODE_MASK \
 	((1 << CONFIG_LID_ANGLE_SENSOR_BASE) | \
 	 (1 << CONFIG_LID_ANGLE_SENSOR_LID))
 #endif
 
-#if defined(TEST_BODY_DETECTION)
+#if defined(TEST_BODY_DETECTION) || defined(TEST_BODY_DETECTION_DECIM)
 #define CONFIG_BODY_DETECTION
 #define CONFIG_BODY_DETECTION_SENSOR BASE
 #endif
 
+#if defined(TEST_BODY_DETECTION_DECIM)
+#define CONFIG_MOTION_SENSE_DECIM
+#define CONFIG_BODY_DETECTION_DECIM 2
+#endif
+
 #ifdef TEST_RMA_AUTH
 
 /* Test server public and private keys */
@@ -223,6 +239,16 @@ enum sensor_id {
 #define CONFIG_SW_CRC
 #endif
 
+#ifdef TEST_CRC32_SLICE4
+#define CONFIG_SW_CRC
+#define CONFIG_SW_CRC_SLICE 4
+#endif
+
+#ifdef TEST_CRC32_SLICE8
+#define CONFIG_SW_CRC
+#define CONFIG_SW_CRC_SLICE 8
+#endif
+
 #ifdef TEST_RSA
 #define CONFIG_RSA
 #undef CONFIG_RSA_KEY_SIZE
@@ -238,6 +264,13 @@ enum sensor_id {
 #define CONFIG_RSA_EXPONENT_3
 #define CONFIG_RWSIG_TYPE_RWSIG
 #endif
+#ifdef TEST_RSA3072
+#define CONFIG_RSA
+#undef CONFIG_RSA_KEY_SIZE
+#define CONFIG_RSA_KEY_SIZE 3072
+#define CONFIG_RSA_EXPONENT_3
+#define CONFIG_RWSIG_TYPE_RWSIG
+#endif
 
 #ifdef TEST_SHA256
 #define CONFIG_SHA256
@@ -252,6 +285,10 @@ enum sensor_id {
 #define CONFIG_MALLOC
 #endif
 
+#ifdef TEST_FLASH_STORAGE
+#define CONFIG_CRC8
+#endif
+
 #ifdef TEST_SBS_CHARGING_V2
 #define CONFIG_BATTERY
 #define CONFIG_BATTERY_MOCK
@@ -464,7 +501,7 @@ int ncp15wb_calculate_temp(uint16_t adc);
 #undef CONFIG_USB_PD_HOST_CMD
 #endif
 
-#ifdef TEST_USB_TCPMV2_TCPCI
+#if defined(TEST_USB_TCPMV2_TCPCI) || defined(TEST_USB_TCPMV2_TCPCI_TICKLESS)
 #define CONFIG_USB_DRP_ACC_TRYSRC
 #define CONFIG_USB_PD_DUAL_ROLE
 #define CONFIG_USB_PD_DUAL_ROLE_AUTO_TOGGLE
@@ -489,6 +526,11 @@ int ncp15wb_calculate_temp(uint16_t adc);
 #define CONFIG_USB_PD_DEBUG_LEVEL 3
 #define CONFIG_USB_PD_EXTENDED_MESSAGES
 #define CONFIG_USB_PD_DECODE_SOP
+#define CONFIG_USB_PD_TCPC_RUNTIME_CONFIG
+#define CONFIG_CMD_TCPCI_ALERT_STATS
+#ifdef TEST_USB_TCPMV2_TCPCI_TICKLESS
+#define CONFIG_USB_PD_TICKLESS
+#endif
 #endif
 
 #ifdef TEST_USB_PD_INT
@@ -581,6 +623,26 @@ int ncp15wb_calculate_temp(uint16_t adc);
 #define CONFIG_CURVE25519
 #endif /* TEST_X25519 */
 
+#ifdef TEST_I2C_ASYNC
+#define CONFIG_I2C
+#define CONFIG_I2C_MASTER
+#define CONFIG_I2C_ASYNC
+#endif
+
+#ifdef TEST_I2C_MSGS
+#undef CONFIG_I2C_NACK_RETRY_COUNT
+#define CONFIG_I2C_NACK_RETRY_COUNT 2
+#endif
+
+#ifdef TEST_I2C_PROFILE
+#define CONFIG_I2C
+#define CONFIG_I2C_MASTER
+#define CONFIG_I2C_PROFILE
+#define CONFIG_I2C_PROFILE_SLAVES 2
+#undef CONFIG_I2C_NACK_RETRY_COUNT
+#define CONFIG_I2C_NACK_RETRY_COUNT 2
+#endif
+
 #ifdef TEST_I2C_BITBANG
 #define CONFIG_I2C
 #define CONFIG_I2C_MASTER
@@ -42,6 +42,7 @@ const int test_pe_sm_data_size;
 test_static int test_no_parent_cycles(const struct test_sm_data * const sm_data)
 {
 	int i;
+	int max_depth = 0;
 
 	for (i = 0; i < sm_data->size; ++i) {
 		int depth = 0;
@@ -52,11 +53,16 @@ test_static int test_no_parent_cycles(const struct test_sm_data * const sm_data)
 
 		if (depth > sm_data->size)
 			break;
+
+		max_depth = MAX(max_depth, depth);
 	}
 
 	/* Ensure all states end, otherwise the ith state has a cycle. */
 	TEST_EQ(i, sm_data->size, "%d");
 
+	/* Ensure set_state() can flatten the ancestry of every state */
+	TEST_LE(max_depth, USB_SM_MAX_DEPTH, "%d");
+
 	return EC_SUCCESS;
 }
 
@@ -5,6 +5,7 @@
  * Test USB Type-C VPD and CTVPD module.
  */
 #include "common.h"
+#include "console.h"
 #include "task.h"
 #include "test_util.h"
 #include "timer.h"
@@ -963,6 +964,102 @@ static const struct usb_state states[] = {
 	},
 };
 
+/*
+ * Benchmark states mirror the A4 and B4 branches of the hierarchy above, with
+ * a callback that only counts, so that the framework itself dominates.
+ */
+#define BENCH_ITERATIONS 100000
+
+static int bench_calls;
+
+static void sm_bench_count(const int port)
+{
+	bench_calls++;
+}
+
+#define SM_BENCH_STATE(p) {			\
+		.entry  = sm_bench_count,	\
+		.run    = sm_bench_count,	\
+		.exit   = sm_bench_count,	\
+		.parent = (p),			\
+	}
+
+#ifdef TEST_AT_LEAST_3
+static const struct usb_state bench_a1 = SM_BENCH_STATE(NULL);
+static const struct usb_state bench_b1 = SM_BENCH_STATE(NULL);
+#define BENCH_A1 &bench_a1
+#define BENCH_B1 &bench_b1
+#else
+#define BENCH_A1 NULL
+#define BENCH_B1 NULL
+#endif
+#ifdef TEST_AT_LEAST_2
+static const struct usb_state bench_a2 = SM_BENCH_STATE(BENCH_A1);
+static const struct usb_state bench_b2 = SM_BENCH_STATE(BENCH_B1);
+#define BENCH_A2 &bench_a2
+#define BENCH_B2 &bench_b2
+#else
+#define BENCH_A2 NULL
+#define BENCH_B2 NULL
+#endif
+#ifdef TEST_AT_LEAST_1
+static const struct usb_state bench_a3 = SM_BENCH_STATE(BENCH_A2);
+static const struct usb_state bench_b3 = SM_BENCH_STATE(BENCH_B2);
+#define BENCH_A3 &bench_a3
+#define BENCH_B3 &bench_b3
+#else
+#define BENCH_A3 NULL
+#define BENCH_B3 NULL
+#endif
+static const struct usb_state bench_a4 = SM_BENCH_STATE(BENCH_A3);
+static const struct usb_state bench_a5 = SM_BENCH_STATE(BENCH_A3);
+static const struct usb_state bench_b4 = SM_BENCH_STATE(BENCH_B3);
+
+test_static int test_benchmark(void)
+{
+	struct sm_ctx ctx = { 0 };
+	usb_state_ptr state;
+	int depth = 0;
+	uint64_t t0;
+	uint64_t t1;
+	int i;
+
+	for (state = &bench_a4; state != NULL; state = state->parent)
+		depth++;
+
+	/* Sibling transitions only exit and enter the leaf states */
+	set_state(PORT0, &ctx, &bench_a4);
+	bench_calls = 0;
+	t0 = test_bench_now_ns();
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		set_state(PORT0, &ctx, (i & 1) ? &bench_a4 : &bench_a5);
+	t1 = test_bench_now_ns();
+	TEST_EQ(bench_calls, 2 * BENCH_ITERATIONS, "%d");
+	ccprints("depth %d: sibling set_state %d ns", depth,
+		 (int)((t1 - t0) / BENCH_ITERATIONS));
+
+	/* Transitions across the hierarchy exit and enter every level */
+	bench_calls = 0;
+	t0 = test_bench_now_ns();
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		set_state(PORT0, &ctx, (i & 1) ? &bench_a4 : &bench_b4);
+	t1 = test_bench_now_ns();
+	TEST_EQ(bench_calls, 2 * depth * BENCH_ITERATIONS, "%d");
+	ccprints("depth %d: disjoint set_state %d ns", depth,
+		 (int)((t1 - t0) / BENCH_ITERATIONS));
+
+	bench_calls = 0;
+	t0 = test_bench_now_ns();
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		run_state(PORT0, &ctx);
+	t1 = test_bench_now_ns();
+	TEST_EQ(bench_calls, depth * BENCH_ITERATIONS, "%d");
+	ccprints("depth %d: run_state %d ns", depth,
+		 (int)((t1 - t0) / BENCH_ITERATIONS));
+
+	return EC_SUCCESS;
+}
+
 /* Run before each RUN_TEST line */
 void before_test(void)
 {
@@ -998,5 +1095,6 @@ void run_test(int argc, char **argv)
 #else
 	RUN_TEST(test_hierarchy_0);
 #endif
+	RUN_TEST(test_benchmark);
 	test_print_result();
 }
@@ -13,6 +13,7 @@
 #include "usb_mux.h"
 #include "usb_tc_sm.h"
 #include "usb_prl_sm.h"
+#include "usb_sm.h"
 
 #define PORT0 0
 
@@ -83,7 +84,7 @@ int pd_check_vconn_swap(int port)
 
 void board_reset_pd_mcu(void) {}
 
-const struct tcpc_config_t tcpc_config[CONFIG_USB_PD_PORT_MAX_COUNT] = {
+struct tcpc_config_t tcpc_config[CONFIG_USB_PD_PORT_MAX_COUNT] = {
 	{
 		.bus_type = EC_BUS_TYPE_I2C,
 		.i2c_info = {
@@ -253,6 +254,113 @@ __maybe_unused static int test_connect_as_pd3_source(void)
 	return EC_SUCCESS;
 }
 
+__maybe_unused static int test_connect_as_pd3_source_burst_read(void)
+{
+	tcpc_config[PORT0].flags |= TCPC_FLAGS_ALERT_BURST_READ;
+
+	return test_connect_as_pd3_source();
+}
+
+__maybe_unused static int test_alert_burst_read(void)
+{
+	int single_xfers;
+	int burst_xfers;
+
+	TEST_EQ(test_startup_and_resume(), EC_SUCCESS, "%d");
+
+	/*
+	 * Simulate a non-PD power supply being plugged in. The first alert
+	 * also brings the TCPC out of low power mode, so only measure the
+	 * one that follows.
+	 */
+	mock_set_cc(MOCK_CC_WE_ARE_SNK, MOCK_CC_SNK_OPEN, MOCK_CC_SNK_RP_3_0);
+	mock_set_alert(TCPC_REG_ALERT_CC_STATUS);
+	task_wait_event(10 * MSEC);
+	mock_set_alert(TCPC_REG_ALERT_CC_STATUS);
+	task_wait_event(40 * MSEC);
+	single_xfers = tcpci_get_last_alert_xfers(PORT0);
+
+	/* Repeat the same CC alert, decoded from a single burst read */
+	tcpc_config[PORT0].flags |= TCPC_FLAGS_ALERT_BURST_READ;
+	mock_set_alert(TCPC_REG_ALERT_CC_STATUS);
+	task_wait_event(40 * MSEC);
+	burst_xfers = tcpci_get_last_alert_xfers(PORT0);
+
+	ccprints("CC alert I2C xfers: %d single, %d burst", single_xfers,
+		 burst_xfers);
+	TEST_LT(burst_xfers, single_xfers, "%d");
+
+	/* VBUS detection must still work from the snapshot */
+	mock_tcpci_set_reg(TCPC_REG_POWER_STATUS,
+			   TCPC_REG_POWER_STATUS_VBUS_PRES);
+	mock_set_alert(TCPC_REG_ALERT_POWER_STATUS);
+
+	task_wait_event(10 * SECOND);
+	TEST_EQ(tc_is_attached_snk(PORT0), true, "%d");
+
+	return EC_SUCCESS;
+}
+
+__maybe_unused static int get_rx_stats(
+	const struct ec_params_typec_rx_stats *p,
+	struct ec_response_typec_rx_stats *r)
+{
+	return test_send_host_command(
+		EC_PRIVATE_HOST_COMMAND_VALUE(EC_CMD_TYPEC_RX_STATS), 0,
+		p, sizeof(*p), r, sizeof(*r));
+}
+
+__maybe_unused static int test_rx_queue_flood(void)
+{
+	struct ec_params_typec_rx_stats p = {
+		.port = PORT0,
+		.flags = EC_TYPEC_RX_STATS_RESET,
+	};
+	struct ec_response_typec_rx_stats r;
+	const int extra = 4;
+	int i;
+
+	TEST_EQ(test_connect_as_nonpd_sink(), EC_SUCCESS, "%d");
+	TEST_EQ(get_rx_stats(&p, &r), EC_RES_SUCCESS, "%d");
+
+	/*
+	 * Run the alert handler back to back from this task, which has a
+	 * higher priority than the PD task, so nothing is consumed until the
+	 * flood is over.
+	 */
+	for (i = 0; i < CONFIG_USB_PD_TCPM_RX_DEPTH + extra; i++) {
+		mock_tcpci_receive(PD_MSG_SOP,
+			PD_HEADER(PD_CTRL_PING, PD_ROLE_SOURCE, PD_ROLE_DFP,
+				  0, 0, PD_REV30, 0),
+			NULL);
+		mock_tcpci_set_reg(TCPC_REG_ALERT, TCPC_REG_ALERT_RX_STATUS);
+		tcpc_config[PORT0].drv->tcpc_alert(PORT0);
+		/* Lost messages must still be pulled off the TCPC */
+		TEST_EQ(mock_tcpci_get_reg(TCPC_REG_ALERT) &
+			TCPC_REG_ALERT_RX_STATUS, 0, "%d");
+	}
+
+	p.flags = 0;
+	TEST_EQ(get_rx_stats(&p, &r), EC_RES_SUCCESS, "%d");
+	TEST_EQ(r.depth, CONFIG_USB_PD_TCPM_RX_DEPTH, "%d");
+	TEST_EQ(r.pending, CONFIG_USB_PD_TCPM_RX_DEPTH, "%d");
+	TEST_EQ(r.high_water, CONFIG_USB_PD_TCPM_RX_DEPTH, "%d");
+	TEST_EQ(r.received, CONFIG_USB_PD_TCPM_RX_DEPTH, "%d");
+	TEST_EQ(r.lost, extra, "%d");
+
+	/* The PD task drains the queue and the port stays up */
+	task_wait_event(100 * MSEC);
+	TEST_EQ(get_rx_stats(&p, &r), EC_RES_SUCCESS, "%d");
+	TEST_EQ(r.pending, 0, "%d");
+	TEST_EQ(tc_is_attached_snk(PORT0), true, "%d");
+
+	/* Out of range ports are rejected */
+	p.port = CONFIG_USB_PD_PORT_MAX_COUNT;
+	TEST_EQ(get_rx_stats(&p, &r), EC_RES_INVALID_PARAM, "%d");
+
+	return EC_SUCCESS;
+}
+
 __maybe_unused static int test_retry_count_sop(void)
 {
 	/* DRP auto-toggling with AP in S0, source enabled. */
@@ -365,9 +473,54 @@ __maybe_unused static int test_pd3_source_send_soft_reset(void)
 	return EC_SUCCESS;
 }
 
+__maybe_unused static int test_next_deadline(void)
+{
+	const uint64_t timer = 1000;
+
+	/* Timers expire once the time is past them */
+	TEST_ASSERT(sm_next_deadline(USBC_NO_DEADLINE, timer, 500) ==
+		    timer + 1);
+	/* Woken exactly at the timer: not expired yet, still a deadline */
+	TEST_ASSERT(sm_next_deadline(USBC_NO_DEADLINE, timer, timer) ==
+		    timer + 1);
+	/* Expired when the state machine ran */
+	TEST_ASSERT(sm_next_deadline(USBC_NO_DEADLINE, timer, timer + 1) ==
+		    USBC_NO_DEADLINE);
+	/* Disabled timer */
+	TEST_ASSERT(sm_next_deadline(timer, USBC_NO_DEADLINE, 500) == timer);
+	/* An earlier deadline is kept */
+	TEST_ASSERT(sm_next_deadline(timer, timer + 10, 500) == timer);
+
+	return EC_SUCCESS;
+}
+
+__maybe_unused static int test_pd3_source_idle_wakeups(void)
+{
+	uint32_t wakeups;
+
+	/* Reach PE_SRC_READY with an explicit contract and nothing to do */
+	TEST_EQ(test_connect_as_pd3_source(), EC_SUCCESS, "%d");
+
+	wakeups = pd_task_get_wakeups(PORT0);
+	task_wait_event(SECOND);
+	wakeups = pd_task_get_wakeups(PORT0) - wakeups;
+	ccprints("PD task wakeups while idle: %u/s", wakeups);
+
+	/* Polling every USBC_EVENT_TIMEOUT would be about 200 wakeups */
+	if (IS_ENABLED(CONFIG_USB_PD_TICKLESS))
+		TEST_LE(wakeups, (uint32_t)(SECOND /
+			CONFIG_USB_PD_TICKLESS_MAX_SLEEP + 5), "%u");
+	else
+		TEST_GE(wakeups, (uint32_t)(SECOND / USBC_EVENT_TIMEOUT / 2),
+			"%u");
+
+	return EC_SUCCESS;
+}
+
 void before_test(void)
 {
 	rx_id = 0;
+	tcpc_config[PORT0].flags &= ~TCPC_FLAGS_ALERT_BURST_READ;
 
 	mock_usb_mux_reset();
 	mock_tcpci_reset();
@@ -384,9 +537,14 @@ void run_test(int argc, char **argv)
 	RUN_TEST(test_connect_as_nonpd_sink);
 	RUN_TEST(test_startup_and_resume);
 	RUN_TEST(test_connect_as_pd3_source);
+	RUN_TEST(test_connect_as_pd3_source_burst_read);
+	RUN_TEST(test_alert_burst_read);
+	RUN_TEST(test_rx_queue_flood);
 	RUN_TEST(test_retry_count_sop);
 	RUN_TEST(test_retry_count_hard_reset);
 	RUN_TEST(test_pd3_source_send_soft_reset);
+	RUN_TEST(test_next_deadline);
+	RUN_TEST(test_pd3_source_idle_wakeups);
 
 	test_print_result();
 }
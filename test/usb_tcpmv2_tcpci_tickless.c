@@ -0,0 +1 @@
+usb_tcpmv2_tcpci.c
\ No newline at end of file
@@ -35,6 +35,7 @@
  * SUCH DAMAGE.
  */
 
+#include "endian.h"
 #include "sha256.h"
 #include "util.h"
 
@@ -67,16 +68,23 @@
 
 /* Macros used for loops unrolling */
 
-#define SHA256_SCR(i)						\
-	{							\
-		w[i] =  SHA256_F4(w[i -  2]) + w[i -  7]	\
-			+ SHA256_F3(w[i - 15]) + w[i - 16];	\
+/*
+ * The message schedule is kept in a rolling window of 16 words: w[i] only
+ * depends on w[i - 2], w[i - 7], w[i - 15] and w[i - 16], and the latter is
+ * not needed anymore once w[i] is computed, so it is overwritten in place.
+ */
+#define SHA256_W(i) w[(i) & 15]
+
+#define SHA256_SCR(i)							\
+	{								\
+		SHA256_W(i) += SHA256_F4(SHA256_W((i) - 2))		\
+			+ SHA256_W((i) - 7) + SHA256_F3(SHA256_W((i) - 15)); \
 	}
 
 #define SHA256_EXP(a, b, c, d, e, f, g, h, j)				\
 	{								\
 		t1 = wv[h] + SHA256_F2(wv[e]) + CH(wv[e], wv[f], wv[g])	\
-			+ sha256_k[j] + w[j];				\
+			+ sha256_k[j] + SHA256_W(j);			\
 		t2 = SHA256_F1(wv[a]) + MAJ(wv[a], wv[b], wv[c]);	\
 		wv[d] += t1;						\
 		wv[h] = t1 + t2;					\
@@ -115,11 +123,18 @@ void SHA256_init(struct sha256_ctx *ctx)
 	ctx->tot_len = 0;
 }
 
+#ifdef CONFIG_SHA256_HW_ACCELERATE
+static void SHA256_transform(struct sha256_ctx *ctx, const uint8_t *message,
+			     unsigned int block_nb)
+{
+	if (block_nb)
+		SHA256_hw_transform(ctx->h, message, block_nb);
+}
+#else
 static void SHA256_transform(struct sha256_ctx *ctx, const uint8_t *message,
 			     unsigned int block_nb)
 {
-	/* Note: this function requires a considerable amount of stack */
-	uint32_t w[64];
+	uint32_t w[16];
 	uint32_t wv[8];
 	uint32_t t1, t2;
 	const unsigned char *sub_block;
@@ -128,30 +143,32 @@ static void SHA256_transform(struct sha256_ctx *ctx, const uint8_t *message,
 	for (i = 0; i < (int) block_nb; i++) {
 		sub_block = message + (i << 6);
 
-		for (j = 0; j < 16; j++)
-			PACK32(&sub_block[j << 2], &w[j]);
+		/* Image and context buffers are word aligned, load words. */
+		if (((uintptr_t)sub_block & 3) == 0) {
+			const uint32_t *words = (const uint32_t *)sub_block;
 
-#ifdef CONFIG_SHA256_UNROLLED
-		for (j = 16; j < 64; j += 8) {
-			SHA256_SCR(j);
-			SHA256_SCR(j+1);
-			SHA256_SCR(j+2);
-			SHA256_SCR(j+3);
-			SHA256_SCR(j+4);
-			SHA256_SCR(j+5);
-			SHA256_SCR(j+6);
-			SHA256_SCR(j+7);
+			for (j = 0; j < 16; j++)
+				w[j] = be32toh(words[j]);
+		} else {
+			for (j = 0; j < 16; j++)
+				PACK32(&sub_block[j << 2], &w[j]);
 		}
-#else
-		for (j = 16; j < 64; j++)
-			SHA256_SCR(j);
-#endif
 
 		for (j = 0; j < 8; j++)
 			wv[j] = ctx->h[j];
 
 #ifdef CONFIG_SHA256_UNROLLED
 		for (j = 0; j < 64; j += 8) {
+			if (j >= 16) {
+				SHA256_SCR(j);
+				SHA256_SCR(j+1);
+				SHA256_SCR(j+2);
+				SHA256_SCR(j+3);
+				SHA256_SCR(j+4);
+				SHA256_SCR(j+5);
+				SHA256_SCR(j+6);
+				SHA256_SCR(j+7);
+			}
 			SHA256_EXP(0, 1, 2, 3, 4, 5, 6, 7, j);
 			SHA256_EXP(7, 0, 1, 2, 3, 4, 5, 6, j+1);
 			SHA256_EXP(6, 7, 0, 1, 2, 3, 4, 5, j+2);
@@ -163,8 +180,10 @@ static void SHA256_transform(struct sha256_ctx *ctx, const uint8_t *message,
 		}
 #else
 		for (j = 0; j < 64; j++) {
+			if (j >= 16)
+				SHA256_SCR(j);
 			t1 = wv[7] + SHA256_F2(wv[4]) + CH(wv[4], wv[5], wv[6])
-				+ sha256_k[j] + w[j];
+				+ sha256_k[j] + SHA256_W(j);
 			t2 = SHA256_F1(wv[0]) + MAJ(wv[0], wv[1], wv[2]);
 			wv[7] = wv[6];
 			wv[6] = wv[5];
@@ -181,6 +200,7 @@ static void SHA256_transform(struct sha256_ctx *ctx, const uint8_t *message,
 			ctx->h[j] += wv[j];
 	}
 }
+#endif /* CONFIG_SHA256_HW_ACCELERATE */
 
 void SHA256_update(struct sha256_ctx *ctx, const uint8_t *data, uint32_t len)
 {
@@ -256,6 +276,18 @@ uint8_t *SHA256_final(struct sha256_ctx *ctx)
 	return ctx->buf;
 }
 
+void SHA256_hash_bufs(const struct sha256_buf *bufs, int count,
+		      uint8_t *digest)
+{
+	struct sha256_ctx ctx;
+	int i;
+
+	SHA256_init(&ctx);
+	for (i = 0; i < count; i++)
+		SHA256_update(&ctx, bufs[i].data, bufs[i].len);
+	memcpy(digest, SHA256_final(&ctx), SHA256_DIGEST_SIZE);
+}
+
 static void hmac_SHA256_step(uint8_t *output, uint8_t mask,
 			const uint8_t *key, const int key_len,
 			const uint8_t *data, const int data_len) {